@@ -0,0 +1,89 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of the hot functions of gcu-align-params-on-parenthesis (see
+ * gcu-bench.c). The source file of the tool is included, to call its static
+ * functions. Its main() is renamed, and not called.
+ */
+
+int gcu_align_params_on_parenthesis_main (void);
+
+#define main gcu_align_params_on_parenthesis_main
+#include "gcu-align-params-on-parenthesis.c"
+#undef main
+
+#include <string.h>
+#include "gcu-bench.h"
+
+static void
+call_get_column_num (gpointer user_data)
+{
+  const gchar *first_line = user_data;
+
+  gcu_bench_sink += get_column_num (first_line);
+}
+
+static void
+run_get_column_num (GcuBench    *bench,
+                    const gchar *input_name,
+                    const gchar *first_line)
+{
+  gcu_bench_run (bench,
+                 "get_column_num",
+                 input_name,
+                 strlen (first_line),
+                 call_get_column_num,
+                 (gpointer) first_line);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GcuBench *bench;
+  gchar *str;
+  gchar *long_line;
+  gchar *long_line_without_paren;
+  gchar *long_utf8_line;
+
+  bench = gcu_bench_new (&argc, &argv);
+
+  str = gcu_bench_repeat ("word ", 20000);
+  long_line = g_strconcat (str, "(param,", NULL);
+  long_line_without_paren = g_strconcat (str, "param,", NULL);
+  g_free (str);
+
+  /* Two bytes per character. */
+  str = gcu_bench_repeat ("é", 50000);
+  long_utf8_line = g_strconcat (str, "(param,", NULL);
+  g_free (str);
+
+  run_get_column_num (bench, "typical", "  gtk_text_buffer_insert (buffer,");
+  run_get_column_num (bench, "nested", "  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer) && (text != NULL ||");
+  run_get_column_num (bench, "paren-at-end-100k", long_line);
+  run_get_column_num (bench, "no-paren-100k", long_line_without_paren);
+  run_get_column_num (bench, "utf8-100k", long_utf8_line);
+
+  g_free (long_line);
+  g_free (long_line_without_paren);
+  g_free (long_utf8_line);
+
+  return gcu_bench_finish (bench);
+}
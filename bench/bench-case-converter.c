@@ -0,0 +1,96 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of the hot functions of gcu-case-converter (see
+ * gcu-bench.c). The source file of the tool is included, to call its static
+ * functions. Its main() is renamed, and not called.
+ */
+
+int gcu_case_converter_main (int    argc,
+                             char **argv);
+
+#define main gcu_case_converter_main
+#include "gcu-case-converter.c"
+#undef main
+
+#include <string.h>
+#include "gcu-bench.h"
+
+typedef struct
+{
+  const gchar *word;
+  GcuCase to_case;
+} ConvertInput;
+
+static void
+call_convert_word (gpointer user_data)
+{
+  const ConvertInput *input = user_data;
+  gchar *converted_word;
+
+  converted_word = convert_word (input->word, input->to_case);
+  gcu_bench_sink += converted_word[0];
+  g_free (converted_word);
+}
+
+static void
+run_convert_word (GcuBench    *bench,
+                  const gchar *input_name,
+                  const gchar *word,
+                  GcuCase      to_case)
+{
+  ConvertInput input;
+
+  input.word = word;
+  input.to_case = to_case;
+
+  gcu_bench_run (bench, "convert_word", input_name, strlen (word), call_convert_word, &input);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GcuBench *bench;
+  gchar *long_lowercase;
+  gchar *long_camelcase;
+  gchar *alternating_case;
+
+  bench = gcu_bench_new (&argc, &argv);
+
+  long_lowercase = gcu_bench_repeat ("text_buffer_", 1000);
+  long_camelcase = gcu_bench_repeat ("TextBuffer", 1000);
+
+  /* Each character starts a subword. */
+  alternating_case = gcu_bench_repeat ("aB", 5000);
+
+  run_convert_word (bench, "lower-to-camel", "gtk_text_buffer", GCU_CASE_TO_CAMELCASE);
+  run_convert_word (bench, "camel-to-upper", "GtkTextBuffer", GCU_CASE_TO_UPPERCASE);
+  run_convert_word (bench, "upper-to-lower", "GTK_TEXT_BUFFER", GCU_CASE_TO_LOWERCASE);
+  run_convert_word (bench, "lower-to-camel-12k", long_lowercase, GCU_CASE_TO_CAMELCASE);
+  run_convert_word (bench, "camel-to-lower-10k", long_camelcase, GCU_CASE_TO_LOWERCASE);
+  run_convert_word (bench, "alternating-to-upper-10k", alternating_case, GCU_CASE_TO_UPPERCASE);
+
+  g_free (long_lowercase);
+  g_free (long_camelcase);
+  g_free (alternating_case);
+
+  return gcu_bench_finish (bench);
+}
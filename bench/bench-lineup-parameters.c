@@ -0,0 +1,333 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of the hot functions of gcu-lineup-parameters (see
+ * gcu-bench.c). The source file of the tool is included, to call its static
+ * functions. Its main() is renamed, and not called.
+ *
+ * The "parse_contents_to_memory" benchmark processes the same set of files
+ * with 1, 2, 4, ... threads, up to the number of processors. Its throughput
+ * should grow almost linearly with the number of threads, the threads sharing
+ * nothing but the job queue (see gcu-arena.c).
+ */
+
+int gcu_lineup_parameters_main (int    argc,
+                                char **argv);
+
+#define main gcu_lineup_parameters_main
+#include "gcu-lineup-parameters.c"
+#undef main
+
+#include "gcu-bench.h"
+
+typedef struct
+{
+  GOutputStream *output_stream;
+  gchar **lines;
+  guint length;
+} DeclarationInput;
+
+/* The number of files per run of the scaling benchmark. */
+#define N_SCALING_FILES (64)
+
+typedef struct
+{
+  GThreadPool *pool;
+  const gchar *contents;
+  gsize length;
+
+  GMutex mutex;
+  GCond cond;
+  guint n_files_remaining;
+} ScalingInput;
+
+static void
+call_match_function_name (gpointer user_data)
+{
+  const gchar *line = user_data;
+  gchar *function_name = NULL;
+  gint first_param_pos = 0;
+
+  if (match_function_name (line, &function_name, &first_param_pos))
+    gcu_bench_sink += first_param_pos;
+
+  gcu_arena_reset (gcu_arena_get_for_thread ());
+}
+
+static void
+call_match_parameter (gpointer user_data)
+{
+  gchar *line = user_data;
+  ParameterInfo *info = NULL;
+  gboolean is_last_parameter;
+
+  if (match_parameter (line, &info, &is_last_parameter))
+    gcu_bench_sink += info->nb_stars;
+
+  gcu_arena_reset (gcu_arena_get_for_thread ());
+}
+
+static void
+call_print_function_declaration (gpointer user_data)
+{
+  DeclarationInput *input = user_data;
+  GError *error = NULL;
+
+  g_seekable_seek (G_SEEKABLE (input->output_stream), 0, G_SEEK_SET, NULL, &error);
+  g_assert_no_error (error);
+
+  print_function_declaration (input->output_stream, input->lines, input->length);
+  gcu_arena_reset (gcu_arena_get_for_thread ());
+}
+
+static void
+scaling_job_run (gpointer data,
+                 gpointer user_data)
+{
+  ScalingInput *input = user_data;
+  GMemoryOutputStream *output_stream;
+
+  if (parse_contents_to_memory (input->contents, input->length, &output_stream))
+    gcu_bench_sink++;
+
+  free_output_stream (output_stream);
+
+  g_mutex_lock (&input->mutex);
+  input->n_files_remaining--;
+  if (input->n_files_remaining == 0)
+    g_cond_signal (&input->cond);
+  g_mutex_unlock (&input->mutex);
+}
+
+/* The pool is kept between the calls, so that its threads and their buffers
+ * are reused like in a real run.
+ */
+static void
+call_parse_contents_to_memory (gpointer user_data)
+{
+  ScalingInput *input = user_data;
+  guint file_num;
+
+  input->n_files_remaining = N_SCALING_FILES;
+
+  for (file_num = 0; file_num < N_SCALING_FILES; file_num++)
+    {
+      GError *error = NULL;
+
+      g_thread_pool_push (input->pool, GUINT_TO_POINTER (file_num + 1), &error);
+      g_assert_no_error (error);
+    }
+
+  g_mutex_lock (&input->mutex);
+  while (input->n_files_remaining > 0)
+    g_cond_wait (&input->cond, &input->mutex);
+  g_mutex_unlock (&input->mutex);
+}
+
+static void
+run_line_benchmarks (GcuBench     *bench,
+                     const gchar  *function_name,
+                     GcuBenchFunc  func)
+{
+  gchar *long_name;
+  gchar *long_word;
+  gchar *spaces;
+  gchar *words;
+  gchar *str;
+
+  str = gcu_bench_repeat ("a", 1000);
+  long_name = g_strconcat (str, " (int a,", NULL);
+  g_free (str);
+
+  long_word = gcu_bench_repeat ("a", 100000);
+
+  str = gcu_bench_repeat (" ", 10000);
+  spaces = g_strconcat (str, "a", NULL);
+  g_free (str);
+
+  words = gcu_bench_repeat ("a ", 5000);
+
+  gcu_bench_run (bench, function_name, "function-first-line", 0, func,
+                 (gpointer) "gtk_text_buffer_insert (GtkTextBuffer *buffer,");
+  gcu_bench_run (bench, function_name, "parameter-line", 0, func,
+                 (gpointer) "                        const gchar   *text,");
+  gcu_bench_run (bench, function_name, "statement-line", 0, func,
+                 (gpointer) "  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));");
+  gcu_bench_run (bench, function_name, "long-name-1k", strlen (long_name), func, long_name);
+  gcu_bench_run (bench, function_name, "long-word-100k", strlen (long_word), func, long_word);
+  gcu_bench_run (bench, function_name, "spaces-10k", strlen (spaces), func, spaces);
+  gcu_bench_run (bench, function_name, "words-10k", strlen (words), func, words);
+
+  g_free (long_name);
+  g_free (long_word);
+  g_free (spaces);
+  g_free (words);
+}
+
+/* A declaration with @n_params parameters of various types. */
+static void
+init_declaration_input (DeclarationInput *input,
+                        guint             n_params)
+{
+  static const gchar *types[] = { "GtkTextBuffer", "const gchar", "gint", "GError" };
+  static const gchar *stars[] = { "*", "*", "", "**" };
+  guint param_num;
+
+  input->output_stream = g_memory_output_stream_new_resizable ();
+  input->lines = g_new0 (gchar *, n_params + 1);
+  input->length = n_params;
+
+  for (param_num = 0; param_num < n_params; param_num++)
+    {
+      guint type_num = param_num % G_N_ELEMENTS (types);
+
+      input->lines[param_num] = g_strdup_printf ("%s%s %s%s_%u%s",
+                                                 param_num == 0 ? "frobnitz_set_property (" : "  ",
+                                                 types[type_num],
+                                                 stars[type_num],
+                                                 "param",
+                                                 param_num,
+                                                 param_num == n_params - 1 ? ")" : ",");
+    }
+}
+
+static void
+clear_declaration_input (DeclarationInput *input)
+{
+  g_object_unref (input->output_stream);
+  g_strfreev (input->lines);
+}
+
+static void
+run_declaration_benchmarks (GcuBench *bench)
+{
+  static const guint n_params[] = { 3, 20, 200 };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (n_params); i++)
+    {
+      DeclarationInput input;
+      gchar *input_name;
+      gchar *text;
+
+      init_declaration_input (&input, n_params[i]);
+      input_name = g_strdup_printf ("%u-params", n_params[i]);
+      text = g_strjoinv ("\n", input.lines);
+
+      gcu_bench_run (bench,
+                     "print_function_declaration",
+                     input_name,
+                     strlen (text),
+                     call_print_function_declaration,
+                     &input);
+
+      g_free (input_name);
+      g_free (text);
+      clear_declaration_input (&input);
+    }
+}
+
+/* A C file of about 100K, with function declarations to line up. */
+static gchar *
+create_scaling_contents (void)
+{
+  GString *contents = g_string_new (NULL);
+  guint function_num;
+
+  for (function_num = 0; function_num < 500; function_num++)
+    {
+      g_string_append_printf (contents,
+                              "static gboolean\n"
+                              "frobnitz_%u (Frobnitz *frobnitz,\n"
+                              "gint magic_number,\n"
+                              "const gchar *name,\n"
+                              "GError **error)\n"
+                              "{\n"
+                              "  g_return_val_if_fail (FROBNITZ_IS_FROBNITZ (frobnitz), FALSE);\n"
+                              "  return frobnitz_get_magic (frobnitz, name) == magic_number;\n"
+                              "}\n"
+                              "\n",
+                              function_num);
+    }
+
+  return g_string_free (contents, FALSE);
+}
+
+static void
+run_scaling_benchmarks (GcuBench *bench)
+{
+  ScalingInput input;
+  gchar *contents;
+  guint max_threads;
+  guint n_threads;
+
+  contents = create_scaling_contents ();
+  input.contents = contents;
+  input.length = strlen (contents);
+  g_mutex_init (&input.mutex);
+  g_cond_init (&input.cond);
+
+  max_threads = g_get_num_processors ();
+
+  /* 1, 2, 4, ..., and the number of processors. */
+  for (n_threads = 1; ; n_threads = MIN (n_threads * 2, max_threads))
+    {
+      gchar *input_name;
+      GError *error = NULL;
+
+      input.pool = g_thread_pool_new (scaling_job_run, &input, n_threads, TRUE, &error);
+      g_assert_no_error (error);
+
+      input_name = g_strdup_printf ("%u-threads", n_threads);
+
+      gcu_bench_run (bench,
+                     "parse_contents_to_memory",
+                     input_name,
+                     N_SCALING_FILES * input.length,
+                     call_parse_contents_to_memory,
+                     &input);
+
+      g_free (input_name);
+      g_thread_pool_free (input.pool, FALSE, TRUE);
+
+      if (n_threads == max_threads)
+        break;
+    }
+
+  g_mutex_clear (&input.mutex);
+  g_cond_clear (&input.cond);
+  g_free (contents);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GcuBench *bench;
+
+  bench = gcu_bench_new (&argc, &argv);
+
+  run_line_benchmarks (bench, "match_function_name", call_match_function_name);
+  run_line_benchmarks (bench, "match_parameter", call_match_parameter);
+  run_declaration_benchmarks (bench);
+  run_scaling_benchmarks (bench);
+
+  return gcu_bench_finish (bench);
+}
@@ -0,0 +1,114 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of the hot functions of gcu-lineup-substitution (see
+ * gcu-bench.c). The source file of the tool is included, to call its static
+ * functions. Its main() is renamed, and not called.
+ */
+
+int gcu_lineup_substitution_main (int    argc,
+                                  char **argv);
+
+#define main gcu_lineup_substitution_main
+#include "gcu-lineup-substitution.c"
+#undef main
+
+#include "gcu-bench.h"
+
+typedef struct
+{
+  Sub *sub;
+  GtkTextIter pos;
+} ColumnsInput;
+
+static void
+call_get_parentheses_columns (gpointer user_data)
+{
+  ColumnsInput *input = user_data;
+  GSList *columns;
+
+  columns = get_parentheses_columns (input->sub, &input->pos);
+
+  if (columns != NULL)
+    gcu_bench_sink += GPOINTER_TO_INT (columns->data);
+
+  g_slist_free (columns);
+}
+
+/* @pos_offset is where the search text would be matched on @line. */
+static void
+run_get_parentheses_columns (GcuBench    *bench,
+                             const gchar *input_name,
+                             const gchar *line,
+                             gint         pos_offset)
+{
+  ColumnsInput input;
+
+  input.sub = sub_new ("function_call", "another_beautiful_name", "bench.c");
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (input.sub->buffer), line, -1);
+  gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (input.sub->buffer), &input.pos, pos_offset);
+
+  gcu_bench_run (bench,
+                 "get_parentheses_columns",
+                 input_name,
+                 strlen (line),
+                 call_get_parentheses_columns,
+                 &input);
+
+  sub_free (input.sub);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  GcuBench *bench;
+  gchar *many_parentheses;
+  gchar *tabs;
+  gchar *no_parentheses;
+
+  bench = gcu_bench_new (&argc, &argv);
+  gtk_init (NULL, NULL);
+
+  /* Each opening parenthesis is a column in the returned list. */
+  many_parentheses = gcu_bench_repeat ("f (", 3000);
+
+  tabs = gcu_bench_repeat ("\t\tx (", 2000);
+  no_parentheses = gcu_bench_repeat ("param, ", 15000);
+
+  run_get_parentheses_columns (bench, "typical",
+                               "  function_call (param1, g_strdup (str), NULL);", 2);
+  run_get_parentheses_columns (bench, "indented-with-tabs",
+                               "\t\tfunction_call (param1,", 2);
+  run_get_parentheses_columns (bench, "parentheses-9k", many_parentheses, 0);
+  run_get_parentheses_columns (bench, "tabs-10k", tabs, 0);
+  run_get_parentheses_columns (bench, "no-parentheses-100k", no_parentheses, 0);
+
+  /* Only the parentheses after the position are returned, but the whole line
+   * is read.
+   */
+  run_get_parentheses_columns (bench, "pos-at-end-9k", many_parentheses, 8998);
+
+  g_free (many_parentheses);
+  g_free (tabs);
+  g_free (no_parentheses);
+
+  return gcu_bench_finish (bench);
+}
@@ -0,0 +1,284 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks of the hot functions of gcu-smart-c-comment-substitution (see
+ * gcu-bench.c). The source file of the tool is included, to call its static
+ * functions. Its main() is renamed, and not called.
+ */
+
+int gcu_smart_c_comment_substitution_main (int    argc,
+                                           char **argv);
+
+#define main gcu_smart_c_comment_substitution_main
+#include "gcu-smart-c-comment-substitution.c"
+#undef main
+
+#include "gcu-bench.h"
+
+#define LICENSE_HEADER \
+  "/*\n" \
+  " * This file is part of gnome-c-utils.\n" \
+  " *\n" \
+  " * Copyright © 2017 Sébastien Wilmet <swilmet@gnome.org>\n" \
+  " *\n" \
+  " * gnome-c-utils is free software: you can redistribute it and/or modify\n" \
+  " * it under the terms of the GNU General Public License as published by\n" \
+  " * the Free Software Foundation, either version 3 of the License, or\n" \
+  " * (at your option) any later version.\n" \
+  " *\n" \
+  " * gnome-c-utils is distributed in the hope that it will be useful,\n" \
+  " * but WITHOUT ANY WARRANTY; without even the implied warranty of\n" \
+  " * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the\n" \
+  " * GNU General Public License for more details.\n" \
+  " *\n" \
+  " * You should have received a copy of the GNU General Public License\n" \
+  " * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.\n" \
+  " */\n"
+
+/* The search text of the substitution: the middle paragraph of the license
+ * header, with other newlines and spaces. The other one differs only by its
+ * last word, so all the words are compared.
+ */
+#define SEARCH_TEXT_BEGIN \
+  "/* gnome-c-utils is distributed in the hope that it will be useful, but\n" \
+  " * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY\n" \
+  " * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License\n"
+#define SEARCH_TEXT SEARCH_TEXT_BEGIN " * for more details. */"
+#define OTHER_SEARCH_TEXT SEARCH_TEXT_BEGIN " * for more information. */"
+
+#define SEARCH_TEXT_FIRST_WORD "gnome-c-utils is distributed"
+
+#define CODE \
+  "\n#include \"gcu-budget.h\"\n\n" \
+  "/* gnome-c-utils is distributed, but in code. */\n" \
+  "static const gchar *str = \"gnome-c-utils is distributed\";\n"
+
+typedef struct
+{
+  Sub *sub;
+  GtkTextIter match_start;
+  GtkTextIter first_word_end;
+} MatchInput;
+
+static void
+call_canonicalize_c_comment (gpointer user_data)
+{
+  const gchar *comment = user_data;
+  GQueue *words;
+
+  words = canonicalize_c_comment (comment);
+  gcu_bench_sink += words->length;
+  g_queue_free_full (words, g_free);
+}
+
+/* Reads all the words of the buffer. */
+static void
+call_next_word (gpointer user_data)
+{
+  GtkTextBuffer *buffer = user_data;
+  GtkTextIter iter;
+  gchar *word;
+
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+
+  while ((word = next_word (&iter)) != NULL)
+    {
+      gcu_bench_sink += word[0];
+      g_free (word);
+    }
+}
+
+static void
+call_lex_buffer (gpointer user_data)
+{
+  Sub *sub = user_data;
+  guint n_comments;
+
+  lex_buffer (sub);
+  gcu_lex_get_spans (sub->lex, GCU_LEX_SPAN_COMMENT, &n_comments);
+  gcu_bench_sink += n_comments;
+}
+
+static void
+call_match_search_text (gpointer user_data)
+{
+  MatchInput *input = user_data;
+  GtkTextIter match_end;
+
+  match_end = input->first_word_end;
+  if (match_search_text (input->sub, &input->match_start, &match_end))
+    gcu_bench_sink += gtk_text_iter_get_offset (&match_end);
+}
+
+static void
+run_canonicalize_c_comment (GcuBench    *bench,
+                            const gchar *input_name,
+                            const gchar *comment)
+{
+  gcu_bench_run (bench,
+                 "canonicalize_c_comment",
+                 input_name,
+                 strlen (comment),
+                 call_canonicalize_c_comment,
+                 (gpointer) comment);
+}
+
+static void
+run_next_word (GcuBench    *bench,
+               const gchar *input_name,
+               const gchar *comment)
+{
+  GtkTextBuffer *buffer;
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, comment, -1);
+
+  gcu_bench_run (bench, "next_word", input_name, strlen (comment), call_next_word, buffer);
+
+  g_object_unref (buffer);
+}
+
+static void
+run_lex_buffer (GcuBench    *bench,
+                const gchar *input_name,
+                const gchar *text)
+{
+  Sub *sub;
+
+  sub = sub_new (NULL, "", "bench.c");
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (sub->buffer), text, -1);
+
+  gcu_bench_run (bench, "lex_buffer", input_name, strlen (text), call_lex_buffer, sub);
+
+  sub_free (sub);
+}
+
+/* Runs match_search_text() at the occurrence number @occurrence_num of
+ * @first_word in @text.
+ */
+static void
+run_match_search_text (GcuBench    *bench,
+                       const gchar *input_name,
+                       const gchar *search_text,
+                       const gchar *text,
+                       const gchar *first_word,
+                       gint         occurrence_num)
+{
+  MatchInput input;
+  GQueue *canonicalized_search_text;
+  GtkTextIter iter;
+  GtkTextIter match_end;
+  gint i;
+
+  canonicalized_search_text = canonicalize_c_comment (search_text);
+
+  input.sub = sub_new (canonicalized_search_text, "", "bench.c");
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (input.sub->buffer), text, -1);
+  lex_buffer (input.sub);
+
+  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (input.sub->buffer), &iter);
+
+  for (i = 0; i <= occurrence_num; i++)
+    {
+      if (!gtk_text_iter_forward_search (&iter, first_word, 0, &input.match_start, &match_end, NULL))
+        g_error ("Benchmark input '%s' not found.", input_name);
+
+      iter = match_end;
+    }
+
+  /* Where do_substitution() finds the first word. */
+  input.first_word_end = input.match_start;
+  gtk_text_iter_forward_chars (&input.first_word_end,
+                               g_utf8_strlen (g_queue_peek_head (canonicalized_search_text), -1));
+
+  gcu_bench_run (bench,
+                 "match_search_text",
+                 input_name,
+                 strlen (search_text),
+                 call_match_search_text,
+                 &input);
+
+  sub_free (input.sub);
+  g_queue_free_full (canonicalized_search_text, g_free);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  GcuBench *bench;
+  gchar *str;
+  gchar *big_comment;
+  gchar *long_word_comment;
+  gchar *empty_lines_comment;
+  gchar *text;
+  gchar *big_code;
+
+  bench = gcu_bench_new (&argc, &argv);
+  gcu_budget_init (&_budget);
+  gtk_init (NULL, NULL);
+
+  /* The lexing is measured, not the cache (see gcu-lex.c). */
+  g_setenv ("GCU_LEX_CACHE", "0", TRUE);
+
+  str = gcu_bench_repeat (" * Lorem ipsum dolor sit amet, consectetur adipiscing elit.\n", 1600);
+  big_comment = g_strconcat ("/*\n", str, " */", NULL);
+  g_free (str);
+
+  str = gcu_bench_repeat ("x", 100000);
+  long_word_comment = g_strconcat ("/* ", str, " */", NULL);
+  g_free (str);
+
+  /* next_word() skips the leading stars line by line. */
+  str = gcu_bench_repeat (" *\n", 30000);
+  empty_lines_comment = g_strconcat ("/*\n", str, " * word */", NULL);
+  g_free (str);
+
+  run_canonicalize_c_comment (bench, "one-line", "/* Returns: the converted word. */");
+  run_canonicalize_c_comment (bench, "license-header", LICENSE_HEADER);
+  run_canonicalize_c_comment (bench, "lorem-ipsum-100k", big_comment);
+  run_canonicalize_c_comment (bench, "long-word-100k", long_word_comment);
+  run_canonicalize_c_comment (bench, "empty-lines-90k", empty_lines_comment);
+
+  run_next_word (bench, "license-header", LICENSE_HEADER);
+  run_next_word (bench, "lorem-ipsum-100k", big_comment);
+  run_next_word (bench, "long-word-100k", long_word_comment);
+  run_next_word (bench, "empty-lines-90k", empty_lines_comment);
+
+  text = g_strconcat (LICENSE_HEADER, CODE, NULL);
+  big_code = gcu_bench_repeat (CODE, 1000);
+
+  run_lex_buffer (bench, "license-header", text);
+  run_lex_buffer (bench, "lorem-ipsum-100k", big_comment);
+  run_lex_buffer (bench, "code-130k", big_code);
+
+  run_match_search_text (bench, "license-header", SEARCH_TEXT, text, SEARCH_TEXT_FIRST_WORD, 0);
+  run_match_search_text (bench, "mismatch-at-end", OTHER_SEARCH_TEXT, text, SEARCH_TEXT_FIRST_WORD, 0);
+  run_match_search_text (bench, "mismatch-in-comment", SEARCH_TEXT, text, SEARCH_TEXT_FIRST_WORD, 1);
+  run_match_search_text (bench, "not-in-comment", SEARCH_TEXT, text, SEARCH_TEXT_FIRST_WORD, 2);
+
+  g_free (big_comment);
+  g_free (long_word_comment);
+  g_free (empty_lines_comment);
+  g_free (text);
+  g_free (big_code);
+
+  return gcu_bench_finish (bench);
+}
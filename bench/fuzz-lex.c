@@ -0,0 +1,62 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Worst-case performance fuzzing of gcu-lex.c (see gcu-fuzz.c): the lexing of
+ * a file, with the search of the function definitions. gcu-check-chain-ups
+ * finds the function that contains a chain-up with the function spans, instead
+ * of walking backwards in the buffer, so this is the part of the tool that
+ * depends on the input, and it doesn't need GTK.
+ */
+
+#include "gcu-lex.h"
+#include "gcu-fuzz.h"
+
+static const gchar *tokens[] =
+{
+  "\n", " ", "\t", "\\\n", "(", ")", "{", "}", ";", "*", "a", "f (",
+  "/*", "*/", "//", "\"", "'", "#", "#if 0\n", "#if A\n", "#else\n",
+  "#endif\n", "\nstatic void\n", "\n{\n", "\n}\n",
+  NULL
+};
+
+static void
+lex_input (const gchar *input,
+           gsize        length,
+           gpointer     user_data)
+{
+  GcuLex *lex;
+
+  lex = gcu_lex_new (input, length);
+  gcu_lex_free (lex);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GcuFuzz *fuzz;
+
+  /* The lexing is measured, not the cache. */
+  g_setenv ("GCU_LEX_CACHE", "0", TRUE);
+
+  fuzz = gcu_fuzz_new (&argc, &argv, tokens, lex_input, NULL);
+
+  return gcu_fuzz_run (fuzz);
+}
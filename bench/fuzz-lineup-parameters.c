@@ -0,0 +1,63 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Worst-case performance fuzzing of gcu-lineup-parameters (see gcu-fuzz.c):
+ * the whole parsing of a file, from the "\n{" anchors to the printing of the
+ * function declarations. The source file of the tool is included, to call its
+ * static functions. Its main() is renamed, and not called.
+ */
+
+int gcu_lineup_parameters_main (int    argc,
+                                char **argv);
+
+#define main gcu_lineup_parameters_main
+#include "gcu-lineup-parameters.c"
+#undef main
+
+#include "gcu-fuzz.h"
+
+static const gchar *tokens[] =
+{
+  "\n", "\n{\n", "\n}\n", "{", "(", ")", ",", ";", " ", "  ", "\t", "*", "!",
+  "a", "gint", "const ", "gchar", "GError", "frobnitz (", "static void\n",
+  NULL
+};
+
+static void
+parse_input (const gchar *input,
+             gsize        length,
+             gpointer     user_data)
+{
+  GMemoryOutputStream *output_stream;
+
+  parse_contents_to_memory (input, length, &output_stream);
+  free_output_stream (output_stream);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GcuFuzz *fuzz;
+
+  fuzz = gcu_fuzz_new (&argc, &argv, tokens, parse_input, NULL);
+
+  return gcu_fuzz_run (fuzz);
+}
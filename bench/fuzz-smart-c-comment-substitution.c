@@ -0,0 +1,84 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Worst-case performance fuzzing of gcu-smart-c-comment-substitution (see
+ * gcu-fuzz.c): the lexing of a buffer and the substitution of a two-word
+ * comment in it. The source file of the tool is included, to call
+ * its static functions. Its main() is renamed, and not called.
+ */
+
+int gcu_smart_c_comment_substitution_main (int    argc,
+                                           char **argv);
+
+#define main gcu_smart_c_comment_substitution_main
+#include "gcu-smart-c-comment-substitution.c"
+#undef main
+
+#include "gcu-fuzz.h"
+
+static const gchar *tokens[] =
+{
+  "/*", "*/", "/* ", " */", "//", "\"", "\n", " ", "  ", "\t", "*", "\n * ",
+  "a", "b", "ab", "a b", "x",
+  NULL
+};
+
+static void
+substitute_input (const gchar *input,
+                  gsize        length,
+                  gpointer     user_data)
+{
+  Sub *sub = user_data;
+
+  /* A GtkTextBuffer contains only valid UTF-8. */
+  if (!g_utf8_validate (input, length, NULL))
+    return;
+
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (sub->buffer), input, length);
+  gcu_budget_counter_init (&sub->budget_counter, &_budget, "fuzz.c");
+  lex_buffer (sub);
+  do_substitution (sub);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GQueue *canonicalized_search_text;
+  Sub *sub;
+  GcuFuzz *fuzz;
+  gint status;
+
+  gtk_init (NULL, NULL);
+
+  /* The lexing is measured, not the cache (see gcu-lex.c). */
+  g_setenv ("GCU_LEX_CACHE", "0", TRUE);
+
+  /* The budget is not initialized, so there is no limit. */
+  canonicalized_search_text = canonicalize_c_comment ("/* a b */");
+  sub = sub_new (canonicalized_search_text, "/* c */", "fuzz.c");
+
+  fuzz = gcu_fuzz_new (&argc, &argv, tokens, substitute_input, sub);
+  status = gcu_fuzz_run (fuzz);
+
+  sub_free (sub);
+  g_queue_free_full (canonicalized_search_text, g_free);
+  return status;
+}
@@ -0,0 +1,647 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-bench.h"
+#include <gio/gio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gcu-json.h"
+
+/*
+ * Harness for the microbenchmarks of the hot functions of the tools.
+ *
+ * For each function and input, gcu_bench_run() first calls the function during
+ * WARMUP_TIME, which also gives the number of calls per sample, so that a
+ * sample lasts at least MIN_SAMPLE_TIME and the resolution of the clock is
+ * negligible. Then it takes --repetitions samples and computes the time per
+ * call of each: the minimum, median, mean, standard deviation and maximum are
+ * reported. The median is the least sensitive to the noise of the machine, it
+ * is the one compared with the baseline.
+ *
+ * gcu_bench_finish() prints a table, writes the results in JSON with
+ * --output=FILE, and with --baseline=FILE, a JSON file written by a previous
+ * run, prints the change of each median. The exit status is then 1 if one of
+ * the functions is slower by more than --threshold percent.
+ *
+ * With --filter=STRING, only the functions whose name contains STRING are run.
+ */
+
+#define WARMUP_TIME (G_USEC_PER_SEC / 10)
+#define MIN_SAMPLE_TIME (G_USEC_PER_SEC / 100)
+#define DEFAULT_REPETITIONS (15)
+#define DEFAULT_THRESHOLD (10.0)
+
+typedef struct _BenchResult BenchResult;
+struct _BenchResult
+{
+  gchar *function_name;
+  gchar *input_name;
+  gsize input_size;
+  guint64 n_calls_per_sample;
+  guint n_repetitions;
+
+  /* Per call, in nanoseconds. */
+  gdouble min_ns;
+  gdouble median_ns;
+  gdouble mean_ns;
+  gdouble stddev_ns;
+  gdouble max_ns;
+};
+
+struct _GcuBench
+{
+  gchar *program_name;
+
+  /* BenchResult * */
+  GPtrArray *results;
+};
+
+/* Written by the benchmarks, so that the compiler cannot remove the calls
+ * whose results are otherwise unused.
+ */
+volatile gsize gcu_bench_sink;
+
+static gchar *_output_path;
+static gchar *_baseline_path;
+static gchar *_filter;
+static gint _repetitions = DEFAULT_REPETITIONS;
+static gdouble _threshold = DEFAULT_THRESHOLD;
+
+static GOptionEntry _option_entries[] =
+{
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &_output_path,
+    "Write the results to FILE, in JSON.", "FILE" },
+  { "baseline", 'b', 0, G_OPTION_ARG_FILENAME, &_baseline_path,
+    "Compare the results with the ones saved in FILE by a previous run.", "FILE" },
+  { "threshold", 0, 0, G_OPTION_ARG_DOUBLE, &_threshold,
+    "With --baseline, fail if a function is slower by more than PERCENT (default: 10).", "PERCENT" },
+  { "repetitions", 'r', 0, G_OPTION_ARG_INT, &_repetitions,
+    "Take N samples of each benchmark (default: 15).", "N" },
+  { "filter", 'f', 0, G_OPTION_ARG_STRING, &_filter,
+    "Run only the functions whose name contains STRING.", "STRING" },
+  { NULL }
+};
+
+static void
+bench_result_free (BenchResult *result)
+{
+  g_free (result->function_name);
+  g_free (result->input_name);
+  g_free (result);
+}
+
+/* Exits on a command line error, like the tools. */
+GcuBench *
+gcu_bench_new (gint    *argc,
+               gchar ***argv)
+{
+  GcuBench *bench;
+  GOptionContext *option_context;
+  GError *error = NULL;
+
+  option_context = g_option_context_new ("- microbenchmarks");
+  g_option_context_add_main_entries (option_context, _option_entries, NULL);
+
+  if (!g_option_context_parse (option_context, argc, argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      exit (EXIT_FAILURE);
+    }
+
+  g_option_context_free (option_context);
+
+  if (_repetitions < 1)
+    {
+      g_printerr ("The number of repetitions must be at least 1.\n");
+      exit (EXIT_FAILURE);
+    }
+
+  bench = g_new0 (GcuBench, 1);
+  bench->program_name = g_path_get_basename ((*argv)[0]);
+  bench->results = g_ptr_array_new_with_free_func ((GDestroyNotify) bench_result_free);
+
+  return bench;
+}
+
+static gint
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+  gdouble value_a = *(const gdouble *) a;
+  gdouble value_b = *(const gdouble *) b;
+
+  if (value_a < value_b)
+    return -1;
+
+  return value_a > value_b ? 1 : 0;
+}
+
+/* Returns the duration of the calls, in microseconds. */
+static gint64
+call_n_times (GcuBenchFunc func,
+              gpointer     user_data,
+              guint64      n_calls)
+{
+  gint64 begin_time;
+  guint64 call_num;
+
+  begin_time = g_get_monotonic_time ();
+
+  for (call_num = 0; call_num < n_calls; call_num++)
+    func (user_data);
+
+  return g_get_monotonic_time () - begin_time;
+}
+
+static void
+compute_stats (BenchResult *result,
+               gdouble     *samples,
+               guint        n_samples)
+{
+  gdouble sum = 0.0;
+  gdouble sum_of_squares = 0.0;
+  guint i;
+
+  qsort (samples, n_samples, sizeof (gdouble), compare_doubles);
+
+  result->n_repetitions = n_samples;
+  result->min_ns = samples[0];
+  result->max_ns = samples[n_samples - 1];
+
+  if (n_samples % 2 == 1)
+    result->median_ns = samples[n_samples / 2];
+  else
+    result->median_ns = (samples[n_samples / 2 - 1] + samples[n_samples / 2]) / 2.0;
+
+  for (i = 0; i < n_samples; i++)
+    sum += samples[i];
+
+  result->mean_ns = sum / n_samples;
+
+  for (i = 0; i < n_samples; i++)
+    sum_of_squares += (samples[i] - result->mean_ns) * (samples[i] - result->mean_ns);
+
+  result->stddev_ns = n_samples > 1 ? sqrt (sum_of_squares / (n_samples - 1)) : 0.0;
+}
+
+/**
+ * gcu_bench_run:
+ * @bench: a #GcuBench.
+ * @function_name: the name of the benchmarked function.
+ * @input_name: a short description of the input, for example "typical" or
+ *   "long-line-100k".
+ * @input_size: the size of the input in bytes, for the throughput, or 0.
+ * @func: calls the benchmarked function once.
+ * @user_data: user data for @func.
+ *
+ * Measures the time taken by one call of @func.
+ */
+void
+gcu_bench_run (GcuBench     *bench,
+               const gchar  *function_name,
+               const gchar  *input_name,
+               gsize         input_size,
+               GcuBenchFunc  func,
+               gpointer      user_data)
+{
+  BenchResult *result;
+  gdouble *samples;
+  guint64 n_warmup_calls = 0;
+  gint64 warmup_time = 0;
+  gint sample_num;
+
+  g_return_if_fail (bench != NULL);
+  g_return_if_fail (function_name != NULL);
+  g_return_if_fail (input_name != NULL);
+  g_return_if_fail (func != NULL);
+
+  if (_filter != NULL && strstr (function_name, _filter) == NULL)
+    return;
+
+  /* Doubles the number of calls until the warmup time is reached. */
+  while (warmup_time < WARMUP_TIME)
+    {
+      guint64 n_calls = MAX (n_warmup_calls, 1);
+
+      warmup_time += call_n_times (func, user_data, n_calls);
+      n_warmup_calls += n_calls;
+    }
+
+  result = g_new0 (BenchResult, 1);
+  result->function_name = g_strdup (function_name);
+  result->input_name = g_strdup (input_name);
+  result->input_size = input_size;
+  result->n_calls_per_sample = MAX (1, n_warmup_calls * MIN_SAMPLE_TIME / warmup_time);
+
+  samples = g_new (gdouble, _repetitions);
+
+  for (sample_num = 0; sample_num < _repetitions; sample_num++)
+    {
+      gint64 sample_time;
+
+      sample_time = call_n_times (func, user_data, result->n_calls_per_sample);
+      samples[sample_num] = (gdouble) sample_time * 1000.0 / result->n_calls_per_sample;
+    }
+
+  compute_stats (result, samples, _repetitions);
+  g_free (samples);
+
+  g_ptr_array_add (bench->results, result);
+}
+
+/* Returns: (transfer full): @ns as a duration with a unit. */
+static gchar *
+format_duration (gdouble ns)
+{
+  if (ns < 1000.0)
+    return g_strdup_printf ("%.1f ns", ns);
+
+  if (ns < 1000.0 * 1000.0)
+    return g_strdup_printf ("%.2f us", ns / 1000.0);
+
+  if (ns < 1000.0 * 1000.0 * 1000.0)
+    return g_strdup_printf ("%.2f ms", ns / (1000.0 * 1000.0));
+
+  return g_strdup_printf ("%.2f s", ns / (1000.0 * 1000.0 * 1000.0));
+}
+
+static void
+print_results (GcuBench *bench)
+{
+  guint i;
+
+  g_print ("%-28s %-24s %12s %10s %12s\n",
+           "function",
+           "input",
+           "median",
+           "stddev",
+           "throughput");
+
+  for (i = 0; i < bench->results->len; i++)
+    {
+      const BenchResult *result = g_ptr_array_index (bench->results, i);
+      gchar *median;
+      gchar *throughput;
+
+      median = format_duration (result->median_ns);
+
+      if (result->input_size > 0)
+        throughput = g_strdup_printf ("%.1f MB/s", result->input_size * 1000.0 / result->median_ns);
+      else
+        throughput = g_strdup ("");
+
+      g_print ("%-28s %-24s %12s %9.1f%% %12s\n",
+               result->function_name,
+               result->input_name,
+               median,
+               100.0 * result->stddev_ns / result->mean_ns,
+               throughput);
+
+      g_free (median);
+      g_free (throughput);
+    }
+}
+
+static void
+append_json_double (GString     *json,
+                    const gchar *key,
+                    gdouble      value)
+{
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append_printf (json,
+                          ",\"%s\":%s",
+                          key,
+                          g_ascii_formatd (buffer, sizeof (buffer), "%.1f", value));
+}
+
+static gchar *
+results_to_json (GcuBench *bench)
+{
+  GString *json;
+  guint i;
+
+  json = g_string_new ("{\"program\":");
+  gcu_json_append_string (json, bench->program_name);
+  g_string_append (json, ",\"results\":[");
+
+  for (i = 0; i < bench->results->len; i++)
+    {
+      const BenchResult *result = g_ptr_array_index (bench->results, i);
+
+      g_string_append (json, i > 0 ? ",\n" : "\n");
+      g_string_append (json, "{\"function\":");
+      gcu_json_append_string (json, result->function_name);
+      g_string_append (json, ",\"input\":");
+      gcu_json_append_string (json, result->input_name);
+      g_string_append_printf (json,
+                              ",\"bytes\":%" G_GSIZE_FORMAT
+                              ",\"calls_per_sample\":%" G_GUINT64_FORMAT
+                              ",\"repetitions\":%u",
+                              result->input_size,
+                              result->n_calls_per_sample,
+                              result->n_repetitions);
+      append_json_double (json, "min_ns", result->min_ns);
+      append_json_double (json, "median_ns", result->median_ns);
+      append_json_double (json, "mean_ns", result->mean_ns);
+      append_json_double (json, "stddev_ns", result->stddev_ns);
+      append_json_double (json, "max_ns", result->max_ns);
+      g_string_append_c (json, '}');
+    }
+
+  g_string_append (json, "\n]}\n");
+
+  return g_string_free (json, FALSE);
+}
+
+static gchar *
+get_result_key (const gchar *function_name,
+                const gchar *input_name)
+{
+  return g_strconcat (function_name, " ", input_name, NULL);
+}
+
+/* Reads a result of a baseline file, and adds its median to @medians. */
+static gboolean
+read_baseline_result (GcuJsonReader *reader,
+                      GHashTable    *medians)
+{
+  gchar *function_name = NULL;
+  gchar *input_name = NULL;
+  gdouble median_ns = -1.0;
+  gboolean ok = TRUE;
+
+  if (!gcu_json_reader_expect (reader, '{'))
+    return FALSE;
+
+  do
+    {
+      gchar *key;
+
+      key = gcu_json_reader_read_string (reader);
+      if (key == NULL || !gcu_json_reader_expect (reader, ':'))
+        {
+          g_free (key);
+          ok = FALSE;
+          break;
+        }
+
+      if (g_str_equal (key, "function"))
+        {
+          g_free (function_name);
+          function_name = gcu_json_reader_read_string (reader);
+          ok = function_name != NULL;
+        }
+      else if (g_str_equal (key, "input"))
+        {
+          g_free (input_name);
+          input_name = gcu_json_reader_read_string (reader);
+          ok = input_name != NULL;
+        }
+      else if (g_str_equal (key, "median_ns"))
+        {
+          ok = gcu_json_reader_read_double (reader, &median_ns);
+        }
+      else
+        {
+          ok = gcu_json_reader_skip_value (reader);
+        }
+
+      g_free (key);
+    }
+  while (ok && gcu_json_reader_expect (reader, ','));
+
+  ok = (ok &&
+        gcu_json_reader_expect (reader, '}') &&
+        function_name != NULL &&
+        input_name != NULL &&
+        median_ns > 0.0);
+
+  if (ok)
+    {
+      gdouble *value = g_new (gdouble, 1);
+
+      *value = median_ns;
+      g_hash_table_insert (medians, get_result_key (function_name, input_name), value);
+    }
+
+  g_free (function_name);
+  g_free (input_name);
+  return ok;
+}
+
+/* Returns: (transfer full) (nullable): the medians (gdouble *) of the baseline
+ * results, by function and input names.
+ */
+static GHashTable *
+load_baseline (const gchar  *path,
+               GError      **error)
+{
+  gchar *contents;
+  gsize length;
+  GcuJsonReader reader;
+  GHashTable *medians;
+  gboolean ok;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  medians = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  gcu_json_reader_init (&reader, contents, length);
+
+  ok = gcu_json_reader_expect (&reader, '{');
+
+  while (ok)
+    {
+      gchar *key;
+
+      key = gcu_json_reader_read_string (&reader);
+      ok = key != NULL && gcu_json_reader_expect (&reader, ':');
+
+      if (ok && g_str_equal (key, "results"))
+        {
+          ok = gcu_json_reader_expect (&reader, '[');
+
+          while (ok && !gcu_json_reader_peek (&reader, ']'))
+            {
+              if (g_hash_table_size (medians) > 0)
+                ok = gcu_json_reader_expect (&reader, ',');
+
+              ok = ok && read_baseline_result (&reader, medians);
+            }
+
+          ok = ok && gcu_json_reader_expect (&reader, ']');
+        }
+      else if (ok)
+        {
+          ok = gcu_json_reader_skip_value (&reader);
+        }
+
+      g_free (key);
+
+      if (!ok || !gcu_json_reader_expect (&reader, ','))
+        break;
+    }
+
+  ok = (ok &&
+        gcu_json_reader_expect (&reader, '}') &&
+        gcu_json_reader_at_end (&reader));
+
+  if (!ok)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "%s: invalid benchmark results file at byte %" G_GSIZE_FORMAT,
+                   path,
+                   (gsize) (reader.pos - contents));
+      g_hash_table_unref (medians);
+      medians = NULL;
+    }
+
+  g_free (contents);
+  return medians;
+}
+
+/* Returns whether no function is slower than the threshold. */
+static gboolean
+compare_with_baseline (GcuBench   *bench,
+                       GHashTable *medians)
+{
+  gboolean ok = TRUE;
+  guint i;
+
+  g_print ("\nCompared with %s:\n", _baseline_path);
+
+  for (i = 0; i < bench->results->len; i++)
+    {
+      const BenchResult *result = g_ptr_array_index (bench->results, i);
+      const gdouble *baseline_median;
+      gchar *key;
+      gchar *old_median;
+      gchar *new_median;
+      gdouble change;
+
+      key = get_result_key (result->function_name, result->input_name);
+      baseline_median = g_hash_table_lookup (medians, key);
+      g_free (key);
+
+      if (baseline_median == NULL)
+        {
+          g_print ("%-28s %-24s not in the baseline\n",
+                   result->function_name,
+                   result->input_name);
+          continue;
+        }
+
+      change = 100.0 * (result->median_ns - *baseline_median) / *baseline_median;
+      old_median = format_duration (*baseline_median);
+      new_median = format_duration (result->median_ns);
+
+      g_print ("%-28s %-24s %12s -> %12s %+7.1f%%%s\n",
+               result->function_name,
+               result->input_name,
+               old_median,
+               new_median,
+               change,
+               change > _threshold ? "  REGRESSION" : "");
+
+      if (change > _threshold)
+        ok = FALSE;
+
+      g_free (old_median);
+      g_free (new_median);
+    }
+
+  return ok;
+}
+
+/* Reports the results and frees @bench. Returns the exit status. */
+gint
+gcu_bench_finish (GcuBench *bench)
+{
+  gint exit_status = EXIT_SUCCESS;
+  GError *error = NULL;
+
+  g_return_val_if_fail (bench != NULL, EXIT_FAILURE);
+
+  print_results (bench);
+
+  if (_output_path != NULL)
+    {
+      gchar *json = results_to_json (bench);
+
+      if (!g_file_set_contents (_output_path, json, -1, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          g_clear_error (&error);
+          exit_status = EXIT_FAILURE;
+        }
+
+      g_free (json);
+    }
+
+  if (_baseline_path != NULL)
+    {
+      GHashTable *medians;
+
+      medians = load_baseline (_baseline_path, &error);
+
+      if (medians == NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          g_clear_error (&error);
+          exit_status = EXIT_FAILURE;
+        }
+      else
+        {
+          if (!compare_with_baseline (bench, medians))
+            exit_status = EXIT_FAILURE;
+
+          g_hash_table_unref (medians);
+        }
+    }
+
+  g_free (bench->program_name);
+  g_ptr_array_unref (bench->results);
+  g_free (bench);
+
+  g_clear_pointer (&_output_path, g_free);
+  g_clear_pointer (&_baseline_path, g_free);
+  g_clear_pointer (&_filter, g_free);
+
+  return exit_status;
+}
+
+/* Returns: (transfer full): @str repeated @n_times, to build big inputs. */
+gchar *
+gcu_bench_repeat (const gchar *str,
+                  guint        n_times)
+{
+  GString *repeated;
+  guint i;
+
+  repeated = g_string_sized_new (strlen (str) * n_times);
+
+  for (i = 0; i < n_times; i++)
+    g_string_append (repeated, str);
+
+  return g_string_free (repeated, FALSE);
+}
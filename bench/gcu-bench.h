@@ -0,0 +1,50 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_BENCH_H
+#define GCU_BENCH_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef void (* GcuBenchFunc) (gpointer user_data);
+
+typedef struct _GcuBench GcuBench;
+
+GcuBench *	gcu_bench_new		(gint          *argc,
+					 gchar       ***argv);
+
+void		gcu_bench_run		(GcuBench      *bench,
+					 const gchar   *function_name,
+					 const gchar   *input_name,
+					 gsize          input_size,
+					 GcuBenchFunc   func,
+					 gpointer       user_data);
+
+gint		gcu_bench_finish	(GcuBench      *bench);
+
+gchar *		gcu_bench_repeat	(const gchar   *str,
+					 guint          n_times);
+
+extern volatile gsize gcu_bench_sink;
+
+G_END_DECLS
+
+#endif /* GCU_BENCH_H */
@@ -0,0 +1,823 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-fuzz.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Cost-guided fuzzing: instead of crashes, it searches the inputs for which a
+ * function of a tool is super-linear, and checks that the inputs found in the
+ * past stay linear once the code is fixed.
+ *
+ * An input has the form prefix + pump × n + suffix, like for the analysis of
+ * regex denial of service. If the function is linear, its time grows like n;
+ * a quadratic path grows like n². measure_growth() doubles n until the input
+ * takes MIN_TIME more than prefix + suffix alone, and then measures
+ * GROWTH_FACTOR × n. The ratio of the two times, divided by GROWTH_FACTOR, is
+ * the super-linearity of the input: about 1 for a linear cost, GROWTH_FACTOR
+ * for a quadratic one. Each time is the minimum of N_MEASURES calls, which is
+ * the least sensitive to the noise of the machine. An input that still takes
+ * less than MIN_TIME at MAX_INPUT_SIZE is too fast to be measured reliably
+ * (caches, clock resolution), so it is not considered slow.
+ *
+ * By default, the inputs of the --corpus directory are measured, and the exit
+ * status is 1 if the super-linearity of one of them exceeds --bound. An input
+ * is a GKeyFile, with the prefix, pump and suffix keys, so that the inputs
+ * found by the fuzzer and the ones written by hand are in the same format.
+ *
+ * With --fuzz=SECONDS, random inputs are generated during SECONDS from the
+ * tokens of the tool (e.g. "(", "," and "\n{" for gcu-lineup-parameters), and
+ * the slowest inputs found so far, including the corpus, are mutated. An
+ * input that exceeds --bound is minimized, by removing the characters that
+ * are not needed to exceed it and by renaming the identifiers, so that the
+ * variants of a slow path found by the mutations give the same input. It is
+ * then added to the corpus directory, if it also exceeds --bound with the
+ * slower measure of the check. Run it with --seed to reproduce a run.
+ */
+
+#define GROWTH_FACTOR (4)
+#define N_MEASURES (5)
+#define MAX_INPUT_SIZE (4 * 1024 * 1024)
+
+/* In microseconds. The fuzzer uses a shorter time, to try more inputs. */
+#define MIN_TIME (2 * 1000)
+#define FUZZ_MIN_TIME (500)
+
+#define DEFAULT_BOUND (2.0)
+
+/* For the fuzzer. */
+#define N_BEST_INPUTS (32)
+#define MAX_PART_LENGTH (64)
+
+typedef struct _PumpedInput PumpedInput;
+struct _PumpedInput
+{
+  gchar *prefix;
+  gchar *pump;
+  gchar *suffix;
+
+  /* The super-linearity, for the fuzzer. */
+  gdouble score;
+};
+
+typedef struct
+{
+  /* The size of the biggest input measured. */
+  gsize size;
+  gdouble ns_per_byte;
+
+  /* 0 if too fast to be measured. */
+  gdouble superlinearity;
+} Growth;
+
+struct _GcuFuzz
+{
+  const gchar * const *tokens;
+  guint n_tokens;
+  GcuFuzzFunc func;
+  gpointer user_data;
+
+  GRand *rand;
+};
+
+static gchar *_corpus_dir;
+static gint _fuzz_seconds;
+static gint _seed;
+static gdouble _bound = DEFAULT_BOUND;
+
+static GOptionEntry _option_entries[] =
+{
+  { "corpus", 'c', 0, G_OPTION_ARG_FILENAME, &_corpus_dir,
+    "The directory of the slow inputs.", "DIR" },
+  { "fuzz", 0, 0, G_OPTION_ARG_INT, &_fuzz_seconds,
+    "Search new slow inputs during SECONDS, and add them to the corpus.", "SECONDS" },
+  { "seed", 0, 0, G_OPTION_ARG_INT, &_seed,
+    "With --fuzz, the seed of the random inputs (default: the time).", "N" },
+  { "bound", 0, 0, G_OPTION_ARG_DOUBLE, &_bound,
+    "The maximum super-linearity of an input (default: 2).", "FACTOR" },
+  { NULL }
+};
+
+static PumpedInput *
+pumped_input_new (const gchar *prefix,
+                  const gchar *pump,
+                  const gchar *suffix)
+{
+  PumpedInput *input = g_new0 (PumpedInput, 1);
+
+  input->prefix = g_strdup (prefix);
+  input->pump = g_strdup (pump);
+  input->suffix = g_strdup (suffix);
+
+  return input;
+}
+
+static void
+pumped_input_free (PumpedInput *input)
+{
+  if (input != NULL)
+    {
+      g_free (input->prefix);
+      g_free (input->pump);
+      g_free (input->suffix);
+      g_free (input);
+    }
+}
+
+static gchar *
+pumped_input_build (const PumpedInput *input,
+                    guint              n,
+                    gsize             *length)
+{
+  GString *str;
+  guint i;
+
+  str = g_string_new (input->prefix);
+
+  for (i = 0; i < n; i++)
+    g_string_append (str, input->pump);
+
+  g_string_append (str, input->suffix);
+
+  *length = str->len;
+  return g_string_free (str, FALSE);
+}
+
+static PumpedInput *
+pumped_input_load (const gchar  *path,
+                   GError      **error)
+{
+  GKeyFile *key_file;
+  gchar *prefix = NULL;
+  gchar *pump = NULL;
+  gchar *suffix = NULL;
+  PumpedInput *input = NULL;
+
+  key_file = g_key_file_new ();
+
+  if (g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, error) &&
+      (prefix = g_key_file_get_string (key_file, "Input", "prefix", error)) != NULL &&
+      (pump = g_key_file_get_string (key_file, "Input", "pump", error)) != NULL &&
+      (suffix = g_key_file_get_string (key_file, "Input", "suffix", error)) != NULL)
+    {
+      if (pump[0] != '\0')
+        input = pumped_input_new (prefix, pump, suffix);
+      else
+        g_set_error (error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE, "The pump is empty.");
+    }
+
+  g_key_file_unref (key_file);
+  g_free (prefix);
+  g_free (pump);
+  g_free (suffix);
+
+  return input;
+}
+
+/* Returns: (transfer full): the file name of @input in the corpus, that
+ * depends only on its contents, so that an input is added only once.
+ */
+static gchar *
+pumped_input_get_filename (const PumpedInput *input)
+{
+  GChecksum *checksum;
+  gchar *filename;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, (const guchar *) input->prefix, strlen (input->prefix) + 1);
+  g_checksum_update (checksum, (const guchar *) input->pump, strlen (input->pump) + 1);
+  g_checksum_update (checksum, (const guchar *) input->suffix, strlen (input->suffix) + 1);
+
+  filename = g_strdup_printf ("fuzz-%.12s.ini", g_checksum_get_string (checksum));
+
+  g_checksum_free (checksum);
+  return filename;
+}
+
+static gboolean
+pumped_input_save (const PumpedInput  *input,
+                   const gchar        *path,
+                   GError            **error)
+{
+  GKeyFile *key_file;
+  gboolean ok;
+
+  key_file = g_key_file_new ();
+  g_key_file_set_string (key_file, "Input", "prefix", input->prefix);
+  g_key_file_set_string (key_file, "Input", "pump", input->pump);
+  g_key_file_set_string (key_file, "Input", "suffix", input->suffix);
+
+  ok = g_key_file_save_to_file (key_file, path, error);
+
+  g_key_file_unref (key_file);
+  return ok;
+}
+
+/* The tools print their results, which would flood the output. */
+static void
+silent_print_func (const gchar *string)
+{
+}
+
+/* Returns the minimum time of N_MEASURES calls, in nanoseconds. */
+static gdouble
+measure (GcuFuzz     *fuzz,
+         const gchar *str,
+         gsize        length)
+{
+  GPrintFunc old_print_func;
+  GPrintFunc old_printerr_func;
+  gdouble min_ns = G_MAXDOUBLE;
+  guint i;
+
+  old_print_func = g_set_print_handler (silent_print_func);
+  old_printerr_func = g_set_printerr_handler (silent_print_func);
+
+  for (i = 0; i < N_MEASURES; i++)
+    {
+      gint64 begin_time;
+
+      begin_time = g_get_monotonic_time ();
+      fuzz->func (str, length, fuzz->user_data);
+      min_ns = MIN (min_ns, (g_get_monotonic_time () - begin_time) * 1000.0);
+    }
+
+  g_set_print_handler (old_print_func);
+  g_set_printerr_handler (old_printerr_func);
+
+  return min_ns;
+}
+
+static gdouble
+measure_pumped_input (GcuFuzz           *fuzz,
+                      const PumpedInput *input,
+                      guint              n,
+                      gsize             *length)
+{
+  gchar *str;
+  gdouble ns;
+
+  str = pumped_input_build (input, n, length);
+  ns = measure (fuzz, str, *length);
+  g_free (str);
+
+  return ns;
+}
+
+static void
+measure_growth (GcuFuzz           *fuzz,
+                const PumpedInput *input,
+                gint64             min_time,
+                Growth            *growth)
+{
+  gsize pump_length = strlen (input->pump);
+  gdouble base_ns;
+  gdouble ns;
+  gdouble big_ns;
+  gsize length;
+  guint n = 1;
+
+  base_ns = measure_pumped_input (fuzz, input, 0, &length);
+
+  while (TRUE)
+    {
+      ns = measure_pumped_input (fuzz, input, n, &length);
+
+      if (ns - base_ns >= min_time * 1000.0)
+        break;
+
+      /* The pumps of the input at 2n, times GROWTH_FACTOR. */
+      if (2 * n * GROWTH_FACTOR * pump_length > MAX_INPUT_SIZE)
+        {
+          growth->size = length;
+          growth->ns_per_byte = ns / MAX (length, 1);
+          growth->superlinearity = 0.0;
+          return;
+        }
+
+      n *= 2;
+    }
+
+  big_ns = measure_pumped_input (fuzz, input, n * GROWTH_FACTOR, &length);
+
+  growth->size = length;
+  growth->ns_per_byte = big_ns / MAX (length, 1);
+  growth->superlinearity = (big_ns - base_ns) / (GROWTH_FACTOR * (ns - base_ns));
+}
+
+/* Exits on a command line error, like the tools. @tokens are the pieces of
+ * the random inputs, typically the syntax that the tool matches.
+ */
+GcuFuzz *
+gcu_fuzz_new (gint                 *argc,
+              gchar              ***argv,
+              const gchar * const  *tokens,
+              GcuFuzzFunc           func,
+              gpointer              user_data)
+{
+  GcuFuzz *fuzz;
+  GOptionContext *option_context;
+  GError *error = NULL;
+
+  g_return_val_if_fail (tokens != NULL && tokens[0] != NULL, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  option_context = g_option_context_new ("- worst-case performance fuzzing");
+  g_option_context_add_main_entries (option_context, _option_entries, NULL);
+
+  if (!g_option_context_parse (option_context, argc, argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      exit (EXIT_FAILURE);
+    }
+
+  g_option_context_free (option_context);
+
+  if (_corpus_dir == NULL)
+    {
+      g_printerr ("The --corpus directory is required.\n");
+      exit (EXIT_FAILURE);
+    }
+
+  fuzz = g_new0 (GcuFuzz, 1);
+  fuzz->tokens = tokens;
+  fuzz->n_tokens = g_strv_length ((gchar **) tokens);
+  fuzz->func = func;
+  fuzz->user_data = user_data;
+
+  return fuzz;
+}
+
+static gint
+compare_paths (gconstpointer a,
+               gconstpointer b)
+{
+  return strcmp (*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+/* Returns: (transfer full): the paths of the inputs of the corpus, sorted. */
+static GPtrArray *
+list_corpus (GError **error)
+{
+  GDir *dir;
+  GPtrArray *paths;
+  const gchar *name;
+
+  dir = g_dir_open (_corpus_dir, 0, error);
+  if (dir == NULL)
+    return NULL;
+
+  paths = g_ptr_array_new_with_free_func (g_free);
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      if (g_str_has_suffix (name, ".ini"))
+        g_ptr_array_add (paths, g_build_filename (_corpus_dir, name, NULL));
+    }
+
+  g_dir_close (dir);
+
+  g_ptr_array_sort (paths, compare_paths);
+  return paths;
+}
+
+static gint
+check_corpus (GcuFuzz *fuzz)
+{
+  GPtrArray *paths;
+  guint n_slow_inputs = 0;
+  guint i;
+  GError *error = NULL;
+
+  paths = list_corpus (&error);
+  if (paths == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
+
+  g_print ("%-32s %10s %12s %16s\n", "input", "size", "time/byte", "super-linearity");
+
+  for (i = 0; i < paths->len; i++)
+    {
+      const gchar *path = g_ptr_array_index (paths, i);
+      gchar *basename;
+      PumpedInput *input;
+      Growth growth;
+      gboolean slow;
+
+      basename = g_path_get_basename (path);
+
+      input = pumped_input_load (path, &error);
+      if (input == NULL)
+        {
+          g_printerr ("%s: %s\n", path, error->message);
+          g_clear_error (&error);
+          g_free (basename);
+          n_slow_inputs++;
+          continue;
+        }
+
+      measure_growth (fuzz, input, MIN_TIME, &growth);
+      slow = growth.superlinearity > _bound;
+
+      if (growth.superlinearity > 0.0)
+        g_print ("%-32s %10" G_GSIZE_FORMAT " %9.1f ns %16.2f%s\n",
+                 basename,
+                 growth.size,
+                 growth.ns_per_byte,
+                 growth.superlinearity,
+                 slow ? "  SLOW" : "");
+      else
+        g_print ("%-32s %10" G_GSIZE_FORMAT " %9.1f ns %16s\n",
+                 basename,
+                 growth.size,
+                 growth.ns_per_byte,
+                 "too fast");
+
+      if (slow)
+        n_slow_inputs++;
+
+      pumped_input_free (input);
+      g_free (basename);
+    }
+
+  g_ptr_array_unref (paths);
+
+  if (n_slow_inputs > 0)
+    {
+      g_print ("%u of %u inputs exceed the bound (%.2f).\n", n_slow_inputs, i, _bound);
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+/* Returns: (transfer full): between @min and @max random tokens. */
+static gchar *
+random_tokens (GcuFuzz *fuzz,
+               guint    min,
+               guint    max)
+{
+  GString *str = g_string_new (NULL);
+  guint n_tokens;
+  guint i;
+
+  n_tokens = g_rand_int_range (fuzz->rand, min, max + 1);
+
+  for (i = 0; i < n_tokens; i++)
+    g_string_append (str, fuzz->tokens[g_rand_int_range (fuzz->rand, 0, fuzz->n_tokens)]);
+
+  return g_string_free (str, FALSE);
+}
+
+static PumpedInput *
+random_input (GcuFuzz *fuzz)
+{
+  PumpedInput *input = g_new0 (PumpedInput, 1);
+
+  input->prefix = random_tokens (fuzz, 0, 3);
+  input->pump = random_tokens (fuzz, 1, 4);
+  input->suffix = random_tokens (fuzz, 0, 3);
+
+  return input;
+}
+
+/* Returns: (transfer full): @part with a random change, at a character
+ * boundary, so that a valid UTF-8 part stays valid.
+ */
+static gchar *
+mutate_part (GcuFuzz     *fuzz,
+             const gchar *part)
+{
+  const gchar *token = fuzz->tokens[g_rand_int_range (fuzz->rand, 0, fuzz->n_tokens)];
+  glong n_chars = g_utf8_strlen (part, -1);
+  const gchar *start;
+  const gchar *end;
+
+  start = g_utf8_offset_to_pointer (part, g_rand_int_range (fuzz->rand, 0, n_chars + 1));
+  end = g_utf8_offset_to_pointer (start, MIN (g_rand_int_range (fuzz->rand, 1, 4), g_utf8_strlen (start, -1)));
+
+  switch (g_rand_int_range (fuzz->rand, 0, 4))
+    {
+      /* Insert a token. */
+      case 0:
+        return g_strdup_printf ("%.*s%s%s", (gint) (start - part), part, token, start);
+
+      /* Delete a few characters. */
+      case 1:
+        return g_strdup_printf ("%.*s%s", (gint) (start - part), part, end);
+
+      /* Replace a few characters by a token. */
+      case 2:
+        return g_strdup_printf ("%.*s%s%s", (gint) (start - part), part, token, end);
+
+      /* Repeat the part, e.g. to have a longer pump. */
+      default:
+        return g_strconcat (part, part, NULL);
+    }
+}
+
+static PumpedInput *
+mutate_input (GcuFuzz           *fuzz,
+              const PumpedInput *parent)
+{
+  PumpedInput *input;
+  gchar **part;
+
+  input = pumped_input_new (parent->prefix, parent->pump, parent->suffix);
+
+  switch (g_rand_int_range (fuzz->rand, 0, 3))
+    {
+      case 0:
+        part = &input->prefix;
+        break;
+
+      case 1:
+        part = &input->pump;
+        break;
+
+      default:
+        part = &input->suffix;
+        break;
+    }
+
+  do
+    {
+      gchar *new_part = mutate_part (fuzz, *part);
+
+      g_free (*part);
+      *part = new_part;
+    }
+  while (input->pump[0] == '\0');
+
+  if (strlen (input->prefix) > MAX_PART_LENGTH ||
+      strlen (input->pump) > MAX_PART_LENGTH ||
+      strlen (input->suffix) > MAX_PART_LENGTH)
+    {
+      pumped_input_free (input);
+      return random_input (fuzz);
+    }
+
+  return input;
+}
+
+static gboolean
+is_slow (GcuFuzz           *fuzz,
+         const PumpedInput *input,
+         gint64             min_time)
+{
+  Growth growth;
+
+  measure_growth (fuzz, input, min_time, &growth);
+  return growth.superlinearity > _bound;
+}
+
+/* Removes the characters of @input, one at a time, as long as it stays slow.
+ * The remaining letters and digits are then replaced by "a" when possible, so
+ * that the same slow input with other identifiers is saved only once.
+ */
+static void
+minimize_input (GcuFuzz     *fuzz,
+                PumpedInput *input)
+{
+  gchar **parts[] = { &input->prefix, &input->pump, &input->suffix };
+  gboolean changed = TRUE;
+  guint part_num;
+
+  while (changed)
+    {
+      changed = FALSE;
+
+      for (part_num = 0; part_num < G_N_ELEMENTS (parts); part_num++)
+        {
+          gchar **part = parts[part_num];
+          gchar *pos = *part;
+
+          while (*pos != '\0')
+            {
+              gchar *next = g_utf8_next_char (pos);
+              gchar *old_part = *part;
+
+              *part = g_strdup_printf ("%.*s%s", (gint) (pos - old_part), old_part, next);
+
+              if (input->pump[0] != '\0' &&
+                  is_slow (fuzz, input, FUZZ_MIN_TIME))
+                {
+                  pos = *part + (pos - old_part);
+                  g_free (old_part);
+                  changed = TRUE;
+                }
+              else
+                {
+                  g_free (*part);
+                  *part = old_part;
+                  pos = next;
+                }
+            }
+        }
+    }
+
+  for (part_num = 0; part_num < G_N_ELEMENTS (parts); part_num++)
+    {
+      gchar *pos;
+
+      for (pos = *parts[part_num]; *pos != '\0'; pos++)
+        {
+          gchar old_char = *pos;
+
+          if (!g_ascii_isalnum (old_char) || old_char == 'a')
+            continue;
+
+          *pos = 'a';
+          if (!is_slow (fuzz, input, FUZZ_MIN_TIME))
+            *pos = old_char;
+        }
+    }
+}
+
+static gint
+compare_scores (gconstpointer a,
+                gconstpointer b)
+{
+  const PumpedInput *input_a = *(const PumpedInput * const *) a;
+  const PumpedInput *input_b = *(const PumpedInput * const *) b;
+
+  if (input_a->score > input_b->score)
+    return -1;
+
+  return input_a->score < input_b->score ? 1 : 0;
+}
+
+/* Keeps the N_BEST_INPUTS slowest inputs in @best_inputs, sorted by score.
+ * Takes ownership of @input.
+ */
+static void
+add_best_input (GPtrArray   *best_inputs,
+                PumpedInput *input)
+{
+  g_ptr_array_add (best_inputs, input);
+  g_ptr_array_sort (best_inputs, compare_scores);
+
+  if (best_inputs->len > N_BEST_INPUTS)
+    g_ptr_array_remove_index (best_inputs, best_inputs->len - 1);
+}
+
+/* Returns whether @input is new in the corpus. */
+static gboolean
+add_to_corpus (const PumpedInput *input)
+{
+  gchar *filename;
+  gchar *path;
+  gboolean added = FALSE;
+  GError *error = NULL;
+
+  filename = pumped_input_get_filename (input);
+  path = g_build_filename (_corpus_dir, filename, NULL);
+
+  if (!g_file_test (path, G_FILE_TEST_EXISTS))
+    {
+      added = pumped_input_save (input, path, &error);
+
+      if (error != NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  g_free (filename);
+  g_free (path);
+  return added;
+}
+
+static gint
+run_fuzzer (GcuFuzz *fuzz)
+{
+  GPtrArray *best_inputs;
+  GPtrArray *paths;
+  gint64 end_time;
+  guint n_tries = 0;
+  guint n_found = 0;
+  guint i;
+  GError *error = NULL;
+
+  g_mkdir_with_parents (_corpus_dir, 0755);
+
+  paths = list_corpus (&error);
+  if (paths == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
+
+  if (_seed == 0)
+    _seed = g_get_real_time () % G_MAXINT;
+
+  fuzz->rand = g_rand_new_with_seed (_seed);
+  g_print ("Seed: %d\n", _seed);
+
+  best_inputs = g_ptr_array_new_with_free_func ((GDestroyNotify) pumped_input_free);
+
+  /* The corpus is the starting point, it may be slow in a new way after a
+   * change.
+   */
+  for (i = 0; i < paths->len; i++)
+    {
+      PumpedInput *input;
+      Growth growth;
+
+      input = pumped_input_load (g_ptr_array_index (paths, i), NULL);
+      if (input == NULL)
+        continue;
+
+      measure_growth (fuzz, input, FUZZ_MIN_TIME, &growth);
+      input->score = growth.superlinearity;
+      add_best_input (best_inputs, input);
+    }
+
+  end_time = g_get_monotonic_time () + (gint64) _fuzz_seconds * G_USEC_PER_SEC;
+
+  while (g_get_monotonic_time () < end_time)
+    {
+      PumpedInput *input;
+      Growth growth;
+
+      if (best_inputs->len > 0 && g_rand_int_range (fuzz->rand, 0, 4) != 0)
+        input = mutate_input (fuzz, g_ptr_array_index (best_inputs, g_rand_int_range (fuzz->rand, 0, best_inputs->len)));
+      else
+        input = random_input (fuzz);
+
+      n_tries++;
+      measure_growth (fuzz, input, FUZZ_MIN_TIME, &growth);
+      input->score = growth.superlinearity;
+
+      /* Confirmed with the measure of the check, to skip the noise. */
+      if (input->score > _bound)
+        {
+          PumpedInput *minimized;
+
+          minimized = pumped_input_new (input->prefix, input->pump, input->suffix);
+          minimize_input (fuzz, minimized);
+          measure_growth (fuzz, minimized, MIN_TIME, &growth);
+
+          if (growth.superlinearity > _bound && add_to_corpus (minimized))
+            {
+              g_print ("Found: super-linearity %.2f, %.1f ns per byte for %" G_GSIZE_FORMAT " bytes\n",
+                       growth.superlinearity,
+                       growth.ns_per_byte,
+                       growth.size);
+              n_found++;
+            }
+
+          pumped_input_free (minimized);
+        }
+
+      add_best_input (best_inputs, input);
+    }
+
+  g_print ("%u inputs tried, %u slow inputs added to %s\n", n_tries, n_found, _corpus_dir);
+
+  g_ptr_array_unref (best_inputs);
+  g_ptr_array_unref (paths);
+  g_rand_free (fuzz->rand);
+  fuzz->rand = NULL;
+
+  return EXIT_SUCCESS;
+}
+
+/* Frees @fuzz. Returns the exit status of the program. */
+gint
+gcu_fuzz_run (GcuFuzz *fuzz)
+{
+  gint status;
+
+  g_return_val_if_fail (fuzz != NULL, EXIT_FAILURE);
+
+  if (_fuzz_seconds > 0)
+    status = run_fuzzer (fuzz);
+  else
+    status = check_corpus (fuzz);
+
+  g_free (fuzz);
+  return status;
+}
@@ -0,0 +1,43 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_FUZZ_H
+#define GCU_FUZZ_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef void (* GcuFuzzFunc) (const gchar *input,
+			      gsize        length,
+			      gpointer     user_data);
+
+typedef struct _GcuFuzz GcuFuzz;
+
+GcuFuzz *	gcu_fuzz_new		(gint               *argc,
+					 gchar            ***argv,
+					 const gchar * const *tokens,
+					 GcuFuzzFunc         func,
+					 gpointer            user_data);
+
+gint		gcu_fuzz_run		(GcuFuzz            *fuzz);
+
+G_END_DECLS
+
+#endif /* GCU_FUZZ_H */
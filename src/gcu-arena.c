@@ -0,0 +1,195 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-arena.h"
+#include <string.h>
+
+/*
+ * Bump allocator for the short-lived data of the parsing, e.g. the copies of
+ * the lines and the matched parameters of a function declaration.
+ *
+ * When several threads process files, each small g_malloc() and g_free() goes
+ * through the shared allocator, which doesn't scale well with the number of
+ * threads. Instead, each thread has its own arena: an allocation just moves a
+ * pointer in a chunk, and everything is freed at once by gcu_arena_reset(),
+ * when the data is no longer needed. The chunks are kept for the next use,
+ * up to MAX_RETAINED_SIZE, so after the first few files a thread doesn't call
+ * the allocator at all for that data.
+ *
+ * An arena must only be used by its thread, and the memory returned by
+ * gcu_arena_alloc() must not be freed or reallocated.
+ */
+
+#define CHUNK_SIZE (64 * 1024)
+#define MAX_RETAINED_SIZE (1024 * 1024)
+#define ALIGNMENT (2 * sizeof (gpointer))
+#define ALIGN(size) (((size) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+typedef struct _Chunk Chunk;
+struct _Chunk
+{
+  Chunk *next;
+  gsize size;
+  gsize used;
+
+  /* Followed by the data, at CHUNK_HEADER_SIZE. */
+};
+
+#define CHUNK_HEADER_SIZE ALIGN (sizeof (Chunk))
+
+struct _GcuArena
+{
+  Chunk *first;
+  Chunk *last;
+
+  /* The chunks after the current one are unused. */
+  Chunk *current;
+};
+
+static void arena_free (GcuArena *arena);
+
+static GPrivate thread_arena = G_PRIVATE_INIT ((GDestroyNotify) arena_free);
+
+static Chunk *
+chunk_new (gsize size)
+{
+  Chunk *chunk;
+
+  chunk = g_malloc (CHUNK_HEADER_SIZE + size);
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+
+  return chunk;
+}
+
+static void
+arena_free (GcuArena *arena)
+{
+  Chunk *chunk;
+  Chunk *next;
+
+  for (chunk = arena->first; chunk != NULL; chunk = next)
+    {
+      next = chunk->next;
+      g_free (chunk);
+    }
+
+  g_free (arena);
+}
+
+/* Returns: (transfer none): the arena of the current thread, freed when the
+ * thread exits.
+ */
+GcuArena *
+gcu_arena_get_for_thread (void)
+{
+  GcuArena *arena;
+
+  arena = g_private_get (&thread_arena);
+  if (arena != NULL)
+    return arena;
+
+  arena = g_new0 (GcuArena, 1);
+  arena->first = chunk_new (CHUNK_SIZE);
+  arena->last = arena->first;
+  arena->current = arena->first;
+
+  g_private_set (&thread_arena, arena);
+  return arena;
+}
+
+/* Returns: uninitialized memory of @size bytes, aligned like g_malloc(),
+ * valid until the next gcu_arena_reset().
+ */
+gpointer
+gcu_arena_alloc (GcuArena *arena,
+                 gsize     size)
+{
+  Chunk *chunk;
+  gpointer data;
+
+  size = ALIGN (size);
+
+  for (chunk = arena->current; chunk != NULL; chunk = chunk->next)
+    {
+      if (chunk->size - chunk->used >= size)
+        break;
+    }
+
+  if (chunk == NULL)
+    {
+      chunk = chunk_new (MAX (CHUNK_SIZE, size));
+      arena->last->next = chunk;
+      arena->last = chunk;
+    }
+
+  arena->current = chunk;
+
+  data = (guint8 *) chunk + CHUNK_HEADER_SIZE + chunk->used;
+  chunk->used += size;
+
+  return data;
+}
+
+/* Like g_strndup(), @str must have at least @length bytes. */
+gchar *
+gcu_arena_strndup (GcuArena    *arena,
+                   const gchar *str,
+                   gsize        length)
+{
+  gchar *copy;
+
+  copy = gcu_arena_alloc (arena, length + 1);
+  memcpy (copy, str, length);
+  copy[length] = '\0';
+
+  return copy;
+}
+
+/* Frees all the memory allocated from @arena. The first chunks are kept for
+ * the next allocations, the others (e.g. for a very long line) are freed.
+ */
+void
+gcu_arena_reset (GcuArena *arena)
+{
+  Chunk *prev = arena->first;
+  Chunk *chunk;
+  gsize retained_size = arena->first->size;
+
+  arena->first->used = 0;
+
+  for (chunk = arena->first->next; chunk != NULL; chunk = prev->next)
+    {
+      if (retained_size + chunk->size <= MAX_RETAINED_SIZE)
+        {
+          chunk->used = 0;
+          retained_size += chunk->size;
+          prev = chunk;
+        }
+      else
+        {
+          prev->next = chunk->next;
+          g_free (chunk);
+        }
+    }
+
+  arena->last = prev;
+  arena->current = arena->first;
+}
@@ -0,0 +1,42 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_ARENA_H
+#define GCU_ARENA_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GcuArena GcuArena;
+
+GcuArena *	gcu_arena_get_for_thread	(void);
+
+gpointer	gcu_arena_alloc			(GcuArena	*arena,
+						 gsize		 size);
+
+gchar *		gcu_arena_strndup		(GcuArena	*arena,
+						 const gchar	*str,
+						 gsize		 length);
+
+void		gcu_arena_reset			(GcuArena	*arena);
+
+G_END_DECLS
+
+#endif /* GCU_ARENA_H */
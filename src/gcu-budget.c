@@ -0,0 +1,335 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-budget.h"
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <string.h>
+
+/*
+ * Per-file work budget, so that one pathological file (minified or generated
+ * code, with multi-megabyte lines) doesn't stall a job on a whole tree.
+ *
+ * Before processing a file, gcu_budget_check_contents() checks its size and
+ * the length of its longest line. A tool that loads the file itself (in a
+ * GtkTextBuffer) checks the size with gcu_budget_check_file() before loading
+ * it, and then the lines of the loaded contents with gcu_budget_check_line(),
+ * so that the file is not read twice. During the processing,
+ * gcu_budget_counter_add_match() is called for each match, and checks the
+ * number of matches and the elapsed time. When a limit is exceeded, a warning
+ * is printed and the file must be left unmodified.
+ *
+ * The budget is opt-in: without the GCU_BUDGET environment variable, there is
+ * no limit. When it is set, the default limits below are used, overridden by
+ * its items, a comma-separated list, for example:
+ * GCU_BUDGET=bytes=4M,line-length=20000,matches=0,time=2.5
+ * "bytes" accepts the K, M and G suffixes, "time" is in seconds, and 0 means no
+ * limit. GCU_BUDGET= (empty) sets only the default limits.
+ */
+
+#define DEFAULT_MAX_BYTES (8 * 1024 * 1024)
+#define DEFAULT_MAX_LINE_LENGTH 10000
+#define DEFAULT_MAX_MATCHES 100000
+#define DEFAULT_MAX_SECONDS 10.0
+
+/* Parses a size in bytes, with an optional K, M or G suffix, like the "bytes"
+ * of GCU_BUDGET. A size that doesn't fit in a gsize is invalid.
+ */
+gboolean
+gcu_budget_parse_size (const gchar *str,
+                       gsize       *size)
+{
+  gchar *end;
+  guint64 value;
+  guint64 multiplier = 1;
+
+  if (!g_ascii_isdigit (str[0]))
+    return FALSE;
+
+  errno = 0;
+  value = g_ascii_strtoull (str, &end, 10);
+  if (errno == ERANGE)
+    return FALSE;
+
+  switch (*end)
+    {
+      case 'K':
+        multiplier = 1024;
+        end++;
+        break;
+
+      case 'M':
+        multiplier = 1024 * 1024;
+        end++;
+        break;
+
+      case 'G':
+        multiplier = 1024 * 1024 * 1024;
+        end++;
+        break;
+
+      default:
+        break;
+    }
+
+  /* Checked before the multiplication, which could overflow. */
+  if (*end != '\0' || value > G_MAXSIZE / multiplier)
+    return FALSE;
+
+  *size = value * multiplier;
+  return TRUE;
+}
+
+static gboolean
+parse_item (GcuBudget   *budget,
+            const gchar *key,
+            const gchar *value)
+{
+  gchar *end;
+  gsize size;
+
+  if (g_str_equal (key, "bytes"))
+    return gcu_budget_parse_size (value, &budget->max_bytes);
+
+  if (g_str_equal (key, "line-length"))
+    return gcu_budget_parse_size (value, &budget->max_line_length);
+
+  if (g_str_equal (key, "matches"))
+    {
+      if (!gcu_budget_parse_size (value, &size) || size > G_MAXUINT)
+        return FALSE;
+
+      budget->max_matches = size;
+      return TRUE;
+    }
+
+  if (g_str_equal (key, "time"))
+    {
+      budget->max_seconds = g_ascii_strtod (value, &end);
+      return value[0] != '\0' && *end == '\0' && budget->max_seconds >= 0.0;
+    }
+
+  return FALSE;
+}
+
+/* Sets the limits of the GCU_BUDGET environment variable, or no limit if it is
+ * not set.
+ */
+void
+gcu_budget_init (GcuBudget *budget)
+{
+  const gchar *spec;
+  gchar **items;
+  gint i;
+
+  g_return_if_fail (budget != NULL);
+
+  budget->max_bytes = 0;
+  budget->max_line_length = 0;
+  budget->max_matches = 0;
+  budget->max_seconds = 0.0;
+
+  spec = g_getenv ("GCU_BUDGET");
+  if (spec == NULL)
+    return;
+
+  budget->max_bytes = DEFAULT_MAX_BYTES;
+  budget->max_line_length = DEFAULT_MAX_LINE_LENGTH;
+  budget->max_matches = DEFAULT_MAX_MATCHES;
+  budget->max_seconds = DEFAULT_MAX_SECONDS;
+
+  items = g_strsplit (spec, ",", -1);
+
+  for (i = 0; items[i] != NULL; i++)
+    {
+      gchar **key_value;
+
+      if (items[i][0] == '\0')
+        continue;
+
+      key_value = g_strsplit (items[i], "=", 2);
+
+      if (key_value[1] == NULL ||
+          !parse_item (budget, key_value[0], key_value[1]))
+        g_warning ("GCU_BUDGET: invalid item '%s', ignored.", items[i]);
+
+      g_strfreev (key_value);
+    }
+
+  g_strfreev (items);
+}
+
+/* Returns whether the file can be processed. The cost is linear, with memchr(),
+ * so it can be called on any file.
+ */
+gboolean
+gcu_budget_check_contents (const GcuBudget *budget,
+                           const gchar     *filename,
+                           const gchar     *contents,
+                           gsize            length)
+{
+  const gchar *line_start;
+  const gchar *end;
+  guint line_num;
+
+  g_return_val_if_fail (budget != NULL, FALSE);
+  g_return_val_if_fail (contents != NULL || length == 0, FALSE);
+
+  if (budget->max_bytes > 0 && length > budget->max_bytes)
+    {
+      g_warning ("%s: skipped, %" G_GSIZE_FORMAT " bytes (limit: %" G_GSIZE_FORMAT ").",
+                 filename,
+                 length,
+                 budget->max_bytes);
+      return FALSE;
+    }
+
+  if (budget->max_line_length == 0)
+    return TRUE;
+
+  end = contents + length;
+
+  for (line_start = contents, line_num = 1; line_start < end; line_num++)
+    {
+      const gchar *line_end;
+
+      line_end = memchr (line_start, '\n', end - line_start);
+      if (line_end == NULL)
+        line_end = end;
+
+      if (!gcu_budget_check_line (budget, filename, line_num, line_end - line_start))
+        return FALSE;
+
+      line_start = line_end + 1;
+    }
+
+  return TRUE;
+}
+
+/* Checks the length in bytes of the line @line_num (starting at 1), without
+ * the newline.
+ */
+gboolean
+gcu_budget_check_line (const GcuBudget *budget,
+                       const gchar     *filename,
+                       guint            line_num,
+                       gsize            line_length)
+{
+  g_return_val_if_fail (budget != NULL, FALSE);
+
+  if (budget->max_line_length > 0 && line_length > budget->max_line_length)
+    {
+      g_warning ("%s: skipped, line %u has %" G_GSIZE_FORMAT " bytes (limit: %" G_GSIZE_FORMAT ").",
+                 filename,
+                 line_num,
+                 line_length,
+                 budget->max_line_length);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Checks only the size of @filename, without reading it, so that a huge file
+ * is not loaded. The lines must then be checked on the loaded contents, with
+ * gcu_budget_check_line(). An inaccessible file is not skipped, to let the
+ * tool report the error.
+ */
+gboolean
+gcu_budget_check_file (const GcuBudget *budget,
+                       const gchar     *filename)
+{
+  GStatBuf file_stat;
+
+  g_return_val_if_fail (budget != NULL, FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+
+  if (budget->max_bytes == 0 ||
+      g_stat (filename, &file_stat) != 0)
+    return TRUE;
+
+  if ((guint64) file_stat.st_size > budget->max_bytes)
+    {
+      g_warning ("%s: skipped, %" G_GUINT64_FORMAT " bytes (limit: %" G_GSIZE_FORMAT ").",
+                 filename,
+                 (guint64) file_stat.st_size,
+                 budget->max_bytes);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Starts counting the work done on @filename. @budget and @filename must stay
+ * alive as long as @counter is used.
+ */
+void
+gcu_budget_counter_init (GcuBudgetCounter *counter,
+                         const GcuBudget  *budget,
+                         const gchar      *filename)
+{
+  g_return_if_fail (counter != NULL);
+  g_return_if_fail (budget != NULL);
+
+  counter->budget = budget;
+  counter->filename = filename;
+  counter->start_time = g_get_monotonic_time ();
+  counter->n_matches = 0;
+  counter->exceeded = FALSE;
+}
+
+/* Returns: %FALSE if the budget is exceeded. The processing must then stop and
+ * the file must be left unmodified.
+ */
+gboolean
+gcu_budget_counter_add_match (GcuBudgetCounter *counter)
+{
+  const GcuBudget *budget;
+  gdouble elapsed_seconds;
+
+  g_return_val_if_fail (counter != NULL, FALSE);
+
+  if (counter->exceeded)
+    return FALSE;
+
+  budget = counter->budget;
+  counter->n_matches++;
+
+  if (budget->max_matches > 0 && counter->n_matches > budget->max_matches)
+    {
+      g_warning ("%s: skipped, more than %u matches.",
+                 counter->filename,
+                 budget->max_matches);
+      counter->exceeded = TRUE;
+      return FALSE;
+    }
+
+  elapsed_seconds = (g_get_monotonic_time () - counter->start_time) / (gdouble) G_USEC_PER_SEC;
+
+  if (budget->max_seconds > 0.0 && elapsed_seconds > budget->max_seconds)
+    {
+      g_warning ("%s: skipped, more than %.1f seconds.",
+                 counter->filename,
+                 budget->max_seconds);
+      counter->exceeded = TRUE;
+      return FALSE;
+    }
+
+  return TRUE;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_BUDGET_H
+#define GCU_BUDGET_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GcuBudget		GcuBudget;
+typedef struct _GcuBudgetCounter	GcuBudgetCounter;
+
+/* The limits for one file. 0 means no limit. */
+struct _GcuBudget
+{
+  gsize max_bytes;
+  gsize max_line_length;
+  guint max_matches;
+  gdouble max_seconds;
+};
+
+/* The work done so far on one file. */
+struct _GcuBudgetCounter
+{
+  const GcuBudget *budget;
+  const gchar *filename;
+  gint64 start_time;
+  guint n_matches;
+  guint exceeded : 1;
+};
+
+void		gcu_budget_init			(GcuBudget		*budget);
+
+gboolean	gcu_budget_check_contents	(const GcuBudget	*budget,
+						 const gchar		*filename,
+						 const gchar		*contents,
+						 gsize			 length);
+
+gboolean	gcu_budget_check_line		(const GcuBudget	*budget,
+						 const gchar		*filename,
+						 guint			 line_num,
+						 gsize			 line_length);
+
+gboolean	gcu_budget_check_file		(const GcuBudget	*budget,
+						 const gchar		*filename);
+
+void		gcu_budget_counter_init		(GcuBudgetCounter	*counter,
+						 const GcuBudget	*budget,
+						 const gchar		*filename);
+
+gboolean	gcu_budget_counter_add_match	(GcuBudgetCounter	*counter);
+
+gboolean	gcu_budget_parse_size		(const gchar		*str,
+						 gsize			*size);
+
+G_END_DECLS
+
+#endif /* GCU_BUDGET_H */
@@ -20,7 +20,7 @@
 /*
  * Basic check of GObject virtual function chain-ups.
  *
- * Usage: gcu-check-chain-ups <file.c>
+ * Usage: gcu-check-chain-ups [--shard I/N] [--results FILE] [--metrics FILE] <file.c>...
  *
  * For a less verbose output, redirect stdout to /dev/null. The warnings/errors
  * are printed on stderr.
@@ -46,6 +46,25 @@
  *
  * "my_class_finalize" doesn't have the "dispose" suffix, so it'll print a
  * message on stderr.
+ *
+ * The chain-ups in comments (including the #if 0 blocks) and in strings are
+ * ignored. The function name is the one of the function definition found by
+ * the lexer (see gcu-lex.c), a chain-up outside a function is ignored.
+ *
+ * A file that exceeds the limits of the GCU_BUDGET environment variable is
+ * skipped, or not checked further, with a warning (see gcu-budget.c). A file
+ * whose check is stopped partway is "incomplete", and the exit status is then
+ * 1, since the chain-ups after that point are not checked.
+ *
+ * With --shard I/N, only the part I of N of the files is checked, to split a
+ * tree-wide check between N processes (see gcu-shard.c). With --results FILE,
+ * the status of each file ("ok", "warning", "incomplete" or "skipped") and its
+ * warnings are written to FILE in JSON, and the results files of the shards
+ * can be combined with gcu-merge-results.
+ *
+ * With --metrics FILE, the progress of the check is written to FILE in the
+ * Prometheus text format, and updated every few seconds (see gcu-metrics.c).
+ * The matches are the chain-ups.
  */
 
 /* TODO A possible improvement is to search the function name
@@ -67,72 +86,108 @@
  */
 #include <gtksourceview/gtksource.h>
 #include <stdlib.h>
+#include "gcu-budget.h"
+#include "gcu-lex.h"
+#include "gcu-metrics.h"
+#include "gcu-results.h"
+#include "gcu-shard.h"
 
+static GcuBudget _budget;
+
+/* Returns NULL if the file is over budget. Otherwise @lex is set to the spans
+ * of the buffer. @length is set to the size of the file, in bytes.
+ */
 static GtkSourceBuffer *
-open_file (GFile *file)
+open_file (GFile        *file,
+           const gchar  *path,
+           GcuLex      **lex,
+           gsize        *length)
 {
   gchar *content;
   GtkSourceBuffer *buffer;
   GError *error = NULL;
 
-  g_file_load_contents (file, NULL, &content, NULL, NULL, &error);
+  g_file_load_contents (file, NULL, &content, length, NULL, &error);
   g_assert_no_error (error);
 
+  if (!gcu_budget_check_contents (&_budget, path, content, *length))
+    {
+      g_free (content);
+      return NULL;
+    }
+
   buffer = gtk_source_buffer_new (NULL);
   gtk_text_buffer_set_text (GTK_TEXT_BUFFER (buffer), content, -1);
+  *lex = gcu_lex_new (content, -1);
 
   g_free (content);
   return buffer;
 }
 
-static gchar *
-get_function_name (const GtkTextIter *_iter)
+static gboolean
+is_in_span (const GcuLex      *lex,
+            GcuLexSpanKind     kind,
+            const GtkTextIter *iter)
 {
-  GtkTextIter iter = *_iter;
+  return gcu_lex_find_span (lex, kind, gtk_text_iter_get_offset (iter)) != NULL;
+}
 
-  while (gtk_text_iter_backward_line (&iter))
-    {
-      gunichar c;
+static gboolean
+is_in_comment_or_string (const GcuLex      *lex,
+                         const GtkTextIter *iter)
+{
+  return (is_in_span (lex, GCU_LEX_SPAN_COMMENT, iter) ||
+          is_in_span (lex, GCU_LEX_SPAN_STRING, iter));
+}
 
-      c = gtk_text_iter_get_char (&iter);
-      if (g_unichar_isalpha (c) || c == '_')
-        {
-          GtkTextIter function_name_start;
-          GtkTextIter function_name_end;
+/* Returns the name of the function definition that contains @_iter, or %NULL
+ * if it's not in a function.
+ */
+static gchar *
+get_function_name (const GtkTextIter *_iter,
+                   const GcuLex      *lex)
+{
+  const GcuLexSpan *function;
+  GtkTextIter function_name_start;
+  GtkTextIter function_name_end;
 
-          function_name_start = iter;
-          function_name_end = iter;
+  function = gcu_lex_find_span (lex,
+                                GCU_LEX_SPAN_FUNCTION,
+                                gtk_text_iter_get_offset (_iter));
+  if (function == NULL)
+    return NULL;
 
-          while (gtk_text_iter_forward_char (&function_name_end))
-            {
-              gunichar end_c;
+  function_name_start = *_iter;
+  gtk_text_iter_set_offset (&function_name_start, function->start);
+  function_name_end = function_name_start;
 
-              end_c = gtk_text_iter_get_char (&function_name_end);
-              if (!g_unichar_isalnum (end_c) && end_c != '_')
-                break;
-            }
+  while (!gtk_text_iter_is_end (&function_name_end))
+    {
+      gunichar c;
 
-          /* A goto label, not a function name. */
-          if (gtk_text_iter_get_char (&function_name_end) == ':')
-            continue;
+      c = gtk_text_iter_get_char (&function_name_end);
+      if (!g_unichar_isalnum (c) && c != '_')
+        break;
 
-          return gtk_text_iter_get_text (&function_name_start, &function_name_end);
-        }
+      gtk_text_iter_forward_char (&function_name_end);
     }
 
-  return NULL;
+  return gtk_text_iter_get_text (&function_name_start, &function_name_end);
 }
 
+/* The warnings are also appended to @warnings. */
 static void
 check_chain_up (GtkSourceBuffer   *buffer,
                 const GtkTextIter *vfunc_start,
-                const gchar       *basename)
+                const GcuLex      *lex,
+                const gchar       *basename,
+                GString           *warnings)
 {
   gchar *function_name;
   GtkTextIter vfunc_end;
   gchar *vfunc;
 
-  function_name = get_function_name (vfunc_start);
+  function_name = get_function_name (vfunc_start, lex);
   if (function_name == NULL)
     return;
 
@@ -163,24 +218,36 @@ check_chain_up (GtkSourceBuffer   *buffer,
     }
   else
     {
-      g_printerr ("%s: %s() chains up '%s'. Is that correct?\n",
-                  basename,
-                  function_name,
-                  vfunc);
+      gchar *warning;
+
+      warning = g_strdup_printf ("%s: %s() chains up '%s'. Is that correct?\n",
+                                 basename,
+                                 function_name,
+                                 vfunc);
+
+      g_printerr ("%s", warning);
+      g_string_append (warnings, warning);
+      g_free (warning);
     }
 
   g_free (function_name);
   g_free (vfunc);
 }
 
-static void
+/* Returns %FALSE if the budget ran out before the end of @buffer. */
+static gboolean
 check_buffer (GtkSourceBuffer *buffer,
-              const gchar     *basename)
+              const GcuLex    *lex,
+              const gchar     *basename,
+              GString         *warnings)
 {
   GtkSourceSearchSettings *search_settings;
   GtkSourceSearchContext *search_context;
   GtkTextIter iter;
   GtkTextIter match_end;
+  GcuBudgetCounter budget_counter;
+
+  gcu_budget_counter_init (&budget_counter, &_budget, basename);
 
   search_settings = gtk_source_search_settings_new ();
   gtk_source_search_settings_set_regex_enabled (search_settings, TRUE);
@@ -198,41 +265,194 @@ check_buffer (GtkSourceBuffer *buffer,
                                             &match_end,
                                             NULL))
     {
-      check_chain_up (buffer, &match_end, basename);
+      if (!gcu_budget_counter_add_match (&budget_counter))
+        break;
+
       iter = match_end;
+
+      if (is_in_comment_or_string (lex, &match_end))
+        continue;
+
+      gcu_metrics_add_matches (1);
+      check_chain_up (buffer, &match_end, lex, basename, warnings);
     }
 
   g_object_unref (search_settings);
   g_object_unref (search_context);
+
+  return !budget_counter.exceeded;
 }
 
-gint
-main (gint   argc,
-      gchar *argv[])
+/* Returns %FALSE if the check of the file is incomplete. */
+static gboolean
+check_file (const gchar *path,
+            GcuResults  *results)
 {
-  const gchar *path;
   GFile *file;
   GtkSourceBuffer *buffer;
+  GcuLex *lex = NULL;
   gchar *basename;
+  GString *warnings;
+  const gchar *status;
+  gboolean complete = TRUE;
+  gsize length;
+  gint64 metrics_begin_time;
+
+  metrics_begin_time = gcu_metrics_file_begin (path);
+
+  file = g_file_new_for_path (path);
+  basename = g_file_get_basename (file);
+  warnings = g_string_new (NULL);
+
+  buffer = open_file (file, path, &lex, &length);
+  if (buffer != NULL)
+    complete = check_buffer (buffer, lex, basename, warnings);
 
+  if (buffer == NULL)
+    status = "skipped";
+  else if (!complete)
+    status = "incomplete";
+  else
+    status = warnings->len > 0 ? "warning" : "ok";
+
+  if (results != NULL)
+    {
+      gcu_results_add (results,
+                       path,
+                       status,
+                       length,
+                       warnings->len > 0 ? warnings->str : NULL);
+    }
+
+  gcu_metrics_file_end (metrics_begin_time, length, status);
+
+  g_object_unref (file);
+  g_clear_object (&buffer);
+  gcu_lex_free (lex);
+  g_free (basename);
+  g_string_free (warnings, TRUE);
+
+  return complete;
+}
+
+static void
+print_usage (gchar **argv)
+{
+  g_printerr ("Usage: %s [--shard I/N] [--results FILE] [--metrics FILE] <file.c>...\n", argv[0]);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  const gchar *shard_spec = NULL;
+  const gchar *results_path = NULL;
+  const gchar *metrics_path = NULL;
+  GcuShard shard;
+  GcuResults *results = NULL;
+  gboolean *selected;
+  gint n_files;
+  gchar **files;
+  gint arg_num = 1;
+  gint file_num;
+  gint ret = EXIT_SUCCESS;
+  GError *error = NULL;
+
+  gcu_budget_init (&_budget);
   gtk_init (NULL, NULL);
 
-  if (argc != 2)
+  while (arg_num + 1 < argc)
+    {
+      if (g_str_equal (argv[arg_num], "--shard"))
+        shard_spec = argv[arg_num + 1];
+      else if (g_str_equal (argv[arg_num], "--results"))
+        results_path = argv[arg_num + 1];
+      else if (g_str_equal (argv[arg_num], "--metrics"))
+        metrics_path = argv[arg_num + 1];
+      else
+        break;
+
+      arg_num += 2;
+    }
+
+  if (arg_num >= argc)
     {
-      g_printerr ("Usage: %s <file.c>\n", argv[0]);
+      print_usage (argv);
       return EXIT_FAILURE;
     }
 
-  path = argv[1];
-  file = g_file_new_for_path (path);
-  basename = g_file_get_basename (file);
+  if (shard_spec != NULL && !gcu_shard_parse (&shard, shard_spec, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
 
-  buffer = open_file (file);
-  check_buffer (buffer, basename);
+  if (metrics_path != NULL && !gcu_metrics_start ("gcu-check-chain-ups", metrics_path, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
 
-  g_object_unref (file);
-  g_object_unref (buffer);
-  g_free (basename);
+  if (results_path != NULL)
+    results = gcu_results_new ("gcu-check-chain-ups", shard_spec != NULL ? &shard : NULL);
+
+  n_files = argc - arg_num;
+  files = argv + arg_num;
+  selected = g_new (gboolean, n_files);
+
+  if (shard_spec != NULL)
+    {
+      gcu_shard_select (&shard, n_files, files, NULL, selected);
+    }
+  else
+    {
+      for (file_num = 0; file_num < n_files; file_num++)
+        selected[file_num] = TRUE;
+    }
+
+  for (file_num = 0; file_num < n_files; file_num++)
+    {
+      if (selected[file_num])
+        gcu_metrics_add_queued (1);
+    }
+
+  for (file_num = 0; file_num < n_files; file_num++)
+    {
+      if (selected[file_num] && !check_file (files[file_num], results))
+        ret = EXIT_FAILURE;
+    }
+
+  g_free (selected);
+
+  if (metrics_path != NULL && !gcu_metrics_stop (&error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+
+      if (results != NULL)
+        gcu_results_free (results);
+
+      return EXIT_FAILURE;
+    }
+
+  if (results != NULL)
+    {
+      gboolean ok;
+
+      gcu_results_set_exit_status (results, ret);
+      ok = gcu_results_save (results, results_path, &error);
+
+      gcu_results_free (results);
+
+      if (!ok)
+        {
+          g_printerr ("%s\n", error->message);
+          g_clear_error (&error);
+          return EXIT_FAILURE;
+        }
+    }
 
-  return EXIT_SUCCESS;
+  return ret;
 }
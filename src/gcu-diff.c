@@ -0,0 +1,381 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-diff.h"
+#include <string.h>
+
+/*
+ * Unified diffs, like "git diff" or "diff -u", to show the changes that a
+ * tool would do, without writing the files.
+ *
+ * The lines are compared with the Myers algorithm, after removing the common
+ * prefix and suffix. It needs O((N+M)·D) time and O(D²) memory, where D is the
+ * number of changed lines. That is small for the output of the tools, but if D
+ * is greater than MAX_EDIT_DISTANCE, the remaining lines are shown as entirely
+ * replaced instead.
+ */
+
+#define N_CONTEXT_LINES 3
+
+#define MAX_EDIT_DISTANCE 2000
+
+#define OP_EQUAL ' '
+#define OP_DELETE '-'
+#define OP_INSERT '+'
+
+typedef struct
+{
+  const gchar *start;
+
+  /* Including the '\n', if any. */
+  gsize length;
+} Line;
+
+static GArray *
+split_lines (const gchar *text,
+             gsize        length)
+{
+  GArray *lines;
+  const gchar *end = text + length;
+
+  lines = g_array_new (FALSE, FALSE, sizeof (Line));
+
+  while (text < end)
+    {
+      const gchar *newline;
+      Line line;
+
+      newline = memchr (text, '\n', end - text);
+
+      line.start = text;
+      line.length = newline != NULL ? (gsize) (newline - text + 1) : (gsize) (end - text);
+      g_array_append_val (lines, line);
+
+      text += line.length;
+    }
+
+  return lines;
+}
+
+static gboolean
+lines_equal (const Line *a,
+             const Line *b)
+{
+  return a->length == b->length && memcmp (a->start, b->start, a->length) == 0;
+}
+
+/* Appends to @ops the edit script from @a to @b, with one OP_* per line. */
+static void
+append_edit_script (GString    *ops,
+                    const Line *a,
+                    gint        n,
+                    const Line *b,
+                    gint        m)
+{
+  gint max;
+  gint *v;
+  GPtrArray *history;
+  GString *reversed_ops;
+  gint d;
+  gint x;
+  gint y;
+  gboolean found = FALSE;
+
+  max = MIN (n + m, MAX_EDIT_DISTANCE);
+
+  /* v[k + max + 1]: furthest x reached on the diagonal k = x - y. */
+  v = g_new0 (gint, 2 * max + 3);
+
+  /* history[d]: v for the diagonals -d..d, after d edits. */
+  history = g_ptr_array_new_with_free_func (g_free);
+
+  for (d = 0; d <= max && !found; d++)
+    {
+      gint k;
+      gint *snapshot;
+
+      for (k = -d; k <= d; k += 2)
+        {
+          if (k == -d || (k != d && v[k - 1 + max + 1] < v[k + 1 + max + 1]))
+            x = v[k + 1 + max + 1];
+          else
+            x = v[k - 1 + max + 1] + 1;
+
+          y = x - k;
+
+          while (x < n && y < m && lines_equal (&a[x], &b[y]))
+            {
+              x++;
+              y++;
+            }
+
+          v[k + max + 1] = x;
+
+          if (x >= n && y >= m)
+            found = TRUE;
+        }
+
+      snapshot = g_new (gint, 2 * d + 1);
+      memcpy (snapshot, v + max + 1 - d, (2 * d + 1) * sizeof (gint));
+      g_ptr_array_add (history, snapshot);
+    }
+
+  g_free (v);
+
+  if (!found)
+    {
+      for (x = 0; x < n; x++)
+        g_string_append_c (ops, OP_DELETE);
+      for (y = 0; y < m; y++)
+        g_string_append_c (ops, OP_INSERT);
+
+      g_ptr_array_unref (history);
+      return;
+    }
+
+  /* Backtrack from the end. */
+  reversed_ops = g_string_new (NULL);
+  x = n;
+  y = m;
+
+  for (d = history->len - 1; d >= 0; d--)
+    {
+      gint k = x - y;
+      gint previous_k;
+      gint previous_x;
+      gint previous_y;
+
+      if (d == 0)
+        {
+          while (x > 0)
+            {
+              g_string_append_c (reversed_ops, OP_EQUAL);
+              x--;
+            }
+
+          break;
+        }
+
+      {
+        const gint *previous_v = (const gint *) g_ptr_array_index (history, d - 1) + (d - 1);
+
+        if (k == -d || (k != d && previous_v[k - 1] < previous_v[k + 1]))
+          previous_k = k + 1;
+        else
+          previous_k = k - 1;
+
+        previous_x = previous_v[previous_k];
+        previous_y = previous_x - previous_k;
+      }
+
+      /* The snake after the edit. */
+      while (x - previous_x > (previous_k == k + 1 ? 0 : 1) &&
+             y - previous_y > (previous_k == k + 1 ? 1 : 0))
+        {
+          g_string_append_c (reversed_ops, OP_EQUAL);
+          x--;
+          y--;
+        }
+
+      if (previous_k == k + 1)
+        g_string_append_c (reversed_ops, OP_INSERT);
+      else
+        g_string_append_c (reversed_ops, OP_DELETE);
+
+      x = previous_x;
+      y = previous_y;
+    }
+
+  g_strreverse (reversed_ops->str);
+  g_string_append_len (ops, reversed_ops->str, reversed_ops->len);
+
+  g_string_free (reversed_ops, TRUE);
+  g_ptr_array_unref (history);
+}
+
+static void
+append_line (GString    *diff,
+             gchar       op,
+             const Line *line)
+{
+  g_string_append_c (diff, op);
+  g_string_append_len (diff, line->start, line->length);
+
+  if (line->length == 0 || line->start[line->length - 1] != '\n')
+    g_string_append (diff, "\n\\ No newline at end of file\n");
+}
+
+static void
+append_range (GString *diff,
+              gchar    sign,
+              gint     start,
+              gint     count)
+{
+  /* Like diff, an empty range starts at the line before. */
+  g_string_append_printf (diff, " %c%d", sign, count == 0 ? start : start + 1);
+
+  if (count != 1)
+    g_string_append_printf (diff, ",%d", count);
+}
+
+/* Appends to @diff the unified diff from @old_text to @new_text, with @path in
+ * the headers. Nothing is appended if the texts are equal.
+ */
+void
+gcu_diff_append_unified (GString     *diff,
+                         const gchar *path,
+                         const gchar *old_text,
+                         gsize        old_length,
+                         const gchar *new_text,
+                         gsize        new_length)
+{
+  GArray *old_lines;
+  GArray *new_lines;
+  const Line *a;
+  const Line *b;
+  gint n;
+  gint m;
+  gint prefix = 0;
+  gint suffix = 0;
+  GString *ops;
+  gsize pos;
+  gint old_line = 0;
+  gint new_line = 0;
+
+  g_return_if_fail (diff != NULL);
+  g_return_if_fail (path != NULL);
+
+  if (old_length == new_length &&
+      memcmp (old_text, new_text, old_length) == 0)
+    return;
+
+  old_lines = split_lines (old_text, old_length);
+  new_lines = split_lines (new_text, new_length);
+  a = (const Line *) (gpointer) old_lines->data;
+  b = (const Line *) (gpointer) new_lines->data;
+  n = old_lines->len;
+  m = new_lines->len;
+
+  while (prefix < n && prefix < m && lines_equal (&a[prefix], &b[prefix]))
+    prefix++;
+
+  while (suffix < n - prefix && suffix < m - prefix &&
+         lines_equal (&a[n - 1 - suffix], &b[m - 1 - suffix]))
+    suffix++;
+
+  ops = g_string_new (NULL);
+
+  for (pos = 0; pos < (gsize) prefix; pos++)
+    g_string_append_c (ops, OP_EQUAL);
+
+  append_edit_script (ops, a + prefix, n - prefix - suffix, b + prefix, m - prefix - suffix);
+
+  for (pos = 0; pos < (gsize) suffix; pos++)
+    g_string_append_c (ops, OP_EQUAL);
+
+  g_string_append_printf (diff, "--- a/%s\n+++ b/%s\n", path, path);
+
+  pos = 0;
+  while (pos < ops->len)
+    {
+      gsize hunk_start;
+      gsize hunk_end;
+      gsize changes_end;
+      gsize i;
+      gint old_count = 0;
+      gint new_count = 0;
+      gint hunk_old_line;
+      gint hunk_new_line;
+
+      if (ops->str[pos] == OP_EQUAL)
+        {
+          pos++;
+          old_line++;
+          new_line++;
+          continue;
+        }
+
+      /* Extend the hunk to the next changes, as long as they are close enough
+       * to share the context lines.
+       */
+      changes_end = pos;
+      i = pos;
+      while (i < ops->len)
+        {
+          gsize n_equal = 0;
+
+          if (ops->str[i] != OP_EQUAL)
+            {
+              changes_end = ++i;
+              continue;
+            }
+
+          while (i + n_equal < ops->len && ops->str[i + n_equal] == OP_EQUAL)
+            n_equal++;
+
+          if (i + n_equal == ops->len || n_equal > 2 * N_CONTEXT_LINES)
+            break;
+
+          i += n_equal;
+        }
+
+      hunk_start = pos >= N_CONTEXT_LINES ? pos - N_CONTEXT_LINES : 0;
+      hunk_end = MIN (changes_end + N_CONTEXT_LINES, ops->len);
+
+      hunk_old_line = old_line - (pos - hunk_start);
+      hunk_new_line = new_line - (pos - hunk_start);
+
+      for (i = hunk_start; i < hunk_end; i++)
+        {
+          if (ops->str[i] != OP_INSERT)
+            old_count++;
+          if (ops->str[i] != OP_DELETE)
+            new_count++;
+        }
+
+      g_string_append (diff, "@@");
+      append_range (diff, '-', hunk_old_line, old_count);
+      append_range (diff, '+', hunk_new_line, new_count);
+      g_string_append (diff, " @@\n");
+
+      old_line = hunk_old_line;
+      new_line = hunk_new_line;
+
+      for (i = hunk_start; i < hunk_end; i++)
+        {
+          gchar op = ops->str[i];
+
+          if (op == OP_INSERT)
+            append_line (diff, op, &b[new_line]);
+          else
+            append_line (diff, op, &a[old_line]);
+
+          if (op != OP_INSERT)
+            old_line++;
+          if (op != OP_DELETE)
+            new_line++;
+        }
+
+      pos = hunk_end;
+    }
+
+  g_string_free (ops, TRUE);
+  g_array_unref (old_lines);
+  g_array_unref (new_lines);
+}
@@ -0,0 +1,616 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-file-list.h"
+#include "gcu-json.h"
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Lists of *.c and *.h files to process, for the tools that accept several
+ * files.
+ *
+ * gcu_file_list_new_from_paths() scans directories recursively.
+ *
+ * gcu_file_list_new_from_compile_commands() takes the translation units from a
+ * compile_commands.json file, as generated by meson (or CMake), so that only
+ * the code actually compiled is processed, not the vendored or unused code
+ * that a checkout may contain. Only the files in the source tree (the current
+ * directory) are kept, and the files in the build directory (the directory of
+ * compile_commands.json) are skipped, since they are generated. For an
+ * in-source build, where the build directory is the source tree itself, no
+ * file is skipped. With @include_headers, the headers included with
+ * #include "..." from those files are added too, recursively, by searching
+ * them like the compiler: in the directory of the including file, then in the
+ * -I and -iquote directories of the translation unit.
+ *
+ * The returned filenames are sorted, and deduplicated for compile_commands.json,
+ * so that the results are stable between runs.
+ */
+
+typedef struct
+{
+  gchar *directory;
+  gchar *file;
+  gchar *command;
+  gchar **arguments;
+} CompileCommand;
+
+typedef struct
+{
+  /* Canonical path of the current directory. */
+  gchar *source_root;
+
+  /* Canonical path of the build directory, or %NULL if it is not a
+   * subdirectory of @source_root.
+   */
+  gchar *build_directory;
+
+  /* Set of canonical paths (gchar *) already added. */
+  GHashTable *added_files;
+
+  /* Filenames (gchar *) relative to @source_root. */
+  GPtrArray *filenames;
+} FileListBuilder;
+
+static gboolean
+is_c_source_file (const gchar *filename)
+{
+  return (g_str_has_suffix (filename, ".c") ||
+          g_str_has_suffix (filename, ".h"));
+}
+
+/* Recursively adds the *.c and *.h files found in @path to @filenames. Hidden
+ * files and directories are skipped, and symlinks to directories are not
+ * followed.
+ */
+static void
+collect_source_files (const gchar *path,
+                      GPtrArray   *filenames)
+{
+  GDir *dir;
+  const gchar *name;
+  GError *error = NULL;
+
+  dir = g_dir_open (path, 0, &error);
+  if (error != NULL)
+    {
+      g_warning ("Impossible to open directory: %s", error->message);
+      g_clear_error (&error);
+      return;
+    }
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *child;
+
+      if (name[0] == '.')
+        continue;
+
+      child = g_build_filename (path, name, NULL);
+
+      if (g_file_test (child, G_FILE_TEST_IS_DIR))
+        {
+          if (!g_file_test (child, G_FILE_TEST_IS_SYMLINK))
+            collect_source_files (child, filenames);
+
+          g_free (child);
+        }
+      else if (is_c_source_file (name))
+        {
+          g_ptr_array_add (filenames, child);
+        }
+      else
+        {
+          g_free (child);
+        }
+    }
+
+  g_dir_close (dir);
+}
+
+static gint
+compare_filenames (gconstpointer a,
+                   gconstpointer b)
+{
+  const gchar * const *filename_a = a;
+  const gchar * const *filename_b = b;
+
+  return strcmp (*filename_a, *filename_b);
+}
+
+/* Returns: (transfer full): the files in @paths, with the directories scanned
+ * recursively. If @n_paths is 0, the current directory is scanned.
+ */
+GPtrArray *
+gcu_file_list_new_from_paths (gint    n_paths,
+                              gchar **paths)
+{
+  GPtrArray *filenames;
+  gint i;
+
+  filenames = g_ptr_array_new_with_free_func (g_free);
+
+  if (n_paths == 0)
+    collect_source_files (".", filenames);
+
+  for (i = 0; i < n_paths; i++)
+    {
+      if (g_file_test (paths[i], G_FILE_TEST_IS_DIR))
+        collect_source_files (paths[i], filenames);
+      else
+        g_ptr_array_add (filenames, g_strdup (paths[i]));
+    }
+
+  g_ptr_array_sort (filenames, compare_filenames);
+
+  return filenames;
+}
+
+static void
+compile_command_free (CompileCommand *command)
+{
+  if (command != NULL)
+    {
+      g_free (command->directory);
+      g_free (command->file);
+      g_free (command->command);
+      g_strfreev (command->arguments);
+      g_free (command);
+    }
+}
+
+/* Reads one entry of compile_commands.json. The unknown keys are skipped.
+ * Returns: (transfer full) (nullable): the entry, or %NULL if invalid.
+ */
+static CompileCommand *
+json_read_compile_command (GcuJsonReader *reader)
+{
+  CompileCommand *command;
+
+  if (!gcu_json_reader_expect (reader, '{'))
+    return NULL;
+
+  command = g_new0 (CompileCommand, 1);
+
+  if (gcu_json_reader_expect (reader, '}'))
+    goto error;
+
+  do
+    {
+      gchar *key;
+      gboolean ok;
+
+      key = gcu_json_reader_read_string (reader);
+      if (key == NULL || !gcu_json_reader_expect (reader, ':'))
+        {
+          g_free (key);
+          goto error;
+        }
+
+      if (g_str_equal (key, "directory"))
+        {
+          g_free (command->directory);
+          command->directory = gcu_json_reader_read_string (reader);
+          ok = command->directory != NULL;
+        }
+      else if (g_str_equal (key, "file"))
+        {
+          g_free (command->file);
+          command->file = gcu_json_reader_read_string (reader);
+          ok = command->file != NULL;
+        }
+      else if (g_str_equal (key, "command"))
+        {
+          g_free (command->command);
+          command->command = gcu_json_reader_read_string (reader);
+          ok = command->command != NULL;
+        }
+      else if (g_str_equal (key, "arguments"))
+        {
+          g_strfreev (command->arguments);
+          command->arguments = gcu_json_reader_read_string_array (reader);
+          ok = command->arguments != NULL;
+        }
+      else
+        {
+          ok = gcu_json_reader_skip_value (reader);
+        }
+
+      g_free (key);
+
+      if (!ok)
+        goto error;
+    }
+  while (gcu_json_reader_expect (reader, ','));
+
+  if (!gcu_json_reader_expect (reader, '}') ||
+      command->directory == NULL ||
+      command->file == NULL)
+    goto error;
+
+  return command;
+
+error:
+  compile_command_free (command);
+  return NULL;
+}
+
+/* Returns: (transfer full) (nullable): the CompileCommand's. */
+static GPtrArray *
+read_compile_commands (const gchar  *path,
+                       GError      **error)
+{
+  gchar *contents;
+  gsize length;
+  GcuJsonReader reader;
+  GPtrArray *commands;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  gcu_json_reader_init (&reader, contents, length);
+
+  commands = g_ptr_array_new_with_free_func ((GDestroyNotify) compile_command_free);
+
+  if (!gcu_json_reader_expect (&reader, '['))
+    goto error;
+
+  if (!gcu_json_reader_expect (&reader, ']'))
+    {
+      do
+        {
+          CompileCommand *command = json_read_compile_command (&reader);
+
+          if (command == NULL)
+            goto error;
+
+          g_ptr_array_add (commands, command);
+        }
+      while (gcu_json_reader_expect (&reader, ','));
+
+      if (!gcu_json_reader_expect (&reader, ']'))
+        goto error;
+    }
+
+  if (!gcu_json_reader_at_end (&reader))
+    goto error;
+
+  g_free (contents);
+  return commands;
+
+error:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "%s: invalid compilation database at byte %" G_GSIZE_FORMAT,
+               path,
+               (gsize) (reader.pos - contents));
+
+  g_free (contents);
+  g_ptr_array_unref (commands);
+  return NULL;
+}
+
+/* Returns: (transfer full) (nullable): the canonical path of @path, or %NULL
+ * if it doesn't exist.
+ */
+static gchar *
+canonicalize_path (const gchar *path)
+{
+  char *resolved;
+  gchar *ret;
+
+  resolved = realpath (path, NULL);
+  if (resolved == NULL)
+    return NULL;
+
+  ret = g_strdup (resolved);
+  free (resolved);
+  return ret;
+}
+
+/* Returns: (transfer full): @path made absolute, relative to @directory. */
+static gchar *
+get_absolute_path (const gchar *directory,
+                   const gchar *path)
+{
+  if (g_path_is_absolute (path))
+    return g_strdup (path);
+
+  return g_build_filename (directory, path, NULL);
+}
+
+static gboolean
+is_in_directory (const gchar *canonical_path,
+                 const gchar *canonical_directory)
+{
+  gsize length = strlen (canonical_directory);
+
+  return (strncmp (canonical_path, canonical_directory, length) == 0 &&
+          canonical_path[length] == G_DIR_SEPARATOR);
+}
+
+/* Returns: (transfer full): the -I and -iquote directories of @command, made
+ * absolute.
+ */
+static GPtrArray *
+get_include_directories (const CompileCommand *command)
+{
+  GPtrArray *directories;
+  gchar **arguments = NULL;
+  gint i;
+
+  directories = g_ptr_array_new_with_free_func (g_free);
+
+  if (command->arguments != NULL)
+    arguments = g_strdupv (command->arguments);
+  else if (command->command != NULL &&
+           !g_shell_parse_argv (command->command, NULL, &arguments, NULL))
+    arguments = NULL;
+
+  for (i = 0; arguments != NULL && arguments[i] != NULL; i++)
+    {
+      const gchar *directory = NULL;
+
+      if (g_str_equal (arguments[i], "-I") ||
+          g_str_equal (arguments[i], "-iquote"))
+        {
+          if (arguments[i + 1] == NULL)
+            break;
+
+          directory = arguments[++i];
+        }
+      else if (g_str_has_prefix (arguments[i], "-iquote"))
+        {
+          directory = arguments[i] + strlen ("-iquote");
+        }
+      else if (g_str_has_prefix (arguments[i], "-I"))
+        {
+          directory = arguments[i] + strlen ("-I");
+        }
+
+      if (directory != NULL)
+        g_ptr_array_add (directories, get_absolute_path (command->directory, directory));
+    }
+
+  g_strfreev (arguments);
+  return directories;
+}
+
+/* Adds @canonical_path if it is a *.c or *.h file of the source tree, outside
+ * the build directory. Returns whether it has been added now.
+ */
+static gboolean
+file_list_builder_add (FileListBuilder *builder,
+                       const gchar     *canonical_path)
+{
+  if (!is_c_source_file (canonical_path) ||
+      !is_in_directory (canonical_path, builder->source_root) ||
+      (builder->build_directory != NULL &&
+       is_in_directory (canonical_path, builder->build_directory)) ||
+      g_hash_table_contains (builder->added_files, canonical_path))
+    return FALSE;
+
+  g_hash_table_add (builder->added_files, g_strdup (canonical_path));
+  g_ptr_array_add (builder->filenames,
+                   g_strdup (canonical_path + strlen (builder->source_root) + 1));
+  return TRUE;
+}
+
+/* Returns: (transfer full) (nullable): the canonical path of the header
+ * included with #include "@header", or %NULL if not found.
+ */
+static gchar *
+find_header (const gchar *header,
+             const gchar *including_filename,
+             GPtrArray   *include_directories)
+{
+  gchar *including_directory;
+  gchar *path;
+  gchar *canonical_path;
+  guint i;
+
+  if (g_path_is_absolute (header))
+    return canonicalize_path (header);
+
+  including_directory = g_path_get_dirname (including_filename);
+  path = g_build_filename (including_directory, header, NULL);
+  canonical_path = canonicalize_path (path);
+  g_free (including_directory);
+  g_free (path);
+
+  for (i = 0; canonical_path == NULL && i < include_directories->len; i++)
+    {
+      path = g_build_filename (g_ptr_array_index (include_directories, i), header, NULL);
+      canonical_path = canonicalize_path (path);
+      g_free (path);
+    }
+
+  return canonical_path;
+}
+
+/* Adds the headers included by @canonical_path, recursively. */
+static void
+add_included_headers (FileListBuilder *builder,
+                      const gchar     *canonical_path,
+                      GPtrArray       *include_directories)
+{
+  GQueue queue = G_QUEUE_INIT;
+  gchar *filename;
+
+  g_queue_push_tail (&queue, g_strdup (canonical_path));
+
+  while ((filename = g_queue_pop_head (&queue)) != NULL)
+    {
+      gchar *contents;
+      const gchar *line;
+
+      if (!g_file_get_contents (filename, &contents, NULL, NULL))
+        {
+          g_free (filename);
+          continue;
+        }
+
+      for (line = contents; line != NULL; line = strchr (line, '\n'))
+        {
+          const gchar *header_start;
+          const gchar *header_end;
+          gchar *header;
+          gchar *header_path;
+
+          if (*line == '\n')
+            line++;
+
+          while (*line == ' ' || *line == '\t')
+            line++;
+
+          if (*line != '#')
+            continue;
+          line++;
+
+          while (*line == ' ' || *line == '\t')
+            line++;
+
+          if (!g_str_has_prefix (line, "include"))
+            continue;
+          line += strlen ("include");
+
+          while (*line == ' ' || *line == '\t')
+            line++;
+
+          if (*line != '"')
+            continue;
+
+          header_start = line + 1;
+          header_end = strpbrk (header_start, "\"\n");
+          if (header_end == NULL || *header_end != '"')
+            continue;
+
+          header = g_strndup (header_start, header_end - header_start);
+          header_path = find_header (header, filename, include_directories);
+
+          if (header_path != NULL &&
+              file_list_builder_add (builder, header_path))
+            g_queue_push_tail (&queue, header_path);
+          else
+            g_free (header_path);
+
+          g_free (header);
+        }
+
+      g_free (contents);
+      g_free (filename);
+    }
+}
+
+/* Returns: (transfer full) (nullable): the files compiled according to
+ * @compile_commands_path, and with @include_headers the headers that they
+ * include.
+ */
+GPtrArray *
+gcu_file_list_new_from_compile_commands (const gchar  *compile_commands_path,
+                                         gboolean      include_headers,
+                                         GError      **error)
+{
+  GPtrArray *commands;
+  FileListBuilder builder;
+  gchar *current_dir;
+  gchar *build_directory;
+  gboolean success = FALSE;
+  guint i;
+
+  g_return_val_if_fail (compile_commands_path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  commands = read_compile_commands (compile_commands_path, error);
+  if (commands == NULL)
+    return NULL;
+
+  current_dir = g_get_current_dir ();
+  builder.source_root = canonicalize_path (current_dir);
+  builder.added_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  builder.filenames = g_ptr_array_new_with_free_func (g_free);
+  g_free (current_dir);
+
+  build_directory = g_path_get_dirname (compile_commands_path);
+  builder.build_directory = canonicalize_path (build_directory);
+  g_free (build_directory);
+
+  if (builder.source_root == NULL)
+    {
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   G_FILE_ERROR_NOENT,
+                   "Impossible to get the current directory.");
+      goto out;
+    }
+
+  /* An in-source build, or a build directory outside the source tree, whose
+   * files are skipped anyway.
+   */
+  if (builder.build_directory != NULL &&
+      !is_in_directory (builder.build_directory, builder.source_root))
+    g_clear_pointer (&builder.build_directory, g_free);
+
+  for (i = 0; i < commands->len; i++)
+    {
+      const CompileCommand *command = g_ptr_array_index (commands, i);
+      gchar *path;
+      gchar *canonical_path;
+
+      path = get_absolute_path (command->directory, command->file);
+      canonical_path = canonicalize_path (path);
+      g_free (path);
+
+      /* A translation unit can be compiled several times, with different
+       * flags. Its headers are searched only the first time.
+       */
+      if (canonical_path != NULL &&
+          file_list_builder_add (&builder, canonical_path) &&
+          include_headers)
+        {
+          GPtrArray *include_directories;
+
+          include_directories = get_include_directories (command);
+          add_included_headers (&builder, canonical_path, include_directories);
+          g_ptr_array_unref (include_directories);
+        }
+
+      g_free (canonical_path);
+    }
+
+  g_ptr_array_sort (builder.filenames, compare_filenames);
+  success = TRUE;
+
+out:
+  g_ptr_array_unref (commands);
+  g_hash_table_unref (builder.added_files);
+  g_free (builder.source_root);
+  g_free (builder.build_directory);
+
+  if (!success)
+    {
+      g_ptr_array_unref (builder.filenames);
+      return NULL;
+    }
+
+  return builder.filenames;
+}
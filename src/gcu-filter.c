@@ -0,0 +1,179 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-filter.h"
+#include <gio/gunixoutputstream.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <unistd.h>
+
+/*
+ * For the "-" file argument of the tools: the input is read on stdin and the
+ * result is written on stdout, so that the tools can be chained in a shell
+ * pipeline, e.g.:
+ * $ git show HEAD:file.c | gcu-include-config-h - | diff -u file.c -
+ *
+ * stdin is read with gcu_filter_read_fd(), also used by gcu-lineup-parameters
+ * to load the files: with read(), directly in the returned buffer. When the
+ * file descriptor is a regular file (e.g. a redirection of stdin), the buffer
+ * is allocated at once with its size, otherwise it grows by doubling, from
+ * CHUNK_SIZE bytes. The output is buffered by CHUNK_SIZE bytes too, so that the
+ * many small writes of a tool do not each do a write() on a pipe.
+ */
+
+#define CHUNK_SIZE (1024 * 1024)
+
+/* Reads @fd until the end, in *@buffer, of *@buffer_size bytes, reallocated if
+ * needed, so that a buffer can be reused for several files. @name is for the
+ * error messages. The contents are nul-terminated, @length doesn't include the
+ * nul byte.
+ */
+gboolean
+gcu_filter_read_fd (gint          fd,
+                    const gchar  *name,
+                    gchar       **buffer,
+                    gsize        *buffer_size,
+                    gsize        *length,
+                    GError      **error)
+{
+  struct stat fd_stat;
+  gsize needed_size = CHUNK_SIZE;
+  gsize n_bytes = 0;
+
+  g_return_val_if_fail (buffer != NULL, FALSE);
+  g_return_val_if_fail (buffer_size != NULL, FALSE);
+  g_return_val_if_fail (length != NULL, FALSE);
+
+  /* With room for the nul byte, and for the last read(), that returns 0. */
+  if (fstat (fd, &fd_stat) == 0 &&
+      S_ISREG (fd_stat.st_mode) &&
+      (guint64) fd_stat.st_size < G_MAXSIZE - 2)
+    needed_size = (gsize) fd_stat.st_size + 2;
+
+  if (*buffer == NULL || *buffer_size < needed_size)
+    {
+      g_free (*buffer);
+      *buffer = g_malloc (needed_size);
+      *buffer_size = needed_size;
+    }
+
+  while (TRUE)
+    {
+      gssize n_bytes_read;
+
+      /* The file has grown since the fstat(), or is not a regular file. */
+      if (n_bytes + 1 == *buffer_size)
+        {
+          if (*buffer_size > G_MAXSIZE / 2)
+            {
+              g_set_error (error,
+                           G_FILE_ERROR,
+                           G_FILE_ERROR_NOMEM,
+                           "Failed to read %s: file too big",
+                           name);
+              return FALSE;
+            }
+
+          *buffer_size *= 2;
+          *buffer = g_realloc (*buffer, *buffer_size);
+        }
+
+      n_bytes_read = read (fd,
+                           *buffer + n_bytes,
+                           MIN (*buffer_size - 1 - n_bytes, G_MAXSSIZE));
+
+      if (n_bytes_read == 0)
+        break;
+
+      if (n_bytes_read < 0)
+        {
+          gint saved_errno = errno;
+
+          if (saved_errno == EINTR)
+            continue;
+
+          g_set_error (error,
+                       G_FILE_ERROR,
+                       g_file_error_from_errno (saved_errno),
+                       "Failed to read %s: %s",
+                       name,
+                       g_strerror (saved_errno));
+          return FALSE;
+        }
+
+      n_bytes += n_bytes_read;
+    }
+
+  (*buffer)[n_bytes] = '\0';
+  *length = n_bytes;
+  return TRUE;
+}
+
+/* Returns: (transfer full): the contents of stdin, nul-terminated, or %NULL on
+ * error.
+ */
+gchar *
+gcu_filter_read_stdin (gsize   *length,
+                       GError **error)
+{
+  gchar *buffer = NULL;
+  gsize buffer_size = 0;
+
+  if (!gcu_filter_read_fd (STDIN_FILENO, "stdin", &buffer, &buffer_size, length, error))
+    {
+      g_free (buffer);
+      return NULL;
+    }
+
+  return buffer;
+}
+
+/* Returns: (transfer full): a buffered stream to stdout. It must be closed, to
+ * flush the end of the output.
+ */
+GOutputStream *
+gcu_filter_get_stdout_stream (void)
+{
+  GOutputStream *unix_stream;
+  GOutputStream *buffered_stream;
+
+  unix_stream = g_unix_output_stream_new (STDOUT_FILENO, FALSE);
+  buffered_stream = g_buffered_output_stream_new_sized (unix_stream, CHUNK_SIZE);
+  g_object_unref (unix_stream);
+
+  return buffered_stream;
+}
+
+/* Writes @contents to stdout, and closes the stream to flush it. */
+gboolean
+gcu_filter_write_stdout (const gchar  *contents,
+                         gsize         length,
+                         GError      **error)
+{
+  GOutputStream *output_stream;
+  gboolean ok;
+
+  output_stream = gcu_filter_get_stdout_stream ();
+
+  ok = (g_output_stream_write_all (output_stream, contents, length, NULL, NULL, error) &&
+        g_output_stream_close (output_stream, NULL, error));
+
+  g_object_unref (output_stream);
+  return ok;
+}
@@ -0,0 +1,2014 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-git.h"
+#include <gio/gio.h>
+#include <string.h>
+
+/*
+ * Read-only access to the files of a git revision, directly from the object
+ * store, without a working tree. Works with bare repositories.
+ *
+ * The revision can be a full object name (40 hex digits), or a ref name
+ * resolved like git does (HEAD, a branch, a tag, "origin/main", ...), from the
+ * loose refs or from packed-refs. Annotated tags and commits are peeled to
+ * their tree.
+ *
+ * The objects are read from the loose objects and from the packs (with a
+ * version 2 index). The packs and their indexes are mmapped, and the deltas
+ * are resolved. The zlib streams are inflated with GZlibDecompressor, so there
+ * is no dependency other than GIO. Alternate object stores are not supported.
+ *
+ * In a pack, the versions of a file form a chain of deltas, each one based on
+ * the previous object of the chain, so reading N versions of a file would
+ * inflate O(N^2) objects. Like git does, the inflated delta bases are kept in
+ * an LRU cache, keyed by pack and offset, of BASE_CACHE_MAX_SIZE bytes.
+ *
+ * A linked worktree (git worktree add) has its own git directory, for HEAD and
+ * the per-worktree refs, and shares the objects, the other refs and the config
+ * with the main repository, in the directory given by its "commondir" file.
+ *
+ * After gcu_git_repository_open(), the repository is only read (the delta base
+ * cache has a mutex), so gcu_git_repository_read_file() can be called from
+ * several threads.
+ */
+
+/* Protects against a corrupted pack with a delta loop. */
+#define MAX_DELTA_DEPTH 10000
+
+/* The default of git's core.deltaBaseCacheLimit is 96M, but its cache is per
+ * process, and this one is shared by the threads.
+ */
+#define BASE_CACHE_MAX_SIZE (32 * 1024 * 1024)
+
+/* A bigger base would evict many others. */
+#define BASE_CACHE_MAX_OBJECT_SIZE (BASE_CACHE_MAX_SIZE / 8)
+
+/* Max number of "ref: " indirections. */
+#define MAX_SYMREF_DEPTH 10
+
+#define OBJECT_TYPE_COMMIT 1
+#define OBJECT_TYPE_TREE 2
+#define OBJECT_TYPE_BLOB 3
+#define OBJECT_TYPE_TAG 4
+#define OBJECT_TYPE_OFS_DELTA 6
+#define OBJECT_TYPE_REF_DELTA 7
+
+/* Size of the fixed parts of a version 2 pack index. */
+#define INDEX_HEADER_SIZE (8 + 256 * 4)
+#define INDEX_TRAILER_SIZE (2 * GCU_GIT_OID_LENGTH)
+
+typedef struct
+{
+  GMappedFile *index_file;
+  GMappedFile *pack_file;
+
+  const guint8 *index_data;
+  const guint8 *pack_data;
+  gsize pack_size;
+
+  guint32 n_objects;
+  const guint8 *fanout;
+  const guint8 *oids;
+  const guint8 *offsets;
+  const guint8 *large_offsets;
+  gsize n_large_offsets;
+} Pack;
+
+typedef struct
+{
+  const Pack *pack;
+  guint64 offset;
+} BaseKey;
+
+typedef struct
+{
+  BaseKey key;
+  GBytes *data;
+  guint type;
+
+  /* In GcuGitRepository.base_cache_lru. */
+  GList link;
+} BaseEntry;
+
+struct _GcuGitRepository
+{
+  gchar *git_dir;
+
+  /* The objects, the refs (except HEAD and the per-worktree refs) and the
+   * config. The same as @git_dir, except for a linked worktree.
+   */
+  gchar *common_dir;
+
+  /* Pack's. */
+  GPtrArray *packs;
+
+  /* Key: BaseKey, value: BaseEntry, owns the entry. */
+  GHashTable *base_cache;
+
+  /* The most recently used first. */
+  GQueue base_cache_lru;
+  gsize base_cache_size;
+  GMutex base_cache_mutex;
+};
+
+static guint32
+read_be32 (const guint8 *p)
+{
+  return ((guint32) p[0] << 24 |
+          (guint32) p[1] << 16 |
+          (guint32) p[2] << 8 |
+          (guint32) p[3]);
+}
+
+static guint64
+read_be64 (const guint8 *p)
+{
+  return (guint64) read_be32 (p) << 32 | read_be32 (p + 4);
+}
+
+static void
+oid_to_hex (const guint8 *oid,
+            gchar        *hex)
+{
+  gint i;
+
+  for (i = 0; i < GCU_GIT_OID_LENGTH; i++)
+    g_snprintf (hex + 2 * i, 3, "%02x", oid[i]);
+}
+
+/* Returns whether @hex is exactly a full object name. */
+static gboolean
+hex_to_oid (const gchar *hex,
+            guint8      *oid)
+{
+  gint i;
+
+  for (i = 0; i < GCU_GIT_OID_LENGTH; i++)
+    {
+      gint high = g_ascii_xdigit_value (hex[2 * i]);
+      gint low;
+
+      if (high == -1)
+        return FALSE;
+
+      low = g_ascii_xdigit_value (hex[2 * i + 1]);
+      if (low == -1)
+        return FALSE;
+
+      oid[i] = high << 4 | low;
+    }
+
+  return hex[2 * GCU_GIT_OID_LENGTH] == '\0';
+}
+
+static void
+set_corrupted_error (GError      **error,
+                     const gchar  *what)
+{
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "Corrupted git object store: %s",
+               what);
+}
+
+/* Inflates the zlib stream at the start of @data, which can be followed by
+ * other data, like in a pack. @size_hint is the expected size.
+ */
+static guint8 *
+inflate_data (const guint8  *data,
+              gsize          length,
+              gsize          size_hint,
+              gsize         *inflated_size,
+              GError       **error)
+{
+  GConverter *converter;
+  guint8 *buffer;
+  gsize capacity;
+  gsize total_read = 0;
+  gsize total_written = 0;
+
+  converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+
+  /* One more byte, so that the end of the stream can be read without growing
+   * the buffer.
+   */
+  capacity = size_hint + 1;
+  buffer = g_malloc (capacity);
+
+  while (TRUE)
+    {
+      GConverterResult result;
+      gsize n_read = 0;
+      gsize n_written = 0;
+
+      if (total_written == capacity)
+        {
+          capacity *= 2;
+          buffer = g_realloc (buffer, capacity);
+        }
+
+      result = g_converter_convert (converter,
+                                    data + total_read,
+                                    length - total_read,
+                                    buffer + total_written,
+                                    capacity - total_written,
+                                    G_CONVERTER_INPUT_AT_END,
+                                    &n_read,
+                                    &n_written,
+                                    error);
+
+      if (result == G_CONVERTER_ERROR)
+        goto error;
+
+      total_read += n_read;
+      total_written += n_written;
+
+      if (result == G_CONVERTER_FINISHED)
+        break;
+
+      if (n_read == 0 && n_written == 0)
+        {
+          set_corrupted_error (error, "truncated zlib stream");
+          goto error;
+        }
+    }
+
+  g_object_unref (converter);
+  *inflated_size = total_written;
+  return buffer;
+
+error:
+  g_object_unref (converter);
+  g_free (buffer);
+  return NULL;
+}
+
+/* Inflates only the start of the zlib stream at the start of @data, at most
+ * @buffer_size bytes, for example to read a header.
+ */
+static gboolean
+inflate_prefix (const guint8  *data,
+                gsize          length,
+                guint8        *buffer,
+                gsize          buffer_size,
+                gsize         *inflated_size,
+                GError       **error)
+{
+  GConverter *converter;
+  gsize total_read = 0;
+  gsize total_written = 0;
+  gboolean ok = TRUE;
+
+  converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+
+  while (total_written < buffer_size)
+    {
+      GConverterResult result;
+      gsize n_read = 0;
+      gsize n_written = 0;
+
+      result = g_converter_convert (converter,
+                                    data + total_read,
+                                    length - total_read,
+                                    buffer + total_written,
+                                    buffer_size - total_written,
+                                    G_CONVERTER_INPUT_AT_END,
+                                    &n_read,
+                                    &n_written,
+                                    error);
+
+      if (result == G_CONVERTER_ERROR)
+        {
+          ok = FALSE;
+          break;
+        }
+
+      total_read += n_read;
+      total_written += n_written;
+
+      if (result == G_CONVERTER_FINISHED)
+        break;
+
+      if (n_read == 0 && n_written == 0)
+        {
+          set_corrupted_error (error, "truncated zlib stream");
+          ok = FALSE;
+          break;
+        }
+    }
+
+  g_object_unref (converter);
+  *inflated_size = total_written;
+  return ok;
+}
+
+static gboolean
+read_delta_size (const guint8 **p,
+                 const guint8  *end,
+                 gsize         *size)
+{
+  guint shift = 0;
+
+  *size = 0;
+
+  while (*p < end && shift < 64)
+    {
+      guint8 c = *(*p)++;
+
+      *size |= (gsize) (c & 0x7f) << shift;
+      shift += 7;
+
+      if ((c & 0x80) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static guint8 *
+apply_delta (const guint8  *base,
+             gsize          base_size,
+             const guint8  *delta,
+             gsize          delta_size,
+             gsize         *result_size,
+             GError       **error)
+{
+  const guint8 *p = delta;
+  const guint8 *end = delta + delta_size;
+  gsize source_size;
+  gsize target_size;
+  guint8 *result;
+  gsize pos = 0;
+
+  if (!read_delta_size (&p, end, &source_size) ||
+      !read_delta_size (&p, end, &target_size) ||
+      source_size != base_size)
+    {
+      set_corrupted_error (error, "invalid delta header");
+      return NULL;
+    }
+
+  result = g_malloc (target_size + 1);
+
+  while (p < end)
+    {
+      guint8 op = *p++;
+
+      if (op & 0x80)
+        {
+          guint64 copy_offset = 0;
+          gsize copy_size = 0;
+          gint i;
+
+          for (i = 0; i < 4; i++)
+            {
+              if ((op & (1 << i)) == 0)
+                continue;
+
+              if (p >= end)
+                goto corrupted;
+
+              copy_offset |= (guint64) *p++ << (8 * i);
+            }
+
+          for (i = 0; i < 3; i++)
+            {
+              if ((op & (0x10 << i)) == 0)
+                continue;
+
+              if (p >= end)
+                goto corrupted;
+
+              copy_size |= (gsize) *p++ << (8 * i);
+            }
+
+          if (copy_size == 0)
+            copy_size = 0x10000;
+
+          if (copy_offset + copy_size > base_size ||
+              copy_size > target_size - pos)
+            goto corrupted;
+
+          memcpy (result + pos, base + copy_offset, copy_size);
+          pos += copy_size;
+        }
+      else if (op != 0)
+        {
+          if (op > end - p ||
+              op > target_size - pos)
+            goto corrupted;
+
+          memcpy (result + pos, p, op);
+          p += op;
+          pos += op;
+        }
+      else
+        {
+          goto corrupted;
+        }
+    }
+
+  if (pos != target_size)
+    goto corrupted;
+
+  *result_size = target_size;
+  return result;
+
+corrupted:
+  set_corrupted_error (error, "invalid delta");
+  g_free (result);
+  return NULL;
+}
+
+static void
+pack_free (Pack *pack)
+{
+  if (pack != NULL)
+    {
+      if (pack->index_file != NULL)
+        g_mapped_file_unref (pack->index_file);
+
+      if (pack->pack_file != NULL)
+        g_mapped_file_unref (pack->pack_file);
+
+      g_free (pack);
+    }
+}
+
+static Pack *
+pack_open (const gchar  *index_path,
+           GError      **error)
+{
+  Pack *pack;
+  gchar *pack_path;
+  gsize index_size;
+  gsize min_index_size;
+
+  pack = g_new0 (Pack, 1);
+
+  pack->index_file = g_mapped_file_new (index_path, FALSE, error);
+  if (pack->index_file == NULL)
+    goto error;
+
+  pack_path = g_strconcat (index_path, NULL);
+  strcpy (pack_path + strlen (pack_path) - strlen ("idx"), "pack");
+  pack->pack_file = g_mapped_file_new (pack_path, FALSE, error);
+  g_free (pack_path);
+
+  if (pack->pack_file == NULL)
+    goto error;
+
+  pack->index_data = (const guint8 *) g_mapped_file_get_contents (pack->index_file);
+  index_size = g_mapped_file_get_length (pack->index_file);
+  pack->pack_data = (const guint8 *) g_mapped_file_get_contents (pack->pack_file);
+  pack->pack_size = g_mapped_file_get_length (pack->pack_file);
+
+  if (index_size < INDEX_HEADER_SIZE + INDEX_TRAILER_SIZE ||
+      memcmp (pack->index_data, "\377tOc", 4) != 0 ||
+      read_be32 (pack->index_data + 4) != 2)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "%s: only the version 2 of pack indexes is supported.",
+                   index_path);
+      goto error;
+    }
+
+  if (pack->pack_size < 12 + GCU_GIT_OID_LENGTH ||
+      memcmp (pack->pack_data, "PACK", 4) != 0)
+    {
+      set_corrupted_error (error, index_path);
+      goto error;
+    }
+
+  pack->fanout = pack->index_data + 8;
+  pack->n_objects = read_be32 (pack->fanout + 255 * 4);
+
+  min_index_size = (INDEX_HEADER_SIZE +
+                    (gsize) pack->n_objects * (GCU_GIT_OID_LENGTH + 4 + 4) +
+                    INDEX_TRAILER_SIZE);
+
+  if (index_size < min_index_size ||
+      (index_size - min_index_size) % 8 != 0)
+    {
+      set_corrupted_error (error, index_path);
+      goto error;
+    }
+
+  pack->oids = pack->fanout + 256 * 4;
+  pack->offsets = pack->oids + (gsize) pack->n_objects * (GCU_GIT_OID_LENGTH + 4);
+  pack->large_offsets = pack->offsets + (gsize) pack->n_objects * 4;
+  pack->n_large_offsets = (index_size - min_index_size) / 8;
+
+  return pack;
+
+error:
+  pack_free (pack);
+  return NULL;
+}
+
+static guint
+base_key_hash (gconstpointer key)
+{
+  const BaseKey *base_key = key;
+
+  return g_direct_hash (base_key->pack) ^ g_int64_hash (&base_key->offset);
+}
+
+static gboolean
+base_key_equal (gconstpointer a,
+                gconstpointer b)
+{
+  const BaseKey *key_a = a;
+  const BaseKey *key_b = b;
+
+  return key_a->pack == key_b->pack && key_a->offset == key_b->offset;
+}
+
+static void
+base_entry_free (BaseEntry *entry)
+{
+  if (entry != NULL)
+    {
+      g_bytes_unref (entry->data);
+      g_free (entry);
+    }
+}
+
+/* Returns: (transfer full) (nullable): the cached object at @offset. */
+static GBytes *
+base_cache_lookup (GcuGitRepository *repo,
+                   const Pack       *pack,
+                   guint64           offset,
+                   guint            *type)
+{
+  BaseKey key;
+  BaseEntry *entry;
+  GBytes *data = NULL;
+
+  key.pack = pack;
+  key.offset = offset;
+
+  g_mutex_lock (&repo->base_cache_mutex);
+
+  entry = g_hash_table_lookup (repo->base_cache, &key);
+  if (entry != NULL)
+    {
+      g_queue_unlink (&repo->base_cache_lru, &entry->link);
+      g_queue_push_head_link (&repo->base_cache_lru, &entry->link);
+
+      data = g_bytes_ref (entry->data);
+      *type = entry->type;
+    }
+
+  g_mutex_unlock (&repo->base_cache_mutex);
+
+  return data;
+}
+
+static void
+base_cache_insert (GcuGitRepository *repo,
+                   const Pack       *pack,
+                   guint64           offset,
+                   GBytes           *data,
+                   guint             type)
+{
+  BaseEntry *entry;
+
+  if (g_bytes_get_size (data) > BASE_CACHE_MAX_OBJECT_SIZE)
+    return;
+
+  entry = g_new0 (BaseEntry, 1);
+  entry->key.pack = pack;
+  entry->key.offset = offset;
+  entry->data = g_bytes_ref (data);
+  entry->type = type;
+  entry->link.data = entry;
+
+  g_mutex_lock (&repo->base_cache_mutex);
+
+  /* Another thread has read the same base in the meantime. */
+  if (g_hash_table_contains (repo->base_cache, &entry->key))
+    {
+      g_mutex_unlock (&repo->base_cache_mutex);
+      base_entry_free (entry);
+      return;
+    }
+
+  g_hash_table_add (repo->base_cache, entry);
+  g_queue_push_head_link (&repo->base_cache_lru, &entry->link);
+  repo->base_cache_size += g_bytes_get_size (data);
+
+  while (repo->base_cache_size > BASE_CACHE_MAX_SIZE)
+    {
+      GList *oldest = g_queue_pop_tail_link (&repo->base_cache_lru);
+      BaseEntry *oldest_entry = oldest->data;
+
+      repo->base_cache_size -= g_bytes_get_size (oldest_entry->data);
+      g_hash_table_remove (repo->base_cache, &oldest_entry->key);
+    }
+
+  g_mutex_unlock (&repo->base_cache_mutex);
+}
+
+static gboolean
+pack_find_offset (const Pack   *pack,
+                  const guint8 *oid,
+                  guint64      *offset)
+{
+  guint32 low;
+  guint32 high;
+
+  low = oid[0] == 0 ? 0 : read_be32 (pack->fanout + (oid[0] - 1) * 4);
+  high = read_be32 (pack->fanout + oid[0] * 4);
+
+  while (low < high)
+    {
+      guint32 middle = low + (high - low) / 2;
+      gint cmp;
+
+      cmp = memcmp (pack->oids + (gsize) middle * GCU_GIT_OID_LENGTH, oid, GCU_GIT_OID_LENGTH);
+
+      if (cmp < 0)
+        {
+          low = middle + 1;
+        }
+      else if (cmp > 0)
+        {
+          high = middle;
+        }
+      else
+        {
+          guint32 small_offset = read_be32 (pack->offsets + (gsize) middle * 4);
+
+          if ((small_offset & 0x80000000) == 0)
+            {
+              *offset = small_offset;
+              return TRUE;
+            }
+
+          small_offset &= 0x7fffffff;
+          if (small_offset >= pack->n_large_offsets)
+            return FALSE;
+
+          *offset = read_be64 (pack->large_offsets + (gsize) small_offset * 8);
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+static guint8 *read_object (GcuGitRepository  *repo,
+                            const guint8      *oid,
+                            guint              depth,
+                            guint             *type,
+                            gsize             *size,
+                            GError           **error);
+
+static guint8 *read_pack_object (GcuGitRepository  *repo,
+                                 const Pack        *pack,
+                                 guint64            offset,
+                                 guint              depth,
+                                 guint             *type,
+                                 gsize             *size,
+                                 GError           **error);
+
+/* Returns: (transfer full) (nullable): the base of a delta, from the cache if
+ * possible.
+ */
+static GBytes *
+read_delta_base (GcuGitRepository  *repo,
+                 const Pack        *pack,
+                 guint64            offset,
+                 guint              depth,
+                 guint             *type,
+                 GError           **error)
+{
+  GBytes *base;
+  guint8 *data;
+  gsize size;
+
+  base = base_cache_lookup (repo, pack, offset, type);
+  if (base != NULL)
+    return base;
+
+  data = read_pack_object (repo, pack, offset, depth, type, &size, error);
+  if (data == NULL)
+    return NULL;
+
+  base = g_bytes_new_take (data, size);
+  base_cache_insert (repo, pack, offset, base, *type);
+  return base;
+}
+
+/* Reads the header of the object at @offset. @data is set to the start of its
+ * data, and @end to the end of the objects of the pack.
+ */
+static gboolean
+read_pack_object_header (const Pack    *pack,
+                         guint64        offset,
+                         guint         *object_type,
+                         guint64       *object_size,
+                         const guint8 **data,
+                         const guint8 **end,
+                         GError       **error)
+{
+  const guint8 *p;
+  guint8 c;
+  guint shift;
+
+  /* The pack ends with its checksum. */
+  *end = pack->pack_data + pack->pack_size - GCU_GIT_OID_LENGTH;
+
+  if (offset < 12 || offset >= (guint64) (*end - pack->pack_data))
+    {
+      set_corrupted_error (error, "invalid object offset");
+      return FALSE;
+    }
+
+  p = pack->pack_data + offset;
+
+  c = *p++;
+  *object_type = (c >> 4) & 7;
+  *object_size = c & 15;
+  shift = 4;
+
+  while (c & 0x80)
+    {
+      if (p >= *end || shift > 57)
+        {
+          set_corrupted_error (error, "invalid object header");
+          return FALSE;
+        }
+
+      c = *p++;
+      *object_size |= (guint64) (c & 0x7f) << shift;
+      shift += 7;
+    }
+
+  if (*object_size > G_MAXSIZE - 1)
+    {
+      set_corrupted_error (error, "object too big");
+      return FALSE;
+    }
+
+  *data = p;
+  return TRUE;
+}
+
+/* Reads the base offset of the OFS_DELTA object at @offset, whose data starts
+ * at @p. @p is advanced to the delta.
+ */
+static gboolean
+read_ofs_delta_base_offset (guint64        offset,
+                            const guint8 **p,
+                            const guint8  *end,
+                            guint64       *base_offset,
+                            GError       **error)
+{
+  guint64 distance;
+  guint8 c;
+
+  if (*p >= end)
+    {
+      set_corrupted_error (error, "truncated delta");
+      return FALSE;
+    }
+
+  c = *(*p)++;
+  distance = c & 0x7f;
+
+  while (c & 0x80)
+    {
+      if (*p >= end || distance > G_MAXUINT64 >> 8)
+        {
+          set_corrupted_error (error, "invalid delta offset");
+          return FALSE;
+        }
+
+      c = *(*p)++;
+      distance = ((distance + 1) << 7) | (c & 0x7f);
+    }
+
+  if (distance == 0 || distance > offset)
+    {
+      set_corrupted_error (error, "invalid delta offset");
+      return FALSE;
+    }
+
+  *base_offset = offset - distance;
+  return TRUE;
+}
+
+static guint8 *
+read_pack_object (GcuGitRepository  *repo,
+                  const Pack        *pack,
+                  guint64            offset,
+                  guint              depth,
+                  guint             *type,
+                  gsize             *size,
+                  GError           **error)
+{
+  const guint8 *p;
+  const guint8 *end;
+  guint object_type;
+  guint64 object_size;
+  guint64 base_offset;
+  GBytes *base;
+  gsize base_size;
+  guint8 *base_data;
+  guint8 *delta;
+  gsize delta_size;
+  guint8 *result;
+
+  if (depth > MAX_DELTA_DEPTH)
+    {
+      set_corrupted_error (error, "delta chain too long");
+      return NULL;
+    }
+
+  if (!read_pack_object_header (pack, offset, &object_type, &object_size, &p, &end, error))
+    return NULL;
+
+  switch (object_type)
+    {
+      case OBJECT_TYPE_COMMIT:
+      case OBJECT_TYPE_TREE:
+      case OBJECT_TYPE_BLOB:
+      case OBJECT_TYPE_TAG:
+        result = inflate_data (p, end - p, object_size, size, error);
+        if (result == NULL)
+          return NULL;
+
+        if (*size != object_size)
+          {
+            set_corrupted_error (error, "wrong object size");
+            g_free (result);
+            return NULL;
+          }
+
+        *type = object_type;
+        return result;
+
+      case OBJECT_TYPE_OFS_DELTA:
+        if (!read_ofs_delta_base_offset (offset, &p, end, &base_offset, error))
+          return NULL;
+
+        base = read_delta_base (repo, pack, base_offset, depth + 1, type, error);
+        break;
+
+      case OBJECT_TYPE_REF_DELTA:
+        if (end - p < GCU_GIT_OID_LENGTH)
+          {
+            set_corrupted_error (error, "truncated delta");
+            return NULL;
+          }
+
+        base_data = read_object (repo, p, depth + 1, type, &base_size, error);
+        base = base_data != NULL ? g_bytes_new_take (base_data, base_size) : NULL;
+        p += GCU_GIT_OID_LENGTH;
+        break;
+
+      default:
+        set_corrupted_error (error, "unknown object type");
+        return NULL;
+    }
+
+  if (base == NULL)
+    return NULL;
+
+  delta = inflate_data (p, end - p, object_size, &delta_size, error);
+  if (delta == NULL)
+    {
+      g_bytes_unref (base);
+      return NULL;
+    }
+
+  base_data = (guint8 *) g_bytes_get_data (base, &base_size);
+  result = apply_delta (base_data, base_size, delta, delta_size, size, error);
+
+  g_bytes_unref (base);
+  g_free (delta);
+  return result;
+}
+
+/* Returns NULL without setting @error if the loose object doesn't exist. */
+static guint8 *
+read_loose_object (GcuGitRepository  *repo,
+                   const gchar       *hex,
+                   guint             *type,
+                   gsize             *size,
+                   GError           **error)
+{
+  gchar *path;
+  gchar *contents;
+  gsize length;
+  guint8 *inflated;
+  gsize inflated_size;
+  const guint8 *header_end;
+  guint8 *result = NULL;
+  gchar *size_end;
+  guint64 header_size;
+  GError *my_error = NULL;
+
+  path = g_strdup_printf ("%s/objects/%.2s/%s", repo->common_dir, hex, hex + 2);
+  g_file_get_contents (path, &contents, &length, &my_error);
+  g_free (path);
+
+  if (g_error_matches (my_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+    {
+      g_clear_error (&my_error);
+      return NULL;
+    }
+
+  if (my_error != NULL)
+    {
+      g_propagate_error (error, my_error);
+      return NULL;
+    }
+
+  inflated = inflate_data ((const guint8 *) contents, length, length * 4, &inflated_size, error);
+  g_free (contents);
+
+  if (inflated == NULL)
+    return NULL;
+
+  /* "<type> <size>\0<data>" */
+  header_end = memchr (inflated, '\0', inflated_size);
+  if (header_end == NULL)
+    goto corrupted;
+
+  if (g_str_has_prefix ((const gchar *) inflated, "blob "))
+    *type = OBJECT_TYPE_BLOB;
+  else if (g_str_has_prefix ((const gchar *) inflated, "tree "))
+    *type = OBJECT_TYPE_TREE;
+  else if (g_str_has_prefix ((const gchar *) inflated, "commit "))
+    *type = OBJECT_TYPE_COMMIT;
+  else if (g_str_has_prefix ((const gchar *) inflated, "tag "))
+    *type = OBJECT_TYPE_TAG;
+  else
+    goto corrupted;
+
+  header_size = g_ascii_strtoull (strchr ((const gchar *) inflated, ' ') + 1, &size_end, 10);
+  header_end++;
+
+  if (size_end + 1 != (const gchar *) header_end ||
+      header_size != (guint64) (inflated_size - (header_end - inflated)))
+    goto corrupted;
+
+  *size = header_size;
+  result = g_malloc (*size + 1);
+  memcpy (result, header_end, *size);
+
+  g_free (inflated);
+  return result;
+
+corrupted:
+  set_corrupted_error (error, hex);
+  g_free (inflated);
+  return NULL;
+}
+
+/* Returns: (transfer full): the object content, with a size of @size. */
+static guint8 *
+read_object (GcuGitRepository  *repo,
+             const guint8      *oid,
+             guint              depth,
+             guint             *type,
+             gsize             *size,
+             GError           **error)
+{
+  gchar hex[2 * GCU_GIT_OID_LENGTH + 1];
+  guint8 *result;
+  GError *my_error = NULL;
+  guint pack_num;
+
+  oid_to_hex (oid, hex);
+
+  result = read_loose_object (repo, hex, type, size, &my_error);
+  if (result != NULL || my_error != NULL)
+    {
+      if (my_error != NULL)
+        g_propagate_error (error, my_error);
+
+      return result;
+    }
+
+  for (pack_num = 0; pack_num < repo->packs->len; pack_num++)
+    {
+      const Pack *pack = g_ptr_array_index (repo->packs, pack_num);
+      guint64 offset;
+
+      if (pack_find_offset (pack, oid, &offset))
+        return read_pack_object (repo, pack, offset, depth, type, size, error);
+    }
+
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_NOT_FOUND,
+               "git object %s not found.",
+               hex);
+  return NULL;
+}
+
+/* The size of a delta target is at the start of the delta, after the size of
+ * its base, so only the start of the delta is inflated.
+ */
+static gboolean
+read_pack_object_size (const Pack  *pack,
+                       guint64      offset,
+                       guint64     *size,
+                       GError     **error)
+{
+  const guint8 *p;
+  const guint8 *end;
+  guint object_type;
+  guint64 object_size;
+  guint64 base_offset;
+  guint8 header[2 * 10];
+  gsize header_size;
+  const guint8 *header_p;
+  gsize base_size;
+  gsize target_size;
+
+  if (!read_pack_object_header (pack, offset, &object_type, &object_size, &p, &end, error))
+    return FALSE;
+
+  switch (object_type)
+    {
+      case OBJECT_TYPE_COMMIT:
+      case OBJECT_TYPE_TREE:
+      case OBJECT_TYPE_BLOB:
+      case OBJECT_TYPE_TAG:
+        *size = object_size;
+        return TRUE;
+
+      case OBJECT_TYPE_OFS_DELTA:
+        if (!read_ofs_delta_base_offset (offset, &p, end, &base_offset, error))
+          return FALSE;
+        break;
+
+      case OBJECT_TYPE_REF_DELTA:
+        if (end - p < GCU_GIT_OID_LENGTH)
+          {
+            set_corrupted_error (error, "truncated delta");
+            return FALSE;
+          }
+
+        p += GCU_GIT_OID_LENGTH;
+        break;
+
+      default:
+        set_corrupted_error (error, "unknown object type");
+        return FALSE;
+    }
+
+  if (!inflate_prefix (p, end - p, header, sizeof (header), &header_size, error))
+    return FALSE;
+
+  header_p = header;
+  if (!read_delta_size (&header_p, header + header_size, &base_size) ||
+      !read_delta_size (&header_p, header + header_size, &target_size))
+    {
+      set_corrupted_error (error, "invalid delta header");
+      return FALSE;
+    }
+
+  *size = target_size;
+  return TRUE;
+}
+
+/* Like read_object(), but reads only the size of the object, from its header. */
+static gboolean
+read_object_size (GcuGitRepository  *repo,
+                  const guint8      *oid,
+                  guint64           *size,
+                  GError           **error)
+{
+  gchar hex[2 * GCU_GIT_OID_LENGTH + 1];
+  gchar *path;
+  gchar *contents;
+  gsize length;
+  guint pack_num;
+  GError *my_error = NULL;
+
+  oid_to_hex (oid, hex);
+
+  path = g_strdup_printf ("%s/objects/%.2s/%s", repo->common_dir, hex, hex + 2);
+  g_file_get_contents (path, &contents, &length, &my_error);
+  g_free (path);
+
+  if (my_error == NULL)
+    {
+      /* "<type> <size>\0", the size has at most 20 digits. */
+      gchar header[32];
+      gsize header_size;
+      const gchar *space;
+      gchar *size_end;
+      gboolean ok;
+
+      ok = inflate_prefix ((const guint8 *) contents, length, (guint8 *) header, sizeof (header), &header_size, error);
+      g_free (contents);
+
+      if (!ok)
+        return FALSE;
+
+      space = memchr (header, ' ', header_size);
+      if (space == NULL || memchr (space, '\0', header_size - (space - header)) == NULL)
+        {
+          set_corrupted_error (error, hex);
+          return FALSE;
+        }
+
+      *size = g_ascii_strtoull (space + 1, &size_end, 10);
+      if (size_end == space + 1 || *size_end != '\0')
+        {
+          set_corrupted_error (error, hex);
+          return FALSE;
+        }
+
+      return TRUE;
+    }
+
+  if (!g_error_matches (my_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+    {
+      g_propagate_error (error, my_error);
+      return FALSE;
+    }
+
+  g_clear_error (&my_error);
+
+  for (pack_num = 0; pack_num < repo->packs->len; pack_num++)
+    {
+      const Pack *pack = g_ptr_array_index (repo->packs, pack_num);
+      guint64 offset;
+
+      if (pack_find_offset (pack, oid, &offset))
+        return read_pack_object_size (pack, offset, size, error);
+    }
+
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_NOT_FOUND,
+               "git object %s not found.",
+               hex);
+  return FALSE;
+}
+
+static gboolean
+load_packs (GcuGitRepository  *repo,
+            GError           **error)
+{
+  gchar *pack_dir;
+  GDir *dir;
+  const gchar *name;
+  GError *my_error = NULL;
+
+  pack_dir = g_build_filename (repo->common_dir, "objects", "pack", NULL);
+  dir = g_dir_open (pack_dir, 0, &my_error);
+
+  /* A repository can have no packs. */
+  if (dir == NULL)
+    {
+      g_clear_error (&my_error);
+      g_free (pack_dir);
+      return TRUE;
+    }
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *index_path;
+      Pack *pack;
+
+      if (!g_str_has_suffix (name, ".idx"))
+        continue;
+
+      index_path = g_build_filename (pack_dir, name, NULL);
+      pack = pack_open (index_path, error);
+      g_free (index_path);
+
+      if (pack == NULL)
+        {
+          g_dir_close (dir);
+          g_free (pack_dir);
+          return FALSE;
+        }
+
+      g_ptr_array_add (repo->packs, pack);
+    }
+
+  g_dir_close (dir);
+  g_free (pack_dir);
+  return TRUE;
+}
+
+/* Returns: (transfer full) (nullable): the git directory of @path. */
+static gchar *
+find_git_dir (const gchar *path)
+{
+  gchar *dot_git;
+  gchar *objects_dir;
+  gchar *commondir;
+  gchar *head;
+  gboolean is_bare;
+
+  dot_git = g_build_filename (path, ".git", NULL);
+
+  if (g_file_test (dot_git, G_FILE_TEST_IS_DIR))
+    return dot_git;
+
+  /* A linked worktree or a submodule: "gitdir: <path>". */
+  if (g_file_test (dot_git, G_FILE_TEST_IS_REGULAR))
+    {
+      gchar *contents;
+
+      if (g_file_get_contents (dot_git, &contents, NULL, NULL) &&
+          g_str_has_prefix (contents, "gitdir: "))
+        {
+          gchar *git_dir = g_strstrip (contents + strlen ("gitdir: "));
+          gchar *ret;
+
+          if (g_path_is_absolute (git_dir))
+            ret = g_strdup (git_dir);
+          else
+            ret = g_build_filename (path, git_dir, NULL);
+
+          g_free (contents);
+          g_free (dot_git);
+          return ret;
+        }
+
+      g_free (contents);
+    }
+
+  g_free (dot_git);
+
+  /* A bare repository, or the git directory of a linked worktree, which has
+   * a commondir file instead of the objects.
+   */
+  objects_dir = g_build_filename (path, "objects", NULL);
+  commondir = g_build_filename (path, "commondir", NULL);
+  head = g_build_filename (path, "HEAD", NULL);
+  is_bare = ((g_file_test (objects_dir, G_FILE_TEST_IS_DIR) ||
+              g_file_test (commondir, G_FILE_TEST_IS_REGULAR)) &&
+             g_file_test (head, G_FILE_TEST_IS_REGULAR));
+  g_free (objects_dir);
+  g_free (commondir);
+  g_free (head);
+
+  return is_bare ? g_strdup (path) : NULL;
+}
+
+/* Returns: (transfer full): the common directory of @git_dir, given by its
+ * commondir file, relative to @git_dir or absolute.
+ */
+static gchar *
+find_common_dir (const gchar *git_dir)
+{
+  gchar *path;
+  gchar *contents;
+  gchar *common_dir;
+  gchar *ret;
+
+  path = g_build_filename (git_dir, "commondir", NULL);
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      g_free (path);
+      return g_strdup (git_dir);
+    }
+
+  g_free (path);
+  common_dir = g_strstrip (contents);
+
+  if (common_dir[0] == '\0')
+    ret = g_strdup (git_dir);
+  else if (g_path_is_absolute (common_dir))
+    ret = g_strdup (common_dir);
+  else
+    ret = g_build_filename (git_dir, common_dir, NULL);
+
+  g_free (contents);
+  return ret;
+}
+
+/* The object names are SHA-1 hashes, unless the repository has been created
+ * with "git init --object-format=sha256".
+ */
+static gboolean
+uses_sha1 (const gchar *git_dir)
+{
+  gchar *path;
+  gchar *contents;
+  gchar **lines;
+  gboolean ret = TRUE;
+  gint i;
+
+  path = g_build_filename (git_dir, "config", NULL);
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      g_free (path);
+      return TRUE;
+    }
+
+  g_free (path);
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      gchar *line = g_ascii_strdown (lines[i], -1);
+      gchar **tokens = g_strsplit_set (line, " \t=", -1);
+      gchar *joined = g_strjoinv ("", tokens);
+
+      if (g_str_equal (joined, "objectformatsha256"))
+        ret = FALSE;
+
+      g_free (joined);
+      g_strfreev (tokens);
+      g_free (line);
+    }
+
+  g_strfreev (lines);
+  return ret;
+}
+
+/* @path is a bare repository, a .git directory, or a working tree. If %NULL,
+ * the GIT_DIR environment variable is used, or the current directory.
+ */
+GcuGitRepository *
+gcu_git_repository_open (const gchar  *path,
+                         GError      **error)
+{
+  GcuGitRepository *repo;
+  gchar *git_dir;
+  gchar *common_dir;
+
+  if (path == NULL)
+    path = g_getenv ("GIT_DIR");
+  if (path == NULL)
+    path = ".";
+
+  git_dir = find_git_dir (path);
+  if (git_dir == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   "%s is not a git repository.",
+                   path);
+      return NULL;
+    }
+
+  common_dir = find_common_dir (git_dir);
+
+  if (!uses_sha1 (common_dir))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "%s: only the SHA-1 object format is supported.",
+                   git_dir);
+      g_free (git_dir);
+      g_free (common_dir);
+      return NULL;
+    }
+
+  repo = g_new0 (GcuGitRepository, 1);
+  repo->git_dir = git_dir;
+  repo->common_dir = common_dir;
+  repo->packs = g_ptr_array_new_with_free_func ((GDestroyNotify) pack_free);
+  repo->base_cache = g_hash_table_new_full (base_key_hash,
+                                            base_key_equal,
+                                            (GDestroyNotify) base_entry_free,
+                                            NULL);
+  g_queue_init (&repo->base_cache_lru);
+  g_mutex_init (&repo->base_cache_mutex);
+
+  if (!load_packs (repo, error))
+    {
+      gcu_git_repository_free (repo);
+      return NULL;
+    }
+
+  return repo;
+}
+
+void
+gcu_git_repository_free (GcuGitRepository *repo)
+{
+  if (repo != NULL)
+    {
+      g_free (repo->git_dir);
+      g_free (repo->common_dir);
+
+      /* The cache keys point to the packs. */
+      g_hash_table_unref (repo->base_cache);
+      g_mutex_clear (&repo->base_cache_mutex);
+      g_ptr_array_unref (repo->packs);
+
+      g_free (repo);
+    }
+}
+
+static gboolean
+read_packed_ref (GcuGitRepository *repo,
+                 const gchar      *refname,
+                 guint8           *oid)
+{
+  gchar *path;
+  gchar *contents;
+  gchar **lines;
+  gboolean found = FALSE;
+  gint i;
+
+  path = g_build_filename (repo->common_dir, "packed-refs", NULL);
+  if (!g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      g_free (path);
+      return FALSE;
+    }
+
+  g_free (path);
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  /* "<oid> <refname>", with "#" comments and "^<oid>" peeled tags. */
+  for (i = 0; lines[i] != NULL && !found; i++)
+    {
+      gchar *line = lines[i];
+
+      if (strlen (line) > 2 * GCU_GIT_OID_LENGTH + 1 &&
+          line[2 * GCU_GIT_OID_LENGTH] == ' ' &&
+          g_str_equal (line + 2 * GCU_GIT_OID_LENGTH + 1, refname))
+        {
+          line[2 * GCU_GIT_OID_LENGTH] = '\0';
+          found = hex_to_oid (line, oid);
+        }
+    }
+
+  g_strfreev (lines);
+  return found;
+}
+
+/* Like git, see gitrepository-layout(5): HEAD and the other pseudo refs, and
+ * refs/worktree/, refs/bisect/ and refs/rewritten/.
+ */
+static gboolean
+is_per_worktree_ref (const gchar *refname)
+{
+  return (strchr (refname, '/') == NULL ||
+          g_str_has_prefix (refname, "refs/worktree/") ||
+          g_str_has_prefix (refname, "refs/bisect/") ||
+          g_str_has_prefix (refname, "refs/rewritten/"));
+}
+
+static gboolean
+read_ref (GcuGitRepository *repo,
+          const gchar      *refname,
+          guint             depth,
+          guint8           *oid)
+{
+  gchar *path;
+  gchar *contents;
+  gboolean found;
+
+  if (depth > MAX_SYMREF_DEPTH)
+    return FALSE;
+
+  path = g_build_filename (is_per_worktree_ref (refname) ? repo->git_dir : repo->common_dir,
+                           refname,
+                           NULL);
+
+  if (!g_file_test (path, G_FILE_TEST_IS_REGULAR) ||
+      !g_file_get_contents (path, &contents, NULL, NULL))
+    {
+      g_free (path);
+      return read_packed_ref (repo, refname, oid);
+    }
+
+  g_free (path);
+  g_strstrip (contents);
+
+  if (g_str_has_prefix (contents, "ref: "))
+    found = read_ref (repo, contents + strlen ("ref: "), depth + 1, oid);
+  else
+    found = hex_to_oid (contents, oid);
+
+  g_free (contents);
+  return found;
+}
+
+static gboolean
+resolve_ref (GcuGitRepository *repo,
+             const gchar      *name,
+             guint8           *oid)
+{
+  /* The same order as git, see gitrevisions(7). Pairs of prefix and suffix. */
+  const gchar *candidates[] =
+    {
+      "", "",
+      "refs/", "",
+      "refs/tags/", "",
+      "refs/heads/", "",
+      "refs/remotes/", "",
+      "refs/remotes/", "/HEAD",
+      NULL
+    };
+  gint i;
+
+  if (hex_to_oid (name, oid))
+    return TRUE;
+
+  if (name[0] == '\0' || name[0] == '/' || strstr (name, "..") != NULL)
+    return FALSE;
+
+  for (i = 0; candidates[i] != NULL; i += 2)
+    {
+      gchar *refname = g_strconcat (candidates[i], name, candidates[i + 1], NULL);
+      gboolean found = read_ref (repo, refname, 0, oid);
+
+      g_free (refname);
+      if (found)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Replaces @oid, a commit or a tag pointing to a commit, by its parent number
+ * @parent_num, starting at 1.
+ */
+static gboolean
+get_parent (GcuGitRepository  *repo,
+            guint8            *oid,
+            guint64            parent_num,
+            GError           **error)
+{
+  gint i;
+
+  for (i = 0; i <= MAX_SYMREF_DEPTH; i++)
+    {
+      guint8 *data;
+      guint type;
+      gsize size;
+      gchar *text;
+      gchar **lines;
+      gboolean ok = FALSE;
+      gint line_num;
+
+      data = read_object (repo, oid, 0, &type, &size, error);
+      if (data == NULL)
+        return FALSE;
+
+      if (type != OBJECT_TYPE_COMMIT && type != OBJECT_TYPE_TAG)
+        {
+          g_free (data);
+          break;
+        }
+
+      text = g_strndup ((const gchar *) data, size);
+      g_free (data);
+      lines = g_strsplit (text, "\n", -1);
+      g_free (text);
+
+      /* The headers end at the first empty line. */
+      for (line_num = 0; lines[line_num] != NULL && lines[line_num][0] != '\0'; line_num++)
+        {
+          const gchar *line = lines[line_num];
+
+          if (type == OBJECT_TYPE_TAG && g_str_has_prefix (line, "object "))
+            {
+              ok = hex_to_oid (line + strlen ("object "), oid);
+              break;
+            }
+
+          if (type == OBJECT_TYPE_COMMIT &&
+              g_str_has_prefix (line, "parent ") &&
+              --parent_num == 0)
+            {
+              ok = hex_to_oid (line + strlen ("parent "), oid);
+              break;
+            }
+        }
+
+      g_strfreev (lines);
+
+      if (type == OBJECT_TYPE_COMMIT)
+        {
+          if (ok)
+            return TRUE;
+
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_NOT_FOUND,
+                       "The commit doesn't have enough parents.");
+          return FALSE;
+        }
+
+      if (!ok)
+        break;
+    }
+
+  set_corrupted_error (error, "invalid tag");
+  return FALSE;
+}
+
+/* Supports a full object name or a ref name, followed by "~N" and "^N"
+ * suffixes.
+ */
+static gboolean
+resolve_rev (GcuGitRepository  *repo,
+             const gchar       *rev,
+             guint8            *oid,
+             GError           **error)
+{
+  gchar *name;
+  const gchar *suffix;
+  gboolean found;
+
+  suffix = rev + strcspn (rev, "~^");
+  name = g_strndup (rev, suffix - rev);
+  found = resolve_ref (repo, name, oid);
+  g_free (name);
+
+  if (!found)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_FOUND,
+                   "Unknown revision: %s",
+                   rev);
+      return FALSE;
+    }
+
+  while (*suffix != '\0')
+    {
+      gchar op = *suffix++;
+      guint64 n = 1;
+      guint64 i;
+
+      if (g_ascii_isdigit (*suffix))
+        {
+          gchar *end;
+
+          n = g_ascii_strtoull (suffix, &end, 10);
+          suffix = end;
+        }
+
+      if ((op != '~' && op != '^') || n > G_MAXINT)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_ARGUMENT,
+                       "Unsupported revision syntax: %s",
+                       rev);
+          return FALSE;
+        }
+
+      /* "~N" is the Nth first-parent ancestor, "^N" the Nth parent. "^0" and
+       * "~0" are the commit itself.
+       */
+      if (op == '~')
+        {
+          for (i = 0; i < n; i++)
+            {
+              if (!get_parent (repo, oid, 1, error))
+                return FALSE;
+            }
+        }
+      else if (n > 0 &&
+               !get_parent (repo, oid, n, error))
+        {
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
+/* Returns: (transfer full): the tree object of @oid, peeling tags and commits. */
+static guint8 *
+read_tree (GcuGitRepository  *repo,
+           const guint8      *oid,
+           gsize             *size,
+           GError           **error)
+{
+  guint8 current_oid[GCU_GIT_OID_LENGTH];
+  gint i;
+
+  memcpy (current_oid, oid, GCU_GIT_OID_LENGTH);
+
+  for (i = 0; i <= MAX_SYMREF_DEPTH; i++)
+    {
+      guint8 *data;
+      guint type;
+      gchar hex[2 * GCU_GIT_OID_LENGTH + 1];
+      const gchar *prefix;
+
+      data = read_object (repo, current_oid, 0, &type, size, error);
+      if (data == NULL)
+        return NULL;
+
+      if (type == OBJECT_TYPE_TREE)
+        return data;
+
+      /* "tree <oid>\n" is the first line of a commit, "object <oid>\n" the first
+       * line of an annotated tag.
+       */
+      prefix = type == OBJECT_TYPE_COMMIT ? "tree " : "object ";
+
+      if ((type != OBJECT_TYPE_COMMIT && type != OBJECT_TYPE_TAG) ||
+          *size < strlen (prefix) + 2 * GCU_GIT_OID_LENGTH ||
+          strncmp ((const gchar *) data, prefix, strlen (prefix)) != 0)
+        {
+          g_free (data);
+          break;
+        }
+
+      memcpy (hex, data + strlen (prefix), 2 * GCU_GIT_OID_LENGTH);
+      hex[2 * GCU_GIT_OID_LENGTH] = '\0';
+      g_free (data);
+
+      if (!hex_to_oid (hex, current_oid))
+        break;
+    }
+
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "The revision doesn't point to a tree.");
+  return NULL;
+}
+
+static gboolean
+list_tree (GcuGitRepository  *repo,
+           const guint8      *tree,
+           gsize              tree_size,
+           const gchar       *prefix,
+           guint              depth,
+           GPtrArray         *files,
+           GError           **error)
+{
+  const guint8 *p = tree;
+  const guint8 *end = tree + tree_size;
+
+  if (depth > MAX_DELTA_DEPTH)
+    {
+      set_corrupted_error (error, "tree too deep");
+      return FALSE;
+    }
+
+  /* Entries: "<mode> <name>\0<binary oid>". */
+  while (p < end)
+    {
+      const guint8 *space;
+      const guint8 *name_end;
+      const guint8 *oid;
+      gchar *mode;
+      gchar *path;
+
+      space = memchr (p, ' ', end - p);
+      if (space == NULL)
+        goto corrupted;
+
+      name_end = memchr (space, '\0', end - space);
+      if (name_end == NULL || end - name_end - 1 < GCU_GIT_OID_LENGTH)
+        goto corrupted;
+
+      oid = name_end + 1;
+      mode = g_strndup ((const gchar *) p, space - p);
+      path = g_strdup_printf ("%s%.*s", prefix, (gint) (name_end - space - 1), space + 1);
+
+      if (g_str_equal (mode, "40000"))
+        {
+          guint8 *subtree;
+          gsize subtree_size;
+          guint type;
+          gchar *subtree_prefix;
+          gboolean ok;
+
+          subtree = read_object (repo, oid, 0, &type, &subtree_size, error);
+          if (subtree == NULL || type != OBJECT_TYPE_TREE)
+            {
+              if (subtree != NULL)
+                set_corrupted_error (error, "a tree entry is not a tree");
+
+              g_free (subtree);
+              g_free (mode);
+              g_free (path);
+              return FALSE;
+            }
+
+          subtree_prefix = g_strconcat (path, "/", NULL);
+          ok = list_tree (repo, subtree, subtree_size, subtree_prefix, depth + 1, files, error);
+          g_free (subtree_prefix);
+          g_free (subtree);
+
+          if (!ok)
+            {
+              g_free (mode);
+              g_free (path);
+              return FALSE;
+            }
+
+          g_free (path);
+        }
+      /* Regular files. The symlinks (120000) and submodules (160000) are
+       * skipped.
+       */
+      else if (g_str_equal (mode, "100644") ||
+               g_str_equal (mode, "100755"))
+        {
+          GcuGitFile *file = g_new0 (GcuGitFile, 1);
+
+          file->path = path;
+          memcpy (file->oid, oid, GCU_GIT_OID_LENGTH);
+          g_ptr_array_add (files, file);
+        }
+      else
+        {
+          g_free (path);
+        }
+
+      g_free (mode);
+      p = oid + GCU_GIT_OID_LENGTH;
+    }
+
+  return TRUE;
+
+corrupted:
+  set_corrupted_error (error, "invalid tree");
+  return FALSE;
+}
+
+static gint
+compare_files (gconstpointer a,
+               gconstpointer b)
+{
+  const GcuGitFile * const *file_a = a;
+  const GcuGitFile * const *file_b = b;
+
+  return strcmp ((*file_a)->path, (*file_b)->path);
+}
+
+/* Returns: (transfer full) (nullable): the regular files (GcuGitFile's) of
+ * @rev, recursively, sorted by path.
+ */
+GPtrArray *
+gcu_git_repository_list_files (GcuGitRepository  *repo,
+                               const gchar       *rev,
+                               GError           **error)
+{
+  guint8 oid[GCU_GIT_OID_LENGTH];
+  guint8 *tree;
+  gsize tree_size;
+  GPtrArray *files;
+
+  g_return_val_if_fail (repo != NULL, NULL);
+  g_return_val_if_fail (rev != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (!resolve_rev (repo, rev, oid, error))
+    return NULL;
+
+  tree = read_tree (repo, oid, &tree_size, error);
+  if (tree == NULL)
+    return NULL;
+
+  files = g_ptr_array_new_with_free_func ((GDestroyNotify) gcu_git_file_free);
+
+  if (!list_tree (repo, tree, tree_size, "", 0, files, error))
+    {
+      g_ptr_array_unref (files);
+      files = NULL;
+    }
+  else
+    {
+      g_ptr_array_sort (files, compare_files);
+    }
+
+  g_free (tree);
+  return files;
+}
+
+/* Returns: (transfer full) (nullable): the content of @file. Thread-safe. The
+ * content is followed by a nul byte, not included in the size.
+ */
+GBytes *
+gcu_git_repository_read_file (GcuGitRepository  *repo,
+                              const GcuGitFile  *file,
+                              GError           **error)
+{
+  guint8 *data;
+  gsize size;
+  guint type;
+
+  g_return_val_if_fail (repo != NULL, NULL);
+  g_return_val_if_fail (file != NULL, NULL);
+
+  data = read_object (repo, file->oid, 0, &type, &size, error);
+  if (data == NULL)
+    return NULL;
+
+  if (type != OBJECT_TYPE_BLOB)
+    {
+      set_corrupted_error (error, file->path);
+      g_free (data);
+      return NULL;
+    }
+
+  data[size] = '\0';
+  return g_bytes_new_take (data, size);
+}
+
+/* Sets @size to the size of the content of @file, without reading it: only the
+ * header of its object is inflated. Thread-safe.
+ */
+gboolean
+gcu_git_repository_file_size (GcuGitRepository  *repo,
+                              const GcuGitFile  *file,
+                              guint64           *size,
+                              GError           **error)
+{
+  g_return_val_if_fail (repo != NULL, FALSE);
+  g_return_val_if_fail (file != NULL, FALSE);
+  g_return_val_if_fail (size != NULL, FALSE);
+
+  return read_object_size (repo, file->oid, size, error);
+}
+
+/* Returns whether @file is one of @paths, or is in one of those directories.
+ * All files are if @n_paths is 0, like with "git ls-files". The paths are
+ * relative to the root of the tree, a leading "./" is ignored and "." is the
+ * whole tree.
+ */
+gboolean
+gcu_git_file_is_in_paths (const GcuGitFile  *file,
+                          gint               n_paths,
+                          gchar            **paths)
+{
+  gint i;
+
+  g_return_val_if_fail (file != NULL, FALSE);
+
+  if (n_paths == 0)
+    return TRUE;
+
+  for (i = 0; i < n_paths; i++)
+    {
+      const gchar *path = paths[i];
+      gsize length;
+
+      while (path[0] == '.' && path[1] == '/')
+        {
+          path += 2;
+
+          while (path[0] == '/')
+            path++;
+        }
+
+      if (g_str_equal (path, "."))
+        path = "";
+
+      length = strlen (path);
+      while (length > 0 && path[length - 1] == '/')
+        length--;
+
+      if (length == 0 ||
+          (strncmp (file->path, path, length) == 0 &&
+           (file->path[length] == '\0' || file->path[length] == '/')))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+void
+gcu_git_file_free (GcuGitFile *file)
+{
+  if (file != NULL)
+    {
+      g_free (file->path);
+      g_free (file);
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_GIT_H
+#define GCU_GIT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define GCU_GIT_OID_LENGTH 20
+
+typedef struct _GcuGitRepository	GcuGitRepository;
+typedef struct _GcuGitFile		GcuGitFile;
+
+struct _GcuGitFile
+{
+  /* Relative to the root of the tree. */
+  gchar *path;
+
+  guint8 oid[GCU_GIT_OID_LENGTH];
+};
+
+GcuGitRepository *	gcu_git_repository_open		(const gchar		 *path,
+							 GError			**error);
+
+void			gcu_git_repository_free		(GcuGitRepository	 *repo);
+
+GPtrArray *		gcu_git_repository_list_files	(GcuGitRepository	 *repo,
+							 const gchar		 *rev,
+							 GError			**error);
+
+GBytes *		gcu_git_repository_read_file	(GcuGitRepository	 *repo,
+							 const GcuGitFile	 *file,
+							 GError			**error);
+
+gboolean		gcu_git_repository_file_size	(GcuGitRepository	 *repo,
+							 const GcuGitFile	 *file,
+							 guint64		 *size,
+							 GError			**error);
+
+gboolean		gcu_git_file_is_in_paths	(const GcuGitFile	 *file,
+							 gint			  n_paths,
+							 gchar			**paths);
+
+void			gcu_git_file_free		(GcuGitFile		 *file);
+
+G_END_DECLS
+
+#endif /* GCU_GIT_H */
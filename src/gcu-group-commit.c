@@ -0,0 +1,574 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* For syncfs(). */
+#define _GNU_SOURCE
+
+#include "gcu-group-commit.h"
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Durable writes of several files, with one sync for the whole group instead
+ * of one per file.
+ *
+ * gcu_group_commit_add() writes the new content to a new temporary file in the
+ * same directory, created with g_mkstemp_full(), without flushing it. It can be
+ * called from several threads.
+ * gcu_group_commit_commit() then:
+ * 1. flushes all the temporary files at once, with syncfs() (or, if syncfs()
+ *    is not available, with fdatasync() on each temporary file);
+ * 2. renames all the temporary files to their final names;
+ * 3. fsyncs each directory once;
+ * 4. appends the filenames to the journal, if any, and fsyncs it.
+ *
+ * On the next run with the same journal, gcu_group_commit_is_done() returns
+ * TRUE for the files committed by a previous run, so an interrupted run can be
+ * resumed.
+ */
+
+struct _GcuGroupCommit
+{
+  GMutex mutex;
+
+  /* Filenames (gchar *) added since the last commit, with their temporary
+   * file (gchar *), or NULL if the file is unchanged.
+   */
+  GPtrArray *filenames;
+  GPtrArray *tmp_filenames;
+
+  /* Set of filenames (gchar *) committed by previous runs. */
+  GHashTable *done_files;
+
+  gint journal_fd;
+};
+
+static gboolean
+write_all_to_fd (gint          fd,
+                 const gchar  *data,
+                 gsize         length,
+                 const gchar  *filename,
+                 GError      **error)
+{
+  while (length > 0)
+    {
+      gssize n_written;
+
+      n_written = write (fd, data, length);
+
+      if (n_written == -1)
+        {
+          gint saved_errno = errno;
+
+          if (saved_errno == EINTR)
+            continue;
+
+          g_set_error (error,
+                       G_FILE_ERROR,
+                       g_file_error_from_errno (saved_errno),
+                       "Error when writing to %s: %s",
+                       filename,
+                       g_strerror (saved_errno));
+          return FALSE;
+        }
+
+      data += n_written;
+      length -= n_written;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+load_journal (GcuGroupCommit  *group_commit,
+              const gchar     *journal_path,
+              GError         **error)
+{
+  gchar *contents;
+  gchar **lines;
+  gint i;
+  GError *my_error = NULL;
+
+  g_file_get_contents (journal_path, &contents, NULL, &my_error);
+
+  if (g_error_matches (my_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+    {
+      g_clear_error (&my_error);
+      return TRUE;
+    }
+
+  if (my_error != NULL)
+    {
+      g_propagate_error (error, my_error);
+      return FALSE;
+    }
+
+  lines = g_strsplit (contents, "\n", -1);
+
+  /* The last line is incomplete if the previous run was interrupted while
+   * writing the journal, or is empty.
+   */
+  for (i = 0; lines[i] != NULL && lines[i + 1] != NULL; i++)
+    {
+      if (lines[i][0] != '\0')
+        g_hash_table_add (group_commit->done_files, g_strdup (lines[i]));
+    }
+
+  g_strfreev (lines);
+  g_free (contents);
+  return TRUE;
+}
+
+/* @journal_path: (nullable): the journal, to resume an interrupted run. */
+GcuGroupCommit *
+gcu_group_commit_new (const gchar  *journal_path,
+                      GError      **error)
+{
+  GcuGroupCommit *group_commit;
+
+  group_commit = g_new0 (GcuGroupCommit, 1);
+  g_mutex_init (&group_commit->mutex);
+  group_commit->filenames = g_ptr_array_new_with_free_func (g_free);
+  group_commit->tmp_filenames = g_ptr_array_new_with_free_func (g_free);
+  group_commit->done_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  group_commit->journal_fd = -1;
+
+  if (journal_path == NULL)
+    return group_commit;
+
+  if (!load_journal (group_commit, journal_path, error))
+    goto error;
+
+  group_commit->journal_fd = g_open (journal_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+  if (group_commit->journal_fd == -1)
+    {
+      gint saved_errno = errno;
+
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   g_file_error_from_errno (saved_errno),
+                   "Impossible to open the journal %s: %s",
+                   journal_path,
+                   g_strerror (saved_errno));
+      goto error;
+    }
+
+  return group_commit;
+
+error:
+  gcu_group_commit_free (group_commit);
+  return NULL;
+}
+
+void
+gcu_group_commit_free (GcuGroupCommit *group_commit)
+{
+  if (group_commit != NULL)
+    {
+      g_mutex_clear (&group_commit->mutex);
+      g_ptr_array_unref (group_commit->filenames);
+      g_ptr_array_unref (group_commit->tmp_filenames);
+      g_hash_table_unref (group_commit->done_files);
+
+      if (group_commit->journal_fd != -1)
+        close (group_commit->journal_fd);
+
+      g_free (group_commit);
+    }
+}
+
+/* Returns whether @filename has been committed by a previous run. */
+gboolean
+gcu_group_commit_is_done (GcuGroupCommit *group_commit,
+                          const gchar    *filename)
+{
+  return g_hash_table_contains (group_commit->done_files, filename);
+}
+
+/* Returns the template of the temporary file, for g_mkstemp_full(). */
+static gchar *
+get_tmp_filename (const gchar *filename)
+{
+  gchar *dirname;
+  gchar *basename;
+  gchar *tmp_basename;
+  gchar *tmp_filename;
+
+  dirname = g_path_get_dirname (filename);
+  basename = g_path_get_basename (filename);
+
+  tmp_basename = g_strdup_printf (".%s.XXXXXX", basename);
+  tmp_filename = g_build_filename (dirname, tmp_basename, NULL);
+
+  g_free (dirname);
+  g_free (basename);
+  g_free (tmp_basename);
+  return tmp_filename;
+}
+
+/* Writes @contents to a temporary file, renamed to @filename by the next
+ * gcu_group_commit_commit(). Thread-safe.
+ */
+gboolean
+gcu_group_commit_add (GcuGroupCommit  *group_commit,
+                      const gchar     *filename,
+                      const gchar     *contents,
+                      gsize            length,
+                      GError         **error)
+{
+  gchar *tmp_filename;
+  GStatBuf file_stat;
+  mode_t mode = 0644;
+  gint fd;
+
+  if (g_stat (filename, &file_stat) == 0)
+    mode = file_stat.st_mode & 07777;
+
+  tmp_filename = get_tmp_filename (filename);
+
+  /* A new file each time, so that an existing file is never truncated, and
+   * two adds of the same filename don't write to the same temporary file.
+   */
+  fd = g_mkstemp_full (tmp_filename, O_WRONLY | O_CLOEXEC, mode);
+
+  if (fd == -1)
+    {
+      gint saved_errno = errno;
+
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   g_file_error_from_errno (saved_errno),
+                   "Impossible to create a temporary file for %s: %s",
+                   filename,
+                   g_strerror (saved_errno));
+
+      g_free (tmp_filename);
+      return FALSE;
+    }
+
+  /* The mode given to open() is affected by the umask. */
+  fchmod (fd, mode);
+
+  if (!write_all_to_fd (fd, contents, length, tmp_filename, error))
+    {
+      close (fd);
+      g_unlink (tmp_filename);
+      g_free (tmp_filename);
+      return FALSE;
+    }
+
+  close (fd);
+
+  g_mutex_lock (&group_commit->mutex);
+  g_ptr_array_add (group_commit->filenames, g_strdup (filename));
+  g_ptr_array_add (group_commit->tmp_filenames, tmp_filename);
+  g_mutex_unlock (&group_commit->mutex);
+
+  return TRUE;
+}
+
+/* Records that @filename is done, without rewriting it. Thread-safe. */
+void
+gcu_group_commit_add_unchanged (GcuGroupCommit *group_commit,
+                                const gchar    *filename)
+{
+  g_mutex_lock (&group_commit->mutex);
+  g_ptr_array_add (group_commit->filenames, g_strdup (filename));
+  g_ptr_array_add (group_commit->tmp_filenames, NULL);
+  g_mutex_unlock (&group_commit->mutex);
+}
+
+static gboolean
+sync_fd (gint          fd,
+         gboolean      data_only,
+         const gchar  *filename,
+         GError      **error)
+{
+  gint ret;
+
+  if (data_only)
+    ret = fdatasync (fd);
+  else
+    ret = fsync (fd);
+
+  if (ret == -1)
+    {
+      gint saved_errno = errno;
+
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   g_file_error_from_errno (saved_errno),
+                   "Error when syncing %s: %s",
+                   filename,
+                   g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gint
+open_for_sync (const gchar  *filename,
+               gint          flags,
+               GError      **error)
+{
+  gint fd;
+
+  fd = g_open (filename, O_RDONLY | O_CLOEXEC | flags, 0);
+
+  if (fd == -1)
+    {
+      gint saved_errno = errno;
+
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   g_file_error_from_errno (saved_errno),
+                   "Impossible to open %s: %s",
+                   filename,
+                   g_strerror (saved_errno));
+    }
+
+  return fd;
+}
+
+/* Returns the set of directories (gchar *) containing the temporary files. */
+static GHashTable *
+get_directories (GcuGroupCommit *group_commit)
+{
+  GHashTable *directories;
+  guint i;
+
+  directories = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (i = 0; i < group_commit->tmp_filenames->len; i++)
+    {
+      const gchar *tmp_filename = g_ptr_array_index (group_commit->tmp_filenames, i);
+
+      if (tmp_filename != NULL)
+        g_hash_table_add (directories, g_path_get_dirname (tmp_filename));
+    }
+
+  return directories;
+}
+
+static gboolean
+sync_tmp_files (GcuGroupCommit  *group_commit,
+                GHashTable      *directories,
+                GError         **error)
+{
+#ifdef HAVE_SYNCFS
+  GHashTable *synced_devices;
+  GHashTableIter iter;
+  gpointer directory;
+  gboolean ret = TRUE;
+
+  /* One syncfs() per filesystem. */
+  synced_devices = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+
+  g_hash_table_iter_init (&iter, directories);
+  while (ret && g_hash_table_iter_next (&iter, &directory, NULL))
+    {
+      struct stat dir_stat;
+      gint64 device;
+      gint fd;
+
+      fd = open_for_sync (directory, O_DIRECTORY, error);
+      if (fd == -1)
+        {
+          ret = FALSE;
+          break;
+        }
+
+      if (fstat (fd, &dir_stat) == 0)
+        {
+          device = dir_stat.st_dev;
+
+          if (!g_hash_table_contains (synced_devices, &device))
+            {
+              gint64 *device_key;
+
+              if (syncfs (fd) == -1)
+                {
+                  gint saved_errno = errno;
+
+                  g_set_error (error,
+                               G_FILE_ERROR,
+                               g_file_error_from_errno (saved_errno),
+                               "Error when syncing the filesystem of %s: %s",
+                               (const gchar *) directory,
+                               g_strerror (saved_errno));
+                  ret = FALSE;
+                }
+
+              device_key = g_new (gint64, 1);
+              *device_key = device;
+              g_hash_table_add (synced_devices, device_key);
+            }
+        }
+
+      close (fd);
+    }
+
+  g_hash_table_unref (synced_devices);
+  return ret;
+#else
+  guint i;
+
+  for (i = 0; i < group_commit->tmp_filenames->len; i++)
+    {
+      const gchar *tmp_filename = g_ptr_array_index (group_commit->tmp_filenames, i);
+      gboolean ok;
+      gint fd;
+
+      if (tmp_filename == NULL)
+        continue;
+
+      fd = open_for_sync (tmp_filename, 0, error);
+      if (fd == -1)
+        return FALSE;
+
+      ok = sync_fd (fd, TRUE, tmp_filename, error);
+      close (fd);
+
+      if (!ok)
+        return FALSE;
+    }
+
+  return TRUE;
+#endif
+}
+
+static gboolean
+sync_directories (GHashTable  *directories,
+                  GError     **error)
+{
+  GHashTableIter iter;
+  gpointer directory;
+
+  g_hash_table_iter_init (&iter, directories);
+  while (g_hash_table_iter_next (&iter, &directory, NULL))
+    {
+      gboolean ok;
+      gint fd;
+
+      fd = open_for_sync (directory, O_DIRECTORY, error);
+      if (fd == -1)
+        return FALSE;
+
+      ok = sync_fd (fd, FALSE, directory, error);
+      close (fd);
+
+      if (!ok)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+write_journal (GcuGroupCommit  *group_commit,
+               GError         **error)
+{
+  GString *journal_lines;
+  gboolean ok;
+  guint i;
+
+  if (group_commit->journal_fd == -1)
+    return TRUE;
+
+  journal_lines = g_string_new (NULL);
+
+  for (i = 0; i < group_commit->filenames->len; i++)
+    {
+      g_string_append (journal_lines, g_ptr_array_index (group_commit->filenames, i));
+      g_string_append_c (journal_lines, '\n');
+    }
+
+  ok = (write_all_to_fd (group_commit->journal_fd,
+                         journal_lines->str,
+                         journal_lines->len,
+                         "the journal",
+                         error) &&
+        sync_fd (group_commit->journal_fd, TRUE, "the journal", error));
+
+  g_string_free (journal_lines, TRUE);
+  return ok;
+}
+
+/* Makes durable all the files added since the last commit. Must not be called
+ * while other threads add files.
+ */
+gboolean
+gcu_group_commit_commit (GcuGroupCommit  *group_commit,
+                         GError         **error)
+{
+  GHashTable *directories;
+  gboolean ret = FALSE;
+  guint i;
+
+  if (group_commit->filenames->len == 0)
+    return TRUE;
+
+  directories = get_directories (group_commit);
+
+  if (!sync_tmp_files (group_commit, directories, error))
+    goto out;
+
+  for (i = 0; i < group_commit->filenames->len; i++)
+    {
+      const gchar *filename = g_ptr_array_index (group_commit->filenames, i);
+      const gchar *tmp_filename = g_ptr_array_index (group_commit->tmp_filenames, i);
+
+      if (tmp_filename == NULL)
+        continue;
+
+      if (g_rename (tmp_filename, filename) == -1)
+        {
+          gint saved_errno = errno;
+
+          g_set_error (error,
+                       G_FILE_ERROR,
+                       g_file_error_from_errno (saved_errno),
+                       "Impossible to rename %s to %s: %s",
+                       tmp_filename,
+                       filename,
+                       g_strerror (saved_errno));
+          goto out;
+        }
+    }
+
+  if (!sync_directories (directories, error))
+    goto out;
+
+  if (!write_journal (group_commit, error))
+    goto out;
+
+  g_ptr_array_set_size (group_commit->filenames, 0);
+  g_ptr_array_set_size (group_commit->tmp_filenames, 0);
+  ret = TRUE;
+
+out:
+  g_hash_table_unref (directories);
+  return ret;
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_GROUP_COMMIT_H
+#define GCU_GROUP_COMMIT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GcuGroupCommit GcuGroupCommit;
+
+GcuGroupCommit *	gcu_group_commit_new		(const gchar     *journal_path,
+							 GError         **error);
+
+void			gcu_group_commit_free		(GcuGroupCommit  *group_commit);
+
+gboolean		gcu_group_commit_is_done	(GcuGroupCommit  *group_commit,
+							 const gchar     *filename);
+
+gboolean		gcu_group_commit_add		(GcuGroupCommit  *group_commit,
+							 const gchar     *filename,
+							 const gchar     *contents,
+							 gsize            length,
+							 GError         **error);
+
+void			gcu_group_commit_add_unchanged	(GcuGroupCommit  *group_commit,
+							 const gchar     *filename);
+
+gboolean		gcu_group_commit_commit		(GcuGroupCommit  *group_commit,
+							 GError         **error);
+
+G_END_DECLS
+
+#endif /* GCU_GROUP_COMMIT_H */
@@ -28,12 +28,56 @@
  * #endif
  *
  * If config.h is already included differently, it is replaced by the above
- * snippet. The snippet is always inserted as the first #include.
+ * snippet. The snippet is always inserted as the first #include, at the start
+ * of a line, and not in a comment or an #if 0 block (see gcu-lex.c).
+ *
+ * If <file.c> is "-", stdin is read and the result is written to stdout
+ * instead, so the script can be used in a pipeline (see gcu-filter.c), e.g.:
+ * $ git show HEAD:file.c | gcu-include-config-h - | diff -u file.c -
+ * stdin must be UTF-8, otherwise it is written unchanged, with a warning.
+ *
+ * Usage:
+ * $ gcu-include-config-h --git-rev <rev> [--git-dir <dir>] [path...]
+ * Does not modify any file. Reads the *.c files of the git revision directly
+ * from the object store of the repository (by default GIT_DIR or the current
+ * directory), without a checkout (see gcu-git.c), and prints the changes as a
+ * unified diff against the revision. The exit status is 1 if some files would
+ * be changed. The paths restrict the files to those directories or files of the
+ * revision. The files are processed one after the other, since the buffers must
+ * be used from the main thread.
+ *
+ * Usage:
+ * $ gcu-include-config-h --tar < project.tar > new-project.tar
+ * Reads a tar archive on stdin and writes it on stdout, with the *.c files
+ * modified, without extracting it to the disk (see gcu-tar.c). For example:
+ * $ xzcat project-1.0.tar.xz | gcu-include-config-h --tar | xz > new-project-1.0.tar.xz
  */
 
 #include <tepl/tepl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <locale.h>
+#include "gcu-diff.h"
+#include "gcu-filter.h"
+#include "gcu-git.h"
+#include "gcu-lex.h"
+#include "gcu-tar.h"
+#include <unistd.h>
+
+static gchar *_git_rev;
+static gchar *_git_dir;
+static gboolean _tar;
+
+static GOptionEntry option_entries[] =
+{
+  { "git-rev", 0, 0, G_OPTION_ARG_STRING, &_git_rev,
+    "Print as a diff the changes for the files of the git revision REV, without a checkout.", "REV" },
+  { "git-dir", 0, 0, G_OPTION_ARG_FILENAME, &_git_dir,
+    "With --git-rev, the git repository (default: GIT_DIR or the current directory).", "DIR" },
+  { "tar", 0, 0, G_OPTION_ARG_NONE, &_tar,
+    "Read a tar archive on stdin and write it on stdout, with the *.c files modified.", NULL },
+  { NULL }
+};
 
 static void
 save_file_cb (GObject      *source_object,
@@ -120,28 +164,45 @@ static gboolean
 find_first_include (GtkSourceBuffer *buffer,
                     GtkTextIter     *iter)
 {
-  GtkSourceSearchSettings *search_settings;
-  GtkSourceSearchContext *search_context;
   GtkTextIter start;
-  gboolean found;
+  GtkTextIter end;
+  gchar *contents;
+  GcuLex *lex;
+  const GcuLexSpan *directives;
+  guint n_directives;
+  guint directive_num;
+  gboolean found = FALSE;
 
-  search_settings = gtk_source_search_settings_new ();
-  gtk_source_search_settings_set_regex_enabled (search_settings, TRUE);
-  gtk_source_search_settings_set_case_sensitive (search_settings, TRUE);
-  gtk_source_search_settings_set_search_text (search_settings, "^#include");
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &start, &end);
+  contents = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (buffer), &start, &end, TRUE);
+  lex = gcu_lex_new (contents, -1);
 
-  search_context = gtk_source_search_context_new (buffer, search_settings);
+  directives = gcu_lex_get_spans (lex, GCU_LEX_SPAN_DIRECTIVE, &n_directives);
 
-  gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (buffer), &start);
+  for (directive_num = 0; directive_num < n_directives; directive_num++)
+    {
+      GtkTextIter directive_end;
+      gchar *directive_start;
 
-  found = gtk_source_search_context_forward (search_context,
-                                             &start,
-                                             iter,
-                                             NULL,
-                                             NULL);
+      gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (buffer),
+                                          iter,
+                                          directives[directive_num].start);
 
-  g_object_unref (search_settings);
-  g_object_unref (search_context);
+      if (!gtk_text_iter_starts_line (iter))
+        continue;
+
+      directive_end = *iter;
+      gtk_text_iter_forward_chars (&directive_end, strlen ("#include"));
+      directive_start = gtk_text_iter_get_slice (iter, &directive_end);
+      found = g_str_equal (directive_start, "#include");
+      g_free (directive_start);
+
+      if (found)
+        break;
+    }
+
+  gcu_lex_free (lex);
+  g_free (contents);
 
   return found;
 }
@@ -153,12 +214,12 @@ insert_include_config (TeplBuffer *buffer)
 
   if (!find_first_include (GTK_SOURCE_BUFFER (buffer), &pos))
     {
-      TeplFile *file;
+      GFile *location;
       gchar *filename;
 
       /* I don't know where to insert the #include. */
-      file = tepl_buffer_get_file (buffer);
-      filename = g_file_get_parse_name (tepl_file_get_location (file));
+      location = tepl_file_get_location (tepl_buffer_get_file (buffer));
+      filename = location != NULL ? g_file_get_parse_name (location) : g_strdup ("stdin");
       g_warning ("%s: first #include not found.", filename);
       g_free (filename);
       return;
@@ -206,22 +267,314 @@ load_file (TeplBuffer *buffer)
                                buffer);
 }
 
+/* Returns: (transfer full): the new contents of the file @path, or of stdin if
+ * @path is %NULL.
+ */
+static gchar *
+get_new_contents (const gchar *path,
+                  const gchar *contents,
+                  gsize        length)
+{
+  TeplBuffer *buffer;
+  GtkTextIter start;
+  GtkTextIter end;
+  gchar *new_contents;
+
+  buffer = tepl_buffer_new ();
+
+  /* For the warning of insert_include_config(). */
+  if (path != NULL)
+    {
+      GFile *location;
+
+      location = g_file_new_for_path (path);
+      tepl_file_set_location (tepl_buffer_get_file (buffer), location);
+      g_object_unref (location);
+    }
+
+  gtk_text_buffer_set_text (GTK_TEXT_BUFFER (buffer), contents, length);
+
+  remove_existing_include_config (buffer);
+  insert_include_config (buffer);
+
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &start, &end);
+  new_contents = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (buffer), &start, &end, TRUE);
+
+  g_object_unref (buffer);
+
+  return new_contents;
+}
+
+/* Returns: (transfer full) (nullable): the diff for @file, or %NULL if it
+ * would not be changed.
+ */
+static gchar *
+get_git_file_diff (const GcuGitFile *file,
+                   const gchar      *contents,
+                   gsize             length)
+{
+  gchar *new_contents;
+  GString *diff;
+
+  new_contents = get_new_contents (file->path, contents, length);
+
+  diff = g_string_new (NULL);
+  gcu_diff_append_unified (diff,
+                           file->path,
+                           contents,
+                           length,
+                           new_contents,
+                           strlen (new_contents));
+
+  g_free (new_contents);
+
+  if (diff->len == 0)
+    {
+      g_string_free (diff, TRUE);
+      return NULL;
+    }
+
+  return g_string_free (diff, FALSE);
+}
+
+static int
+handle_git_rev (const gchar  *rev,
+                const gchar  *git_dir,
+                gint          n_paths,
+                gchar       **paths)
+{
+  GcuGitRepository *repo;
+  GPtrArray *files;
+  GError *error = NULL;
+  guint file_num;
+  gboolean changed = FALSE;
+  gboolean failed = FALSE;
+
+  repo = gcu_git_repository_open (git_dir, &error);
+  if (repo == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
+
+  files = gcu_git_repository_list_files (repo, rev, &error);
+  if (files == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      gcu_git_repository_free (repo);
+      return EXIT_FAILURE;
+    }
+
+  for (file_num = 0; file_num < files->len; file_num++)
+    {
+      const GcuGitFile *file = g_ptr_array_index (files, file_num);
+      GBytes *bytes;
+      const gchar *contents;
+      gsize length;
+      gchar *diff;
+
+      if (!g_str_has_suffix (file->path, ".c") ||
+          !gcu_git_file_is_in_paths (file, n_paths, paths))
+        continue;
+
+      bytes = gcu_git_repository_read_file (repo, file, &error);
+      if (bytes == NULL)
+        {
+          g_printerr ("%s: %s\n", file->path, error->message);
+          g_clear_error (&error);
+          failed = TRUE;
+          continue;
+        }
+
+      contents = g_bytes_get_data (bytes, &length);
+
+      /* A GtkTextBuffer contains only valid UTF-8. */
+      if (length > G_MAXINT || !g_utf8_validate (contents, length, NULL))
+        {
+          g_printerr ("%s: not a valid UTF-8 text file, skipped.\n", file->path);
+          g_bytes_unref (bytes);
+          continue;
+        }
+
+      diff = get_git_file_diff (file, contents, length);
+      if (diff != NULL)
+        {
+          g_print ("%s", diff);
+          changed = TRUE;
+        }
+
+      g_free (diff);
+      g_bytes_unref (bytes);
+    }
+
+  g_ptr_array_unref (files);
+  gcu_git_repository_free (repo);
+
+  return changed || failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* Called from the main thread, for each *.c member of the tar archive. */
+static gboolean
+tar_transform (const gchar *path,
+               const gchar *contents,
+               gsize        length,
+               GString     *new_contents,
+               gpointer     user_data)
+{
+  gchar *str;
+  gsize new_length;
+  gboolean changed;
+
+  /* A GtkTextBuffer contains only valid UTF-8. */
+  if (length > G_MAXINT || !g_utf8_validate (contents, length, NULL))
+    {
+      g_printerr ("%s: not a valid UTF-8 text file, skipped.\n", path);
+      return FALSE;
+    }
+
+  str = get_new_contents (path, contents, length);
+  new_length = strlen (str);
+
+  changed = new_length != length || memcmp (str, contents, length) != 0;
+  if (changed)
+    g_string_append_len (new_contents, str, new_length);
+
+  g_free (str);
+  return changed;
+}
+
+static int
+handle_tar (void)
+{
+  const gchar *suffixes[] = { ".c", NULL };
+  GError *error = NULL;
+
+  if (!gcu_tar_filter (STDIN_FILENO, STDOUT_FILENO, suffixes, 1, 0, tar_transform, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
+
+static int
+handle_stdin (void)
+{
+  gchar *contents;
+  gsize length;
+  gchar *new_contents = NULL;
+  GError *error = NULL;
+
+  contents = gcu_filter_read_stdin (&length, &error);
+  if (error != NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
+
+  /* A GtkTextBuffer contains only valid UTF-8. */
+  if (length > G_MAXINT || !g_utf8_validate (contents, length, NULL))
+    g_printerr ("stdin: not a valid UTF-8 text, written unchanged.\n");
+  else
+    new_contents = get_new_contents (NULL, contents, length);
+
+  if (new_contents != NULL)
+    {
+      g_free (contents);
+      contents = new_contents;
+      length = strlen (new_contents);
+    }
+
+  if (!gcu_filter_write_stdout (contents, length, &error))
+    g_error ("Error when writing the output: %s", error->message);
+
+  g_free (contents);
+
+  return EXIT_SUCCESS;
+}
+
+static void
+print_usage (char **argv)
+{
+  g_printerr ("Usage: %s <file.c or ->\n", argv[0]);
+  g_printerr ("       %s --git-rev <rev> [--git-dir <dir>] [path...]\n", argv[0]);
+  g_printerr ("       %s --tar < project.tar > new-project.tar\n", argv[0]);
+  g_printerr ("WARNING: the script directly modifies the file without doing a backup first!\n");
+}
+
 int
 main (int    argc,
       char **argv)
 {
+  GOptionContext *option_context;
+  GError *error = NULL;
   GFile *location;
   TeplBuffer *buffer;
   TeplFile *file;
+  int ret = EXIT_SUCCESS;
 
   setlocale (LC_ALL, "");
   gtk_init (NULL, NULL);
 
+  option_context = g_option_context_new ("- include config.h");
+  g_option_context_add_main_entries (option_context, option_entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (_git_dir != NULL && _git_rev == NULL)
+    {
+      g_printerr ("The --git-dir option requires --git-rev.\n");
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (_git_rev != NULL)
+    {
+      if (_tar)
+        {
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      ret = handle_git_rev (_git_rev, _git_dir, argc - 1, argv + 1);
+      goto exit;
+    }
+
+  if (_tar)
+    {
+      if (argc != 1)
+        {
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      ret = handle_tar ();
+      goto exit;
+    }
+
   if (argc != 2)
     {
-      g_printerr ("Usage: %s <file.c>\n", argv[0]);
-      g_printerr ("WARNING: the script directly modifies the file without doing a backup first!\n");
-      return EXIT_FAILURE;
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (g_str_equal (argv[1], "-"))
+    {
+      ret = handle_stdin ();
+      goto exit;
     }
 
   location = g_file_new_for_commandline_arg (argv[1]);
@@ -237,5 +590,10 @@ main (int    argc,
   g_object_unref (location);
   g_object_unref (buffer);
 
-  return EXIT_SUCCESS;
+exit:
+  g_option_context_free (option_context);
+  g_clear_error (&error);
+  g_free (_git_rev);
+  g_free (_git_dir);
+  return ret;
 }
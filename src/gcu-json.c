@@ -0,0 +1,419 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-json.h"
+#include <errno.h>
+#include <string.h>
+
+/*
+ * A minimal JSON reader and writer, for the few JSON files that the tools read
+ * and write (compile_commands.json, the results of a shard, ...), to not
+ * depend on a JSON library.
+ *
+ * The reader is a cursor over the contents, with functions to read the values
+ * in the expected order. They return %FALSE or %NULL if the contents are not
+ * as expected, and the position of the error is then reader->pos. The strings
+ * are not checked to be valid UTF-8.
+ */
+
+/* Maximum nesting of JSON arrays and objects. */
+#define JSON_MAX_DEPTH 64
+
+void
+gcu_json_reader_init (GcuJsonReader *reader,
+                      const gchar   *contents,
+                      gsize          length)
+{
+  reader->pos = contents;
+  reader->end = contents + length;
+}
+
+static void
+skip_whitespace (GcuJsonReader *reader)
+{
+  while (reader->pos < reader->end &&
+         (*reader->pos == ' ' ||
+          *reader->pos == '\t' ||
+          *reader->pos == '\n' ||
+          *reader->pos == '\r'))
+    reader->pos++;
+}
+
+/* Skips the whitespace and @c. */
+gboolean
+gcu_json_reader_expect (GcuJsonReader *reader,
+                        gchar          c)
+{
+  skip_whitespace (reader);
+
+  if (reader->pos >= reader->end || *reader->pos != c)
+    return FALSE;
+
+  reader->pos++;
+  return TRUE;
+}
+
+/* Returns whether the next character, after the whitespace, is @c. */
+gboolean
+gcu_json_reader_peek (GcuJsonReader *reader,
+                      gchar          c)
+{
+  skip_whitespace (reader);
+  return reader->pos < reader->end && *reader->pos == c;
+}
+
+static gboolean
+read_hex4 (GcuJsonReader *reader,
+           gunichar      *ch)
+{
+  gint i;
+
+  if (reader->end - reader->pos < 4)
+    return FALSE;
+
+  *ch = 0;
+  for (i = 0; i < 4; i++)
+    {
+      gint value = g_ascii_xdigit_value (reader->pos[i]);
+
+      if (value == -1)
+        return FALSE;
+
+      *ch = (*ch << 4) | value;
+    }
+
+  reader->pos += 4;
+  return TRUE;
+}
+
+/* Returns: (transfer full) (nullable): the string, or %NULL if invalid. */
+gchar *
+gcu_json_reader_read_string (GcuJsonReader *reader)
+{
+  GString *string;
+
+  if (!gcu_json_reader_expect (reader, '"'))
+    return NULL;
+
+  string = g_string_new (NULL);
+
+  while (reader->pos < reader->end)
+    {
+      gchar c = *reader->pos++;
+      gunichar ch;
+
+      if (c == '"')
+        return g_string_free (string, FALSE);
+
+      if (c != '\\')
+        {
+          g_string_append_c (string, c);
+          continue;
+        }
+
+      if (reader->pos >= reader->end)
+        break;
+
+      c = *reader->pos++;
+
+      switch (c)
+        {
+          case '"':
+          case '\\':
+          case '/':
+            g_string_append_c (string, c);
+            break;
+
+          case 'b':
+            g_string_append_c (string, '\b');
+            break;
+
+          case 'f':
+            g_string_append_c (string, '\f');
+            break;
+
+          case 'n':
+            g_string_append_c (string, '\n');
+            break;
+
+          case 'r':
+            g_string_append_c (string, '\r');
+            break;
+
+          case 't':
+            g_string_append_c (string, '\t');
+            break;
+
+          case 'u':
+            if (!read_hex4 (reader, &ch))
+              goto error;
+
+            /* UTF-16 surrogate pair. */
+            if (ch >= 0xD800 && ch <= 0xDBFF)
+              {
+                gunichar low;
+
+                if (reader->end - reader->pos < 2 ||
+                    reader->pos[0] != '\\' ||
+                    reader->pos[1] != 'u')
+                  goto error;
+
+                reader->pos += 2;
+
+                if (!read_hex4 (reader, &low) ||
+                    low < 0xDC00 || low > 0xDFFF)
+                  goto error;
+
+                ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+              }
+
+            g_string_append_unichar (string, ch);
+            break;
+
+          default:
+            goto error;
+        }
+    }
+
+error:
+  g_string_free (string, TRUE);
+  return NULL;
+}
+
+static gboolean
+skip_value_at_depth (GcuJsonReader *reader,
+                     guint          depth)
+{
+  gchar *string;
+
+  if (depth > JSON_MAX_DEPTH)
+    return FALSE;
+
+  if (gcu_json_reader_peek (reader, '"'))
+    {
+      string = gcu_json_reader_read_string (reader);
+      g_free (string);
+      return string != NULL;
+    }
+
+  if (gcu_json_reader_expect (reader, '['))
+    {
+      if (gcu_json_reader_expect (reader, ']'))
+        return TRUE;
+
+      do
+        {
+          if (!skip_value_at_depth (reader, depth + 1))
+            return FALSE;
+        }
+      while (gcu_json_reader_expect (reader, ','));
+
+      return gcu_json_reader_expect (reader, ']');
+    }
+
+  if (gcu_json_reader_expect (reader, '{'))
+    {
+      if (gcu_json_reader_expect (reader, '}'))
+        return TRUE;
+
+      do
+        {
+          string = gcu_json_reader_read_string (reader);
+          if (string == NULL)
+            return FALSE;
+
+          g_free (string);
+
+          if (!gcu_json_reader_expect (reader, ':') ||
+              !skip_value_at_depth (reader, depth + 1))
+            return FALSE;
+        }
+      while (gcu_json_reader_expect (reader, ','));
+
+      return gcu_json_reader_expect (reader, '}');
+    }
+
+  /* Number, true, false or null. */
+  if (reader->pos >= reader->end ||
+      !(g_ascii_isalnum (*reader->pos) || *reader->pos == '-'))
+    return FALSE;
+
+  while (reader->pos < reader->end &&
+         (g_ascii_isalnum (*reader->pos) ||
+          *reader->pos == '-' ||
+          *reader->pos == '+' ||
+          *reader->pos == '.'))
+    reader->pos++;
+
+  return TRUE;
+}
+
+/* Skips a value of any type. */
+gboolean
+gcu_json_reader_skip_value (GcuJsonReader *reader)
+{
+  return skip_value_at_depth (reader, 1);
+}
+
+/* Reads an integer. */
+gboolean
+gcu_json_reader_read_int64 (GcuJsonReader *reader,
+                            gint64        *value)
+{
+  gchar *str;
+  gchar *end;
+  const gchar *start;
+  gboolean ok;
+
+  skip_whitespace (reader);
+  start = reader->pos;
+
+  while (reader->pos < reader->end &&
+         (g_ascii_isdigit (*reader->pos) || *reader->pos == '-'))
+    reader->pos++;
+
+  if (reader->pos == start)
+    return FALSE;
+
+  str = g_strndup (start, reader->pos - start);
+  errno = 0;
+  *value = g_ascii_strtoll (str, &end, 10);
+  ok = *end == '\0' && end != str && errno == 0;
+  g_free (str);
+
+  return ok;
+}
+
+/* Reads a number, with a fraction or an exponent or not. */
+gboolean
+gcu_json_reader_read_double (GcuJsonReader *reader,
+                             gdouble       *value)
+{
+  gchar *str;
+  gchar *end;
+  const gchar *start;
+  gboolean ok;
+
+  skip_whitespace (reader);
+  start = reader->pos;
+
+  while (reader->pos < reader->end &&
+         (g_ascii_isdigit (*reader->pos) || memchr ("+-.eE", *reader->pos, 5) != NULL))
+    reader->pos++;
+
+  if (reader->pos == start)
+    return FALSE;
+
+  str = g_strndup (start, reader->pos - start);
+  errno = 0;
+  *value = g_ascii_strtod (str, &end);
+  ok = *end == '\0' && end != str && errno == 0;
+  g_free (str);
+
+  return ok;
+}
+
+/* Returns whether there is only whitespace after the current position. */
+gboolean
+gcu_json_reader_at_end (GcuJsonReader *reader)
+{
+  skip_whitespace (reader);
+  return reader->pos == reader->end;
+}
+
+
+/* Returns: (transfer full) (nullable): the array of strings, or %NULL if
+ * invalid.
+ */
+gchar **
+gcu_json_reader_read_string_array (GcuJsonReader *reader)
+{
+  GPtrArray *array;
+
+  if (!gcu_json_reader_expect (reader, '['))
+    return NULL;
+
+  array = g_ptr_array_new ();
+
+  if (!gcu_json_reader_expect (reader, ']'))
+    {
+      do
+        {
+          gchar *string = gcu_json_reader_read_string (reader);
+
+          if (string == NULL)
+            goto error;
+
+          g_ptr_array_add (array, string);
+        }
+      while (gcu_json_reader_expect (reader, ','));
+
+      if (!gcu_json_reader_expect (reader, ']'))
+        goto error;
+    }
+
+  g_ptr_array_add (array, NULL);
+  return (gchar **) g_ptr_array_free (array, FALSE);
+
+error:
+  g_ptr_array_add (array, NULL);
+  g_strfreev ((gchar **) g_ptr_array_free (array, FALSE));
+  return NULL;
+}
+
+/* Appends @str to @string as a JSON string, with the quotes. */
+void
+gcu_json_append_string (GString     *string,
+                        const gchar *str)
+{
+  const gchar *p;
+
+  g_string_append_c (string, '"');
+
+  for (p = str; *p != '\0'; p++)
+    {
+      switch (*p)
+        {
+        case '"':
+          g_string_append (string, "\\\"");
+          break;
+
+        case '\\':
+          g_string_append (string, "\\\\");
+          break;
+
+        case '\n':
+          g_string_append (string, "\\n");
+          break;
+
+        case '\t':
+          g_string_append (string, "\\t");
+          break;
+
+        default:
+          if ((guchar) *p < 0x20)
+            g_string_append_printf (string, "\\u%04x", (guchar) *p);
+          else
+            g_string_append_c (string, *p);
+          break;
+        }
+    }
+
+  g_string_append_c (string, '"');
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_JSON_H
+#define GCU_JSON_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GcuJsonReader GcuJsonReader;
+
+struct _GcuJsonReader
+{
+  const gchar *pos;
+  const gchar *end;
+};
+
+void		gcu_json_reader_init			(GcuJsonReader	*reader,
+							 const gchar	*contents,
+							 gsize		 length);
+
+gboolean	gcu_json_reader_expect			(GcuJsonReader	*reader,
+							 gchar		 c);
+
+gboolean	gcu_json_reader_peek			(GcuJsonReader	*reader,
+							 gchar		 c);
+
+gchar *		gcu_json_reader_read_string		(GcuJsonReader	*reader);
+
+gchar **	gcu_json_reader_read_string_array	(GcuJsonReader	*reader);
+
+gboolean	gcu_json_reader_read_int64		(GcuJsonReader	*reader,
+							 gint64		*value);
+
+gboolean	gcu_json_reader_read_double		(GcuJsonReader	*reader,
+							 gdouble	*value);
+
+gboolean	gcu_json_reader_skip_value		(GcuJsonReader	*reader);
+
+gboolean	gcu_json_reader_at_end			(GcuJsonReader	*reader);
+
+void		gcu_json_append_string			(GString	*string,
+							 const gchar	*str);
+
+G_END_DECLS
+
+#endif /* GCU_JSON_H */
@@ -0,0 +1,1058 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-lex.h"
+#include <string.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+
+/*
+ * A small C lexer, shared by the tools that need to know whether a position is
+ * in a comment, a string, a preprocessor directive or a function definition.
+ * Before, each tool found it by itself: with the GtkSourceView highlighting of
+ * the whole buffer for gcu-smart-c-comment-substitution, and with nothing for
+ * gcu-check-chain-ups and gcu-include-config-h, so a commented-out chain-up or
+ * #include was taken into account.
+ *
+ * The contents are lexed in one pass into sorted lists of spans, one list per
+ * GcuLexSpanKind, and a position is looked up with a binary search. The #if 0
+ * blocks are comments, like in the GtkSourceView c.lang: they end at the #else,
+ * #elif or #endif at the same level of nesting, and what they contain is not
+ * lexed.
+ *
+ * A function definition is a '{' at the top level that follows a ')', its span
+ * starts at the name before the first '(' of the declarator. The braces are
+ * counted outside the comments, strings and directives only, so a function
+ * whose braces are unbalanced in #ifdef branches is not found correctly. The
+ * parenthesis structure is not kept: nested spans don't fit in the sorted
+ * lists.
+ *
+ * The big files are often the same from one run to the next (generated code,
+ * several tools run on a tree), so for the files of at least MIN_CACHED_LENGTH
+ * bytes, the spans are saved in $XDG_CACHE_HOME/gnome-c-utils/lex/, in a file
+ * named after a hash of the contents. A next run maps the file instead of
+ * lexing the contents again. The hash is hash_contents() and not a GChecksum:
+ * SHA-256 is about as slow as the lexing, which would make the cache useless.
+ * The files are in the byte order of the host and contain CACHE_VERSION, to be
+ * changed when the lexing changes. The cache is only an optimization: when it
+ * can't be read or written, the contents are lexed as if it didn't exist. It is
+ * disabled with GCU_LEX_CACHE=0, for example for the fuzzers, which would fill
+ * it with their inputs.
+ *
+ * A cache file is checked before its spans are used, since a wrong offset would
+ * make the tools read outside their buffer. The mtime of a cache file is
+ * updated when it is used, and at most once per PRUNE_INTERVAL, after writing a
+ * cache file, the least recently used ones are deleted until the directory is
+ * smaller than MAX_CACHE_SIZE.
+ */
+
+/* Around 4K, the cost of the cache file (open, stat, mmap, utime) is the same
+ * as the lexing.
+ */
+#define MIN_CACHED_LENGTH (4 * 1024)
+
+#define MAX_CACHE_SIZE (64 * 1024 * 1024)
+#define PRUNE_INTERVAL (60 * 60)
+#define PRUNE_STAMP_NAME "prune-stamp"
+
+#define CACHE_MAGIC "GCU-LEX"
+#define CACHE_VERSION 2
+
+typedef struct
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 n_spans[GCU_LEX_N_SPAN_KINDS];
+
+  /* The number of characters of the contents. */
+  guint32 n_chars;
+
+  guint64 length;
+
+  /* Followed by the spans, for each kind. */
+} CacheHeader;
+
+struct _GcuLex
+{
+  /* Either the spans are in a mapped cache file, or in the arrays. */
+  GMappedFile *cache_file;
+  GArray *arrays[GCU_LEX_N_SPAN_KINDS];
+
+  const GcuLexSpan *spans[GCU_LEX_N_SPAN_KINDS];
+  guint n_spans[GCU_LEX_N_SPAN_KINDS];
+  guint32 n_chars;
+};
+
+typedef struct
+{
+  const gchar *pos;
+  const gchar *end;
+
+  /* In characters, for @pos. */
+  guint32 offset;
+
+  /* Whether there are only spaces between the start of the line and @pos. */
+  guint line_start : 1;
+
+  /* Whether the last token at the top level is a ')' that closes the
+   * outermost parenthesis.
+   */
+  guint after_paren : 1;
+
+  /* Whether the braces at @brace_depth > 0 are a function body. */
+  guint in_function : 1;
+
+  guint brace_depth;
+  guint paren_depth;
+
+  /* At the top level, the start of the last identifier outside parentheses,
+   * and the start of the identifier before the last outermost '('. -1 if
+   * there is none.
+   */
+  gint64 identifier_start;
+  gint64 function_start;
+
+  GArray *spans[GCU_LEX_N_SPAN_KINDS];
+} Lexer;
+
+static gchar
+peek (Lexer *lexer,
+      guint  n)
+{
+  return lexer->pos + n < lexer->end ? lexer->pos[n] : '\0';
+}
+
+/* Skips one byte, @offset is incremented at the first byte of each UTF-8
+ * character.
+ */
+static void
+skip (Lexer *lexer)
+{
+  if ((*lexer->pos & 0xC0) != 0x80)
+    lexer->offset++;
+
+  lexer->pos++;
+}
+
+static void
+skip_n (Lexer *lexer,
+        guint  n)
+{
+  guint i;
+
+  for (i = 0; i < n && lexer->pos < lexer->end; i++)
+    skip (lexer);
+}
+
+/* Returns the length of a backslash-newline at @pos, or 0. */
+static guint
+get_line_continuation_length (Lexer *lexer)
+{
+  if (peek (lexer, 0) != '\\')
+    return 0;
+
+  if (peek (lexer, 1) == '\n')
+    return 2;
+
+  if (peek (lexer, 1) == '\r' && peek (lexer, 2) == '\n')
+    return 3;
+
+  return 0;
+}
+
+static void
+add_span (Lexer          *lexer,
+          GcuLexSpanKind  kind,
+          guint32         start)
+{
+  GcuLexSpan span;
+
+  span.start = start;
+  span.end = lexer->offset;
+  g_array_append_val (lexer->spans[kind], span);
+}
+
+static void
+lex_block_comment (Lexer *lexer)
+{
+  guint32 start = lexer->offset;
+
+  skip_n (lexer, 2);
+
+  while (lexer->pos < lexer->end)
+    {
+      if (lexer->pos[0] == '*' && peek (lexer, 1) == '/')
+        {
+          skip_n (lexer, 2);
+          break;
+        }
+
+      skip (lexer);
+    }
+
+  add_span (lexer, GCU_LEX_SPAN_COMMENT, start);
+}
+
+static void
+lex_line_comment (Lexer *lexer)
+{
+  guint32 start = lexer->offset;
+
+  skip_n (lexer, 2);
+
+  while (lexer->pos < lexer->end && lexer->pos[0] != '\n')
+    {
+      guint continuation_length = get_line_continuation_length (lexer);
+
+      skip_n (lexer, MAX (continuation_length, 1));
+    }
+
+  add_span (lexer, GCU_LEX_SPAN_COMMENT, start);
+}
+
+/* A string or character literal. An unterminated one ends at the end of the
+ * line.
+ */
+static void
+lex_string (Lexer *lexer)
+{
+  guint32 start = lexer->offset;
+  gchar quote = lexer->pos[0];
+
+  skip (lexer);
+
+  while (lexer->pos < lexer->end)
+    {
+      gchar c = lexer->pos[0];
+
+      if (c == '\\')
+        {
+          guint continuation_length = get_line_continuation_length (lexer);
+
+          /* The backslash and the escaped character. */
+          skip_n (lexer, MAX (continuation_length, 2));
+          continue;
+        }
+
+      if (c == quote)
+        {
+          skip (lexer);
+          break;
+        }
+
+      if (c == '\n')
+        break;
+
+      skip (lexer);
+    }
+
+  add_span (lexer, GCU_LEX_SPAN_STRING, start);
+}
+
+static void
+skip_blanks (Lexer *lexer)
+{
+  while (lexer->pos < lexer->end &&
+         (lexer->pos[0] == ' ' || lexer->pos[0] == '\t'))
+    skip (lexer);
+}
+
+/* Reads the name of a directive, after the '#'. Returns its length, at most
+ * @max_length.
+ */
+static gsize
+read_directive_name (Lexer *lexer,
+                     gchar *name,
+                     gsize  max_length)
+{
+  gsize length = 0;
+
+  skip_blanks (lexer);
+
+  while (lexer->pos < lexer->end &&
+         (g_ascii_isalnum (lexer->pos[0]) || lexer->pos[0] == '_'))
+    {
+      if (length < max_length)
+        name[length++] = lexer->pos[0];
+
+      skip (lexer);
+    }
+
+  return length;
+}
+
+static gboolean
+directive_name_equal (const gchar *name,
+                      gsize        length,
+                      const gchar *str)
+{
+  return length == strlen (str) && memcmp (name, str, length) == 0;
+}
+
+static gboolean
+directive_name_has_prefix (const gchar *name,
+                           gsize        length,
+                           const gchar *prefix)
+{
+  gsize prefix_length = strlen (prefix);
+
+  return length >= prefix_length && memcmp (name, prefix, prefix_length) == 0;
+}
+
+/* After "#if", for "#if 0". */
+static gboolean
+is_zero_condition (Lexer *lexer)
+{
+  if (lexer->pos >= lexer->end ||
+      (lexer->pos[0] != ' ' && lexer->pos[0] != '\t'))
+    return FALSE;
+
+  skip_blanks (lexer);
+
+  if (peek (lexer, 0) != '0')
+    return FALSE;
+
+  skip (lexer);
+
+  return !(g_ascii_isalnum (peek (lexer, 0)) || peek (lexer, 0) == '_');
+}
+
+/* Called at the end of the "#if 0" line, so that the comment doesn't overlap
+ * a comment on that line. The comment ends before the directive that ends the
+ * block, which is then lexed as a normal directive.
+ */
+static void
+lex_if0_block (Lexer   *lexer,
+               guint32  start)
+{
+  guint nesting = 0;
+
+  while (lexer->pos < lexer->end)
+    {
+      const gchar *hash_pos;
+      guint32 hash_offset;
+      gchar name[8];
+      gsize length;
+
+      while (lexer->pos < lexer->end && lexer->pos[0] != '\n')
+        skip (lexer);
+
+      skip_n (lexer, 1);
+      skip_blanks (lexer);
+
+      if (peek (lexer, 0) != '#')
+        continue;
+
+      hash_pos = lexer->pos;
+      hash_offset = lexer->offset;
+      skip (lexer);
+      length = read_directive_name (lexer, name, sizeof (name));
+
+      if (directive_name_has_prefix (name, length, "if"))
+        {
+          nesting++;
+        }
+      else if (nesting > 0)
+        {
+          if (directive_name_equal (name, length, "endif"))
+            nesting--;
+        }
+      else if (directive_name_equal (name, length, "endif") ||
+               directive_name_equal (name, length, "else") ||
+               directive_name_has_prefix (name, length, "elif"))
+        {
+          lexer->pos = hash_pos;
+          lexer->offset = hash_offset;
+          lexer->line_start = TRUE;
+          break;
+        }
+    }
+
+  add_span (lexer, GCU_LEX_SPAN_COMMENT, start);
+}
+
+/* A directive, until the end of its logical line. The comments and strings that
+ * it contains are lexed too.
+ */
+static void
+lex_directive (Lexer *lexer)
+{
+  guint32 start = lexer->offset;
+  gchar name[8];
+  gsize length;
+  gboolean if0;
+
+  skip (lexer);
+  length = read_directive_name (lexer, name, sizeof (name));
+  if0 = directive_name_equal (name, length, "if") && is_zero_condition (lexer);
+
+  while (lexer->pos < lexer->end && lexer->pos[0] != '\n')
+    {
+      gchar c = lexer->pos[0];
+      gchar next = peek (lexer, 1);
+      guint continuation_length;
+
+      if (c == '/' && next == '*')
+        {
+          lex_block_comment (lexer);
+          continue;
+        }
+
+      if (c == '/' && next == '/')
+        {
+          lex_line_comment (lexer);
+          continue;
+        }
+
+      /* Not for the <> of an #include, where there can't be quotes. */
+      if (c == '"' || c == '\'')
+        {
+          lex_string (lexer);
+          continue;
+        }
+
+      continuation_length = get_line_continuation_length (lexer);
+      skip_n (lexer, MAX (continuation_length, 1));
+    }
+
+  add_span (lexer, GCU_LEX_SPAN_DIRECTIVE, start);
+
+  if (if0)
+    lex_if0_block (lexer, lexer->offset);
+}
+
+static gboolean
+is_identifier_char (gchar c)
+{
+  /* The bytes of the non-ASCII UTF-8 characters too, for the identifiers
+   * with \u escapes or extended characters.
+   */
+  return g_ascii_isalnum (c) || c == '_' || (c & 0x80) != 0;
+}
+
+/* Outside the function bodies: the identifiers, parentheses and braces, to
+ * find the function definitions.
+ */
+static void
+lex_top_level_token (Lexer *lexer)
+{
+  gchar c = lexer->pos[0];
+
+  if (is_identifier_char (c))
+    {
+      guint32 start = lexer->offset;
+
+      /* A number is skipped like an identifier, it's not a function name. */
+      if (lexer->paren_depth == 0 && !g_ascii_isdigit (c))
+        lexer->identifier_start = start;
+
+      while (lexer->pos < lexer->end && is_identifier_char (lexer->pos[0]))
+        skip (lexer);
+
+      lexer->after_paren = FALSE;
+      return;
+    }
+
+  switch (c)
+    {
+    case '(':
+      if (lexer->paren_depth == 0)
+        lexer->function_start = lexer->identifier_start;
+      lexer->paren_depth++;
+      lexer->after_paren = FALSE;
+      break;
+
+    case ')':
+      if (lexer->paren_depth > 0)
+        lexer->paren_depth--;
+      lexer->after_paren = lexer->paren_depth == 0;
+      break;
+
+    case '{':
+      lexer->in_function = lexer->after_paren && lexer->function_start >= 0;
+      lexer->brace_depth = 1;
+      lexer->paren_depth = 0;
+      lexer->after_paren = FALSE;
+      break;
+
+    case ';':
+      if (lexer->paren_depth == 0)
+        {
+          lexer->identifier_start = -1;
+          lexer->function_start = -1;
+        }
+      lexer->after_paren = FALSE;
+      break;
+
+    default:
+      lexer->after_paren = FALSE;
+      break;
+    }
+
+  skip (lexer);
+}
+
+/* In a function body, or the braces of a struct or an initializer. */
+static void
+lex_braces_token (Lexer *lexer)
+{
+  gchar c = lexer->pos[0];
+
+  skip (lexer);
+
+  if (c == '{')
+    {
+      lexer->brace_depth++;
+      return;
+    }
+
+  if (c != '}')
+    return;
+
+  lexer->brace_depth--;
+  if (lexer->brace_depth > 0)
+    return;
+
+  if (lexer->in_function)
+    add_span (lexer, GCU_LEX_SPAN_FUNCTION, lexer->function_start);
+
+  lexer->in_function = FALSE;
+  lexer->identifier_start = -1;
+  lexer->function_start = -1;
+}
+
+static void
+lex_contents (GcuLex      *lex,
+              const gchar *contents,
+              gsize        length)
+{
+  Lexer lexer;
+  gint kind;
+
+  lexer.pos = contents;
+  lexer.end = contents + length;
+  lexer.offset = 0;
+  lexer.line_start = TRUE;
+  lexer.after_paren = FALSE;
+  lexer.in_function = FALSE;
+  lexer.brace_depth = 0;
+  lexer.paren_depth = 0;
+  lexer.identifier_start = -1;
+  lexer.function_start = -1;
+
+  for (kind = 0; kind < GCU_LEX_N_SPAN_KINDS; kind++)
+    lexer.spans[kind] = g_array_new (FALSE, FALSE, sizeof (GcuLexSpan));
+
+  while (lexer.pos < lexer.end)
+    {
+      gchar c = lexer.pos[0];
+      gchar next;
+
+      if (c == '\n')
+        {
+          lexer.line_start = TRUE;
+          skip (&lexer);
+          continue;
+        }
+
+      if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v')
+        {
+          skip (&lexer);
+          continue;
+        }
+
+      if (c == '#' && lexer.line_start)
+        {
+          lexer.line_start = FALSE;
+          lex_directive (&lexer);
+          continue;
+        }
+
+      lexer.line_start = FALSE;
+      next = peek (&lexer, 1);
+
+      if (c == '/' && next == '*')
+        lex_block_comment (&lexer);
+      else if (c == '/' && next == '/')
+        lex_line_comment (&lexer);
+      else if (c == '"' || c == '\'')
+        {
+          lex_string (&lexer);
+          lexer.after_paren = FALSE;
+        }
+      else if (lexer.brace_depth > 0)
+        lex_braces_token (&lexer);
+      else
+        lex_top_level_token (&lexer);
+    }
+
+  for (kind = 0; kind < GCU_LEX_N_SPAN_KINDS; kind++)
+    {
+      lex->arrays[kind] = lexer.spans[kind];
+      lex->spans[kind] = (const GcuLexSpan *) lexer.spans[kind]->data;
+      lex->n_spans[kind] = lexer.spans[kind]->len;
+    }
+
+  lex->n_chars = lexer.offset;
+}
+
+/* Returns %NULL if the cache is disabled or its directory can't be created. */
+static const gchar *
+get_cache_dir (void)
+{
+  static const gchar *cache_dir = NULL;
+
+  if (g_once_init_enter (&cache_dir))
+    {
+      gchar *dir;
+
+      dir = g_build_filename (g_get_user_cache_dir (), "gnome-c-utils", "lex", NULL);
+
+      if (g_strcmp0 (g_getenv ("GCU_LEX_CACHE"), "0") == 0 ||
+          g_mkdir_with_parents (dir, 0700) != 0)
+        {
+          g_free (dir);
+          dir = g_strdup ("");
+        }
+
+      g_once_init_leave (&cache_dir, dir);
+    }
+
+  return cache_dir[0] != '\0' ? cache_dir : NULL;
+}
+
+static guint64
+mix (guint64 hash,
+     guint64 word,
+     guint64 multiplier)
+{
+  hash ^= word * multiplier;
+  hash = (hash << 31) | (hash >> 33);
+  return hash * 0x9E3779B97F4A7C15;
+}
+
+/* A 128-bit hash, in two independent lanes of 64 bits, fast because it reads
+ * 8 bytes at a time. It is not cryptographic: someone who can write in the
+ * cache directory can anyway write wrong spans there.
+ */
+static void
+hash_contents (const gchar *contents,
+               gsize        length,
+               guint64      hash[2])
+{
+  const gchar *pos = contents;
+  const gchar *end = contents + length;
+  guint64 word;
+
+  hash[0] = length ^ 0x243F6A8885A308D3;
+  hash[1] = length ^ 0x13198A2E03707344;
+
+  for (; pos + 8 <= end; pos += 8)
+    {
+      memcpy (&word, pos, 8);
+      hash[0] = mix (hash[0], word, 0x87C37B91114253D5);
+      hash[1] = mix (hash[1], word, 0x4CF5AD432745937F);
+    }
+
+  word = 0;
+  memcpy (&word, pos, end - pos);
+  hash[0] = mix (hash[0], word, 0x87C37B91114253D5);
+  hash[1] = mix (hash[1], word, 0x4CF5AD432745937F);
+
+  hash[0] ^= hash[0] >> 32;
+  hash[1] ^= hash[1] >> 32;
+}
+
+static gchar *
+get_cache_path (const gchar *contents,
+                gsize        length)
+{
+  const gchar *cache_dir;
+  guint64 hash[2];
+  gchar *basename;
+  gchar *path;
+
+  cache_dir = get_cache_dir ();
+  if (cache_dir == NULL)
+    return NULL;
+
+  hash_contents (contents, length, hash);
+  basename = g_strdup_printf ("%016" G_GINT64_MODIFIER "x%016" G_GINT64_MODIFIER "x",
+                              hash[0], hash[1]);
+  path = g_build_filename (cache_dir, basename, NULL);
+  g_free (basename);
+
+  return path;
+}
+
+/* Whether the spans are sorted, don't overlap and are within the @n_chars
+ * characters of the contents.
+ */
+static gboolean
+check_spans (const GcuLexSpan *spans,
+             guint             n_spans,
+             guint32           n_chars)
+{
+  guint32 previous_end = 0;
+  guint i;
+
+  for (i = 0; i < n_spans; i++)
+    {
+      if (spans[i].start < previous_end ||
+          spans[i].start > spans[i].end ||
+          spans[i].end > n_chars)
+        return FALSE;
+
+      previous_end = spans[i].end;
+    }
+
+  return TRUE;
+}
+
+/* Returns %NULL if the cache file doesn't exist or is not valid. */
+static GcuLex *
+load_cache_file (const gchar *path,
+                 gsize        length)
+{
+  GMappedFile *cache_file;
+  const CacheHeader *header;
+  const GcuLexSpan *spans;
+  gsize size;
+  guint64 total_n_spans = 0;
+  GcuLex *lex;
+  gint kind;
+
+  cache_file = g_mapped_file_new (path, FALSE, NULL);
+  if (cache_file == NULL)
+    return NULL;
+
+  header = (const CacheHeader *) g_mapped_file_get_contents (cache_file);
+  size = g_mapped_file_get_length (cache_file);
+
+  if (size < sizeof (CacheHeader) ||
+      memcmp (header->magic, CACHE_MAGIC, sizeof (header->magic)) != 0 ||
+      header->version != CACHE_VERSION ||
+      header->length != length ||
+      header->n_chars > length)
+    goto invalid;
+
+  for (kind = 0; kind < GCU_LEX_N_SPAN_KINDS; kind++)
+    total_n_spans += header->n_spans[kind];
+
+  if (size != sizeof (CacheHeader) + total_n_spans * sizeof (GcuLexSpan))
+    goto invalid;
+
+  spans = (const GcuLexSpan *) (header + 1);
+  for (kind = 0; kind < GCU_LEX_N_SPAN_KINDS; kind++)
+    {
+      if (!check_spans (spans, header->n_spans[kind], header->n_chars))
+        goto invalid;
+
+      spans += header->n_spans[kind];
+    }
+
+  lex = g_new0 (GcuLex, 1);
+  lex->cache_file = cache_file;
+  lex->n_chars = header->n_chars;
+
+  spans = (const GcuLexSpan *) (header + 1);
+  for (kind = 0; kind < GCU_LEX_N_SPAN_KINDS; kind++)
+    {
+      lex->spans[kind] = spans;
+      lex->n_spans[kind] = header->n_spans[kind];
+      spans += header->n_spans[kind];
+    }
+
+  /* For prune_cache_dir(), the mtime is the time of the last use. */
+  g_utime (path, NULL);
+
+  return lex;
+
+invalid:
+  g_mapped_file_unref (cache_file);
+  return NULL;
+}
+
+/* Errors are ignored, the next run will lex the contents again. */
+static void
+save_cache_file (const gchar  *path,
+                 const GcuLex *lex,
+                 gsize         length)
+{
+  CacheHeader header;
+  GByteArray *bytes;
+  gint kind;
+
+  memset (&header, 0, sizeof (CacheHeader));
+  memcpy (header.magic, CACHE_MAGIC, sizeof (header.magic));
+  header.version = CACHE_VERSION;
+  header.n_chars = lex->n_chars;
+  header.length = length;
+
+  for (kind = 0; kind < GCU_LEX_N_SPAN_KINDS; kind++)
+    header.n_spans[kind] = lex->n_spans[kind];
+
+  bytes = g_byte_array_new ();
+  g_byte_array_append (bytes, (const guint8 *) &header, sizeof (CacheHeader));
+
+  for (kind = 0; kind < GCU_LEX_N_SPAN_KINDS; kind++)
+    g_byte_array_append (bytes,
+                         (const guint8 *) lex->spans[kind],
+                         lex->n_spans[kind] * sizeof (GcuLexSpan));
+
+  g_file_set_contents (path, (const gchar *) bytes->data, bytes->len, NULL);
+  g_byte_array_unref (bytes);
+}
+
+typedef struct
+{
+  gchar *path;
+  gint64 mtime;
+  gint64 size;
+} CacheEntry;
+
+static void
+cache_entry_free (gpointer data)
+{
+  CacheEntry *entry = data;
+
+  g_free (entry->path);
+  g_free (entry);
+}
+
+static gint
+compare_cache_entries (gconstpointer a,
+                       gconstpointer b)
+{
+  const CacheEntry *entry_a = *(const CacheEntry **) a;
+  const CacheEntry *entry_b = *(const CacheEntry **) b;
+
+  if (entry_a->mtime != entry_b->mtime)
+    return entry_a->mtime < entry_b->mtime ? -1 : 1;
+
+  return 0;
+}
+
+/* Whether the last pruning is older than PRUNE_INTERVAL. The stamp is touched
+ * before pruning, so that the other processes don't prune at the same time.
+ */
+static gboolean
+should_prune_cache_dir (const gchar *cache_dir)
+{
+  gchar *stamp_path;
+  GStatBuf stat_buf;
+  gboolean prune = TRUE;
+
+  stamp_path = g_build_filename (cache_dir, PRUNE_STAMP_NAME, NULL);
+
+  if (g_stat (stamp_path, &stat_buf) == 0)
+    {
+      gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+
+      prune = now - stat_buf.st_mtime >= PRUNE_INTERVAL;
+
+      if (prune)
+        g_utime (stamp_path, NULL);
+    }
+  else
+    {
+      g_file_set_contents (stamp_path, "", 0, NULL);
+    }
+
+  g_free (stamp_path);
+  return prune;
+}
+
+/* Deletes the least recently used cache files until the directory is smaller
+ * than MAX_CACHE_SIZE. Errors are ignored, the files are deleted at the next
+ * pruning.
+ */
+static void
+prune_cache_dir (void)
+{
+  const gchar *cache_dir;
+  GDir *dir;
+  const gchar *name;
+  GPtrArray *entries;
+  gint64 total_size = 0;
+  guint i;
+
+  cache_dir = get_cache_dir ();
+  if (cache_dir == NULL || !should_prune_cache_dir (cache_dir))
+    return;
+
+  dir = g_dir_open (cache_dir, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  entries = g_ptr_array_new_with_free_func (cache_entry_free);
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      CacheEntry *entry;
+      GStatBuf stat_buf;
+      gchar *path;
+
+      if (strcmp (name, PRUNE_STAMP_NAME) == 0)
+        continue;
+
+      path = g_build_filename (cache_dir, name, NULL);
+
+      if (g_stat (path, &stat_buf) != 0 || !S_ISREG (stat_buf.st_mode))
+        {
+          g_free (path);
+          continue;
+        }
+
+      entry = g_new (CacheEntry, 1);
+      entry->path = path;
+      entry->mtime = stat_buf.st_mtime;
+      entry->size = stat_buf.st_size;
+      g_ptr_array_add (entries, entry);
+
+      total_size += entry->size;
+    }
+
+  g_dir_close (dir);
+
+  g_ptr_array_sort (entries, compare_cache_entries);
+
+  for (i = 0; i < entries->len && total_size > MAX_CACHE_SIZE; i++)
+    {
+      CacheEntry *entry = g_ptr_array_index (entries, i);
+
+      if (g_unlink (entry->path) == 0)
+        total_size -= entry->size;
+    }
+
+  g_ptr_array_unref (entries);
+}
+
+/* @length can be -1 if @contents is nul-terminated. The offsets of the spans
+ * are 32-bit, so @contents must have less than 4G characters.
+ */
+GcuLex *
+gcu_lex_new (const gchar *contents,
+             gssize       length)
+{
+  gchar *cache_path = NULL;
+  GcuLex *lex;
+
+  g_return_val_if_fail (contents != NULL || length == 0, NULL);
+
+  if (length < 0)
+    length = strlen (contents);
+
+  if (length >= MIN_CACHED_LENGTH)
+    {
+      cache_path = get_cache_path (contents, length);
+
+      if (cache_path != NULL)
+        {
+          lex = load_cache_file (cache_path, length);
+
+          if (lex != NULL)
+            {
+              g_free (cache_path);
+              return lex;
+            }
+        }
+    }
+
+  lex = g_new0 (GcuLex, 1);
+  lex_contents (lex, contents, length);
+
+  if (cache_path != NULL)
+    {
+      save_cache_file (cache_path, lex, length);
+      prune_cache_dir ();
+      g_free (cache_path);
+    }
+
+  return lex;
+}
+
+void
+gcu_lex_free (GcuLex *lex)
+{
+  gint kind;
+
+  if (lex == NULL)
+    return;
+
+  if (lex->cache_file != NULL)
+    g_mapped_file_unref (lex->cache_file);
+
+  for (kind = 0; kind < GCU_LEX_N_SPAN_KINDS; kind++)
+    {
+      if (lex->arrays[kind] != NULL)
+        g_array_unref (lex->arrays[kind]);
+    }
+
+  g_free (lex);
+}
+
+/* Returns the spans of @kind, sorted by offset, which don't overlap. */
+const GcuLexSpan *
+gcu_lex_get_spans (const GcuLex   *lex,
+                   GcuLexSpanKind  kind,
+                   guint          *n_spans)
+{
+  g_return_val_if_fail (lex != NULL, NULL);
+  g_return_val_if_fail (kind < GCU_LEX_N_SPAN_KINDS, NULL);
+
+  if (n_spans != NULL)
+    *n_spans = lex->n_spans[kind];
+
+  return lex->spans[kind];
+}
+
+/* Returns the span of @kind that contains the character at @offset, or %NULL.
+ */
+const GcuLexSpan *
+gcu_lex_find_span (const GcuLex   *lex,
+                   GcuLexSpanKind  kind,
+                   guint           offset)
+{
+  const GcuLexSpan *spans;
+  guint low = 0;
+  guint high;
+
+  g_return_val_if_fail (lex != NULL, NULL);
+  g_return_val_if_fail (kind < GCU_LEX_N_SPAN_KINDS, NULL);
+
+  spans = lex->spans[kind];
+  high = lex->n_spans[kind];
+
+  /* The first span that ends after @offset. */
+  while (low < high)
+    {
+      guint middle = low + (high - low) / 2;
+
+      if (spans[middle].end <= offset)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  if (low < lex->n_spans[kind] && spans[low].start <= offset)
+    return &spans[low];
+
+  return NULL;
+}
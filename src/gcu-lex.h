@@ -0,0 +1,67 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef GCU_LEX_H
+#define GCU_LEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  /* The comments, and the #if 0 blocks. */
+  GCU_LEX_SPAN_COMMENT,
+
+  /* The string and character literals. */
+  GCU_LEX_SPAN_STRING,
+
+  /* The preprocessor directives, with their continuation lines. */
+  GCU_LEX_SPAN_DIRECTIVE,
+
+  /* The function definitions, from the function name to the closing brace. */
+  GCU_LEX_SPAN_FUNCTION,
+
+  GCU_LEX_N_SPAN_KINDS
+} GcuLexSpanKind;
+
+/* In characters, like the offsets of a GtkTextIter. @end is excluded. */
+typedef struct
+{
+  guint32 start;
+  guint32 end;
+} GcuLexSpan;
+
+typedef struct _GcuLex GcuLex;
+
+GcuLex *		gcu_lex_new		(const gchar     *contents,
+						 gssize           length);
+
+void			gcu_lex_free		(GcuLex          *lex);
+
+const GcuLexSpan *	gcu_lex_get_spans	(const GcuLex    *lex,
+						 GcuLexSpanKind   kind,
+						 guint           *n_spans);
+
+const GcuLexSpan *	gcu_lex_find_span	(const GcuLex    *lex,
+						 GcuLexSpanKind   kind,
+						 guint            offset);
+
+G_END_DECLS
+
+#endif /* GCU_LEX_H */
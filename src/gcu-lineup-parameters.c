@@ -20,14 +20,82 @@
 /*
  * Line up parameters of function declarations.
  *
- * Usage: gcu-lineup-parameters [--tabs|-t] [file]
+ * Usage: gcu-lineup-parameters [--tabs|-t] [--durable [--journal=FILE]] [file...]
  * If no files are given, stdin is read and the result is printed to stdout.
  * If 'file' is given, its content is directly modified (WARNING: no backup is
- * made first!).
+ * made first!). If several files are given, they are processed in parallel.
  *
  * By default gcu-lineup-parameters aligns parameters on the parenthesis with
  * spaces only. With the --tabs option, tabs+spaces will be inserted.
  *
+ * With the --durable option, the files are written with a group commit (see
+ * gcu-group-commit.c): the new contents are written to temporary files, made
+ * durable with one sync for a batch of DURABLE_BATCH_SIZE files, and then
+ * renamed. Only the files that change are rewritten. With --journal, the
+ * committed files are recorded in FILE, and are skipped by the next run with
+ * the same journal, to resume an interrupted run.
+ *
+ * Instead of the file arguments, --compile-commands=FILE takes the *.c files
+ * compiled according to a compile_commands.json FILE, as generated by meson,
+ * and --include-headers adds the headers that they include from the source
+ * tree (see gcu-file-list.c). It works for --dump-signatures too.
+ *
+ * The files that exceed the size or line length limits of the GCU_BUDGET
+ * environment variable are skipped, with a warning (see gcu-budget.c). With
+ * stdin, the input is then printed unchanged.
+ *
+ * With --shard=I/N, only the part I of N of the files is processed, to split a
+ * run between N processes or CI runners (see gcu-shard.c). With --results=FILE,
+ * the status of each file is written to FILE in JSON, and the results files of
+ * the shards can be combined with gcu-merge-results. Those two options work
+ * with all the modes that take several files, except --watch.
+ *
+ * With --trace=FILE, a timeline of the run is written to FILE, to see how the
+ * worker threads are used (see gcu-trace.c). Each file has a "file" slice,
+ * with "load", "parse" and "save" slices inside.
+ *
+ * With --metrics=FILE, the progress of the run is written to FILE in the
+ * Prometheus text format, and updated every few seconds (see gcu-metrics.c).
+ * The matches are the function declarations, and the edits are the files with
+ * the "changed" status. Like --trace, it works with all the modes that take
+ * several files, except --watch.
+ *
+ * With --profile=FILE, the CPU usage of the run is sampled, and written to FILE
+ * as folded stacks for a flame graph (see gcu-profile.c), without needing perf.
+ * The samples are attributed to the thread, and to the phase and the file
+ * being processed, with the same phases as for --trace. It works with all the
+ * modes, except --watch.
+ *
+ * With --max-memory=SIZE, the files are processed in parallel only as long as
+ * the memory estimated for them, from their sizes, stays below SIZE (with the
+ * K, M or G suffixes). The big files are started first, and the small files
+ * fill the remaining memory (see gcu-scheduler.c). A file bigger than the
+ * limit is processed alone. With --git-rev, the sizes of the blobs are not
+ * known in advance, so each file counts for the "bytes" of GCU_BUDGET.
+ *
+ * Usage: gcu-lineup-parameters [--tabs|-t] --git-rev=REV [--git-dir=DIR] [path...]
+ * Does not modify any file. Reads the *.c and *.h files of the git revision REV
+ * directly from the object store of the repository DIR (by default GIT_DIR or
+ * the current directory), so it works on a bare repository without a checkout
+ * (see gcu-git.c). The files are processed in parallel, and the changes are
+ * printed on stdout as a unified diff against REV, that "git apply" accepts.
+ * The exit status is 1 if some files would be changed. The paths restrict the
+ * files to those directories or files of the revision.
+ *
+ * Usage: gcu-lineup-parameters [--tabs|-t] --watch=DIR
+ * Watches DIR recursively, and lines up the parameters of each *.c or *.h file
+ * when it is saved, for example by a text editor. Only the files that change
+ * are rewritten, and the events caused by those writes are ignored. Runs until
+ * interrupted.
+ *
+ * Usage: gcu-lineup-parameters --dump-signatures [file or directory...]
+ * Does not modify the files. Prints on stdout, as JSON Lines, the function
+ * declarations recognized by the restrictions below, one per line:
+ * {"name":"frobnitz","file":"frobnitz.c","line":42,"parameters":[{"type":"Frobnitz","stars":1,"name":"frobnitz"},...]}
+ * The directories are scanned recursively for *.c and *.h files (hidden files
+ * are skipped), and the files are read in parallel. If no paths are given, the
+ * current directory is scanned.
+ *
  * The restrictions:
  * - The function name must be at column 0, followed by a space and an opening
  *   parenthesis;
@@ -91,12 +159,35 @@
 /* TODO support "..." vararg parameter. */
 
 #include <gio/gio.h>
-#include <gio/gunixinputstream.h>
 #include <gio/gunixoutputstream.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <locale.h>
 #include <unistd.h>
+#include "gcu-arena.h"
+#include "gcu-budget.h"
+#include "gcu-diff.h"
+#include "gcu-file-list.h"
+#include "gcu-filter.h"
+#include "gcu-git.h"
+#include "gcu-group-commit.h"
+#include "gcu-json.h"
+#include "gcu-metrics.h"
+#include "gcu-profile.h"
+#include "gcu-results.h"
+#include "gcu-scheduler.h"
+#include "gcu-shard.h"
+#include "gcu-trace.h"
+#include "gcu-watch.h"
+
+#define DURABLE_BATCH_SIZE 1024
+/* A bigger I/O buffer is freed after its file, so that a thread doesn't keep
+ * the memory of a huge file until the end of the run.
+ */
+#define MAX_RECYCLED_BUFFER_SIZE (16 * 1024 * 1024)
 
 typedef struct
 {
@@ -105,27 +196,84 @@ typedef struct
   gchar *name;
 } ParameterInfo;
 
+/* The I/O buffers of a thread, recycled from one file to the next, to avoid
+ * a big allocation per file (for a big file, a mmap() and a munmap()).
+ */
+typedef struct
+{
+  /* A plain allocation, a GByteArray is limited to 4G. */
+  gchar *input_data;
+  gsize input_size;
+
+  /* The buffer of the last GMemoryOutputStream. */
+  gpointer output_data;
+  gsize output_size;
+} IOBuffers;
+
 static gboolean _tabs;
+static gboolean _dump_signatures;
+static gboolean _durable;
+static gchar *_journal_path;
+static gchar *_watch_directory;
+static gchar *_compile_commands_path;
+static gboolean _include_headers;
+static gchar *_trace_path;
+static gchar *_metrics_path;
+static gchar *_profile_path;
+static gchar *_max_memory_spec;
+static gsize _max_memory;
+static gchar *_git_rev;
+static gchar *_git_dir;
+static gchar *_shard_spec;
+static gchar *_results_path;
+static GcuShard _shard;
+static GcuResults *_results;
+static GcuBudget _budget;
 
 static GOptionEntry option_entries[] =
 {
   { "tabs", 't', 0, G_OPTION_ARG_NONE, &_tabs,
     "Use tabs to align parameters on the parenthesis.", NULL },
+  { "dump-signatures", 0, 0, G_OPTION_ARG_NONE, &_dump_signatures,
+    "Print the function signatures as JSON Lines, without modifying the files.", NULL },
+  { "durable", 0, 0, G_OPTION_ARG_NONE, &_durable,
+    "Make the writes durable, with one sync for a group of files.", NULL },
+  { "journal", 0, 0, G_OPTION_ARG_FILENAME, &_journal_path,
+    "With --durable, record the committed files in FILE to resume an interrupted run.", "FILE" },
+  { "watch", 0, 0, G_OPTION_ARG_FILENAME, &_watch_directory,
+    "Watch DIR and line up the parameters of the files when they are saved.", "DIR" },
+  { "compile-commands", 0, 0, G_OPTION_ARG_FILENAME, &_compile_commands_path,
+    "Process the files compiled according to FILE, instead of the file arguments.", "FILE" },
+  { "include-headers", 0, 0, G_OPTION_ARG_NONE, &_include_headers,
+    "With --compile-commands, also process the headers included from the source tree.", NULL },
+  { "trace", 0, 0, G_OPTION_ARG_FILENAME, &_trace_path,
+    "Write a timeline of the run to FILE, in the Chrome trace-event format.", "FILE" },
+  { "metrics", 0, 0, G_OPTION_ARG_FILENAME, &_metrics_path,
+    "Write the progress of the run to FILE, in the Prometheus text format.", "FILE" },
+  { "profile", 0, 0, G_OPTION_ARG_FILENAME, &_profile_path,
+    "Sample the CPU usage of the run, and write it to FILE as folded stacks.", "FILE" },
+  { "max-memory", 0, 0, G_OPTION_ARG_STRING, &_max_memory_spec,
+    "Limit the parallelism to the files that fit in SIZE of memory (e.g. 4G).", "SIZE" },
+  { "git-rev", 0, 0, G_OPTION_ARG_STRING, &_git_rev,
+    "Print as a diff the changes for the files of the git revision REV, without a checkout.", "REV" },
+  { "git-dir", 0, 0, G_OPTION_ARG_FILENAME, &_git_dir,
+    "With --git-rev, the git repository (default: GIT_DIR or the current directory).", "DIR" },
+  { "shard", 0, 0, G_OPTION_ARG_STRING, &_shard_spec,
+    "Process only the part I of N of the files, to split a run between N processes.", "I/N" },
+  { "results", 0, 0, G_OPTION_ARG_FILENAME, &_results_path,
+    "Write the status of each file to FILE, in JSON, for gcu-merge-results.", "FILE" },
   { NULL }
 };
 
 static void
 print_usage (char **argv)
 {
-  g_printerr ("Usage: %s [--tabs|-t] [file]\n", argv[0]);
-}
-
-static void
-parameter_info_free (ParameterInfo *param_info)
-{
-  g_free (param_info->type);
-  g_free (param_info->name);
-  g_slice_free (ParameterInfo, param_info);
+  g_printerr ("Usage: %s [--tabs|-t] [--durable [--journal=FILE]] [file...]\n", argv[0]);
+  g_printerr ("       %s [--tabs|-t] [--durable [--journal=FILE]] --compile-commands=FILE [--include-headers]\n", argv[0]);
+  g_printerr ("       %s [--tabs|-t] --git-rev=REV [--git-dir=DIR] [path...]\n", argv[0]);
+  g_printerr ("       %s [--tabs|-t] --watch=DIR\n", argv[0]);
+  g_printerr ("       %s --dump-signatures [file or directory...]\n", argv[0]);
+  g_printerr ("The modes with several files accept [--shard=I/N] [--results=FILE] [--metrics=FILE] [--profile=FILE] [--max-memory=SIZE].\n");
 }
 
 static void
@@ -144,6 +292,39 @@ write_to_output_stream (GOutputStream *output_stream,
   g_assert_no_error (error);
 }
 
+/* Returns a string of @n_chars times @c, in the arena. */
+static gchar *
+arena_strnfill (GcuArena *arena,
+                gsize     n_chars,
+                gchar     c)
+{
+  gchar *str;
+
+  str = gcu_arena_alloc (arena, n_chars + 1);
+  memset (str, c, n_chars);
+  str[n_chars] = '\0';
+
+  return str;
+}
+
+/* Returns the named sub-pattern @name of @match_info, in the arena. */
+static gchar *
+arena_fetch_named (GcuArena         *arena,
+                   const GMatchInfo *match_info,
+                   const gchar      *name)
+{
+  gint start_pos;
+  gint end_pos;
+
+  if (!g_match_info_fetch_named_pos (match_info, name, &start_pos, &end_pos))
+    g_assert_not_reached ();
+
+  return gcu_arena_strndup (arena,
+                            g_match_info_get_string (match_info) + start_pos,
+                            end_pos - start_pos);
+}
+
+/* @function_name is allocated in the arena of the thread. */
 static gboolean
 match_function_name (const gchar  *line,
                      gchar       **function_name,
@@ -154,8 +335,9 @@ match_function_name (const gchar  *line,
   gint end_pos;
   gboolean match = FALSE;
 
-  if (G_UNLIKELY (regex == NULL))
-    regex = g_regex_new ("^(\\w+) ?\\(", G_REGEX_OPTIMIZE, 0, NULL);
+  /* Thread-safe initialization, for --dump-signatures. */
+  if (g_once_init_enter (&regex))
+    g_once_init_leave (&regex, g_regex_new ("^(\\w+) ?\\(", G_REGEX_OPTIMIZE, 0, NULL));
 
   g_regex_match (regex, line, 0, &match_info);
 
@@ -166,13 +348,14 @@ match_function_name (const gchar  *line,
       match = TRUE;
 
       if (function_name != NULL)
-        *function_name = g_strndup (line, end_pos);
+        *function_name = gcu_arena_strndup (gcu_arena_get_for_thread (), line, end_pos);
     }
 
   g_match_info_free (match_info);
   return match;
 }
 
+/* @info is allocated in the arena of the thread. */
 static gboolean
 match_parameter (gchar          *line,
                  ParameterInfo **info,
@@ -182,11 +365,17 @@ match_parameter (gchar          *line,
   GMatchInfo *match_info;
   gint start_pos = 0;
 
-  if (G_UNLIKELY (regex == NULL))
-    regex = g_regex_new ("^\\s*(?<type>(const\\s+)?\\w+)\\s+(?<stars>\\**)\\s*(?<name>\\w+)\\s*(?<end>,|\\))\\s*$",
-                         G_REGEX_OPTIMIZE,
-                         0,
-                         NULL);
+  /* The quantifiers are possessive (e.g. "\s++"), since backtracking into
+   * them can't give another match. Otherwise, for a line like "a   ...   !",
+   * all the ways to split the spaces between "\s+" and "\s*" are tried,
+   * which is quadratic in the length of the line.
+   */
+  if (g_once_init_enter (&regex))
+    g_once_init_leave (&regex,
+                       g_regex_new ("^\\s*+(?<type>(const\\s++)?\\w++)\\s++(?<stars>\\**+)\\s*+(?<name>\\w++)\\s*+(?<end>,|\\))\\s*+$",
+                                    G_REGEX_OPTIMIZE,
+                                    0,
+                                    NULL));
 
   if (is_last_parameter != NULL)
     *is_last_parameter = FALSE;
@@ -203,25 +392,25 @@ match_parameter (gchar          *line,
 
   if (info != NULL)
     {
-      gchar *stars;
+      GcuArena *arena = gcu_arena_get_for_thread ();
+      gint stars_start;
+      gint stars_end;
 
-      *info = g_slice_new0 (ParameterInfo);
+      *info = gcu_arena_alloc (arena, sizeof (ParameterInfo));
 
-      (*info)->type = g_match_info_fetch_named (match_info, "type");
-      (*info)->name = g_match_info_fetch_named (match_info, "name");
-      g_assert ((*info)->type != NULL);
-      g_assert ((*info)->name != NULL);
+      (*info)->type = arena_fetch_named (arena, match_info, "type");
+      (*info)->name = arena_fetch_named (arena, match_info, "name");
 
-      stars = g_match_info_fetch_named (match_info, "stars");
-      (*info)->nb_stars = strlen (stars);
-      g_free (stars);
+      g_match_info_fetch_named_pos (match_info, "stars", &stars_start, &stars_end);
+      (*info)->nb_stars = stars_end - stars_start;
     }
 
   if (is_last_parameter != NULL)
     {
-      gchar *end = g_match_info_fetch_named (match_info, "end");
-      *is_last_parameter = g_str_equal (end, ")");
-      g_free (end);
+      gint end_start;
+
+      g_match_info_fetch_named_pos (match_info, "end", &end_start, NULL);
+      *is_last_parameter = line[start_pos + end_start] == ')';
     }
 
   g_match_info_free (match_info);
@@ -233,81 +422,45 @@ match_opening_curly_brace (const gchar *line)
 {
   static GRegex *regex = NULL;
 
-  if (G_UNLIKELY (regex == NULL))
-    regex = g_regex_new ("^{\\s*$", G_REGEX_OPTIMIZE, 0, NULL);
+  if (g_once_init_enter (&regex))
+    g_once_init_leave (&regex, g_regex_new ("^{\\s*$", G_REGEX_OPTIMIZE, 0, NULL));
 
   return g_regex_match (regex, line, 0, NULL);
 }
 
-/* Returns the number of lines that take the function declaration.
- * Returns 0 if not a function declaration. */
-static guint
-get_function_declaration_length (gchar **lines)
+/* Returns the @length parameter infos, in the arena of the thread. */
+static ParameterInfo **
+get_parameter_infos (gchar **lines,
+                     guint   length)
 {
-  guint nb_lines = 1;
-  gchar **cur_line = lines;
-
-  while (*cur_line != NULL)
-    {
-      gboolean match_param;
-      gboolean is_last_param;
-
-      match_param = match_parameter (*cur_line, NULL, &is_last_param);
-
-      if (is_last_param)
-        {
-          gchar *next_line = *(cur_line + 1);
-
-          if (next_line == NULL ||
-              !match_opening_curly_brace (next_line))
-            return 0;
-
-          return nb_lines;
-        }
-
-      if (!match_param)
-        return 0;
-
-      nb_lines++;
-      cur_line++;
-    }
+  ParameterInfo **infos;
+  guint i;
 
-  /* Should not be reachable - but silences a compiler warning. */
-  return 0;
-}
-
-static GSList *
-get_list_parameter_infos (gchar **lines,
-                          guint   length)
-{
-  GSList *list = NULL;
-  gint i;
+  infos = gcu_arena_alloc (gcu_arena_get_for_thread (), length * sizeof (ParameterInfo *));
 
-  for (i = length - 1; i >= 0; i--)
+  for (i = 0; i < length; i++)
     {
-      ParameterInfo *info = NULL;
-
-      match_parameter (lines[i], &info, NULL);
-      g_assert (info != NULL);
-
-      list = g_slist_prepend (list, info);
+      infos[i] = NULL;
+      match_parameter (lines[i], &infos[i], NULL);
+      g_assert (infos[i] != NULL);
     }
 
-  return list;
+  return infos;
 }
 
 static void
-compute_spacing (GSList *parameter_infos,
-                 guint  *max_type_length,
-                 guint  *max_stars_length)
+compute_spacing (ParameterInfo **parameter_infos,
+                 guint           n_parameters,
+                 guint          *max_type_length,
+                 guint          *max_stars_length)
 {
-  GSList *l;
+  guint i;
   *max_type_length = 0;
   *max_stars_length = 0;
 
-  for (l = parameter_infos; l != NULL; l = l->next)
+  for (i = 0; i < n_parameters; i++)
     {
-      ParameterInfo *info = l->data;
+      ParameterInfo *info = parameter_infos[i];
       guint type_length = strlen (info->type);
 
       if (type_length > *max_type_length)
@@ -324,10 +477,9 @@ print_parameter (GOutputStream *output_stream,
                  guint          max_type_length,
                  guint          max_stars_length)
 {
+  GcuArena *arena = gcu_arena_get_for_thread ();
   gint type_length;
   gint nb_spaces;
-  gchar *spaces;
-  gchar *stars;
 
   write_to_output_stream (output_stream, info->type);
 
@@ -335,20 +487,14 @@ print_parameter (GOutputStream *output_stream,
   nb_spaces = max_type_length - type_length;
   g_assert (nb_spaces >= 0);
 
-  spaces = g_strnfill (nb_spaces, ' ');
-  write_to_output_stream (output_stream, spaces);
+  write_to_output_stream (output_stream, arena_strnfill (arena, nb_spaces, ' '));
   write_to_output_stream (output_stream, " ");
-  g_free (spaces);
 
   nb_spaces = max_stars_length - info->nb_stars;
   g_assert (nb_spaces >= 0);
-  spaces = g_strnfill (nb_spaces, ' ');
-  write_to_output_stream (output_stream, spaces);
-  g_free (spaces);
+  write_to_output_stream (output_stream, arena_strnfill (arena, nb_spaces, ' '));
 
-  stars = g_strnfill (info->nb_stars, '*');
-  write_to_output_stream (output_stream, stars);
-  g_free (stars);
+  write_to_output_stream (output_stream, arena_strnfill (arena, info->nb_stars, '*'));
 
   write_to_output_stream (output_stream, info->name);
 }
@@ -358,14 +504,15 @@ print_function_declaration (GOutputStream  *output_stream,
                             gchar         **lines,
                             guint           length)
 {
+  GcuArena *arena = gcu_arena_get_for_thread ();
   gchar **cur_line = lines;
   gchar *function_name;
   gint nb_spaces_to_parenthesis;
-  GSList *parameter_infos;
-  GSList *l;
+  ParameterInfo **parameter_infos;
   guint max_type_length;
   guint max_stars_length;
   gchar *spaces;
+  guint i;
 
   if (!match_function_name (*cur_line, &function_name, NULL))
     g_error ("The line doesn't match a function name.");
@@ -377,142 +524,418 @@ print_function_declaration (GOutputStream  *output_stream,
 
   if (_tabs)
     {
-      gchar *tabs = g_strnfill (nb_spaces_to_parenthesis / 8, '\t');
-      gchar *spaces_after_tabs = g_strnfill (nb_spaces_to_parenthesis % 8, ' ');
-
-      spaces = g_strdup_printf ("%s%s", tabs, spaces_after_tabs);
+      guint nb_tabs = nb_spaces_to_parenthesis / 8;
 
-      g_free (tabs);
-      g_free (spaces_after_tabs);
+      spaces = arena_strnfill (arena, nb_tabs + nb_spaces_to_parenthesis % 8, ' ');
+      memset (spaces, '\t', nb_tabs);
     }
   else
     {
-      spaces = g_strnfill (nb_spaces_to_parenthesis, ' ');
+      spaces = arena_strnfill (arena, nb_spaces_to_parenthesis, ' ');
     }
 
-  parameter_infos = get_list_parameter_infos (lines, length);
-  compute_spacing (parameter_infos, &max_type_length, &max_stars_length);
+  parameter_infos = get_parameter_infos (lines, length);
+  compute_spacing (parameter_infos, length, &max_type_length, &max_stars_length);
 
-  for (l = parameter_infos; l != NULL; l = l->next)
+  for (i = 0; i < length; i++)
     {
-      ParameterInfo *info = l->data;
-
-      if (l != parameter_infos)
+      if (i > 0)
         write_to_output_stream (output_stream, spaces);
 
-      print_parameter (output_stream, info, max_type_length, max_stars_length);
+      print_parameter (output_stream, parameter_infos[i], max_type_length, max_stars_length);
 
-      if (l->next != NULL)
+      if (i + 1 < length)
         write_to_output_stream (output_stream, ",\n");
     }
 
   write_to_output_stream (output_stream, ")\n");
-
-  g_free (function_name);
-  g_free (spaces);
-  g_slist_free_full (parameter_infos, (GDestroyNotify)parameter_info_free);
 }
 
 static void
-parse_contents (const gchar   *input_str,
-                GOutputStream *output_stream)
+write_range_to_output_stream (GOutputStream *output_stream,
+                              const gchar   *start,
+                              const gchar   *end)
+{
+  gsize bytes_written;
+  GError *error = NULL;
+
+  if (start >= end)
+    return;
+
+  g_output_stream_write_all (output_stream,
+                             start,
+                             end - start,
+                             &bytes_written,
+                             NULL,
+                             &error);
+  g_assert_no_error (error);
+}
+
+/* Returns a copy of the line starting at @line_start, without the \n, in the
+ * arena of the thread.
+ */
+static gchar *
+get_line_at (const gchar *line_start)
+{
+  const gchar *line_end;
+
+  line_end = strchr (line_start, '\n');
+  if (line_end == NULL)
+    line_end = line_start + strlen (line_start);
+
+  return gcu_arena_strndup (gcu_arena_get_for_thread (), line_start, line_end - line_start);
+}
+
+/* @anchor points to the \n that ends the line just before a "{" line. Walks
+ * backwards from @anchor, without going before @limit, to find the start of a
+ * function declaration.
+ *
+ * Returns the lines of the function declaration, followed by the "{" line, in
+ * a NULL-terminated array, in the arena of the thread, and the number of lines
+ * of the declaration in @length. Returns NULL if the "{" is not preceded by a
+ * function declaration. The lines are matched only once, here.
+ */
+static gchar **
+get_function_declaration_before_anchor (const gchar  *anchor,
+                                        const gchar  *limit,
+                                        const gchar **declaration_start,
+                                        guint        *length)
 {
-  gchar **lines;
-  gchar **cur_line;
+  GcuArena *arena = gcu_arena_get_for_thread ();
+  gchar **reversed_lines;
+  guint n_reversed_lines = 0;
+  guint reversed_lines_size = 16;
+  const gchar *line_end = anchor;
+  guint nb_declaration_lines = 0;
+  gchar **lines = NULL;
+  guint i;
 
-  lines = g_strsplit (input_str, "\n", 0);
+  reversed_lines = gcu_arena_alloc (arena, reversed_lines_size * sizeof (gchar *));
 
-  /* Skip the empty last line, to avoid adding an extra \n. */
-  for (cur_line = lines; cur_line[0] != NULL && cur_line[1] != NULL; cur_line++)
+  while (TRUE)
     {
-      guint length;
+      const gchar *line_start = line_end;
+      gchar *line;
+      gboolean is_last_param;
+
+      while (line_start > limit && line_start[-1] != '\n')
+        line_start--;
+
+      line = gcu_arena_strndup (arena, line_start, line_end - line_start);
+
+      /* Only the line just before the "{" can end with ")". */
+      if (!match_parameter (line, NULL, &is_last_param) ||
+          is_last_param != (n_reversed_lines == 0))
+        break;
 
-      if (!match_function_name (*cur_line, NULL, NULL))
+      /* The old array is left in the arena. */
+      if (n_reversed_lines == reversed_lines_size)
         {
-          write_to_output_stream (output_stream, *cur_line);
-          write_to_output_stream (output_stream, "\n");
-          continue;
+          gchar **old_lines = reversed_lines;
+
+          reversed_lines_size *= 2;
+          reversed_lines = gcu_arena_alloc (arena, reversed_lines_size * sizeof (gchar *));
+          memcpy (reversed_lines, old_lines, n_reversed_lines * sizeof (gchar *));
         }
 
-      length = get_function_declaration_length (cur_line);
+      reversed_lines[n_reversed_lines++] = line;
 
-      if (length == 0)
+      /* Keep the topmost function name, like a forward scan would do. */
+      if (match_function_name (line, NULL, NULL))
         {
-          write_to_output_stream (output_stream, *cur_line);
-          write_to_output_stream (output_stream, "\n");
-          continue;
+          nb_declaration_lines = n_reversed_lines;
+          *declaration_start = line_start;
         }
 
-      print_function_declaration (output_stream, cur_line, length);
+      if (line_start <= limit)
+        break;
+
+      line_end = line_start - 1;
+    }
+
+  if (nb_declaration_lines > 0)
+    {
+      lines = gcu_arena_alloc (arena, (nb_declaration_lines + 2) * sizeof (gchar *));
+
+      for (i = 0; i < nb_declaration_lines; i++)
+        lines[i] = reversed_lines[nb_declaration_lines - 1 - i];
 
-      cur_line += length - 1;
+      lines[nb_declaration_lines] = get_line_at (anchor + 1);
+      lines[nb_declaration_lines + 1] = NULL;
     }
 
-  g_strfreev (lines);
+  *length = nb_declaration_lines;
+  return lines;
 }
 
-static gchar *
-get_file_contents (GFile *file)
+typedef void (* FunctionDeclarationFunc) (gchar       **lines,
+                                          guint         length,
+                                          const gchar  *declaration_start,
+                                          const gchar  *brace_line,
+                                          gpointer      user_data);
+
+/* Since the opening curly brace of a function must be at column 0, only the
+ * regions ending with a "\n{" can be function declarations. So the "\n{"
+ * anchors are first searched with strstr(), which is much faster than matching
+ * the regexes on every line.
+ *
+ * The data allocated in the arena of the thread for an anchor, including the
+ * lines passed to @func, is freed before the next anchor (see gcu-arena.c).
+ */
+static void
+foreach_function_declaration (const gchar             *input_str,
+                              FunctionDeclarationFunc  func,
+                              gpointer                 user_data)
 {
-  gchar *path;
-  gchar *contents;
-  GError *error = NULL;
+  GcuArena *arena = gcu_arena_get_for_thread ();
+  const gchar *limit = input_str;
+  const gchar *anchor;
 
-  path = g_file_get_path (file);
-  g_file_get_contents (path, &contents, NULL, &error);
+  for (anchor = strstr (input_str, "\n{");
+       anchor != NULL;
+       anchor = strstr (anchor + 1, "\n{"))
+    {
+      const gchar *brace_line = anchor + 1;
+      const gchar *declaration_start = NULL;
+      gchar **lines;
+      guint length;
 
-  if (error != NULL)
-    g_error ("Impossible to get file contents: %s", error->message);
+      gcu_arena_reset (arena);
 
-  g_free (path);
-  return contents;
+      if (!match_opening_curly_brace (get_line_at (brace_line)))
+        continue;
+
+      lines = get_function_declaration_before_anchor (anchor,
+                                                      limit,
+                                                      &declaration_start,
+                                                      &length);
+      if (lines == NULL)
+        continue;
+
+      func (lines, length, declaration_start, brace_line, user_data);
+      limit = brace_line;
+    }
+
+  gcu_arena_reset (arena);
+}
+
+typedef struct
+{
+  GOutputStream *output_stream;
+  const gchar *copied_until;
+} ParseData;
+
+static void
+parse_function_declaration (gchar       **lines,
+                            guint         length,
+                            const gchar  *declaration_start,
+                            const gchar  *brace_line,
+                            gpointer      user_data)
+{
+  ParseData *data = user_data;
+
+  gcu_metrics_add_matches (1);
+
+  /* The text between the function declarations is copied as-is. */
+  write_range_to_output_stream (data->output_stream,
+                                data->copied_until,
+                                declaration_start);
+
+  print_function_declaration (data->output_stream, lines, length);
+  data->copied_until = brace_line;
+}
+
+static void
+parse_contents (const gchar   *input_str,
+                GOutputStream *output_stream)
+{
+  ParseData data;
+  const gchar *contents_end;
+
+  /* Skip the last line after the last \n, like g_strsplit() + printing each
+   * line followed by \n would do.
+   */
+  contents_end = strrchr (input_str, '\n');
+  if (contents_end == NULL)
+    return;
+  contents_end++;
+
+  data.output_stream = output_stream;
+  data.copied_until = input_str;
+
+  foreach_function_declaration (input_str, parse_function_declaration, &data);
+
+  write_range_to_output_stream (output_stream, data.copied_until, contents_end);
+}
+
+typedef struct
+{
+  const gchar *filename;
+  const gchar *lines_counted_until;
+  guint line_num;
+  GString *output;
+} DumpData;
+
+static void
+dump_function_declaration (gchar       **lines,
+                           guint         length,
+                           const gchar  *declaration_start,
+                           const gchar  *brace_line,
+                           gpointer      user_data)
+{
+  DumpData *data = user_data;
+  const gchar *p;
+  gchar *function_name;
+  ParameterInfo **parameter_infos;
+  guint i;
+
+  /* The declarations come in order, so the lines are counted only once. */
+  for (p = data->lines_counted_until; p < declaration_start; p++)
+    {
+      if (*p == '\n')
+        data->line_num++;
+    }
+  data->lines_counted_until = declaration_start;
+
+  if (!match_function_name (lines[0], &function_name, NULL))
+    g_error ("The line doesn't match a function name.");
+
+  g_string_append (data->output, "{\"name\":");
+  gcu_json_append_string (data->output, function_name);
+  g_string_append (data->output, ",\"file\":");
+  gcu_json_append_string (data->output, data->filename);
+  g_string_append_printf (data->output, ",\"line\":%u,\"parameters\":[", data->line_num);
+
+  parameter_infos = get_parameter_infos (lines, length);
+
+  for (i = 0; i < length; i++)
+    {
+      ParameterInfo *info = parameter_infos[i];
+
+      if (i > 0)
+        g_string_append_c (data->output, ',');
+
+      g_string_append (data->output, "{\"type\":");
+      gcu_json_append_string (data->output, info->type);
+      g_string_append_printf (data->output, ",\"stars\":%u,\"name\":", info->nb_stars);
+      gcu_json_append_string (data->output, info->name);
+      g_string_append_c (data->output, '}');
+    }
+
+  g_string_append (data->output, "]}\n");
 }
 
+/* Returns the function signatures of @input_str, as JSON Lines. */
 static gchar *
-get_stdin_contents (void)
+dump_contents (const gchar *filename,
+               const gchar *input_str)
 {
-  GInputStream *stream;
-  GString *string;
-  GError *error = NULL;
+  DumpData data;
 
-  stream = g_unix_input_stream_new (STDIN_FILENO, FALSE);
-  string = g_string_new ("");
+  data.filename = filename;
+  data.lines_counted_until = input_str;
+  data.line_num = 1;
+  data.output = g_string_new (NULL);
 
-  while (TRUE)
+  foreach_function_declaration (input_str, dump_function_declaration, &data);
+
+  return g_string_free (data.output, FALSE);
+}
+
+static void
+io_buffers_free (IOBuffers *buffers)
+{
+  g_free (buffers->input_data);
+  g_free (buffers->output_data);
+  g_free (buffers);
+}
+
+static GPrivate thread_io_buffers = G_PRIVATE_INIT ((GDestroyNotify) io_buffers_free);
+
+static IOBuffers *
+get_io_buffers (void)
+{
+  IOBuffers *buffers;
+
+  buffers = g_private_get (&thread_io_buffers);
+  if (buffers == NULL)
     {
-      gchar buffer[4097] = { '\0' };
-      gssize nb_bytes_read = g_input_stream_read (stream, buffer, 4096, NULL, &error);
+      buffers = g_new0 (IOBuffers, 1);
+      g_private_set (&thread_io_buffers, buffers);
+    }
 
-      if (nb_bytes_read == 0)
-        break;
+  return buffers;
+}
 
-      if (error != NULL)
-        g_error ("Impossible to read stdin: %s", error->message);
+/* Like g_file_get_contents(), but the contents are in the input buffer of the
+ * thread, and are valid until the next call in the same thread.
+ */
+static const gchar *
+load_file (const gchar  *filename,
+           gsize        *length,
+           GError      **error)
+{
+  IOBuffers *buffers = get_io_buffers ();
+  gboolean ok;
+  gint fd;
+
+  fd = g_open (filename, O_RDONLY | O_CLOEXEC, 0);
+  if (fd == -1)
+    {
+      gint saved_errno = errno;
+
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   g_file_error_from_errno (saved_errno),
+                   "Failed to open %s: %s",
+                   filename,
+                   g_strerror (saved_errno));
+      return NULL;
+    }
 
-      g_string_append (string, buffer);
+  /* The contents of the previous file are not needed anymore. */
+  if (buffers->input_size > MAX_RECYCLED_BUFFER_SIZE)
+    {
+      g_clear_pointer (&buffers->input_data, g_free);
+      buffers->input_size = 0;
     }
 
-  g_input_stream_close (stream, NULL, NULL);
-  g_object_unref (stream);
+  ok = gcu_filter_read_fd (fd, filename, &buffers->input_data, &buffers->input_size, length, error);
+  close (fd);
 
-  return g_string_free (string, FALSE);
+  return ok ? buffers->input_data : NULL;
 }
 
-static GOutputStream *
-get_file_output_stream (GFile *file)
+static const gchar *
+get_file_contents (GFile *file)
 {
-  GFileOutputStream *output_stream;
+  gchar *path;
+  const gchar *contents;
+  gsize length;
   GError *error = NULL;
 
-  output_stream = g_file_replace (file,
-                                  NULL,
-                                  FALSE,
-                                  G_FILE_CREATE_NONE,
-                                  NULL,
-                                  &error);
-  g_assert_no_error (error);
+  path = g_file_get_path (file);
+  contents = load_file (path, &length, &error);
+
+  if (error != NULL)
+    g_error ("Impossible to get file contents: %s", error->message);
+
+  g_free (path);
+  return contents;
+}
+
+static gchar *
+get_stdin_contents (void)
+{
+  gchar *contents;
+  gsize length;
+  GError *error = NULL;
+
+  contents = gcu_filter_read_stdin (&length, &error);
+  if (error != NULL)
+    g_error ("Impossible to read stdin: %s", error->message);
 
-  return G_OUTPUT_STREAM (output_stream);
+  return contents;
 }
 
 static GOutputStream *
@@ -531,7 +954,11 @@ handle_stdin (void)
   input_str = get_stdin_contents ();
   output_stream = get_stdout_output_stream ();
 
-  parse_contents (input_str, output_stream);
+  /* Over budget, the input is printed unchanged. */
+  if (gcu_budget_check_contents (&_budget, "stdin", input_str, strlen (input_str)))
+    parse_contents (input_str, output_stream);
+  else
+    write_to_output_stream (output_stream, input_str);
 
   g_output_stream_close (output_stream, NULL, &error);
   g_assert_no_error (error);
@@ -540,67 +967,1085 @@ handle_stdin (void)
   g_object_unref (output_stream);
 }
 
-static void
-handle_file (GFile *file)
+/* Parses @input_str into a new closed #GMemoryOutputStream, returned in
+ * @output_stream, to free with free_output_stream(). Its buffer is the output
+ * buffer of the thread. Returns whether the contents change, so that only the
+ * files that change are rewritten.
+ */
+static gboolean
+parse_contents_to_memory (const gchar          *input_str,
+                          gsize                 input_length,
+                          GMemoryOutputStream **output_stream)
 {
-  gchar *input_str;
-  GOutputStream *output_stream;
+  IOBuffers *buffers = get_io_buffers ();
+  const gchar *output_data;
+  gsize output_length;
   GError *error = NULL;
 
-  input_str = get_file_contents (file);
-  output_stream = get_file_output_stream (file);
+  *output_stream = G_MEMORY_OUTPUT_STREAM (g_memory_output_stream_new (buffers->output_data,
+                                                                       buffers->output_size,
+                                                                       g_realloc,
+                                                                       g_free));
+  buffers->output_data = NULL;
+  buffers->output_size = 0;
 
-  parse_contents (input_str, output_stream);
+  parse_contents (input_str, G_OUTPUT_STREAM (*output_stream));
 
-  g_output_stream_close (output_stream, NULL, &error);
+  g_output_stream_close (G_OUTPUT_STREAM (*output_stream), NULL, &error);
   g_assert_no_error (error);
 
-  g_free (input_str);
-  g_object_unref (output_stream);
+  output_data = g_memory_output_stream_get_data (*output_stream);
+  output_length = g_memory_output_stream_get_data_size (*output_stream);
+
+  return !(output_length == input_length &&
+           (input_length == 0 || memcmp (output_data, input_str, input_length) == 0));
 }
 
-int
-main (int    argc,
-      char **argv)
+/* Gives back the buffer of @output_stream to the thread, for the next file,
+ * unless it is huge.
+ */
+static void
+free_output_stream (GMemoryOutputStream *output_stream)
 {
-  GOptionContext *option_context;
-  GError *error = NULL;
-  GFile *file;
-  int ret = EXIT_SUCCESS;
+  IOBuffers *buffers = get_io_buffers ();
 
-  setlocale (LC_ALL, "");
+  g_free (buffers->output_data);
+  buffers->output_data = NULL;
+  buffers->output_size = 0;
 
-  option_context = g_option_context_new ("- lineup parameters");
-  g_option_context_add_main_entries (option_context, option_entries, NULL);
-  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+  if (g_memory_output_stream_get_size (output_stream) <= MAX_RECYCLED_BUFFER_SIZE)
     {
-      g_printerr ("Option parsing failed: %s\n", error->message);
-      print_usage (argv);
-      ret = EXIT_FAILURE;
-      goto exit;
+      buffers->output_size = g_memory_output_stream_get_size (output_stream);
+      buffers->output_data = g_memory_output_stream_steal_data (output_stream);
     }
 
-  if (argc > 2)
-    {
-      g_printerr ("Too many arguments.\n");
-      print_usage (argv);
-      ret = EXIT_FAILURE;
-      goto exit;
-    }
+  g_object_unref (output_stream);
+}
+
+/* @path is the file argument, for the results. Only the files that change are
+ * rewritten.
+ */
+static void
+handle_file (GFile       *file,
+             const gchar *path)
+{
+  const gchar *input_str;
+  gsize input_length;
+  gchar *filename;
+  GMemoryOutputStream *output_stream;
+  const gchar *status;
+  gint64 metrics_begin_time;
+  gint64 file_begin_time;
+  gint64 begin_time;
+  GError *error = NULL;
+
+  file_begin_time = gcu_trace_begin ();
+  filename = g_file_get_parse_name (file);
+  metrics_begin_time = gcu_metrics_file_begin (filename);
+
+  gcu_profile_set_phase ("load", filename);
+  begin_time = gcu_trace_begin ();
+  input_str = get_file_contents (file);
+  input_length = strlen (input_str);
+  gcu_trace_end (begin_time, "load", filename, input_length);
 
-  if (argc == 1)
+  if (!gcu_budget_check_contents (&_budget, filename, input_str, input_length))
     {
-      handle_stdin ();
+      status = "skipped";
     }
   else
     {
-      file = g_file_new_for_commandline_arg (argv[1]);
-      handle_file (file);
-      g_object_unref (file);
+      gboolean changed;
+
+      gcu_profile_set_phase ("parse", filename);
+      begin_time = gcu_trace_begin ();
+      changed = parse_contents_to_memory (input_str, input_length, &output_stream);
+      gcu_trace_end (begin_time, "parse", filename, input_length);
+
+      gcu_profile_set_phase ("save", filename);
+      begin_time = gcu_trace_begin ();
+
+      if (changed)
+        {
+          g_file_replace_contents (file,
+                                   g_memory_output_stream_get_data (output_stream),
+                                   g_memory_output_stream_get_data_size (output_stream),
+                                   NULL,
+                                   FALSE,
+                                   G_FILE_CREATE_NONE,
+                                   NULL,
+                                   NULL,
+                                   &error);
+          g_assert_no_error (error);
+        }
+
+      gcu_trace_end (begin_time, "save", filename, -1);
+
+      free_output_stream (output_stream);
+      status = changed ? "changed" : "unchanged";
+    }
+
+  if (_results != NULL)
+    gcu_results_add (_results, path, status, input_length, NULL);
+
+  gcu_trace_end (file_begin_time, "file", filename, input_length);
+  gcu_metrics_file_end (metrics_begin_time, input_length, status);
+  gcu_profile_set_phase (NULL, NULL);
+
+  g_free (filename);
+}
+
+static void
+handle_file_job (gpointer data,
+                 gpointer user_data)
+{
+  const gchar *filename = data;
+  GFile *file;
+
+  file = g_file_new_for_commandline_arg (filename);
+  handle_file (file, filename);
+  g_object_unref (file);
+}
+
+/* Returns: (transfer container): the @paths of the --shard option, in the
+ * same order. @sizes are the sizes of the files, or %NULL to get them from the
+ * file system.
+ */
+static GPtrArray *
+get_shard_paths (guint           n_paths,
+                 gchar         **paths,
+                 const guint64  *sizes)
+{
+  GPtrArray *shard_paths;
+  gboolean *selected;
+  guint i;
+
+  shard_paths = g_ptr_array_new ();
+  selected = g_new (gboolean, n_paths);
+
+  gcu_shard_select (&_shard, n_paths, paths, sizes, selected);
+
+  for (i = 0; i < n_paths; i++)
+    {
+      if (selected[i])
+        g_ptr_array_add (shard_paths, paths[i]);
+    }
+
+  g_free (selected);
+  return shard_paths;
+}
+
+/* Returns: the estimated memory to process a file of @size bytes, for
+ * --max-memory.
+ */
+static guint64
+get_cost (guint64 size)
+{
+  /* A file over budget is only loaded. */
+  if (_budget.max_bytes > 0 && size > _budget.max_bytes)
+    return size;
+
+  return gcu_scheduler_estimate_cost (size);
+}
+
+static guint64
+get_file_cost (const gchar *filename)
+{
+  GStatBuf stat_buf;
+
+  /* Don't stat() the files for nothing. */
+  if (_max_memory == 0)
+    return 0;
+
+  /* The error, if any, is reported when loading the file. */
+  if (g_stat (filename, &stat_buf) != 0)
+    return get_cost (0);
+
+  return get_cost (stat_buf.st_size);
+}
+
+/* Only the header of the object is read. */
+static guint64
+get_git_file_cost (GcuGitRepository *repo,
+                   const GcuGitFile *file)
+{
+  guint64 size;
+
+  if (_max_memory == 0)
+    return 0;
+
+  /* The error, if any, is reported when reading the file. */
+  if (!gcu_git_repository_file_size (repo, file, &size, NULL))
+    return get_cost (0);
+
+  return get_cost (size);
+}
+
+static GcuScheduler *
+create_scheduler (GFunc    func,
+                  gpointer user_data)
+{
+  return gcu_scheduler_new (func, user_data, g_get_num_processors (), _max_memory);
+}
+
+/* The files are independent, so they are processed in parallel. */
+static void
+handle_files (gint    n_files,
+              gchar **filenames)
+{
+  GcuScheduler *scheduler;
+  gint i;
+
+  scheduler = create_scheduler (handle_file_job, NULL);
+
+  gcu_metrics_add_queued (n_files);
+
+  for (i = 0; i < n_files; i++)
+    gcu_scheduler_push (scheduler, filenames[i], get_file_cost (filenames[i]));
+
+  /* Waits for all the jobs to finish. */
+  gcu_scheduler_free (scheduler);
+}
+
+static void
+durable_job_run (gpointer data,
+                 gpointer user_data)
+{
+  const gchar *filename = data;
+  GcuGroupCommit *group_commit = user_data;
+  const gchar *input_str;
+  gsize input_length;
+  GMemoryOutputStream *output_stream;
+  gboolean changed;
+  gint64 metrics_begin_time;
+  gint64 file_begin_time;
+  gint64 begin_time;
+  GError *error = NULL;
+
+  file_begin_time = gcu_trace_begin ();
+  metrics_begin_time = gcu_metrics_file_begin (filename);
+
+  gcu_profile_set_phase ("load", filename);
+  begin_time = gcu_trace_begin ();
+  input_str = load_file (filename, &input_length, &error);
+  if (error != NULL)
+    g_error ("Impossible to get file contents: %s", error->message);
+  gcu_trace_end (begin_time, "load", filename, input_length);
+
+  if (!gcu_budget_check_contents (&_budget, filename, input_str, input_length))
+    {
+      gcu_group_commit_add_unchanged (group_commit, filename);
+
+      if (_results != NULL)
+        gcu_results_add (_results, filename, "skipped", input_length, NULL);
+
+      gcu_trace_end (file_begin_time, "file", filename, input_length);
+      gcu_metrics_file_end (metrics_begin_time, input_length, "skipped");
+      gcu_profile_set_phase (NULL, NULL);
+      return;
+    }
+
+  gcu_profile_set_phase ("parse", filename);
+  begin_time = gcu_trace_begin ();
+  changed = parse_contents_to_memory (input_str, input_length, &output_stream);
+  gcu_trace_end (begin_time, "parse", filename, input_length);
+
+  gcu_profile_set_phase ("save", filename);
+  begin_time = gcu_trace_begin ();
+
+  if (!changed)
+    {
+      gcu_group_commit_add_unchanged (group_commit, filename);
+    }
+  else if (!gcu_group_commit_add (group_commit,
+                                  filename,
+                                  g_memory_output_stream_get_data (output_stream),
+                                  g_memory_output_stream_get_data_size (output_stream),
+                                  &error))
+    {
+      g_error ("%s", error->message);
+    }
+
+  gcu_trace_end (begin_time, "save", filename, -1);
+  gcu_trace_end (file_begin_time, "file", filename, input_length);
+  gcu_metrics_file_end (metrics_begin_time, input_length, changed ? "changed" : "unchanged");
+
+  if (_results != NULL)
+    gcu_results_add (_results, filename, changed ? "changed" : "unchanged", input_length, NULL);
+
+  free_output_stream (output_stream);
+  gcu_profile_set_phase (NULL, NULL);
+}
+
+/* An interrupted run loses at most the current batch, the previous batches
+ * are recorded in the journal.
+ */
+static void
+handle_files_durable (gint    n_files,
+                      gchar **filenames)
+{
+  GcuGroupCommit *group_commit;
+  GError *error = NULL;
+  gint batch_start;
+  gint64 begin_time;
+
+  group_commit = gcu_group_commit_new (_journal_path, &error);
+  if (error != NULL)
+    g_error ("%s", error->message);
+
+  for (batch_start = 0; batch_start < n_files; batch_start += DURABLE_BATCH_SIZE)
+    {
+      GcuScheduler *scheduler;
+      gint i;
+
+      scheduler = create_scheduler (durable_job_run, group_commit);
+
+      for (i = batch_start; i < n_files && i < batch_start + DURABLE_BATCH_SIZE; i++)
+        {
+          if (!gcu_group_commit_is_done (group_commit, filenames[i]))
+            {
+              gcu_metrics_add_queued (1);
+              gcu_scheduler_push (scheduler, filenames[i], get_file_cost (filenames[i]));
+            }
+          else if (_results != NULL)
+            gcu_results_add (_results, filenames[i], "resumed", -1, NULL);
+        }
+
+      gcu_scheduler_free (scheduler);
+
+      gcu_profile_set_phase ("commit", NULL);
+      begin_time = gcu_trace_begin ();
+      if (!gcu_group_commit_commit (group_commit, &error))
+        g_error ("%s", error->message);
+      gcu_trace_end (begin_time, "commit", NULL, -1);
+      gcu_profile_set_phase (NULL, NULL);
+    }
+
+  gcu_group_commit_free (group_commit);
+}
+
+/* Called from the main loop, after @filename has been saved. Errors are not
+ * fatal, the file may for example have been removed in the meantime.
+ */
+static void
+watch_file_changed_cb (GcuWatch    *watch,
+                       const gchar *filename,
+                       gpointer     user_data)
+{
+  gchar *input_str;
+  gsize input_length;
+  GMemoryOutputStream *output_stream;
+  GError *error = NULL;
+
+  if (!g_file_get_contents (filename, &input_str, &input_length, &error))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("Impossible to get file contents: %s", error->message);
+
+      g_clear_error (&error);
+      return;
+    }
+
+  if (!gcu_budget_check_contents (&_budget, filename, input_str, input_length))
+    {
+      g_free (input_str);
+      return;
+    }
+
+  if (parse_contents_to_memory (input_str, input_length, &output_stream))
+    {
+      GFile *file;
+
+      file = g_file_new_for_path (filename);
+      g_file_replace_contents (file,
+                               g_memory_output_stream_get_data (output_stream),
+                               g_memory_output_stream_get_data_size (output_stream),
+                               NULL,
+                               FALSE,
+                               G_FILE_CREATE_NONE,
+                               NULL,
+                               NULL,
+                               &error);
+      g_object_unref (file);
+
+      if (error != NULL)
+        {
+          g_warning ("Error when writing %s: %s", filename, error->message);
+          g_clear_error (&error);
+        }
+      else
+        {
+          gcu_watch_file_written (watch, filename);
+          g_print ("Lined up parameters in %s\n", filename);
+        }
+    }
+
+  g_free (input_str);
+  free_output_stream (output_stream);
+}
+
+/* The GRegex's and the options are kept between the files. */
+static void
+handle_watch (const gchar *directory)
+{
+  GcuWatch *watch;
+  GMainLoop *main_loop;
+  GError *error = NULL;
+
+  watch = gcu_watch_new (directory, watch_file_changed_cb, NULL, &error);
+  if (error != NULL)
+    g_error ("%s", error->message);
+
+  g_print ("Watching %s\n", directory);
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+  g_main_loop_run (main_loop);
+
+  g_main_loop_unref (main_loop);
+  gcu_watch_free (watch);
+}
+
+typedef struct
+{
+  gchar *filename;
+  gchar *signatures;
+} DumpJob;
+
+static void
+dump_job_run (gpointer data,
+              gpointer user_data)
+{
+  DumpJob *job = data;
+  const gchar *contents;
+  gsize length;
+  gint64 metrics_begin_time;
+  gint64 file_begin_time;
+  gint64 begin_time;
+  GError *error = NULL;
+
+  file_begin_time = gcu_trace_begin ();
+  metrics_begin_time = gcu_metrics_file_begin (job->filename);
+
+  gcu_profile_set_phase ("load", job->filename);
+  begin_time = gcu_trace_begin ();
+  contents = load_file (job->filename, &length, &error);
+  if (error != NULL)
+    {
+      g_warning ("Impossible to get file contents: %s", error->message);
+      g_clear_error (&error);
+
+      if (_results != NULL)
+        gcu_results_add (_results, job->filename, "failed", -1, NULL);
+
+      gcu_metrics_file_end (metrics_begin_time, -1, "failed");
+      gcu_profile_set_phase (NULL, NULL);
+      return;
+    }
+  gcu_trace_end (begin_time, "load", job->filename, length);
+
+  if (gcu_budget_check_contents (&_budget, job->filename, contents, length))
+    {
+      gcu_profile_set_phase ("parse", job->filename);
+      begin_time = gcu_trace_begin ();
+      job->signatures = dump_contents (job->filename, contents);
+      gcu_trace_end (begin_time, "parse", job->filename, length);
+
+      if (_results != NULL)
+        gcu_results_add (_results, job->filename, "processed", length, job->signatures);
+
+      gcu_metrics_file_end (metrics_begin_time, length, "processed");
+    }
+  else
+    {
+      if (_results != NULL)
+        gcu_results_add (_results, job->filename, "skipped", length, NULL);
+
+      gcu_metrics_file_end (metrics_begin_time, length, "skipped");
+    }
+
+  gcu_trace_end (file_begin_time, "file", job->filename, length);
+  gcu_profile_set_phase (NULL, NULL);
+}
+
+/* The files are only read, so they are processed in parallel. The output is
+ * printed in the order of the sorted filenames, to be stable between runs.
+ */
+static void
+handle_dump_signatures (gint    n_paths,
+                        gchar **paths)
+{
+  GPtrArray *all_filenames;
+  GPtrArray *filenames;
+  DumpJob *jobs;
+  GcuScheduler *scheduler;
+  GOutputStream *output_stream;
+  GError *error = NULL;
+  guint job_num;
+
+  all_filenames = gcu_file_list_new_from_paths (n_paths, paths);
+
+  /* After the scan of the directories, to split the files. */
+  if (_shard_spec != NULL)
+    filenames = get_shard_paths (all_filenames->len, (gchar **) all_filenames->pdata, NULL);
+  else
+    filenames = g_ptr_array_ref (all_filenames);
+
+  jobs = g_new0 (DumpJob, filenames->len);
+
+  scheduler = create_scheduler (dump_job_run, NULL);
+
+  gcu_metrics_add_queued (filenames->len);
+
+  for (job_num = 0; job_num < filenames->len; job_num++)
+    {
+      jobs[job_num].filename = filenames->pdata[job_num];
+      gcu_scheduler_push (scheduler, &jobs[job_num], get_file_cost (jobs[job_num].filename));
+    }
+
+  /* Waits for all the jobs to finish. */
+  gcu_scheduler_free (scheduler);
+
+  output_stream = get_stdout_output_stream ();
+
+  for (job_num = 0; job_num < filenames->len; job_num++)
+    {
+      if (jobs[job_num].signatures != NULL)
+        write_to_output_stream (output_stream, jobs[job_num].signatures);
+
+      g_free (jobs[job_num].signatures);
+    }
+
+  g_output_stream_close (output_stream, NULL, &error);
+  g_assert_no_error (error);
+
+  g_object_unref (output_stream);
+  g_free (jobs);
+  g_ptr_array_unref (filenames);
+  g_ptr_array_unref (all_filenames);
+}
+
+typedef struct
+{
+  const GcuGitFile *file;
+  gchar *diff;
+  guint failed : 1;
+} GitJob;
+
+static void
+git_job_run (gpointer data,
+             gpointer user_data)
+{
+  GitJob *job = data;
+  GcuGitRepository *repo = user_data;
+  const gchar *path = job->file->path;
+  GBytes *bytes;
+  const gchar *input_str;
+  gsize input_length;
+  GMemoryOutputStream *output_stream;
+  const gchar *status;
+  gint64 metrics_begin_time;
+  gint64 file_begin_time;
+  gint64 begin_time;
+  GError *error = NULL;
+
+  file_begin_time = gcu_trace_begin ();
+  metrics_begin_time = gcu_metrics_file_begin (path);
+
+  gcu_profile_set_phase ("load", path);
+  begin_time = gcu_trace_begin ();
+  bytes = gcu_git_repository_read_file (repo, job->file, &error);
+  if (bytes == NULL)
+    {
+      g_printerr ("%s: %s\n", path, error->message);
+      g_clear_error (&error);
+      job->failed = TRUE;
+
+      if (_results != NULL)
+        gcu_results_add (_results, path, "failed", -1, NULL);
+
+      gcu_metrics_file_end (metrics_begin_time, -1, "failed");
+      gcu_profile_set_phase (NULL, NULL);
+      return;
+    }
+
+  input_str = g_bytes_get_data (bytes, &input_length);
+  gcu_trace_end (begin_time, "load", path, input_length);
+
+  /* Like git, don't show a diff for a binary file. */
+  if (memchr (input_str, '\0', input_length) != NULL ||
+      !gcu_budget_check_contents (&_budget, path, input_str, input_length))
+    {
+      status = "skipped";
+
+      if (_results != NULL)
+        gcu_results_add (_results, path, status, input_length, NULL);
+    }
+  else
+    {
+      gcu_profile_set_phase ("parse", path);
+      begin_time = gcu_trace_begin ();
+
+      if (parse_contents_to_memory (input_str, input_length, &output_stream))
+        {
+          GString *diff = g_string_new (NULL);
+
+          gcu_diff_append_unified (diff,
+                                   path,
+                                   input_str,
+                                   input_length,
+                                   g_memory_output_stream_get_data (output_stream),
+                                   g_memory_output_stream_get_data_size (output_stream));
+
+          job->diff = g_string_free (diff, FALSE);
+        }
+
+      free_output_stream (output_stream);
+      gcu_trace_end (begin_time, "parse", path, input_length);
+
+      status = job->diff != NULL ? "changed" : "unchanged";
+
+      if (_results != NULL)
+        gcu_results_add (_results, path, status, input_length, job->diff);
+    }
+
+  gcu_trace_end (file_begin_time, "file", path, input_length);
+  gcu_metrics_file_end (metrics_begin_time, input_length, status);
+  gcu_profile_set_phase (NULL, NULL);
+  g_bytes_unref (bytes);
+}
+
+/* Like handle_dump_signatures(), the blobs are only read, so they are
+ * processed in parallel, and the diffs are printed in the order of the paths.
+ *
+ * Returns: the exit status.
+ */
+static int
+handle_git_rev (gint    n_paths,
+                gchar **paths)
+{
+  GcuGitRepository *repo;
+  GPtrArray *files;
+  GitJob *jobs;
+  guint n_jobs = 0;
+  gboolean *selected;
+  GcuScheduler *scheduler;
+  GOutputStream *output_stream;
+  GError *error = NULL;
+  guint file_num;
+  guint job_num;
+  gboolean changed = FALSE;
+  gboolean failed = FALSE;
+
+  repo = gcu_git_repository_open (_git_dir, &error);
+  if (repo == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
+
+  files = gcu_git_repository_list_files (repo, _git_rev, &error);
+  if (files == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      gcu_git_repository_free (repo);
+      return EXIT_FAILURE;
+    }
+
+  jobs = g_new0 (GitJob, files->len);
+
+  scheduler = create_scheduler (git_job_run, repo);
+
+  for (file_num = 0; file_num < files->len; file_num++)
+    {
+      const GcuGitFile *file = g_ptr_array_index (files, file_num);
+
+      if ((g_str_has_suffix (file->path, ".c") ||
+           g_str_has_suffix (file->path, ".h")) &&
+          gcu_git_file_is_in_paths (file, n_paths, paths))
+        {
+          jobs[n_jobs].file = file;
+          n_jobs++;
+        }
+    }
+
+  selected = g_new (gboolean, n_jobs);
+
+  if (_shard_spec != NULL)
+    {
+      gchar **job_paths = g_new (gchar *, n_jobs);
+      guint64 *sizes = g_new0 (guint64, n_jobs);
+
+      for (job_num = 0; job_num < n_jobs; job_num++)
+        job_paths[job_num] = jobs[job_num].file->path;
+
+      /* The sizes of the blobs are not known before reading them, so the
+       * files have the same weight.
+       */
+      gcu_shard_select (&_shard, n_jobs, job_paths, sizes, selected);
+
+      g_free (job_paths);
+      g_free (sizes);
+    }
+  else
+    {
+      for (job_num = 0; job_num < n_jobs; job_num++)
+        selected[job_num] = TRUE;
+    }
+
+  for (job_num = 0; job_num < n_jobs; job_num++)
+    {
+      if (selected[job_num])
+        {
+          gcu_metrics_add_queued (1);
+          gcu_scheduler_push (scheduler, &jobs[job_num], get_git_file_cost (repo, jobs[job_num].file));
+        }
+    }
+
+  /* Waits for all the jobs to finish. */
+  gcu_scheduler_free (scheduler);
+
+  output_stream = get_stdout_output_stream ();
+
+  for (job_num = 0; job_num < n_jobs; job_num++)
+    {
+      if (jobs[job_num].diff != NULL)
+        {
+          write_to_output_stream (output_stream, jobs[job_num].diff);
+          changed = TRUE;
+        }
+
+      if (jobs[job_num].failed)
+        failed = TRUE;
+
+      g_free (jobs[job_num].diff);
+    }
+
+  g_output_stream_close (output_stream, NULL, &error);
+  g_assert_no_error (error);
+
+  g_object_unref (output_stream);
+  g_free (selected);
+  g_free (jobs);
+  g_ptr_array_unref (files);
+  gcu_git_repository_free (repo);
+
+  return changed || failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GOptionContext *option_context;
+  GError *error = NULL;
+  GFile *file;
+  GPtrArray *file_list = NULL;
+  GPtrArray *shard_files = NULL;
+  gint n_files;
+  gchar **files;
+  gboolean tracing = FALSE;
+  gboolean metrics = FALSE;
+  gboolean profiling = FALSE;
+  int ret = EXIT_SUCCESS;
+
+  setlocale (LC_ALL, "");
+  gcu_budget_init (&_budget);
+
+  option_context = g_option_context_new ("- lineup parameters");
+  g_option_context_add_main_entries (option_context, option_entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (_shard_spec != NULL && !gcu_shard_parse (&_shard, _shard_spec, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (_max_memory_spec != NULL && !gcu_budget_parse_size (_max_memory_spec, &_max_memory))
+    {
+      g_printerr ("Invalid --max-memory size: %s\n", _max_memory_spec);
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if ((_shard_spec != NULL || _results_path != NULL) && _watch_directory != NULL)
+    {
+      g_printerr ("The --shard and --results options cannot be used with --watch.\n");
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  /* Saved at exit, also if the run fails, for gcu-merge-results to report
+   * it.
+   */
+  if (_results_path != NULL)
+    _results = gcu_results_new ("gcu-lineup-parameters", _shard_spec != NULL ? &_shard : NULL);
+
+  if (_trace_path != NULL)
+    {
+      if (_watch_directory != NULL)
+        {
+          g_printerr ("The --trace option cannot be used with --watch.\n");
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      if (!gcu_trace_start (_trace_path, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      tracing = TRUE;
+    }
+
+  if (_metrics_path != NULL)
+    {
+      if (_watch_directory != NULL)
+        {
+          g_printerr ("The --metrics option cannot be used with --watch.\n");
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      if (!gcu_metrics_start ("gcu-lineup-parameters", _metrics_path, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      metrics = TRUE;
+    }
+
+  if (_profile_path != NULL)
+    {
+      if (_watch_directory != NULL)
+        {
+          g_printerr ("The --profile option cannot be used with --watch.\n");
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      if (!gcu_profile_start (_profile_path, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      profiling = TRUE;
+    }
+
+  if (_git_rev != NULL)
+    {
+      if (_compile_commands_path != NULL || _include_headers ||
+          _watch_directory != NULL || _durable || _journal_path != NULL ||
+          _dump_signatures)
+        {
+          g_printerr ("The --git-rev option cannot be used with --compile-commands, --watch, --durable or --dump-signatures.\n");
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      ret = handle_git_rev (argc - 1, argv + 1);
+      goto exit;
+    }
+  else if (_git_dir != NULL)
+    {
+      g_printerr ("The --git-dir option requires --git-rev.\n");
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (_compile_commands_path != NULL)
+    {
+      if (argc > 1 || _watch_directory != NULL)
+        {
+          g_printerr ("The --compile-commands option cannot be used with files or with --watch.\n");
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      file_list = gcu_file_list_new_from_compile_commands (_compile_commands_path,
+                                                           _include_headers,
+                                                           &error);
+      if (file_list == NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      /* Not stdin, and not the current directory for --dump-signatures. */
+      if (file_list->len == 0)
+        {
+          g_printerr ("No files to process in %s\n", _compile_commands_path);
+          goto exit;
+        }
+
+      n_files = file_list->len;
+      files = (gchar **) file_list->pdata;
+    }
+  else if (_include_headers)
+    {
+      g_printerr ("The --include-headers option requires --compile-commands.\n");
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+  else
+    {
+      n_files = argc - 1;
+      files = argv + 1;
+    }
+
+  if (_dump_signatures)
+    {
+      handle_dump_signatures (n_files, files);
+      goto exit;
+    }
+
+  if (_watch_directory != NULL)
+    {
+      if (n_files > 0 || _durable)
+        {
+          g_printerr ("The --watch option cannot be used with files or with --durable.\n");
+          print_usage (argv);
+          ret = EXIT_FAILURE;
+          goto exit;
+        }
+
+      handle_watch (_watch_directory);
+      goto exit;
+    }
+
+  if (_journal_path != NULL && !_durable)
+    {
+      g_printerr ("The --journal option requires --durable.\n");
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  /* Not stdin, which is written to stdout. */
+  if (n_files == 0 && _durable)
+    {
+      g_printerr ("The --durable option requires files.\n");
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (n_files == 0 && (_shard_spec != NULL || _results_path != NULL))
+    {
+      g_printerr ("The --shard and --results options require files.\n");
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (_shard_spec != NULL)
+    {
+      shard_files = get_shard_paths (n_files, files, NULL);
+      n_files = shard_files->len;
+      files = (gchar **) shard_files->pdata;
+    }
+
+  if (n_files == 0)
+    {
+      /* Not for an empty shard. */
+      if (_shard_spec == NULL)
+        handle_stdin ();
+    }
+  else if (_durable)
+    {
+      handle_files_durable (n_files, files);
+    }
+  else if (n_files == 1)
+    {
+      gcu_metrics_add_queued (1);
+      file = g_file_new_for_commandline_arg (files[0]);
+      handle_file (file, files[0]);
+      g_object_unref (file);
+    }
+  else
+    {
+      handle_files (n_files, files);
+    }
+
+exit:
+  /* Already printed. */
+  g_clear_error (&error);
+
+  if (tracing && !gcu_trace_stop (&error))
+    {
+      g_printerr ("%s\n", error->message);
+      ret = EXIT_FAILURE;
+      g_clear_error (&error);
+    }
+
+  if (metrics && !gcu_metrics_stop (&error))
+    {
+      g_printerr ("%s\n", error->message);
+      ret = EXIT_FAILURE;
+      g_clear_error (&error);
+    }
+
+  if (profiling && !gcu_profile_stop (&error))
+    {
+      g_printerr ("%s\n", error->message);
+      ret = EXIT_FAILURE;
+      g_clear_error (&error);
+    }
+
+  if (_results != NULL)
+    {
+      gcu_results_set_exit_status (_results, ret);
+
+      if (!gcu_results_save (_results, _results_path, &error))
+        {
+          g_printerr ("%s\n", error->message);
+          ret = EXIT_FAILURE;
+        }
+
+      gcu_results_free (_results);
     }
 
-exit:
   g_option_context_free (option_context);
   g_clear_error (&error);
+  g_free (_journal_path);
+  g_free (_watch_directory);
+  g_free (_compile_commands_path);
+  g_free (_trace_path);
+  g_free (_metrics_path);
+  g_free (_profile_path);
+  g_free (_max_memory_spec);
+  g_free (_git_rev);
+  g_free (_git_dir);
+  g_free (_shard_spec);
+  g_free (_results_path);
+  if (file_list != NULL)
+    g_ptr_array_unref (file_list);
+  if (shard_files != NULL)
+    g_ptr_array_unref (shard_files);
   return ret;
 }
@@ -42,6 +42,21 @@
  * the script. The best is to have it in a version control system like Git to
  * see the diff afterwards.
  *
+ * If <file> is "-", stdin is read and the result is written to stdout instead,
+ * so the script can be used in a pipeline (see gcu-filter.c). stdin must be
+ * UTF-8, otherwise it is written unchanged, with a warning.
+ *
+ * Usage: gcu-lineup-substitution --watch <directory> <search-text> <replacement>
+ * Watches <directory> recursively, and does the substitution in each *.c or *.h
+ * file when it is saved, for example by a text editor. GTK+ is initialized only
+ * once. Only the files that change are saved, and the events caused by those
+ * saves are ignored. Runs until interrupted. <replacement> must not contain
+ * <search-text>, otherwise each save would do the substitution again.
+ *
+ * The files that exceed the limits of the GCU_BUDGET environment variable
+ * (size, line length, number of matches, time) are left unmodified, with a
+ * warning (see gcu-budget.c).
+ *
  * The search is case sensitive, regular expressions are *not* supported, and it
  * does *not* try to match only at word boundaries (although it would be easy to
  * add such an option).
@@ -71,13 +86,52 @@
  */
 #include <tepl/tepl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <locale.h>
+#include "gcu-budget.h"
+#include "gcu-filter.h"
+#include "gcu-watch.h"
+
+typedef struct
+{
+  /* The line offset of an opening parenthesis, and the visual column after
+   * it.
+   */
+  gint line_offset;
+  gint column;
+} Parenthesis;
+
+/* The opening parentheses of the line of the last match, scanned once for all
+ * the matches of the line. The offsets and columns are the ones of the line
+ * before the replacements. The replacements shift the text after them by
+ * @shift characters, and by the same number of columns, because the search
+ * text and the replacement contain no tab and the text after the replacement
+ * contains no tab either (otherwise the line is scanned again).
+ */
+typedef struct
+{
+  /* -1 if not valid. */
+  gint line;
+
+  GArray *parentheses;
+
+  /* -1 if there is no tab. */
+  gint last_tab_offset;
+
+  gint shift;
+
+  /* The column returned by get_text_start_column() for the next line, or -2
+   * if not computed yet.
+   */
+  gint next_line_column;
+} LineParentheses;
 
 typedef struct _Sub Sub;
 struct _Sub
 {
   gchar *search_text;
   gchar *replacement;
+  gchar *filename;
 
   TeplBuffer *buffer;
 
@@ -85,37 +139,65 @@ struct _Sub
    * free.
    */
   GtkSourceView *view;
+
+  /* Not NULL in watch mode. */
+  GcuWatch *watch;
+
+  GcuBudgetCounter budget_counter;
+
+  LineParentheses line_parentheses;
+
+  /* Whether @line_parentheses can be updated after a replacement. */
+  guint shift_line_parentheses : 1;
 };
 
+typedef struct
+{
+  const gchar *search_text;
+  const gchar *replacement;
+} WatchData;
+
+static GcuBudget _budget;
+
+/* @filename is %NULL for stdin. */
 static Sub *
 sub_new (const gchar *search_text,
          const gchar *replacement,
          const gchar *filename)
 {
   Sub *sub = g_new0 (Sub, 1);
-  GFile *location;
-  TeplFile *file;
 
   g_assert (search_text != NULL);
   g_assert (search_text[0] != '\0');
   g_assert (replacement != NULL);
-  g_assert (filename != NULL);
-  g_assert (filename[0] != '\0');
+  g_assert (filename == NULL || filename[0] != '\0');
 
   sub->search_text = g_strdup (search_text);
   sub->replacement = g_strdup (replacement);
+  sub->filename = g_strdup (filename != NULL ? filename : "stdin");
 
   sub->buffer = tepl_buffer_new ();
   gtk_source_buffer_set_implicit_trailing_newline (GTK_SOURCE_BUFFER (sub->buffer), FALSE);
 
-  location = g_file_new_for_commandline_arg (filename);
-  file = tepl_buffer_get_file (sub->buffer);
-  tepl_file_set_location (file, location);
-  g_object_unref (location);
+  if (filename != NULL)
+    {
+      GFile *location;
+      TeplFile *file;
+
+      location = g_file_new_for_commandline_arg (filename);
+      file = tepl_buffer_get_file (sub->buffer);
+      tepl_file_set_location (file, location);
+      g_object_unref (location);
+    }
 
   sub->view = GTK_SOURCE_VIEW (gtk_source_view_new_with_buffer (GTK_SOURCE_BUFFER (sub->buffer)));
   g_object_ref_sink (sub->view);
 
+  sub->line_parentheses.line = -1;
+  sub->line_parentheses.parentheses = g_array_new (FALSE, FALSE, sizeof (Parenthesis));
+  sub->shift_line_parentheses = (strpbrk (search_text, "\t\n") == NULL &&
+                                 strpbrk (replacement, "\t\n") == NULL);
+
   return sub;
 }
 
@@ -126,8 +208,10 @@ sub_free (Sub *sub)
     {
       g_free (sub->search_text);
       g_free (sub->replacement);
+      g_free (sub->filename);
       g_clear_object (&sub->buffer);
       g_clear_object (&sub->view);
+      g_array_unref (sub->line_parentheses.parentheses);
 
       g_free (sub);
     }
@@ -139,15 +223,33 @@ save_cb (GObject      *source_object,
          gpointer      user_data)
 {
   TeplFileSaver *saver = TEPL_FILE_SAVER (source_object);
+  Sub *sub = user_data;
   GError *error = NULL;
 
   tepl_file_saver_save_finish (saver, result, &error);
   g_object_unref (saver);
 
+  if (sub->watch == NULL)
+    {
+      if (error != NULL)
+        g_error ("Error when saving file: %s", error->message);
+
+      gtk_main_quit ();
+      return;
+    }
+
   if (error != NULL)
-    g_error ("Error when saving file: %s", error->message);
+    {
+      g_warning ("Error when saving %s: %s", sub->filename, error->message);
+      g_clear_error (&error);
+    }
+  else
+    {
+      gcu_watch_file_written (sub->watch, sub->filename);
+      g_print ("Substitution done in %s\n", sub->filename);
+    }
 
-  gtk_main_quit ();
+  sub_free (sub);
 }
 
 static void
@@ -163,7 +265,7 @@ save_file (Sub *sub)
                               G_PRIORITY_HIGH,
                               NULL,
                               save_cb,
-                              NULL);
+                              sub);
 }
 
 static void
@@ -180,35 +282,103 @@ check_parentheses_columns (GSList *list)
     }
 }
 
-/* Returns the column numbers in reverse order. */
+/* Appends the opening parentheses of the line of @line_iter to @parentheses.
+ * Returns the line offset of the last tab, or -1.
+ *
+ * The visual columns are computed like gtk_source_view_get_visual_column(), but
+ * in one pass over the line. Calling gtk_source_view_get_visual_column() for
+ * each parenthesis would be quadratic on long lines.
+ */
+static gint
+scan_parentheses (Sub               *sub,
+                  const GtkTextIter *line_iter,
+                  GArray            *parentheses)
+{
+  GtkTextIter iter;
+  gint tab_width;
+  gint column = 0;
+  gint last_tab_offset = -1;
+
+  tab_width = gtk_source_view_get_tab_width (sub->view);
+
+  iter = *line_iter;
+  gtk_text_iter_set_line_offset (&iter, 0);
+
+  while (!gtk_text_iter_is_end (&iter) &&
+         !gtk_text_iter_ends_line (&iter))
+    {
+      gunichar c;
+
+      c = gtk_text_iter_get_char (&iter);
+
+      if (c == '\t')
+        {
+          column += tab_width - (column % tab_width);
+          last_tab_offset = gtk_text_iter_get_line_offset (&iter);
+        }
+      else
+        column++;
+
+      if (c == '(')
+        {
+          Parenthesis parenthesis;
+
+          parenthesis.line_offset = gtk_text_iter_get_line_offset (&iter);
+          parenthesis.column = column;
+          g_array_append_val (parentheses, parenthesis);
+        }
+
+      gtk_text_iter_forward_char (&iter);
+    }
+
+  return last_tab_offset;
+}
+
+/* Returns the index of the first parenthesis of @parentheses, from @low, at
+ * or after @line_offset if @by_column is %FALSE, or whose column is at least
+ * @value if @by_column is %TRUE. The line offsets and the columns are both
+ * increasing.
+ */
+static guint
+find_parenthesis (GArray   *parentheses,
+                  guint     low,
+                  gint      value,
+                  gboolean  by_column)
+{
+  guint high = parentheses->len;
+
+  while (low < high)
+    {
+      guint middle = low + (high - low) / 2;
+      const Parenthesis *parenthesis = &g_array_index (parentheses, Parenthesis, middle);
+
+      if ((by_column ? parenthesis->column : parenthesis->line_offset) < value)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  return low;
+}
+
+/* Returns the visual columns after the opening parentheses present after @pos
+ * on the same line, in reverse order.
+ */
 static GSList *
 get_parentheses_columns (Sub               *sub,
                          const GtkTextIter *pos)
 {
-  GtkTextIter limit;
-  GtkTextIter iter;
-  GtkTextIter match_end;
+  GArray *parentheses;
+  guint i;
   GSList *list = NULL;
 
-  limit = *pos;
-  if (!gtk_text_iter_ends_line (&limit))
-    gtk_text_iter_forward_to_line_end (&limit);
-
-  iter = *pos;
-  while (gtk_text_iter_forward_search (&iter,
-                                       "(",
-                                       GTK_TEXT_SEARCH_TEXT_ONLY,
-                                       NULL,
-                                       &match_end,
-                                       &limit))
-    {
-      gint column;
+  parentheses = g_array_new (FALSE, FALSE, sizeof (Parenthesis));
+  scan_parentheses (sub, pos, parentheses);
 
-      column = gtk_source_view_get_visual_column (sub->view, &match_end);
-      list = g_slist_prepend (list, GINT_TO_POINTER (column));
+  for (i = find_parenthesis (parentheses, 0, gtk_text_iter_get_line_offset (pos), FALSE); i < parentheses->len; i++)
+    list = g_slist_prepend (list, GINT_TO_POINTER (g_array_index (parentheses, Parenthesis, i).column));
 
-      iter = match_end;
-    }
+  g_array_unref (parentheses);
 
   check_parentheses_columns (list);
   return list;
@@ -399,6 +569,112 @@ adjust_alignment_after_line (Sub         *sub,
   g_slist_free (parentheses_columns);
 }
 
+static LineParentheses *
+get_line_parentheses (Sub               *sub,
+                      const GtkTextIter *pos)
+{
+  LineParentheses *line_parentheses = &sub->line_parentheses;
+  gint line = gtk_text_iter_get_line (pos);
+
+  if (line_parentheses->line != line)
+    {
+      line_parentheses->line = line;
+      line_parentheses->shift = 0;
+      line_parentheses->next_line_column = -2;
+
+      g_array_set_size (line_parentheses->parentheses, 0);
+      line_parentheses->last_tab_offset = scan_parentheses (sub, pos, line_parentheses->parentheses);
+    }
+
+  if (line_parentheses->next_line_column == -2)
+    {
+      GtkTextIter next_line = *pos;
+
+      if (gtk_text_iter_forward_line (&next_line))
+        line_parentheses->next_line_column = get_text_start_column (sub, &next_line);
+      else
+        line_parentheses->next_line_column = -1;
+    }
+
+  return line_parentheses;
+}
+
+/* Returns the columns of the parentheses after @pos on which the next line can
+ * be aligned, like get_parentheses_columns() but without the columns greater
+ * than the start of the next line, which adjust_alignment_after_line() would
+ * skip. The line is scanned only for its first match, so that a long line with
+ * many matches is not scanned once per match.
+ */
+static GSList *
+get_match_parentheses_columns (Sub               *sub,
+                               const GtkTextIter *pos)
+{
+  LineParentheses *line_parentheses;
+  GArray *parentheses;
+  gint next_line_column;
+  guint first;
+  guint last;
+  guint i;
+  GSList *list = NULL;
+
+  line_parentheses = get_line_parentheses (sub, pos);
+  parentheses = line_parentheses->parentheses;
+  next_line_column = line_parentheses->next_line_column - line_parentheses->shift;
+
+  /* The columns are all greater than the line offsets, so if the next line
+   * starts before @pos, there is nothing to align.
+   */
+  if (next_line_column <= gtk_text_iter_get_line_offset (pos) - line_parentheses->shift)
+    return NULL;
+
+  first = find_parenthesis (parentheses,
+                            0,
+                            gtk_text_iter_get_line_offset (pos) - line_parentheses->shift,
+                            FALSE);
+
+  /* Without a parenthesis at the start of the next line,
+   * adjust_alignment_after_line() would do nothing.
+   */
+  last = find_parenthesis (parentheses, first, next_line_column, TRUE);
+
+  if (last == parentheses->len ||
+      g_array_index (parentheses, Parenthesis, last).column != next_line_column)
+    return NULL;
+
+  for (i = first; i <= last; i++)
+    {
+      gint column = g_array_index (parentheses, Parenthesis, i).column;
+      list = g_slist_prepend (list, GINT_TO_POINTER (column + line_parentheses->shift));
+    }
+
+  check_parentheses_columns (list);
+  return list;
+}
+
+/* Called after a replacement at @match_start_offset, on the line of the
+ * previous get_match_parentheses_columns() call.
+ */
+static void
+shift_line_parentheses (Sub      *sub,
+                        gint      match_start_offset,
+                        gboolean  next_line_adjusted)
+{
+  LineParentheses *line_parentheses = &sub->line_parentheses;
+
+  if (!sub->shift_line_parentheses ||
+      match_start_offset - line_parentheses->shift <= line_parentheses->last_tab_offset)
+    {
+      line_parentheses->line = -1;
+      return;
+    }
+
+  line_parentheses->shift += (g_utf8_strlen (sub->replacement, -1) -
+                              g_utf8_strlen (sub->search_text, -1));
+
+  if (next_line_adjusted)
+    line_parentheses->next_line_column = -2;
+}
+
 static void
 replace (Sub                    *sub,
          GtkSourceSearchContext *search_context,
@@ -406,10 +682,12 @@ replace (Sub                    *sub,
          GtkTextIter            *match_end)
 {
   GSList *parentheses_columns;
+  gint match_start_offset;
   GtkTextIter start;
   GError *error = NULL;
 
-  parentheses_columns = get_parentheses_columns (sub, match_end);
+  parentheses_columns = get_match_parentheses_columns (sub, match_end);
+  match_start_offset = gtk_text_iter_get_line_offset (match_start);
 
   start = *match_start;
   gtk_source_search_context_replace (search_context,
@@ -421,6 +699,7 @@ replace (Sub                    *sub,
   if (error != NULL)
     g_error ("Error when doing the substitution: %s", error->message);
 
+  shift_line_parentheses (sub, match_start_offset, parentheses_columns != NULL);
   adjust_alignment_after_line (sub, parentheses_columns, match_end);
 }
 
@@ -440,6 +719,7 @@ do_substitution (Sub *sub)
   search_context = gtk_source_search_context_new (GTK_SOURCE_BUFFER (sub->buffer),
                                                   search_settings);
 
+  sub->line_parentheses.line = -1;
   gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (sub->buffer), &iter);
 
   while (gtk_source_search_context_forward (search_context,
@@ -448,6 +728,9 @@ do_substitution (Sub *sub)
                                             &match_end,
                                             NULL))
     {
+      if (!gcu_budget_counter_add_match (&sub->budget_counter))
+        break;
+
       replace (sub, search_context, &match_start, &match_end);
       iter = match_end;
     }
@@ -456,6 +739,40 @@ do_substitution (Sub *sub)
   g_object_unref (search_context);
 }
 
+/* The size of the file is checked before loading it, with
+ * gcu_budget_check_file(). The line lengths are checked on the loaded buffer,
+ * to not read the file twice.
+ */
+static gboolean
+check_buffer_lines (Sub *sub)
+{
+  GtkTextBuffer *buffer = GTK_TEXT_BUFFER (sub->buffer);
+  gint n_lines;
+  gint line_num;
+
+  if (_budget.max_line_length == 0)
+    return TRUE;
+
+  n_lines = gtk_text_buffer_get_line_count (buffer);
+
+  for (line_num = 0; line_num < n_lines; line_num++)
+    {
+      GtkTextIter line_end;
+
+      gtk_text_buffer_get_iter_at_line (buffer, &line_end, line_num);
+      if (!gtk_text_iter_ends_line (&line_end))
+        gtk_text_iter_forward_to_line_end (&line_end);
+
+      if (!gcu_budget_check_line (&_budget,
+                                  sub->filename,
+                                  line_num + 1,
+                                  gtk_text_iter_get_line_index (&line_end)))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static void
 load_cb (GObject      *source_object,
          GAsyncResult *result,
@@ -468,10 +785,44 @@ load_cb (GObject      *source_object,
   tepl_file_loader_load_finish (loader, result, &error);
   g_object_unref (loader);
 
+  if (error != NULL && sub->watch != NULL)
+    {
+      /* The file may have been removed in the meantime. */
+      g_warning ("Error when loading %s: %s", sub->filename, error->message);
+      g_clear_error (&error);
+      sub_free (sub);
+      return;
+    }
+
   if (error != NULL)
     g_error ("Error when loading file: %s", error->message);
 
-  do_substitution (sub);
+  gcu_budget_counter_init (&sub->budget_counter, &_budget, sub->filename);
+
+  if (check_buffer_lines (sub))
+    do_substitution (sub);
+  else
+    sub->budget_counter.exceeded = TRUE;
+
+  /* Over budget, the file is left unmodified. */
+  if (sub->budget_counter.exceeded)
+    {
+      if (sub->watch != NULL)
+        sub_free (sub);
+      else
+        gtk_main_quit ();
+
+      return;
+    }
+
+  /* In watch mode, saving an unchanged file would trigger a new event. */
+  if (sub->watch != NULL &&
+      !gtk_text_buffer_get_modified (GTK_TEXT_BUFFER (sub->buffer)))
+    {
+      sub_free (sub);
+      return;
+    }
+
   save_file (sub);
 }
 
@@ -491,6 +842,120 @@ sub_launch (Sub *sub)
                                sub);
 }
 
+/* Does the substitution on stdin, written to stdout. The main loop is not
+ * needed, there is no file to load or save asynchronously.
+ */
+static gint
+handle_stdin (const gchar *search_text,
+              const gchar *replacement)
+{
+  gchar *contents;
+  gsize length;
+  gchar *new_contents = NULL;
+  GError *error = NULL;
+
+  contents = gcu_filter_read_stdin (&length, &error);
+  if (error != NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
+
+  /* A GtkTextBuffer contains only valid UTF-8. */
+  if (length > G_MAXINT || !g_utf8_validate (contents, length, NULL))
+    g_printerr ("stdin: not a valid UTF-8 text, written unchanged.\n");
+  else if (gcu_budget_check_contents (&_budget, "stdin", contents, length))
+    {
+      Sub *sub;
+
+      sub = sub_new (search_text, replacement, NULL);
+      gtk_text_buffer_set_text (GTK_TEXT_BUFFER (sub->buffer), contents, length);
+
+      gcu_budget_counter_init (&sub->budget_counter, &_budget, sub->filename);
+      do_substitution (sub);
+
+      /* Over budget, the input is written unchanged. */
+      if (!sub->budget_counter.exceeded)
+        {
+          GtkTextIter start;
+          GtkTextIter end;
+
+          gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (sub->buffer), &start, &end);
+          new_contents = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (sub->buffer), &start, &end, TRUE);
+        }
+
+      sub_free (sub);
+    }
+
+  if (new_contents != NULL)
+    {
+      g_free (contents);
+      contents = new_contents;
+      length = strlen (new_contents);
+    }
+
+  if (!gcu_filter_write_stdout (contents, length, &error))
+    g_error ("Error when writing the output: %s", error->message);
+
+  g_free (contents);
+
+  return EXIT_SUCCESS;
+}
+
+/* Called from the main loop, after @filename has been saved. The Sub frees
+ * itself when done.
+ */
+static void
+watch_file_changed_cb (GcuWatch    *watch,
+                       const gchar *filename,
+                       gpointer     user_data)
+{
+  WatchData *data = user_data;
+  Sub *sub;
+
+  if (!gcu_budget_check_file (&_budget, filename))
+    return;
+
+  sub = sub_new (data->search_text, data->replacement, filename);
+  sub->watch = watch;
+  sub_launch (sub);
+}
+
+static gint
+handle_watch (const gchar *directory,
+              const gchar *search_text,
+              const gchar *replacement)
+{
+  WatchData data;
+  GcuWatch *watch;
+  GError *error = NULL;
+
+  if (search_text[0] == '\0' ||
+      strstr (replacement, search_text) != NULL)
+    {
+      g_printerr ("In watch mode, <replacement> must not contain <search-text>.\n");
+      return EXIT_FAILURE;
+    }
+
+  data.search_text = search_text;
+  data.replacement = replacement;
+
+  watch = gcu_watch_new (directory, watch_file_changed_cb, &data, &error);
+  if (error != NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
+
+  g_print ("Watching %s\n", directory);
+  gtk_main ();
+
+  gcu_watch_free (watch);
+  return EXIT_SUCCESS;
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
@@ -501,12 +966,17 @@ main (gint   argc,
   Sub *sub;
 
   setlocale (LC_ALL, "");
+  gcu_budget_init (&_budget);
 
   gtk_init (NULL, NULL);
 
+  if (argc == 5 && g_str_equal (argv[1], "--watch"))
+    return handle_watch (argv[2], argv[3], argv[4]);
+
   if (argc != 4)
     {
-      g_printerr ("Usage: %s <search-text> <replacement> <file>\n", argv[0]);
+      g_printerr ("Usage: %s <search-text> <replacement> <file or ->\n", argv[0]);
+      g_printerr ("       %s --watch <directory> <search-text> <replacement>\n", argv[0]);
       g_printerr ("WARNING: the script directly modifies the file without doing a backup first!\n");
       return EXIT_FAILURE;
     }
@@ -515,6 +985,12 @@ main (gint   argc,
   replacement = argv[2];
   filename = argv[3];
 
+  if (g_str_equal (filename, "-"))
+    return handle_stdin (search_text, replacement);
+
+  if (!gcu_budget_check_file (&_budget, filename))
+    return EXIT_SUCCESS;
+
   sub = sub_new (search_text, replacement, filename);
   sub_launch (sub);
   gtk_main ();
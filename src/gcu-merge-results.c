@@ -0,0 +1,239 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Usage:
+ * $ gcu-merge-results [--output=FILE] [--print-output] results.json...
+ *
+ * Combines the results files written with --shard=I/N --results=FILE by each
+ * shard of a run (see gcu-shard.c and gcu-results.c), as if the tool had been
+ * run once on all the files. The results of all the shards are required.
+ *
+ * The merged results are written to FILE with --output, or printed on stdout.
+ * With --print-output, what the tool printed for each file (a diff, the
+ * function signatures, ...) is printed on stdout instead, in the order of the
+ * paths. A summary is printed on stderr.
+ *
+ * The exit status is the highest exit status of the shards, or 1 in case of
+ * error. It is at least 1 if a file is "incomplete", that is its check was
+ * stopped partway by GCU_BUDGET (see gcu-budget.c): such a file is not a pass,
+ * even if the tool of the shard didn't report it in its exit status.
+ *
+ * Example, with 4 shards run locally:
+ * $ for i in 1 2 3 4; do
+ *     gcu-lineup-parameters --shard=$i/4 --results=shard-$i.json *.c &
+ *   done; wait
+ * $ gcu-merge-results --output=results.json shard-*.json
+ */
+
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <locale.h>
+#include "gcu-results.h"
+
+static gchar *_output_path;
+static gboolean _print_output;
+
+static GOptionEntry option_entries[] =
+{
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &_output_path,
+    "Write the merged results to FILE instead of stdout.", "FILE" },
+  { "print-output", 0, 0, G_OPTION_ARG_NONE, &_print_output,
+    "Print what the tool printed for each file, instead of the merged results.", NULL },
+  { NULL }
+};
+
+static void
+print_usage (char **argv)
+{
+  g_printerr ("Usage: %s [--output=FILE] [--print-output] results.json...\n", argv[0]);
+}
+
+static void
+print_summary (GcuResults *results)
+{
+  GPtrArray *files;
+  GHashTable *status_counts;
+  GList *statuses;
+  GList *l;
+  GString *summary;
+  guint i;
+
+  files = gcu_results_get_files (results);
+  status_counts = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (i = 0; i < files->len; i++)
+    {
+      const GcuResultsFile *file = g_ptr_array_index (files, i);
+      guint count = GPOINTER_TO_UINT (g_hash_table_lookup (status_counts, file->status));
+
+      g_hash_table_insert (status_counts, file->status, GUINT_TO_POINTER (count + 1));
+    }
+
+  summary = g_string_new (NULL);
+  g_string_append_printf (summary, "%u files", files->len);
+
+  statuses = g_list_sort (g_hash_table_get_keys (status_counts), (GCompareFunc) g_strcmp0);
+
+  for (l = statuses; l != NULL; l = l->next)
+    {
+      const gchar *status = l->data;
+
+      g_string_append_printf (summary,
+                              "%s %u %s",
+                              l == statuses ? ":" : ",",
+                              GPOINTER_TO_UINT (g_hash_table_lookup (status_counts, status)),
+                              status);
+    }
+
+  g_printerr ("%s\n", summary->str);
+
+  g_string_free (summary, TRUE);
+  g_list_free (statuses);
+  g_hash_table_unref (status_counts);
+}
+
+static guint
+count_incomplete_files (GcuResults *results)
+{
+  GPtrArray *files;
+  guint n_incomplete = 0;
+  guint i;
+
+  files = gcu_results_get_files (results);
+
+  for (i = 0; i < files->len; i++)
+    {
+      const GcuResultsFile *file = g_ptr_array_index (files, i);
+
+      if (g_str_equal (file->status, "incomplete"))
+        n_incomplete++;
+    }
+
+  return n_incomplete;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GOptionContext *option_context;
+  GError *error = NULL;
+  GcuResults *results = NULL;
+  GPtrArray *files;
+  gint arg_num;
+  guint n_incomplete;
+  guint i;
+  int ret = EXIT_SUCCESS;
+
+  setlocale (LC_ALL, "");
+
+  option_context = g_option_context_new ("results.json... - merge the results of shards");
+  g_option_context_add_main_entries (option_context, option_entries, NULL);
+  if (!g_option_context_parse (option_context, &argc, &argv, &error))
+    {
+      g_printerr ("Option parsing failed: %s\n", error->message);
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  if (argc < 2)
+    {
+      print_usage (argv);
+      ret = EXIT_FAILURE;
+      goto exit;
+    }
+
+  for (arg_num = 1; arg_num < argc; arg_num++)
+    {
+      GcuResults *shard_results;
+
+      shard_results = gcu_results_load (argv[arg_num], &error);
+      if (shard_results == NULL)
+        goto error;
+
+      if (results == NULL)
+        {
+          results = shard_results;
+          continue;
+        }
+
+      if (!gcu_results_merge (results, shard_results, &error))
+        {
+          g_prefix_error (&error, "%s: ", argv[arg_num]);
+          gcu_results_free (shard_results);
+          goto error;
+        }
+
+      gcu_results_free (shard_results);
+    }
+
+  if (!gcu_results_check_complete (results, &error))
+    goto error;
+
+  if (_print_output)
+    {
+      files = gcu_results_get_files (results);
+
+      for (i = 0; i < files->len; i++)
+        {
+          const GcuResultsFile *file = g_ptr_array_index (files, i);
+
+          if (file->output != NULL)
+            g_print ("%s", file->output);
+        }
+    }
+
+  if (_output_path != NULL)
+    {
+      if (!gcu_results_save (results, _output_path, &error))
+        goto error;
+    }
+  else if (!_print_output)
+    {
+      gchar *json = gcu_results_to_json (results);
+
+      g_print ("%s", json);
+      g_free (json);
+    }
+
+  print_summary (results);
+  ret = gcu_results_get_exit_status (results);
+
+  n_incomplete = count_incomplete_files (results);
+  if (n_incomplete > 0)
+    {
+      g_printerr ("%u files not checked completely, because of GCU_BUDGET.\n", n_incomplete);
+      ret = MAX (ret, EXIT_FAILURE);
+    }
+
+  goto exit;
+
+error:
+  g_printerr ("%s\n", error->message);
+  ret = EXIT_FAILURE;
+
+exit:
+  g_option_context_free (option_context);
+  g_clear_error (&error);
+  gcu_results_free (results);
+  g_free (_output_path);
+  return ret;
+}
@@ -0,0 +1,622 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-metrics.h"
+#include <string.h>
+
+/*
+ * Live progress of a long run on many files, in the Prometheus text format.
+ * The file can for example be read by the textfile collector of the node
+ * exporter, its name must then end with ".prom".
+ *
+ * A thread rewrites the file every UPDATE_INTERVAL, atomically with
+ * g_file_set_contents(), and gcu_metrics_stop() writes it a last time. It
+ * contains:
+ * - the number of files queued and in progress;
+ * - the number of files done, by status, with the same statuses as in the
+ *   results (see gcu-results.c), for example "changed" for the files rewritten
+ *   and "skipped" for the files over budget;
+ * - the total size of the files done, and the number of matches (what a match
+ *   is depends on the program);
+ * - the file currently processed by each thread;
+ * - the median and 99th percentile of the time to process one file.
+ *
+ * To cost nothing on the hot path, the threads processing the files only do
+ * atomic operations. The counters are atomic integers. The durations are
+ * counted in a histogram with logarithmic buckets, so the percentiles have a
+ * precision of about 20%. The current file of a thread is copied in its slot
+ * with a sequence counter around the copy, and the writer thread copies it
+ * again if the sequence counter has changed in the meantime. A mutex is taken
+ * only the first time that a thread processes a file, to register its slot.
+ * When the metrics are not started, the functions do nothing.
+ */
+
+#define UPDATE_INTERVAL (5 * G_USEC_PER_SEC)
+
+/* The durations are in microseconds. Up to 8 µs, each bucket is 1 µs, and
+ * then there are 4 buckets per power of two, up to 2^32 µs.
+ */
+#define N_BUCKETS (32 * 4)
+
+/* The statuses are a few static strings. */
+#define MAX_STATUSES (8)
+
+/* Longer filenames are truncated. */
+#define MAX_FILENAME_LENGTH (256)
+
+#define MAX_READ_ATTEMPTS (100)
+
+typedef struct
+{
+  guint thread_num;
+
+  /* Odd while @filename is being modified. */
+  gint sequence;
+
+  /* Empty when the thread doesn't process a file. */
+  gchar filename[MAX_FILENAME_LENGTH];
+} WorkerSlot;
+
+typedef struct
+{
+  /* A static string, set only once. A gpointer for the atomic operations. */
+  gpointer status;
+
+  gint n_files;
+} StatusCounter;
+
+static gboolean metrics_enabled;
+static gboolean metrics_started;
+static gchar *metrics_program;
+static gchar *metrics_path;
+static gint64 metrics_start_real_time;
+
+static gint n_files_queued;
+static gint n_files_started;
+static gint n_files_done;
+static gsize n_bytes_done;
+static gsize n_matches;
+static StatusCounter status_counters[MAX_STATUSES];
+
+static gint duration_buckets[N_BUCKETS];
+static gsize duration_sum;
+
+static GMutex worker_slots_mutex;
+static GPtrArray *worker_slots;
+
+/* The WorkerSlot of the current thread, owned by worker_slots. */
+static GPrivate current_worker_slot = G_PRIVATE_INIT (NULL);
+
+static GThread *writer_thread;
+static GMutex writer_mutex;
+static GCond writer_cond;
+static gboolean writer_stopping;
+/* Set by the writer thread, read after it is joined. */
+static GError *writer_error;
+
+static WorkerSlot *
+get_worker_slot (void)
+{
+  WorkerSlot *slot;
+
+  slot = g_private_get (&current_worker_slot);
+  if (slot != NULL)
+    return slot;
+
+  slot = g_new0 (WorkerSlot, 1);
+
+  g_mutex_lock (&worker_slots_mutex);
+  slot->thread_num = worker_slots->len;
+  g_ptr_array_add (worker_slots, slot);
+  g_mutex_unlock (&worker_slots_mutex);
+
+  g_private_set (&current_worker_slot, slot);
+  return slot;
+}
+
+/* The atomic operations are full memory barriers, so the copy is done between
+ * the two increments.
+ */
+static void
+worker_slot_set_filename (WorkerSlot  *slot,
+                          const gchar *filename)
+{
+  g_atomic_int_inc (&slot->sequence);
+
+  if (filename != NULL)
+    g_strlcpy (slot->filename, filename, MAX_FILENAME_LENGTH);
+  else
+    slot->filename[0] = '\0';
+
+  g_atomic_int_inc (&slot->sequence);
+}
+
+/* Copies the filename of @slot to @filename, of MAX_FILENAME_LENGTH bytes.
+ * Returns FALSE if the filename was modified during each attempt.
+ */
+static gboolean
+worker_slot_get_filename (WorkerSlot *slot,
+                          gchar      *filename)
+{
+  guint attempt_num;
+
+  for (attempt_num = 0; attempt_num < MAX_READ_ATTEMPTS; attempt_num++)
+    {
+      gint sequence = g_atomic_int_get (&slot->sequence);
+
+      if (sequence % 2 == 0)
+        {
+          memcpy (filename, slot->filename, MAX_FILENAME_LENGTH);
+
+          if (g_atomic_int_get (&slot->sequence) == sequence)
+            {
+              filename[MAX_FILENAME_LENGTH - 1] = '\0';
+              return TRUE;
+            }
+        }
+
+      g_thread_yield ();
+    }
+
+  return FALSE;
+}
+
+static guint
+get_bucket_num (gint64 duration)
+{
+  guint64 value;
+  guint high_bit_num;
+  guint bucket_num;
+
+  value = CLAMP (duration, 0, G_MAXUINT32);
+  if (value < 8)
+    return value;
+
+  /* The position of the highest bit, and the two bits after it. */
+  high_bit_num = g_bit_storage (value) - 1;
+  bucket_num = (high_bit_num - 1) * 4 + ((value >> (high_bit_num - 2)) & 3);
+
+  return MIN (bucket_num, N_BUCKETS - 1);
+}
+
+/* The middle of the bucket, in microseconds. */
+static gdouble
+get_bucket_value (guint bucket_num)
+{
+  guint high_bit_num;
+  guint64 lower_bound;
+  guint64 width;
+
+  if (bucket_num < 8)
+    return bucket_num + 0.5;
+
+  high_bit_num = bucket_num / 4 + 1;
+  lower_bound = (guint64) (4 + bucket_num % 4) << (high_bit_num - 2);
+  width = G_GUINT64_CONSTANT (1) << (high_bit_num - 2);
+
+  return lower_bound + width / 2.0;
+}
+
+static void
+add_status (const gchar *status)
+{
+  guint i;
+
+  for (i = 0; i < MAX_STATUSES; i++)
+    {
+      StatusCounter *counter = &status_counters[i];
+      const gchar *counter_status;
+
+      counter_status = g_atomic_pointer_get (&counter->status);
+
+      /* The first thread with a new status takes a free counter. */
+      if (counter_status == NULL &&
+          g_atomic_pointer_compare_and_exchange (&counter->status, NULL, (gpointer) status))
+        counter_status = status;
+      else if (counter_status == NULL)
+        counter_status = g_atomic_pointer_get (&counter->status);
+
+      if (g_str_equal (counter_status, status))
+        {
+          g_atomic_int_inc (&counter->n_files);
+          return;
+        }
+    }
+
+  g_warn_if_reached ();
+}
+
+static void
+append_header (GString     *str,
+               const gchar *name,
+               const gchar *type,
+               const gchar *help)
+{
+  g_string_append_printf (str, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void
+append_label_value (GString     *str,
+                    const gchar *value)
+{
+  const gchar *p;
+
+  g_string_append_c (str, '"');
+
+  for (p = value; *p != '\0'; p++)
+    {
+      if (*p == '\\' || *p == '"')
+        {
+          g_string_append_c (str, '\\');
+          g_string_append_c (str, *p);
+        }
+      else if (*p == '\n')
+        g_string_append (str, "\\n");
+      else
+        g_string_append_c (str, *p);
+    }
+
+  g_string_append_c (str, '"');
+}
+
+/* Appends the name and the labels of a sample, without the closing brace. */
+static void
+append_sample_begin (GString     *str,
+                     const gchar *name)
+{
+  g_string_append_printf (str, "%s{program=", name);
+  append_label_value (str, metrics_program);
+}
+
+static void
+append_integer_sample (GString     *str,
+                       const gchar *name,
+                       guint64      value)
+{
+  append_sample_begin (str, name);
+  g_string_append_printf (str, "} %" G_GUINT64_FORMAT "\n", value);
+}
+
+/* Independent of the locale. */
+static void
+append_double (GString *str,
+               gdouble  value)
+{
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append (str, g_ascii_formatd (buffer, sizeof (buffer), "%.6f", value));
+}
+
+static void
+append_workers (GString *str)
+{
+  gchar filename[MAX_FILENAME_LENGTH];
+  guint i;
+
+  append_header (str, "gcu_worker_current_file", "gauge",
+                 "The file being processed by each thread (1), or nothing (0).");
+
+  g_mutex_lock (&worker_slots_mutex);
+
+  for (i = 0; i < worker_slots->len; i++)
+    {
+      WorkerSlot *slot = g_ptr_array_index (worker_slots, i);
+      gchar *display_name;
+
+      if (!worker_slot_get_filename (slot, filename))
+        continue;
+
+      display_name = g_filename_display_name (filename);
+
+      append_sample_begin (str, "gcu_worker_current_file");
+      g_string_append_printf (str, ",worker=\"%u\",file=", slot->thread_num);
+      append_label_value (str, display_name);
+      g_string_append (str, filename[0] != '\0' ? "} 1\n" : "} 0\n");
+
+      g_free (display_name);
+    }
+
+  g_mutex_unlock (&worker_slots_mutex);
+}
+
+static void
+append_durations (GString *str)
+{
+  static const struct
+  {
+    const gchar *label;
+    gdouble value;
+  } quantiles[] =
+  {
+    { "0.5", 0.5 },
+    { "0.99", 0.99 }
+  };
+  guint buckets[N_BUCKETS];
+  guint64 n_durations = 0;
+  guint i;
+
+  for (i = 0; i < N_BUCKETS; i++)
+    {
+      buckets[i] = g_atomic_int_get (&duration_buckets[i]);
+      n_durations += buckets[i];
+    }
+
+  append_header (str, "gcu_file_duration_seconds", "summary",
+                 "The time to process one file.");
+
+  for (i = 0; i < G_N_ELEMENTS (quantiles); i++)
+    {
+      guint64 rank;
+      guint64 n_below = 0;
+      guint bucket_num;
+
+      append_sample_begin (str, "gcu_file_duration_seconds");
+      g_string_append_printf (str, ",quantile=\"%s\"} ", quantiles[i].label);
+
+      if (n_durations == 0)
+        {
+          g_string_append (str, "NaN\n");
+          continue;
+        }
+
+      /* The smallest duration with at least this rank. */
+      rank = MAX (1, (guint64) (quantiles[i].value * n_durations + 0.5));
+
+      for (bucket_num = 0; bucket_num < N_BUCKETS - 1; bucket_num++)
+        {
+          n_below += buckets[bucket_num];
+          if (n_below >= rank)
+            break;
+        }
+
+      append_double (str, get_bucket_value (bucket_num) / G_USEC_PER_SEC);
+      g_string_append_c (str, '\n');
+    }
+
+  append_sample_begin (str, "gcu_file_duration_seconds_sum");
+  g_string_append (str, "} ");
+  append_double (str, (gdouble) (gsize) g_atomic_pointer_get (&duration_sum) / G_USEC_PER_SEC);
+  g_string_append_c (str, '\n');
+
+  append_integer_sample (str, "gcu_file_duration_seconds_count", n_durations);
+}
+
+static gboolean
+write_metrics_file (GError **error)
+{
+  GString *str;
+  guint n_queued;
+  guint n_started;
+  guint n_done;
+  gboolean ok;
+  guint i;
+
+  /* In this order, so that the differences are not negative. */
+  n_done = g_atomic_int_get (&n_files_done);
+  n_started = g_atomic_int_get (&n_files_started);
+  n_queued = g_atomic_int_get (&n_files_queued);
+
+  str = g_string_new (NULL);
+
+  append_header (str, "gcu_start_time_seconds", "gauge",
+                 "The start time of the run, since the Unix epoch.");
+  append_integer_sample (str, "gcu_start_time_seconds", metrics_start_real_time / G_USEC_PER_SEC);
+
+  append_header (str, "gcu_files_queued", "gauge",
+                 "The number of files waiting to be processed.");
+  append_integer_sample (str, "gcu_files_queued", n_queued > n_started ? n_queued - n_started : 0);
+
+  append_header (str, "gcu_files_in_progress", "gauge",
+                 "The number of files being processed.");
+  append_integer_sample (str, "gcu_files_in_progress", n_started - n_done);
+
+  append_header (str, "gcu_files_done_total", "counter",
+                 "The number of files processed, by status (\"changed\" for the files rewritten, \"skipped\" for the files over budget).");
+
+  for (i = 0; i < MAX_STATUSES; i++)
+    {
+      const gchar *status = g_atomic_pointer_get (&status_counters[i].status);
+
+      if (status == NULL)
+        break;
+
+      append_sample_begin (str, "gcu_files_done_total");
+      g_string_append (str, ",status=");
+      append_label_value (str, status);
+      g_string_append_printf (str, "} %d\n", g_atomic_int_get (&status_counters[i].n_files));
+    }
+
+  append_header (str, "gcu_bytes_done_total", "counter",
+                 "The total size of the files processed.");
+  append_integer_sample (str, "gcu_bytes_done_total", (gsize) g_atomic_pointer_get (&n_bytes_done));
+
+  append_header (str, "gcu_matches_total", "counter",
+                 "The number of matches in the files processed, for example function declarations.");
+  append_integer_sample (str, "gcu_matches_total", (gsize) g_atomic_pointer_get (&n_matches));
+
+  append_workers (str);
+  append_durations (str);
+
+  ok = g_file_set_contents (metrics_path, str->str, str->len, error);
+
+  g_string_free (str, TRUE);
+  return ok;
+}
+
+static gpointer
+writer_thread_func (gpointer data)
+{
+  g_mutex_lock (&writer_mutex);
+
+  while (!writer_stopping)
+    {
+      gint64 end_time = g_get_monotonic_time () + UPDATE_INTERVAL;
+
+      while (!writer_stopping &&
+             g_cond_wait_until (&writer_cond, &writer_mutex, end_time))
+        ;
+
+      if (writer_stopping)
+        break;
+
+      g_mutex_unlock (&writer_mutex);
+      write_metrics_file (&writer_error);
+      g_mutex_lock (&writer_mutex);
+
+      /* Don't repeat the error, it is returned by gcu_metrics_stop(). */
+      if (writer_error != NULL)
+        break;
+    }
+
+  g_mutex_unlock (&writer_mutex);
+  return NULL;
+}
+
+/* Starts a thread that writes the metrics to @path, until gcu_metrics_stop().
+ * @program is the value of the "program" label. Must be called from the main
+ * thread, before the other threads are created, and only once per process.
+ */
+gboolean
+gcu_metrics_start (const gchar  *program,
+                   const gchar  *path,
+                   GError      **error)
+{
+  g_return_val_if_fail (program != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (!metrics_started, FALSE);
+
+  metrics_program = g_strdup (program);
+  metrics_path = g_strdup (path);
+  metrics_start_real_time = g_get_real_time ();
+  worker_slots = g_ptr_array_new_with_free_func (g_free);
+  metrics_started = TRUE;
+
+  /* Fail early if the file cannot be written. */
+  if (!write_metrics_file (error))
+    {
+      g_clear_pointer (&metrics_program, g_free);
+      g_clear_pointer (&metrics_path, g_free);
+      g_clear_pointer (&worker_slots, g_ptr_array_unref);
+      return FALSE;
+    }
+
+  metrics_enabled = TRUE;
+  writer_thread = g_thread_new ("gcu-metrics", writer_thread_func, NULL);
+
+  return TRUE;
+}
+
+/* Stops the thread and writes the final metrics. Must be called when the other
+ * threads no longer process files.
+ */
+gboolean
+gcu_metrics_stop (GError **error)
+{
+  gboolean ok;
+
+  g_return_val_if_fail (metrics_enabled, FALSE);
+
+  g_mutex_lock (&writer_mutex);
+  writer_stopping = TRUE;
+  g_cond_signal (&writer_cond);
+  g_mutex_unlock (&writer_mutex);
+
+  g_thread_join (writer_thread);
+  writer_thread = NULL;
+  metrics_enabled = FALSE;
+
+  if (writer_error != NULL)
+    {
+      g_propagate_error (error, writer_error);
+      writer_error = NULL;
+      ok = FALSE;
+    }
+  else
+    {
+      ok = write_metrics_file (error);
+    }
+
+  g_clear_pointer (&metrics_program, g_free);
+  g_clear_pointer (&metrics_path, g_free);
+  /* The threads still point to their slot, but they are no longer used, since
+   * the metrics cannot be started again.
+   */
+  g_clear_pointer (&worker_slots, g_ptr_array_unref);
+
+  return ok;
+}
+
+/* To call when @n_files are added to the queue of the files to process. */
+void
+gcu_metrics_add_queued (guint n_files)
+{
+  if (metrics_enabled)
+    g_atomic_int_add (&n_files_queued, n_files);
+}
+
+/* To call when the current thread begins to process @filename.
+ *
+ * Returns: the begin time, to pass to gcu_metrics_file_end().
+ */
+gint64
+gcu_metrics_file_begin (const gchar *filename)
+{
+  if (!metrics_enabled)
+    return 0;
+
+  worker_slot_set_filename (get_worker_slot (), filename);
+  g_atomic_int_inc (&n_files_started);
+
+  return g_get_monotonic_time ();
+}
+
+/* To call when the current thread has processed its file. @n_bytes is the
+ * size of the file, or -1 if it could not be read. @status must be a static
+ * string, like the status of the results, e.g. "changed" or "skipped".
+ */
+void
+gcu_metrics_file_end (gint64       begin_time,
+                      gssize       n_bytes,
+                      const gchar *status)
+{
+  gint64 duration;
+
+  if (!metrics_enabled || begin_time == 0)
+    return;
+
+  duration = g_get_monotonic_time () - begin_time;
+
+  g_atomic_int_inc (&duration_buckets[get_bucket_num (duration)]);
+  g_atomic_pointer_add (&duration_sum, duration);
+
+  if (n_bytes > 0)
+    g_atomic_pointer_add (&n_bytes_done, n_bytes);
+
+  add_status (status);
+  g_atomic_int_inc (&n_files_done);
+
+  worker_slot_set_filename (get_worker_slot (), NULL);
+}
+
+void
+gcu_metrics_add_matches (guint n_matches_to_add)
+{
+  if (metrics_enabled)
+    g_atomic_pointer_add (&n_matches, n_matches_to_add);
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_METRICS_H
+#define GCU_METRICS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gboolean	gcu_metrics_start		(const gchar  *program,
+						 const gchar  *path,
+						 GError      **error);
+
+gboolean	gcu_metrics_stop		(GError      **error);
+
+void		gcu_metrics_add_queued		(guint         n_files);
+
+gint64		gcu_metrics_file_begin		(const gchar  *filename);
+
+void		gcu_metrics_file_end		(gint64        begin_time,
+						 gssize        n_bytes,
+						 const gchar  *status);
+
+void		gcu_metrics_add_matches		(guint         n_matches);
+
+G_END_DECLS
+
+#endif /* GCU_METRICS_H */
@@ -26,6 +26,33 @@
  *
  * Example:
  * $ ls *.[ch] | parallel gcu-multi-line-substitution license-header-old license-header-new
+ *
+ * If <file> is "-", stdin is read and the result is written to stdout, with
+ * the streaming mode below, so the script can be used in a pipeline (see
+ * gcu-filter.c).
+ *
+ * Streaming mode:
+ * $ gcu-multi-line-substitution --stream <search-text-file> <replacement-file> [<file>]
+ * The input is read by chunks of STREAM_CHUNK_SIZE bytes, and only the end of a
+ * chunk that can be the start of a match is kept for the next chunk. So the
+ * memory usage doesn't depend on the input size, which is useful for very big
+ * files. If <file> is not given or is "-", stdin is read and the result is
+ * written to stdout, through a buffer. Otherwise the result is written to a
+ * temporary file in the same directory, which is then renamed to <file>. The
+ * search is done on the bytes, the content is not interpreted as text.
+ *
+ * Tar mode:
+ * $ gcu-multi-line-substitution --tar [--max-memory=SIZE] <search-text-file> <replacement-file> < project.tar > new-project.tar
+ * Reads a tar archive on stdin and writes it on stdout, with the substitution
+ * done in the *.c and *.h files, without extracting it to the disk (see
+ * gcu-tar.c). The files are processed in memory, in parallel, and the search
+ * is done on the bytes, like in the streaming mode. For example, to change the
+ * license headers of a release tarball:
+ * $ xzcat project-1.0.tar.xz | gcu-multi-line-substitution --tar license-header-old license-header-new | xz > new-project-1.0.tar.xz
+ *
+ * With --max-memory=SIZE, like for gcu-lineup-parameters, the files in memory
+ * are limited to SIZE (with the K, M or G suffixes) in total, estimated from
+ * their sizes, and the big files are started first (see gcu-scheduler.c).
  */
 
 /* Note: yes, this script uses GTK+ and GtkSourceView, because
@@ -35,8 +62,20 @@
  * graphical text editor based on GtkSourceView.
  */
 #include <tepl/tepl.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <locale.h>
+#include <unistd.h>
+#include "gcu-budget.h"
+#include "gcu-filter.h"
+#include "gcu-tar.h"
+
+#define STREAM_CHUNK_SIZE (1024 * 1024)
 
 typedef struct _Sub Sub;
 struct _Sub
@@ -210,6 +249,269 @@ get_file_contents (const gchar *filename)
   return contents;
 }
 
+static const gchar *
+find_search_text (const gchar *haystack,
+                  gsize        haystack_length,
+                  const gchar *search_text,
+                  gsize        search_text_length)
+{
+  const gchar *pos = haystack;
+  const gchar *end = haystack + haystack_length;
+
+  while ((gsize) (end - pos) >= search_text_length)
+    {
+      pos = memchr (pos, search_text[0], end - pos - search_text_length + 1);
+      if (pos == NULL)
+        return NULL;
+
+      if (memcmp (pos, search_text, search_text_length) == 0)
+        return pos;
+
+      pos++;
+    }
+
+  return NULL;
+}
+
+static void
+write_to_output_stream (GOutputStream *output_stream,
+                        const gchar   *data,
+                        gsize          length)
+{
+  GError *error = NULL;
+
+  if (length == 0)
+    return;
+
+  g_output_stream_write_all (output_stream, data, length, NULL, NULL, &error);
+
+  if (error != NULL)
+    g_error ("Error when writing the output: %s", error->message);
+}
+
+/* Only the last (search_text_length - 1) bytes of the buffer are kept between
+ * two chunks, in case a match overlaps the two chunks.
+ */
+static void
+do_stream_substitution (const gchar   *search_text,
+                        const gchar   *replacement,
+                        GInputStream  *input_stream,
+                        GOutputStream *output_stream)
+{
+  gsize search_text_length;
+  gsize replacement_length;
+  gchar *buffer;
+  gsize buffer_length = 0;
+
+  g_assert (search_text != NULL);
+  g_assert (search_text[0] != '\0');
+  g_assert (replacement != NULL);
+
+  search_text_length = strlen (search_text);
+  replacement_length = strlen (replacement);
+
+  buffer = g_malloc (search_text_length + STREAM_CHUNK_SIZE);
+
+  while (TRUE)
+    {
+      const gchar *pos;
+      const gchar *end;
+      const gchar *match;
+      gsize bytes_read;
+      gsize kept_length;
+      GError *error = NULL;
+
+      g_input_stream_read_all (input_stream,
+                               buffer + buffer_length,
+                               STREAM_CHUNK_SIZE,
+                               &bytes_read,
+                               NULL,
+                               &error);
+
+      if (error != NULL)
+        g_error ("Error when reading the input: %s", error->message);
+
+      buffer_length += bytes_read;
+      pos = buffer;
+      end = buffer + buffer_length;
+
+      while ((match = find_search_text (pos, end - pos, search_text, search_text_length)) != NULL)
+        {
+          write_to_output_stream (output_stream, pos, match - pos);
+          write_to_output_stream (output_stream, replacement, replacement_length);
+          pos = match + search_text_length;
+        }
+
+      /* End of input. */
+      if (bytes_read < STREAM_CHUNK_SIZE)
+        {
+          write_to_output_stream (output_stream, pos, end - pos);
+          break;
+        }
+
+      kept_length = MIN ((gsize) (end - pos), search_text_length - 1);
+      write_to_output_stream (output_stream, pos, end - pos - kept_length);
+
+      memmove (buffer, end - kept_length, kept_length);
+      buffer_length = kept_length;
+    }
+
+  g_free (buffer);
+}
+
+typedef struct _TarSub TarSub;
+struct _TarSub
+{
+  const gchar *search_text;
+  const gchar *replacement;
+};
+
+/* Called from the threads of the tar filter. */
+static gboolean
+tar_transform (const gchar *path,
+               const gchar *contents,
+               gsize        length,
+               GString     *new_contents,
+               gpointer     user_data)
+{
+  const TarSub *tar_sub = user_data;
+  gsize search_text_length = strlen (tar_sub->search_text);
+  const gchar *pos = contents;
+  const gchar *end = contents + length;
+  const gchar *match;
+  gboolean changed = FALSE;
+
+  while ((match = find_search_text (pos, end - pos, tar_sub->search_text, search_text_length)) != NULL)
+    {
+      g_string_append_len (new_contents, pos, match - pos);
+      g_string_append (new_contents, tar_sub->replacement);
+      pos = match + search_text_length;
+      changed = TRUE;
+    }
+
+  if (changed)
+    g_string_append_len (new_contents, pos, end - pos);
+
+  return changed;
+}
+
+static void
+tar_substitution (const gchar *search_text,
+                  const gchar *replacement,
+                  guint64      max_memory)
+{
+  const gchar *suffixes[] = { ".c", ".h", NULL };
+  TarSub tar_sub;
+  GError *error = NULL;
+
+  g_assert (search_text[0] != '\0');
+
+  tar_sub.search_text = search_text;
+  tar_sub.replacement = replacement;
+
+  gcu_tar_filter (STDIN_FILENO,
+                  STDOUT_FILENO,
+                  suffixes,
+                  g_get_num_processors (),
+                  max_memory,
+                  tar_transform,
+                  &tar_sub,
+                  &error);
+
+  if (error != NULL)
+    g_error ("Error when filtering the tar archive: %s", error->message);
+}
+
+/* Returns an output stream to a new temporary file in the same directory as
+ * @filename, with the same permissions. The path of the temporary file is
+ * returned in @tmp_filename.
+ */
+static GOutputStream *
+create_tmp_file (const gchar  *filename,
+                 gchar       **tmp_filename)
+{
+  gchar *dirname;
+  gchar *basename;
+  gchar *tmp_basename;
+  GStatBuf file_stat;
+  gint fd;
+
+  dirname = g_path_get_dirname (filename);
+  basename = g_path_get_basename (filename);
+  tmp_basename = g_strdup_printf (".%s.XXXXXX", basename);
+  *tmp_filename = g_build_filename (dirname, tmp_basename, NULL);
+
+  fd = g_mkstemp (*tmp_filename);
+  if (fd == -1)
+    g_error ("Impossible to create a temporary file for %s: %s",
+             filename,
+             g_strerror (errno));
+
+  if (g_stat (filename, &file_stat) == 0)
+    fchmod (fd, file_stat.st_mode & 07777);
+
+  g_free (dirname);
+  g_free (basename);
+  g_free (tmp_basename);
+
+  return g_unix_output_stream_new (fd, TRUE);
+}
+
+static void
+stream_substitution (const gchar *search_text,
+                     const gchar *replacement,
+                     const gchar *filename)
+{
+  GInputStream *input_stream;
+  GOutputStream *output_stream;
+  gchar *tmp_filename = NULL;
+  GError *error = NULL;
+
+  if (filename == NULL || g_str_equal (filename, "-"))
+    {
+      input_stream = g_unix_input_stream_new (STDIN_FILENO, FALSE);
+      output_stream = gcu_filter_get_stdout_stream ();
+    }
+  else
+    {
+      GFile *location;
+
+      location = g_file_new_for_commandline_arg (filename);
+      input_stream = G_INPUT_STREAM (g_file_read (location, NULL, &error));
+      g_object_unref (location);
+
+      if (error != NULL)
+        g_error ("Error when loading file: %s", error->message);
+
+      output_stream = create_tmp_file (filename, &tmp_filename);
+    }
+
+  do_stream_substitution (search_text, replacement, input_stream, output_stream);
+
+  g_input_stream_close (input_stream, NULL, NULL);
+  g_output_stream_close (output_stream, NULL, &error);
+
+  if (error != NULL)
+    g_error ("Error when saving file: %s", error->message);
+
+  if (tmp_filename != NULL &&
+      g_rename (tmp_filename, filename) == -1)
+    g_error ("Error when saving file: %s", g_strerror (errno));
+
+  g_object_unref (input_stream);
+  g_object_unref (output_stream);
+  g_free (tmp_filename);
+}
+
+static void
+print_usage (gchar **argv)
+{
+  g_printerr ("Usage: %s <search-text-file> <replacement-file> <file or ->\n", argv[0]);
+  g_printerr ("       %s --stream <search-text-file> <replacement-file> [<file>]\n", argv[0]);
+  g_printerr ("       %s --tar [--max-memory=SIZE] <search-text-file> <replacement-file> < project.tar > new-project.tar\n", argv[0]);
+  g_printerr ("WARNING: the script directly modifies <file> without doing a backup first!\n");
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
@@ -223,12 +525,81 @@ main (gint   argc,
 
   setlocale (LC_ALL, "");
 
+  /* The streaming mode doesn't need GTK. */
+  if (argc >= 2 && g_str_equal (argv[1], "--stream"))
+    {
+      if (argc != 4 && argc != 5)
+        {
+          print_usage (argv);
+          return EXIT_FAILURE;
+        }
+
+      search_text = get_file_contents (argv[2]);
+      replacement = get_file_contents (argv[3]);
+
+      stream_substitution (search_text, replacement, argc == 5 ? argv[4] : NULL);
+
+      g_free (search_text);
+      g_free (replacement);
+      return EXIT_SUCCESS;
+    }
+
+  /* The tar mode doesn't need GTK either. */
+  if (argc >= 2 && g_str_equal (argv[1], "--tar"))
+    {
+      gint arg_num = 2;
+      gsize max_memory = 0;
+
+      if (arg_num < argc && g_str_has_prefix (argv[arg_num], "--max-memory="))
+        {
+          const gchar *max_memory_spec = argv[arg_num] + strlen ("--max-memory=");
+
+          if (!gcu_budget_parse_size (max_memory_spec, &max_memory))
+            {
+              g_printerr ("Invalid --max-memory size: %s\n", max_memory_spec);
+              print_usage (argv);
+              return EXIT_FAILURE;
+            }
+
+          arg_num++;
+        }
+
+      if (argc - arg_num != 2)
+        {
+          print_usage (argv);
+          return EXIT_FAILURE;
+        }
+
+      search_text = get_file_contents (argv[arg_num]);
+      replacement = get_file_contents (argv[arg_num + 1]);
+
+      tar_substitution (search_text, replacement, max_memory);
+
+      g_free (search_text);
+      g_free (replacement);
+      return EXIT_SUCCESS;
+    }
+
+  /* For stdin, the streaming mode is used too, it doesn't need the whole input
+   * in memory.
+   */
+  if (argc == 4 && g_str_equal (argv[3], "-"))
+    {
+      search_text = get_file_contents (argv[1]);
+      replacement = get_file_contents (argv[2]);
+
+      stream_substitution (search_text, replacement, NULL);
+
+      g_free (search_text);
+      g_free (replacement);
+      return EXIT_SUCCESS;
+    }
+
   gtk_init (NULL, NULL);
 
   if (argc != 4)
     {
-      g_printerr ("Usage: %s <search-text-file> <replacement-file> <file>\n", argv[0]);
-      g_printerr ("WARNING: the script directly modifies <file> without doing a backup first!\n");
+      print_usage (argv);
       return EXIT_FAILURE;
     }
 
@@ -0,0 +1,839 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "gcu-profile.h"
+#include <errno.h>
+#include <string.h>
+
+#ifdef HAVE_PROFILER
+#include <dlfcn.h>
+#include <elf.h>
+#include <execinfo.h>
+#include <link.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+ * Sampling profiler, for the machines where perf is not available. The
+ * samples are written to a file in the folded stacks format, one stack per
+ * line with its number of samples, which is the input of flamegraph.pl
+ * (https://github.com/brendangregg/FlameGraph) or of
+ * https://www.speedscope.app/, for example:
+ *
+ * worker 2;parse;src/frobnitz.c;start_thread;...;g_regex_match_full 42
+ *
+ * The first frame is the thread, "main" or "worker N", then the phase and the
+ * file given by gcu_profile_set_phase(), if any, and the stack of functions.
+ *
+ * Each thread that calls gcu_profile_set_phase() gets a timer on its own CPU
+ * time (timer_create() with CLOCK_THREAD_CPUTIME_ID), which sends SIGPROF to
+ * that thread SAMPLING_FREQUENCY times per second of CPU. So a thread that
+ * waits is not sampled, and the number of samples of a stack is proportional
+ * to the CPU time spent in it. The signal handler walks the stack with
+ * backtrace(), which uses the unwinding tables and doesn't need the frame
+ * pointers, and writes the sample in a ring buffer of the thread, without
+ * locking and without allocating memory. A collector thread empties the ring
+ * buffers every COLLECT_INTERVAL, and counts the samples of each stack, per
+ * thread. If a ring buffer is full, the sample is dropped and counted in a
+ * "[dropped]" stack.
+ *
+ * The addresses are converted to function names only by gcu_profile_stop():
+ * with the symbol table of the executable, read from /proc/self/exe, for its
+ * static functions, and with dladdr() for the shared libraries, whose static
+ * functions are then named after a preceding exported function, or as
+ * library+offset.
+ *
+ * The overhead is a backtrace() per sample, of a few microseconds, so about
+ * 0.1% of the CPU time at the default frequency.
+ *
+ * Linux-specific, for the timers that send a signal to a given thread. When
+ * the profile is not started, gcu_profile_set_phase() does nothing.
+ */
+
+/* Per second of CPU time. Not a round number, so that the samples are not in
+ * lockstep with a periodic activity of the program.
+ */
+#define SAMPLING_FREQUENCY (99)
+
+#define MAX_FRAMES (64)
+
+/* The signal handler, and the signal trampoline of the kernel. */
+#define SKIPPED_FRAMES (2)
+
+/* About 2.5 seconds of samples. */
+#define RING_SIZE (256)
+
+#define COLLECT_INTERVAL (100 * 1000)
+
+#ifdef HAVE_PROFILER
+
+#if __ELF_NATIVE_CLASS == 64
+#define NATIVE_ELF_CLASS ELFCLASS64
+#define NATIVE_ELF_ST_TYPE ELF64_ST_TYPE
+#else
+#define NATIVE_ELF_CLASS ELFCLASS32
+#define NATIVE_ELF_ST_TYPE ELF32_ST_TYPE
+#endif
+
+/* Missing from older versions of glibc. */
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+typedef struct
+{
+  /* Static string. */
+  const gchar *phase;
+
+  /* Interned string. */
+  const gchar *filename;
+
+  gint n_frames;
+  gpointer frames[MAX_FRAMES];
+} Sample;
+
+typedef struct
+{
+  guint thread_num;
+  timer_t timer;
+  gboolean has_timer;
+
+  /* Written by the thread, and read by its signal handler. */
+  gpointer phase;
+  gpointer filename;
+
+  /* Written by the signal handler from @head, and read by the collector thread
+   * from @tail. The indexes only increase, modulo 2^32.
+   */
+  Sample samples[RING_SIZE];
+  gint head;
+  gint tail;
+  gint n_dropped;
+
+  /* Owned by the collector thread. The keys are GBytes with the phase, the
+   * filename and the frames of a Sample, the values are the numbers of
+   * samples.
+   */
+  GHashTable *stack_counts;
+} ThreadProfile;
+
+typedef struct
+{
+  guintptr start;
+  guintptr size;
+
+  /* Owned by the GMappedFile. */
+  const gchar *name;
+} ExecutableSymbol;
+
+typedef struct
+{
+  gpointer executable_base;
+
+  /* Whether the symbol addresses are relative to @executable_base, for a
+   * position-independent executable.
+   */
+  gboolean relative_addresses;
+
+  GMappedFile *executable_file;
+
+  /* Sorted by start address. */
+  GArray *executable_symbols;
+
+  /* Address -> function name. */
+  GHashTable *names;
+} Symbolizer;
+
+static gint profile_enabled;
+static gboolean profile_started;
+static gchar *profile_path;
+
+static GMutex profiles_mutex;
+static GPtrArray *profiles;
+
+/* The ThreadProfile of the current thread, owned by profiles. Not a GPrivate,
+ * because it is read from the signal handler.
+ */
+static __thread ThreadProfile *current_thread_profile;
+
+static GThread *collector_thread;
+static GMutex collector_mutex;
+static GCond collector_cond;
+static gboolean collector_stopping;
+
+static void
+thread_profile_free (ThreadProfile *profile)
+{
+  g_hash_table_unref (profile->stack_counts);
+  g_free (profile);
+}
+
+/* Registers the current thread, and starts its timer. */
+static ThreadProfile *
+get_thread_profile (void)
+{
+  ThreadProfile *profile;
+  struct sigevent event;
+  struct itimerspec interval;
+
+  profile = current_thread_profile;
+  if (profile != NULL)
+    return profile;
+
+  profile = g_new0 (ThreadProfile, 1);
+  profile->stack_counts = g_hash_table_new_full (g_bytes_hash,
+                                                 g_bytes_equal,
+                                                 (GDestroyNotify) g_bytes_unref,
+                                                 NULL);
+
+  g_mutex_lock (&profiles_mutex);
+  profile->thread_num = profiles->len;
+  g_ptr_array_add (profiles, profile);
+  g_mutex_unlock (&profiles_mutex);
+
+  /* Before the first signal. */
+  current_thread_profile = profile;
+
+  memset (&event, 0, sizeof (event));
+  event.sigev_notify = SIGEV_THREAD_ID;
+  event.sigev_signo = SIGPROF;
+  event.sigev_notify_thread_id = syscall (SYS_gettid);
+
+  if (timer_create (CLOCK_THREAD_CPUTIME_ID, &event, &profile->timer) != 0)
+    {
+      g_warning ("Failed to create the profiling timer of a thread: %s", g_strerror (errno));
+      return profile;
+    }
+
+  interval.it_interval.tv_sec = 0;
+  interval.it_interval.tv_nsec = 1000 * 1000 * 1000 / SAMPLING_FREQUENCY;
+  interval.it_value = interval.it_interval;
+
+  timer_settime (profile->timer, 0, &interval, NULL);
+  profile->has_timer = TRUE;
+
+  return profile;
+}
+
+static void
+profile_signal_handler (gint signal_num)
+{
+  ThreadProfile *profile;
+  gint saved_errno = errno;
+  guint head;
+
+  if (!g_atomic_int_get (&profile_enabled))
+    return;
+
+  profile = current_thread_profile;
+  if (profile == NULL)
+    return;
+
+  head = profile->head;
+
+  if (head - (guint) g_atomic_int_get (&profile->tail) >= RING_SIZE)
+    {
+      g_atomic_int_inc (&profile->n_dropped);
+    }
+  else
+    {
+      Sample *sample = &profile->samples[head % RING_SIZE];
+
+      sample->phase = g_atomic_pointer_get (&profile->phase);
+      sample->filename = g_atomic_pointer_get (&profile->filename);
+      sample->n_frames = backtrace (sample->frames, MAX_FRAMES);
+
+      /* Publishes the sample to the collector thread. */
+      g_atomic_int_set (&profile->head, (gint) (head + 1));
+    }
+
+  errno = saved_errno;
+}
+
+static void
+count_sample (ThreadProfile *profile,
+              const Sample  *sample)
+{
+  gpointer key[2 + MAX_FRAMES];
+  gint n_frames;
+  GBytes *stack;
+  guint count;
+
+  n_frames = MAX (sample->n_frames - SKIPPED_FRAMES, 0);
+
+  key[0] = (gpointer) sample->phase;
+  key[1] = (gpointer) sample->filename;
+  memcpy (key + 2, sample->frames + SKIPPED_FRAMES, n_frames * sizeof (gpointer));
+
+  stack = g_bytes_new (key, (2 + n_frames) * sizeof (gpointer));
+  count = GPOINTER_TO_UINT (g_hash_table_lookup (profile->stack_counts, stack));
+
+  /* Frees @stack if it is already a key. */
+  g_hash_table_insert (profile->stack_counts, stack, GUINT_TO_POINTER (count + 1));
+}
+
+static void
+collect_samples (void)
+{
+  guint profile_num;
+
+  g_mutex_lock (&profiles_mutex);
+
+  for (profile_num = 0; profile_num < profiles->len; profile_num++)
+    {
+      ThreadProfile *profile = g_ptr_array_index (profiles, profile_num);
+      guint head = g_atomic_int_get (&profile->head);
+      guint tail;
+
+      for (tail = profile->tail; tail != head; tail++)
+        count_sample (profile, &profile->samples[tail % RING_SIZE]);
+
+      /* Gives the slots back to the signal handler. */
+      g_atomic_int_set (&profile->tail, (gint) tail);
+    }
+
+  g_mutex_unlock (&profiles_mutex);
+}
+
+static gpointer
+collector_thread_func (gpointer data)
+{
+  g_mutex_lock (&collector_mutex);
+
+  while (!collector_stopping)
+    {
+      gint64 end_time = g_get_monotonic_time () + COLLECT_INTERVAL;
+
+      while (!collector_stopping &&
+             g_cond_wait_until (&collector_cond, &collector_mutex, end_time))
+        ;
+
+      if (collector_stopping)
+        break;
+
+      g_mutex_unlock (&collector_mutex);
+      collect_samples ();
+      g_mutex_lock (&collector_mutex);
+    }
+
+  g_mutex_unlock (&collector_mutex);
+  return NULL;
+}
+
+static gint
+compare_executable_symbols (gconstpointer a,
+                            gconstpointer b)
+{
+  const ExecutableSymbol *symbol1 = a;
+  const ExecutableSymbol *symbol2 = b;
+
+  if (symbol1->start < symbol2->start)
+    return -1;
+  if (symbol1->start > symbol2->start)
+    return 1;
+  return 0;
+}
+
+/* The sections are checked to be inside the file, but otherwise the file is
+ * trusted, it is the running program. Without a symbol table (a stripped
+ * executable), dladdr() is used like for the libraries.
+ */
+static void
+load_executable_symbols (Symbolizer *symbolizer)
+{
+  Dl_info info;
+  const gchar *contents;
+  gsize size;
+  const ElfW(Ehdr) *header;
+  const ElfW(Shdr) *sections;
+  guint section_num;
+
+  if (dladdr ((gpointer) gcu_profile_start, &info) == 0)
+    return;
+
+  symbolizer->executable_base = info.dli_fbase;
+
+  symbolizer->executable_file = g_mapped_file_new ("/proc/self/exe", FALSE, NULL);
+  if (symbolizer->executable_file == NULL)
+    return;
+
+  contents = g_mapped_file_get_contents (symbolizer->executable_file);
+  size = g_mapped_file_get_length (symbolizer->executable_file);
+
+  if (size < sizeof (ElfW(Ehdr)))
+    return;
+
+  header = (const ElfW(Ehdr) *) contents;
+
+  if (memcmp (header->e_ident, ELFMAG, SELFMAG) != 0 ||
+      header->e_ident[EI_CLASS] != NATIVE_ELF_CLASS ||
+      header->e_shentsize != sizeof (ElfW(Shdr)) ||
+      header->e_shoff > size ||
+      header->e_shnum > (size - header->e_shoff) / sizeof (ElfW(Shdr)))
+    return;
+
+  symbolizer->relative_addresses = header->e_type == ET_DYN;
+  sections = (const ElfW(Shdr) *) (contents + header->e_shoff);
+
+  for (section_num = 0; section_num < header->e_shnum; section_num++)
+    {
+      const ElfW(Shdr) *section = &sections[section_num];
+      const ElfW(Shdr) *strings_section;
+      const ElfW(Sym) *symbols;
+      const gchar *strings;
+      gsize n_symbols;
+      gsize symbol_num;
+
+      if (section->sh_type != SHT_SYMTAB ||
+          section->sh_link >= header->e_shnum ||
+          section->sh_offset > size ||
+          section->sh_size > size - section->sh_offset)
+        continue;
+
+      strings_section = &sections[section->sh_link];
+
+      if (strings_section->sh_offset > size ||
+          strings_section->sh_size == 0 ||
+          strings_section->sh_size > size - strings_section->sh_offset)
+        continue;
+
+      strings = contents + strings_section->sh_offset;
+      if (strings[strings_section->sh_size - 1] != '\0')
+        continue;
+
+      symbols = (const ElfW(Sym) *) (contents + section->sh_offset);
+      n_symbols = section->sh_size / sizeof (ElfW(Sym));
+
+      for (symbol_num = 0; symbol_num < n_symbols; symbol_num++)
+        {
+          const ElfW(Sym) *symbol = &symbols[symbol_num];
+          ExecutableSymbol executable_symbol;
+
+          if (NATIVE_ELF_ST_TYPE (symbol->st_info) != STT_FUNC ||
+              symbol->st_value == 0 ||
+              symbol->st_name >= strings_section->sh_size)
+            continue;
+
+          executable_symbol.start = symbol->st_value;
+          executable_symbol.size = symbol->st_size;
+          executable_symbol.name = strings + symbol->st_name;
+          g_array_append_val (symbolizer->executable_symbols, executable_symbol);
+        }
+    }
+
+  g_array_sort (symbolizer->executable_symbols, compare_executable_symbols);
+}
+
+static void
+symbolizer_init (Symbolizer *symbolizer)
+{
+  memset (symbolizer, 0, sizeof (Symbolizer));
+  symbolizer->executable_symbols = g_array_new (FALSE, FALSE, sizeof (ExecutableSymbol));
+  symbolizer->names = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  load_executable_symbols (symbolizer);
+}
+
+static void
+symbolizer_clear (Symbolizer *symbolizer)
+{
+  g_array_unref (symbolizer->executable_symbols);
+  g_hash_table_unref (symbolizer->names);
+
+  if (symbolizer->executable_file != NULL)
+    g_mapped_file_unref (symbolizer->executable_file);
+}
+
+/* Returns: (nullable): the function of the executable containing @address. */
+static const gchar *
+lookup_executable_symbol (Symbolizer *symbolizer,
+                          gpointer    address)
+{
+  GArray *symbols = symbolizer->executable_symbols;
+  const ExecutableSymbol *symbol;
+  guintptr offset;
+  guint low = 0;
+  guint high = symbols->len;
+
+  offset = (guintptr) address;
+  if (symbolizer->relative_addresses)
+    offset -= (guintptr) symbolizer->executable_base;
+
+  /* The first symbol after @offset. */
+  while (low < high)
+    {
+      guint middle = low + (high - low) / 2;
+
+      if (g_array_index (symbols, ExecutableSymbol, middle).start <= offset)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  if (low == 0)
+    return NULL;
+
+  symbol = &g_array_index (symbols, ExecutableSymbol, low - 1);
+  if (symbol->size != 0 && offset >= symbol->start + symbol->size)
+    return NULL;
+
+  return symbol->name;
+}
+
+static gchar *
+get_function_name (Symbolizer *symbolizer,
+                   gpointer    address)
+{
+  Dl_info info;
+  const gchar *module_name;
+
+  if (dladdr (address, &info) == 0)
+    return g_strdup ("[unknown]");
+
+  if (info.dli_fbase == symbolizer->executable_base)
+    {
+      const gchar *name = lookup_executable_symbol (symbolizer, address);
+
+      if (name != NULL)
+        return g_strdup (name);
+    }
+
+  if (info.dli_sname != NULL)
+    return g_strdup (info.dli_sname);
+
+  module_name = info.dli_fname != NULL ? strrchr (info.dli_fname, '/') : NULL;
+  module_name = module_name != NULL ? module_name + 1 : g_get_prgname ();
+
+  return g_strdup_printf ("%s+0x%" G_GINTPTR_MODIFIER "x",
+                          module_name,
+                          (guintptr) address - (guintptr) info.dli_fbase);
+}
+
+/* @address is a return address, except for the leaf frame: the address of
+ * the call instruction, just before, is in the right function even when the
+ * call is the last instruction of the function.
+ */
+static const gchar *
+symbolize (Symbolizer *symbolizer,
+           gpointer    address,
+           gboolean    leaf)
+{
+  gchar *name;
+
+  if (!leaf)
+    address = (gpointer) ((guintptr) address - 1);
+
+  name = g_hash_table_lookup (symbolizer->names, address);
+  if (name == NULL)
+    {
+      name = get_function_name (symbolizer, address);
+      g_hash_table_insert (symbolizer->names, address, name);
+    }
+
+  return name;
+}
+
+/* A ';' would start a new frame. */
+static void
+append_frame (GString     *str,
+              const gchar *frame)
+{
+  const gchar *p;
+
+  g_string_append_c (str, ';');
+
+  for (p = frame; *p != '\0'; p++)
+    g_string_append_c (str, *p == ';' || *p == '\n' ? '_' : *p);
+}
+
+static void
+add_folded_stack (GHashTable *folded_stacks,
+                  GString    *str,
+                  guint       count)
+{
+  guint prev_count;
+
+  prev_count = GPOINTER_TO_UINT (g_hash_table_lookup (folded_stacks, str->str));
+  g_hash_table_insert (folded_stacks,
+                       g_strdup (str->str),
+                       GUINT_TO_POINTER (prev_count + count));
+}
+
+/* Several addresses can give the same stack of function names, so the folded
+ * stacks are counted again.
+ */
+static void
+fold_stacks (ThreadProfile *profile,
+             Symbolizer    *symbolizer,
+             GHashTable    *folded_stacks)
+{
+  GString *thread_name;
+  GString *str;
+  GHashTableIter iter;
+  gpointer key;
+  gpointer value;
+
+  thread_name = g_string_new (NULL);
+  if (profile->thread_num == 0)
+    g_string_append (thread_name, "main");
+  else
+    g_string_append_printf (thread_name, "worker %u", profile->thread_num);
+
+  str = g_string_new (NULL);
+
+  g_hash_table_iter_init (&iter, profile->stack_counts);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      gsize size;
+      gpointer const *stack = g_bytes_get_data (key, &size);
+      gint n_frames = size / sizeof (gpointer) - 2;
+      gint frame_num;
+
+      g_string_assign (str, thread_name->str);
+
+      if (stack[0] != NULL)
+        {
+          append_frame (str, stack[0]);
+
+          if (stack[1] != NULL)
+            append_frame (str, stack[1]);
+        }
+
+      /* From the root to the leaf. */
+      for (frame_num = n_frames - 1; frame_num >= 0; frame_num--)
+        append_frame (str, symbolize (symbolizer, stack[2 + frame_num], frame_num == 0));
+
+      add_folded_stack (folded_stacks, str, GPOINTER_TO_UINT (value));
+    }
+
+  if (profile->n_dropped > 0)
+    {
+      g_string_assign (str, thread_name->str);
+      append_frame (str, "[dropped]");
+      add_folded_stack (folded_stacks, str, profile->n_dropped);
+    }
+
+  g_string_free (thread_name, TRUE);
+  g_string_free (str, TRUE);
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  const gchar * const *str1 = a;
+  const gchar * const *str2 = b;
+
+  return strcmp (*str1, *str2);
+}
+
+static gboolean
+write_folded_stacks (GError **error)
+{
+  Symbolizer symbolizer;
+  GHashTable *folded_stacks;
+  GPtrArray *lines;
+  GString *contents;
+  GHashTableIter iter;
+  gpointer key;
+  guint i;
+  gboolean ok;
+
+  symbolizer_init (&symbolizer);
+  folded_stacks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  for (i = 0; i < profiles->len; i++)
+    fold_stacks (g_ptr_array_index (profiles, i), &symbolizer, folded_stacks);
+
+  lines = g_ptr_array_new ();
+
+  g_hash_table_iter_init (&iter, folded_stacks);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_ptr_array_add (lines, key);
+
+  /* To be stable between runs. */
+  g_ptr_array_sort (lines, compare_strings);
+
+  contents = g_string_new (NULL);
+
+  for (i = 0; i < lines->len; i++)
+    {
+      const gchar *line = g_ptr_array_index (lines, i);
+
+      g_string_append_printf (contents,
+                              "%s %u\n",
+                              line,
+                              GPOINTER_TO_UINT (g_hash_table_lookup (folded_stacks, line)));
+    }
+
+  ok = g_file_set_contents (profile_path, contents->str, contents->len, error);
+
+  g_string_free (contents, TRUE);
+  g_ptr_array_unref (lines);
+  g_hash_table_unref (folded_stacks);
+  symbolizer_clear (&symbolizer);
+
+  return ok;
+}
+
+#endif /* HAVE_PROFILER */
+
+/* Starts sampling the main thread, and the other threads once they call
+ * gcu_profile_set_phase(). The folded stacks are written to @path by
+ * gcu_profile_stop(). Must be called from the main thread, before the other
+ * threads are created, and only once per process.
+ */
+gboolean
+gcu_profile_start (const gchar  *path,
+                   GError      **error)
+{
+#ifdef HAVE_PROFILER
+  struct sigaction action;
+  gpointer frames[1];
+
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (!profile_started, FALSE);
+
+  /* Fail early if the file cannot be written. */
+  if (!g_file_set_contents (path, "", 0, error))
+    return FALSE;
+
+  /* The first call of backtrace() loads libgcc_s, which is not possible in a
+   * signal handler.
+   */
+  backtrace (frames, G_N_ELEMENTS (frames));
+
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = profile_signal_handler;
+  action.sa_flags = SA_RESTART;
+  sigemptyset (&action.sa_mask);
+
+  if (sigaction (SIGPROF, &action, NULL) != 0)
+    {
+      gint saved_errno = errno;
+
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   g_file_error_from_errno (saved_errno),
+                   "Failed to install the SIGPROF handler: %s",
+                   g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  profile_path = g_strdup (path);
+  profiles = g_ptr_array_new_with_free_func ((GDestroyNotify) thread_profile_free);
+  profile_started = TRUE;
+  g_atomic_int_set (&profile_enabled, TRUE);
+
+  get_thread_profile ();
+  collector_thread = g_thread_new ("gcu-profile", collector_thread_func, NULL);
+
+  return TRUE;
+#else
+  g_set_error (error,
+               G_FILE_ERROR,
+               G_FILE_ERROR_NOSYS,
+               "Profiling is not supported on this platform.");
+  return FALSE;
+#endif
+}
+
+/* Stops the sampling and writes the folded stacks. Must be called when the
+ * other threads no longer process files.
+ */
+gboolean
+gcu_profile_stop (GError **error)
+{
+#ifdef HAVE_PROFILER
+  struct sigaction action;
+  gboolean ok;
+  guint i;
+
+  g_return_val_if_fail (g_atomic_int_get (&profile_enabled), FALSE);
+
+  g_atomic_int_set (&profile_enabled, FALSE);
+
+  for (i = 0; i < profiles->len; i++)
+    {
+      ThreadProfile *profile = g_ptr_array_index (profiles, i);
+
+      if (profile->has_timer)
+        timer_delete (profile->timer);
+    }
+
+  /* A signal can still be pending. */
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = SIG_IGN;
+  sigemptyset (&action.sa_mask);
+  sigaction (SIGPROF, &action, NULL);
+
+  g_mutex_lock (&collector_mutex);
+  collector_stopping = TRUE;
+  g_cond_signal (&collector_cond);
+  g_mutex_unlock (&collector_mutex);
+
+  g_thread_join (collector_thread);
+  collector_thread = NULL;
+
+  /* The last samples. */
+  collect_samples ();
+
+  ok = write_folded_stacks (error);
+
+  g_clear_pointer (&profile_path, g_free);
+  /* The threads still point to their profile, but they are no longer used,
+   * since the profile cannot be started again.
+   */
+  g_clear_pointer (&profiles, g_ptr_array_unref);
+
+  return ok;
+#else
+  g_return_val_if_reached (FALSE);
+#endif
+}
+
+/* Attributes the next samples of the current thread to @phase, a static
+ * string, and to @filename. Both can be %NULL, for example when the thread
+ * has finished a file.
+ */
+void
+gcu_profile_set_phase (const gchar *phase,
+                       const gchar *filename)
+{
+#ifdef HAVE_PROFILER
+  ThreadProfile *profile;
+
+  if (!g_atomic_int_get (&profile_enabled))
+    return;
+
+  profile = get_thread_profile ();
+
+  /* The signal handler can interrupt this function, so the phase is unset
+   * while the filename changes.
+   */
+  g_atomic_pointer_set (&profile->phase, NULL);
+  g_atomic_pointer_set (&profile->filename, (gpointer) g_intern_string (filename));
+  g_atomic_pointer_set (&profile->phase, (gpointer) phase);
+#endif
+}
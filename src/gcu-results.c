@@ -0,0 +1,618 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-results.h"
+#include <gio/gio.h>
+#include <string.h>
+#include "gcu-json.h"
+
+/*
+ * The results of a run on a shard (see gcu-shard.c), saved as a JSON file with
+ * --results=FILE, so that gcu-merge-results can combine the results of all the
+ * shards, as if the tool had been run once on all the files:
+ *
+ * {"tool":"gcu-lineup-parameters","shard_count":4,"shards":[2],"exit_status":1,
+ *  "files":[{"path":"a.c","status":"changed","bytes":1234,"output":"..."},...]}
+ *
+ * The files are sorted by path. "shards" contains several numbers after a
+ * merge. When reading, the unknown keys are skipped.
+ *
+ * gcu_results_add() can be called from several threads.
+ */
+
+struct _GcuResults
+{
+  gchar *tool;
+  guint shard_count;
+
+  /* The shard numbers (guint), sorted. */
+  GArray *shards;
+
+  gint exit_status;
+
+  /* GcuResultsFile's. */
+  GPtrArray *files;
+  GMutex mutex;
+};
+
+static void
+results_file_free (GcuResultsFile *file)
+{
+  if (file != NULL)
+    {
+      g_free (file->path);
+      g_free (file->status);
+      g_free (file->output);
+      g_free (file);
+    }
+}
+
+static GcuResults *
+results_new (const gchar *tool,
+             guint        shard_count)
+{
+  GcuResults *results;
+
+  results = g_new0 (GcuResults, 1);
+  results->tool = g_strdup (tool);
+  results->shard_count = shard_count;
+  results->shards = g_array_new (FALSE, FALSE, sizeof (guint));
+  results->files = g_ptr_array_new_with_free_func ((GDestroyNotify) results_file_free);
+  g_mutex_init (&results->mutex);
+
+  return results;
+}
+
+/* @shard is %NULL if the run is not sharded. */
+GcuResults *
+gcu_results_new (const gchar    *tool,
+                 const GcuShard *shard)
+{
+  GcuResults *results;
+  guint shard_num = shard != NULL ? shard->index : 1;
+
+  g_return_val_if_fail (tool != NULL, NULL);
+
+  results = results_new (tool, shard != NULL ? shard->count : 1);
+  g_array_append_val (results->shards, shard_num);
+
+  return results;
+}
+
+void
+gcu_results_free (GcuResults *results)
+{
+  if (results != NULL)
+    {
+      g_free (results->tool);
+      g_array_unref (results->shards);
+      g_ptr_array_unref (results->files);
+      g_mutex_clear (&results->mutex);
+      g_free (results);
+    }
+}
+
+/* Thread-safe. */
+void
+gcu_results_add (GcuResults  *results,
+                 const gchar *path,
+                 const gchar *status,
+                 gint64       n_bytes,
+                 const gchar *output)
+{
+  GcuResultsFile *file;
+
+  g_return_if_fail (results != NULL);
+  g_return_if_fail (path != NULL);
+  g_return_if_fail (status != NULL);
+
+  file = g_new0 (GcuResultsFile, 1);
+  file->path = g_strdup (path);
+  file->status = g_strdup (status);
+  file->n_bytes = n_bytes;
+  file->output = g_strdup (output);
+
+  g_mutex_lock (&results->mutex);
+  g_ptr_array_add (results->files, file);
+  g_mutex_unlock (&results->mutex);
+}
+
+void
+gcu_results_set_exit_status (GcuResults *results,
+                             gint        exit_status)
+{
+  g_return_if_fail (results != NULL);
+
+  results->exit_status = exit_status;
+}
+
+gint
+gcu_results_get_exit_status (GcuResults *results)
+{
+  g_return_val_if_fail (results != NULL, 0);
+
+  return results->exit_status;
+}
+
+static gint
+compare_files (gconstpointer a,
+               gconstpointer b)
+{
+  const GcuResultsFile * const *file_a = a;
+  const GcuResultsFile * const *file_b = b;
+
+  return strcmp ((*file_a)->path, (*file_b)->path);
+}
+
+/* Returns: (transfer none): the GcuResultsFile's, sorted by path. */
+GPtrArray *
+gcu_results_get_files (GcuResults *results)
+{
+  g_return_val_if_fail (results != NULL, NULL);
+
+  g_ptr_array_sort (results->files, compare_files);
+  return results->files;
+}
+
+/* Returns: (transfer full): the results in JSON, one file per line. */
+gchar *
+gcu_results_to_json (GcuResults *results)
+{
+  GString *json;
+  GPtrArray *files;
+  guint i;
+
+  g_return_val_if_fail (results != NULL, NULL);
+
+  json = g_string_new ("{\"tool\":");
+  gcu_json_append_string (json, results->tool);
+  g_string_append_printf (json, ",\"shard_count\":%u,\"shards\":[", results->shard_count);
+
+  for (i = 0; i < results->shards->len; i++)
+    {
+      g_string_append_printf (json,
+                              "%s%u",
+                              i > 0 ? "," : "",
+                              g_array_index (results->shards, guint, i));
+    }
+
+  g_string_append_printf (json, "],\"exit_status\":%d,\"files\":[", results->exit_status);
+
+  files = gcu_results_get_files (results);
+
+  for (i = 0; i < files->len; i++)
+    {
+      const GcuResultsFile *file = g_ptr_array_index (files, i);
+
+      g_string_append (json, i > 0 ? ",\n" : "\n");
+      g_string_append (json, "{\"path\":");
+      gcu_json_append_string (json, file->path);
+      g_string_append (json, ",\"status\":");
+      gcu_json_append_string (json, file->status);
+      g_string_append_printf (json, ",\"bytes\":%" G_GINT64_FORMAT, file->n_bytes);
+
+      if (file->output != NULL)
+        {
+          g_string_append (json, ",\"output\":");
+          gcu_json_append_string (json, file->output);
+        }
+
+      g_string_append_c (json, '}');
+    }
+
+  g_string_append (json, "\n]}\n");
+  return g_string_free (json, FALSE);
+}
+
+gboolean
+gcu_results_save (GcuResults   *results,
+                  const gchar  *path,
+                  GError      **error)
+{
+  gchar *json;
+  gboolean ok;
+
+  g_return_val_if_fail (results != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  json = gcu_results_to_json (results);
+  ok = g_file_set_contents (path, json, -1, error);
+  g_free (json);
+
+  return ok;
+}
+
+static GcuResultsFile *
+read_file (GcuJsonReader *reader)
+{
+  GcuResultsFile *file;
+
+  if (!gcu_json_reader_expect (reader, '{'))
+    return NULL;
+
+  file = g_new0 (GcuResultsFile, 1);
+  file->n_bytes = -1;
+
+  if (gcu_json_reader_expect (reader, '}'))
+    goto error;
+
+  do
+    {
+      gchar *key;
+      gboolean ok;
+
+      key = gcu_json_reader_read_string (reader);
+      if (key == NULL || !gcu_json_reader_expect (reader, ':'))
+        {
+          g_free (key);
+          goto error;
+        }
+
+      if (g_str_equal (key, "path"))
+        {
+          g_free (file->path);
+          file->path = gcu_json_reader_read_string (reader);
+          ok = file->path != NULL;
+        }
+      else if (g_str_equal (key, "status"))
+        {
+          g_free (file->status);
+          file->status = gcu_json_reader_read_string (reader);
+          ok = file->status != NULL;
+        }
+      else if (g_str_equal (key, "bytes"))
+        {
+          ok = gcu_json_reader_read_int64 (reader, &file->n_bytes);
+        }
+      else if (g_str_equal (key, "output"))
+        {
+          g_free (file->output);
+          file->output = gcu_json_reader_read_string (reader);
+          ok = file->output != NULL;
+        }
+      else
+        {
+          ok = gcu_json_reader_skip_value (reader);
+        }
+
+      g_free (key);
+
+      if (!ok)
+        goto error;
+    }
+  while (gcu_json_reader_expect (reader, ','));
+
+  if (!gcu_json_reader_expect (reader, '}') ||
+      file->path == NULL ||
+      file->status == NULL)
+    goto error;
+
+  return file;
+
+error:
+  results_file_free (file);
+  return NULL;
+}
+
+static gboolean
+read_results (GcuJsonReader *reader,
+              GcuResults    *results)
+{
+  gboolean has_shard_count = FALSE;
+
+  if (!gcu_json_reader_expect (reader, '{'))
+    return FALSE;
+
+  do
+    {
+      gchar *key;
+      gboolean ok = TRUE;
+      gint64 value;
+
+      key = gcu_json_reader_read_string (reader);
+      if (key == NULL || !gcu_json_reader_expect (reader, ':'))
+        {
+          g_free (key);
+          return FALSE;
+        }
+
+      if (g_str_equal (key, "tool"))
+        {
+          g_free (results->tool);
+          results->tool = gcu_json_reader_read_string (reader);
+          ok = results->tool != NULL;
+        }
+      else if (g_str_equal (key, "shard_count"))
+        {
+          ok = (gcu_json_reader_read_int64 (reader, &value) &&
+                value >= 1 && value <= G_MAXUINT);
+          results->shard_count = value;
+          has_shard_count = TRUE;
+        }
+      else if (g_str_equal (key, "shards"))
+        {
+          ok = gcu_json_reader_expect (reader, '[');
+
+          while (ok && !gcu_json_reader_peek (reader, ']'))
+            {
+              guint shard_num;
+
+              if (results->shards->len > 0)
+                ok = gcu_json_reader_expect (reader, ',');
+
+              ok = (ok &&
+                    gcu_json_reader_read_int64 (reader, &value) &&
+                    value >= 1 && value <= G_MAXUINT);
+
+              shard_num = value;
+              if (ok)
+                g_array_append_val (results->shards, shard_num);
+            }
+
+          ok = ok && gcu_json_reader_expect (reader, ']');
+        }
+      else if (g_str_equal (key, "exit_status"))
+        {
+          ok = (gcu_json_reader_read_int64 (reader, &value) &&
+                value >= 0 && value <= 255);
+          results->exit_status = value;
+        }
+      else if (g_str_equal (key, "files"))
+        {
+          ok = gcu_json_reader_expect (reader, '[');
+
+          if (ok && !gcu_json_reader_expect (reader, ']'))
+            {
+              do
+                {
+                  GcuResultsFile *file = read_file (reader);
+
+                  ok = file != NULL;
+                  if (ok)
+                    g_ptr_array_add (results->files, file);
+                }
+              while (ok && gcu_json_reader_expect (reader, ','));
+
+              ok = ok && gcu_json_reader_expect (reader, ']');
+            }
+        }
+      else
+        {
+          ok = gcu_json_reader_skip_value (reader);
+        }
+
+      g_free (key);
+
+      if (!ok)
+        return FALSE;
+    }
+  while (gcu_json_reader_expect (reader, ','));
+
+  return (gcu_json_reader_expect (reader, '}') &&
+          gcu_json_reader_at_end (reader) &&
+          results->tool != NULL &&
+          has_shard_count &&
+          results->shards->len > 0);
+}
+
+static gint
+compare_shard_nums (gconstpointer a,
+                    gconstpointer b)
+{
+  guint shard_num_a = *(const guint *) a;
+  guint shard_num_b = *(const guint *) b;
+
+  return shard_num_a < shard_num_b ? -1 : shard_num_a > shard_num_b;
+}
+
+/* Returns: (transfer full) (nullable): the results saved in @path. */
+GcuResults *
+gcu_results_load (const gchar  *path,
+                  GError      **error)
+{
+  gchar *contents;
+  gsize length;
+  GcuJsonReader reader;
+  GcuResults *results;
+  guint i;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  results = results_new (NULL, 1);
+  gcu_json_reader_init (&reader, contents, length);
+
+  if (!read_results (&reader, results))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "%s: invalid results file at byte %" G_GSIZE_FORMAT,
+                   path,
+                   (gsize) (reader.pos - contents));
+      g_free (contents);
+      gcu_results_free (results);
+      return NULL;
+    }
+
+  g_free (contents);
+
+  g_array_sort (results->shards, compare_shard_nums);
+
+  for (i = 0; i < results->shards->len; i++)
+    {
+      guint shard_num = g_array_index (results->shards, guint, i);
+
+      if (shard_num > results->shard_count ||
+          (i > 0 && shard_num == g_array_index (results->shards, guint, i - 1)))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "%s: invalid shard %u of %u.",
+                       path,
+                       shard_num,
+                       results->shard_count);
+          gcu_results_free (results);
+          return NULL;
+        }
+    }
+
+  return results;
+}
+
+static gboolean
+has_shard (GcuResults *results,
+           guint       shard_num)
+{
+  guint i;
+
+  for (i = 0; i < results->shards->len; i++)
+    {
+      if (g_array_index (results->shards, guint, i) == shard_num)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Adds the files of @other, from other shards of the same run, to @results.
+ * The exit status is the highest one.
+ */
+gboolean
+gcu_results_merge (GcuResults  *results,
+                   GcuResults  *other,
+                   GError     **error)
+{
+  GHashTable *paths;
+  gboolean ok = TRUE;
+  guint i;
+
+  g_return_val_if_fail (results != NULL, FALSE);
+  g_return_val_if_fail (other != NULL, FALSE);
+
+  if (!g_str_equal (results->tool, other->tool) ||
+      results->shard_count != other->shard_count)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "The results are not from the same run: %s with %u shards, "
+                   "and %s with %u shards.",
+                   results->tool,
+                   results->shard_count,
+                   other->tool,
+                   other->shard_count);
+      return FALSE;
+    }
+
+  for (i = 0; i < other->shards->len; i++)
+    {
+      guint shard_num = g_array_index (other->shards, guint, i);
+
+      if (has_shard (results, shard_num))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "The results of the shard %u/%u are given several times.",
+                       shard_num,
+                       results->shard_count);
+          return FALSE;
+        }
+    }
+
+  /* With the same list of files, the shards are disjoint. */
+  paths = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (i = 0; i < results->files->len; i++)
+    {
+      const GcuResultsFile *file = g_ptr_array_index (results->files, i);
+
+      g_hash_table_add (paths, file->path);
+    }
+
+  for (i = 0; i < other->files->len && ok; i++)
+    {
+      const GcuResultsFile *file = g_ptr_array_index (other->files, i);
+
+      if (g_hash_table_contains (paths, file->path))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "%s is in several shards. Were the shards run on the same files?",
+                       file->path);
+          ok = FALSE;
+        }
+    }
+
+  g_hash_table_unref (paths);
+
+  if (!ok)
+    return FALSE;
+
+  for (i = 0; i < other->files->len; i++)
+    {
+      const GcuResultsFile *file = g_ptr_array_index (other->files, i);
+
+      gcu_results_add (results, file->path, file->status, file->n_bytes, file->output);
+    }
+
+  g_array_append_vals (results->shards, other->shards->data, other->shards->len);
+  g_array_sort (results->shards, compare_shard_nums);
+
+  results->exit_status = MAX (results->exit_status, other->exit_status);
+
+  return TRUE;
+}
+
+/* Returns whether @results contains all the shards. */
+gboolean
+gcu_results_check_complete (GcuResults  *results,
+                            GError     **error)
+{
+  GString *missing_shards;
+  guint shard_num;
+
+  g_return_val_if_fail (results != NULL, FALSE);
+
+  if (results->shards->len == results->shard_count)
+    return TRUE;
+
+  missing_shards = g_string_new (NULL);
+
+  for (shard_num = 1; shard_num <= results->shard_count; shard_num++)
+    {
+      if (!has_shard (results, shard_num))
+        g_string_append_printf (missing_shards, "%s%u", missing_shards->len > 0 ? ", " : "", shard_num);
+    }
+
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_NOT_FOUND,
+               "The results of some shards are missing: %s (of %u).",
+               missing_shards->str,
+               results->shard_count);
+
+  g_string_free (missing_shards, TRUE);
+  return FALSE;
+}
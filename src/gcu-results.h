@@ -0,0 +1,83 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_RESULTS_H
+#define GCU_RESULTS_H
+
+#include <glib.h>
+#include "gcu-shard.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GcuResults	GcuResults;
+typedef struct _GcuResultsFile	GcuResultsFile;
+
+struct _GcuResultsFile
+{
+  gchar *path;
+
+  /* For example "changed", "unchanged", "skipped" or "failed". "incomplete"
+   * is for a file whose processing was stopped partway.
+   */
+  gchar *status;
+
+  /* -1 if unknown. */
+  gint64 n_bytes;
+
+  /* What the tool printed on stdout for this file, or %NULL. */
+  gchar *output;
+};
+
+GcuResults *	gcu_results_new			(const gchar	 *tool,
+						 const GcuShard	 *shard);
+
+void		gcu_results_free		(GcuResults	 *results);
+
+void		gcu_results_add			(GcuResults	 *results,
+						 const gchar	 *path,
+						 const gchar	 *status,
+						 gint64		  n_bytes,
+						 const gchar	 *output);
+
+void		gcu_results_set_exit_status	(GcuResults	 *results,
+						 gint		  exit_status);
+
+gint		gcu_results_get_exit_status	(GcuResults	 *results);
+
+GPtrArray *	gcu_results_get_files		(GcuResults	 *results);
+
+gchar *		gcu_results_to_json		(GcuResults	 *results);
+
+gboolean	gcu_results_save		(GcuResults	 *results,
+						 const gchar	 *path,
+						 GError		**error);
+
+GcuResults *	gcu_results_load		(const gchar	 *path,
+						 GError		**error);
+
+gboolean	gcu_results_merge		(GcuResults	 *results,
+						 GcuResults	 *other,
+						 GError		**error);
+
+gboolean	gcu_results_check_complete	(GcuResults	 *results,
+						 GError		**error);
+
+G_END_DECLS
+
+#endif /* GCU_RESULTS_H */
@@ -0,0 +1,258 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-scheduler.h"
+
+/*
+ * Memory-aware scheduling of the jobs of a thread pool, so that a parallel run
+ * on a tree with some big (e.g. generated) files doesn't run out of memory,
+ * while keeping all the threads busy with the other files.
+ *
+ * Each job has a cost, the memory estimated to process it, for example with
+ * gcu_scheduler_estimate_cost() from the size of the file. A job is admitted,
+ * i.e. pushed to the thread pool, only when a thread is free and when its cost
+ * fits in the remaining memory of max_memory. The waiting jobs are admitted
+ * from the biggest one, so the big files start as early as possible, and the
+ * small files run at the same time in the remaining memory.
+ *
+ * When the biggest waiting job doesn't fit, the other jobs are not admitted
+ * until it does: the memory freed by the running jobs is reserved for it.
+ * Otherwise the small files would keep taking that memory, and the big file
+ * would start only at the end, alone, making the run longer. A job that costs
+ * more than max_memory on its own is admitted when no other job runs.
+ *
+ * With a max_memory of 0, there is no limit, and the jobs are pushed to the
+ * thread pool directly, in order.
+ */
+
+/* Rough estimation of the memory used to process a file, per byte of the
+ * file: the contents of the file and the new contents, and some temporary
+ * strings. The tools that use a GtkTextBuffer, which would need much more, run
+ * in the main thread and don't use the scheduler.
+ */
+#define BYTES_PER_FILE_BYTE (3)
+
+/* The fixed cost of a job, for the small files. */
+#define MIN_JOB_COST (64 * 1024)
+
+typedef struct
+{
+  gpointer data;
+  guint64 cost;
+} Job;
+
+struct _GcuScheduler
+{
+  GThreadPool *pool;
+  GFunc func;
+  gpointer user_data;
+  guint n_threads;
+  guint64 max_memory;
+
+  GMutex mutex;
+  GCond job_done_cond;
+
+  /* The jobs not yet admitted, sorted by cost. */
+  GSequence *waiting_jobs;
+
+  guint n_running_jobs;
+  guint64 running_jobs_cost;
+};
+
+static gint
+compare_jobs (gconstpointer a,
+              gconstpointer b,
+              gpointer      user_data)
+{
+  const Job *job_a = a;
+  const Job *job_b = b;
+
+  if (job_a->cost < job_b->cost)
+    return -1;
+  if (job_a->cost > job_b->cost)
+    return 1;
+  return 0;
+}
+
+/* Returns: the biggest waiting job if it fits in the remaining memory, or
+ * %NULL.
+ */
+static GSequenceIter *
+get_job_to_admit (GcuScheduler *scheduler)
+{
+  GSequenceIter *iter;
+  const Job *job;
+
+  if (g_sequence_is_empty (scheduler->waiting_jobs) ||
+      scheduler->n_running_jobs >= scheduler->n_threads)
+    return NULL;
+
+  iter = g_sequence_iter_prev (g_sequence_get_end_iter (scheduler->waiting_jobs));
+
+  /* Also for a job that doesn't fit in max_memory. */
+  if (scheduler->n_running_jobs == 0)
+    return iter;
+
+  /* After a job that doesn't fit, running_jobs_cost can exceed max_memory. */
+  job = g_sequence_get (iter);
+  if (scheduler->running_jobs_cost >= scheduler->max_memory ||
+      job->cost > scheduler->max_memory - scheduler->running_jobs_cost)
+    return NULL;
+
+  return iter;
+}
+
+/* Must be called with the mutex locked. */
+static void
+admit_jobs (GcuScheduler *scheduler)
+{
+  GSequenceIter *iter;
+
+  while ((iter = get_job_to_admit (scheduler)) != NULL)
+    {
+      Job *job = g_sequence_get (iter);
+
+      g_sequence_remove (iter);
+
+      scheduler->n_running_jobs++;
+      scheduler->running_jobs_cost += job->cost;
+
+      g_thread_pool_push (scheduler->pool, job, NULL);
+    }
+}
+
+static void
+job_run (gpointer data,
+         gpointer user_data)
+{
+  Job *job = data;
+  GcuScheduler *scheduler = user_data;
+
+  scheduler->func (job->data, scheduler->user_data);
+
+  g_mutex_lock (&scheduler->mutex);
+
+  scheduler->n_running_jobs--;
+  scheduler->running_jobs_cost -= job->cost;
+
+  if (scheduler->max_memory > 0)
+    admit_jobs (scheduler);
+
+  g_cond_signal (&scheduler->job_done_cond);
+  g_mutex_unlock (&scheduler->mutex);
+
+  g_free (job);
+}
+
+/* Like g_thread_pool_new() with @n_threads exclusive threads, @func being
+ * called for each job. @max_memory is the maximum total cost of the jobs that
+ * run at the same time, in bytes, or 0 for no limit.
+ */
+GcuScheduler *
+gcu_scheduler_new (GFunc    func,
+                   gpointer user_data,
+                   guint    n_threads,
+                   guint64  max_memory)
+{
+  GcuScheduler *scheduler;
+  GError *error = NULL;
+
+  g_return_val_if_fail (func != NULL, NULL);
+  g_return_val_if_fail (n_threads > 0, NULL);
+
+  scheduler = g_new0 (GcuScheduler, 1);
+  scheduler->func = func;
+  scheduler->user_data = user_data;
+  scheduler->n_threads = n_threads;
+  scheduler->max_memory = max_memory;
+  scheduler->waiting_jobs = g_sequence_new (NULL);
+  g_mutex_init (&scheduler->mutex);
+  g_cond_init (&scheduler->job_done_cond);
+
+  scheduler->pool = g_thread_pool_new (job_run,
+                                       scheduler,
+                                       n_threads,
+                                       TRUE,
+                                       &error);
+  g_assert_no_error (error);
+
+  return scheduler;
+}
+
+/* Adds a job, run now or later depending on its @cost, in bytes. */
+void
+gcu_scheduler_push (GcuScheduler *scheduler,
+                    gpointer      data,
+                    guint64       cost)
+{
+  Job *job;
+
+  g_return_if_fail (scheduler != NULL);
+
+  job = g_new (Job, 1);
+  job->data = data;
+  job->cost = cost;
+
+  g_mutex_lock (&scheduler->mutex);
+
+  if (scheduler->max_memory == 0)
+    {
+      scheduler->n_running_jobs++;
+      g_thread_pool_push (scheduler->pool, job, NULL);
+    }
+  else
+    {
+      g_sequence_insert_sorted (scheduler->waiting_jobs, job, compare_jobs, NULL);
+      admit_jobs (scheduler);
+    }
+
+  g_mutex_unlock (&scheduler->mutex);
+}
+
+/* Waits for all the jobs to finish, and frees @scheduler. */
+void
+gcu_scheduler_free (GcuScheduler *scheduler)
+{
+  if (scheduler == NULL)
+    return;
+
+  /* The running jobs admit the waiting ones, so the thread pool cannot be
+   * freed before they are all done.
+   */
+  g_mutex_lock (&scheduler->mutex);
+  while (scheduler->n_running_jobs > 0 ||
+         !g_sequence_is_empty (scheduler->waiting_jobs))
+    g_cond_wait (&scheduler->job_done_cond, &scheduler->mutex);
+  g_mutex_unlock (&scheduler->mutex);
+
+  g_thread_pool_free (scheduler->pool, FALSE, TRUE);
+  g_sequence_free (scheduler->waiting_jobs);
+  g_mutex_clear (&scheduler->mutex);
+  g_cond_clear (&scheduler->job_done_cond);
+  g_free (scheduler);
+}
+
+/* Returns: the estimated memory, in bytes, to process a file of @file_size
+ * bytes.
+ */
+guint64
+gcu_scheduler_estimate_cost (guint64 file_size)
+{
+  return MIN_JOB_COST + file_size * BYTES_PER_FILE_BYTE;
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_SCHEDULER_H
+#define GCU_SCHEDULER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GcuScheduler GcuScheduler;
+
+GcuScheduler *	gcu_scheduler_new		(GFunc			 func,
+						 gpointer		 user_data,
+						 guint			 n_threads,
+						 guint64		 max_memory);
+
+void		gcu_scheduler_push		(GcuScheduler		*scheduler,
+						 gpointer		 data,
+						 guint64		 cost);
+
+void		gcu_scheduler_free		(GcuScheduler		*scheduler);
+
+guint64		gcu_scheduler_estimate_cost	(guint64		 file_size);
+
+G_END_DECLS
+
+#endif /* GCU_SCHEDULER_H */
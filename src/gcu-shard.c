@@ -0,0 +1,186 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-shard.h"
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Deterministic sharding: "--shard=I/N" selects the part I of N of the files,
+ * so that N processes, possibly on different machines, process each file
+ * exactly once, without coordination. The processes only need the same list of
+ * files, in any order.
+ *
+ * The files are ordered by a hash of their path, and this order is cut into N
+ * contiguous ranges of about the same total weight. The weight of a file is its
+ * size plus FILE_COST, so that the shards finish at about the same time, even
+ * with a few big files. A file belongs to the range that contains the middle of
+ * its weight.
+ *
+ * The partition is stable: adding, removing or resizing a file only moves the
+ * files near the boundaries of the ranges, the other files stay in the same
+ * shard.
+ */
+
+/* The fixed cost of processing a file (opening, reading, writing), in bytes. */
+#define FILE_COST 4096
+
+/* Enough for all the CI runners. */
+#define MAX_SHARD_COUNT 65536
+
+typedef struct
+{
+  const gchar *path;
+  guint64 hash;
+  guint64 weight;
+  guint index;
+} ShardItem;
+
+/* Parses "I/N", with 1 <= I <= N. */
+gboolean
+gcu_shard_parse (GcuShard     *shard,
+                 const gchar  *str,
+                 GError      **error)
+{
+  guint64 index;
+  guint64 count;
+  gchar *end;
+
+  g_return_val_if_fail (shard != NULL, FALSE);
+  g_return_val_if_fail (str != NULL, FALSE);
+
+  if (!g_ascii_isdigit (str[0]))
+    goto error;
+
+  index = g_ascii_strtoull (str, &end, 10);
+  if (*end != '/' || !g_ascii_isdigit (end[1]))
+    goto error;
+
+  count = g_ascii_strtoull (end + 1, &end, 10);
+  if (*end != '\0' ||
+      index < 1 ||
+      index > count ||
+      count > MAX_SHARD_COUNT)
+    goto error;
+
+  shard->index = index;
+  shard->count = count;
+  return TRUE;
+
+error:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_ARGUMENT,
+               "Invalid shard “%s”: expected I/N, with 1 ≤ I ≤ N ≤ %d.",
+               str,
+               MAX_SHARD_COUNT);
+  return FALSE;
+}
+
+/* FNV-1a, to not depend on the implementation of g_str_hash(), which must be
+ * the same on all the machines.
+ */
+static guint64
+hash_path (const gchar *path)
+{
+  guint64 hash = G_GUINT64_CONSTANT (14695981039346656037);
+  const gchar *p;
+
+  for (p = path; *p != '\0'; p++)
+    {
+      hash ^= (guchar) *p;
+      hash *= G_GUINT64_CONSTANT (1099511628211);
+    }
+
+  return hash;
+}
+
+static gint
+compare_items (gconstpointer a,
+               gconstpointer b)
+{
+  const ShardItem *item_a = a;
+  const ShardItem *item_b = b;
+
+  if (item_a->hash != item_b->hash)
+    return item_a->hash < item_b->hash ? -1 : 1;
+
+  return strcmp (item_a->path, item_b->path);
+}
+
+static guint64
+get_file_size (const gchar *path)
+{
+  GStatBuf st;
+
+  /* A missing file is reported later by the tool. */
+  if (g_stat (path, &st) != 0)
+    return 0;
+
+  return st.st_size;
+}
+
+/* Sets @selected[i] to whether @paths[i] is in @shard. @sizes are the sizes of
+ * the files, or %NULL to get them from the file system.
+ */
+void
+gcu_shard_select (const GcuShard  *shard,
+                  guint            n_paths,
+                  gchar          **paths,
+                  const guint64   *sizes,
+                  gboolean        *selected)
+{
+  ShardItem *items;
+  guint64 total_weight = 0;
+  guint64 cumulated_weight = 0;
+  guint i;
+
+  g_return_if_fail (shard != NULL);
+  g_return_if_fail (shard->index >= 1 && shard->index <= shard->count);
+
+  items = g_new (ShardItem, n_paths);
+
+  for (i = 0; i < n_paths; i++)
+    {
+      items[i].path = paths[i];
+      items[i].hash = hash_path (paths[i]);
+      items[i].weight = (sizes != NULL ? sizes[i] : get_file_size (paths[i])) + FILE_COST;
+      items[i].index = i;
+
+      total_weight += items[i].weight;
+    }
+
+  qsort (items, n_paths, sizeof (ShardItem), compare_items);
+
+  for (i = 0; i < n_paths; i++)
+    {
+      /* Twice the middle of the file in the cumulated weights, to stay with
+       * integers.
+       */
+      guint64 middle2 = 2 * cumulated_weight + items[i].weight;
+      guint64 shard_num = middle2 * shard->count / (2 * total_weight);
+
+      selected[items[i].index] = shard_num + 1 == shard->index;
+      cumulated_weight += items[i].weight;
+    }
+
+  g_free (items);
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_SHARD_H
+#define GCU_SHARD_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GcuShard GcuShard;
+
+/* One part of the files, when a run is split between several processes or
+ * machines.
+ */
+struct _GcuShard
+{
+  /* From 1 to @count. */
+  guint index;
+  guint count;
+};
+
+gboolean	gcu_shard_parse		(GcuShard	 *shard,
+					 const gchar	 *str,
+					 GError		**error);
+
+void		gcu_shard_select	(const GcuShard	 *shard,
+					 guint		  n_paths,
+					 gchar		**paths,
+					 const guint64	 *sizes,
+					 gboolean	 *selected);
+
+G_END_DECLS
+
+#endif /* GCU_SHARD_H */
@@ -29,6 +29,10 @@
  * <file> must be a *.c or *.h file.
  * WARNING: the script directly modifies <file> without doing a backup first!
  *
+ * If <file> is "-", stdin is read and the result is written to stdout instead,
+ * so the script can be used in a pipeline (see gcu-filter.c). stdin must be
+ * UTF-8, otherwise it is written unchanged, with a warning.
+ *
  * <search-text-file> should contain a fragment of a C comment. The script
  * canonicalizes its content, to have a list of words to search. When doing the
  * search, the script tries to match the list of words in C comments, by
@@ -39,14 +43,49 @@
  * #define CASE_SENSITIVE below.
  *
  * When a match is found, it is replaced by the content of <replacement-file>.
+ *
+ * A file that exceeds the limits of the GCU_BUDGET environment variable (size,
+ * line length, number of matches, time) is left unmodified, with a warning
+ * (see gcu-budget.c).
+ *
+ * Usage:
+ * $ gcu-smart-c-comment-substitution --find-similar [file or directory...]
+ * $ gcu-smart-c-comment-substitution --find-similar --compile-commands <file> [--include-headers]
+ * Does not modify the files. Finds the slightly different variants of the
+ * leading comment (e.g. the license header) of the *.c and *.h files, and
+ * prints the clusters of similar headers with their files. The first file of a
+ * cluster can then be used to create a <search-text-file>. With
+ * --compile-commands, the files are the ones compiled according to a
+ * compile_commands.json <file>, plus with --include-headers the headers that
+ * they include from the source tree (see gcu-file-list.c).
+ *
+ * The leading comments are canonicalized like the search text. A MinHash
+ * signature is computed for each header, on shingles of SHINGLE_N_WORDS
+ * words, and locality-sensitive hashing (LSH) gives the candidate pairs. So
+ * the headers are not compared pairwise, the running time is almost linear in
+ * the number of files. Two headers are in the same cluster if their estimated
+ * Jaccard similarity is at least SIMILARITY_THRESHOLD.
  */
 
 #include <tepl/tepl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <locale.h>
+#include "gcu-budget.h"
+#include "gcu-file-list.h"
+#include "gcu-filter.h"
+#include "gcu-lex.h"
 
 #define CASE_SENSITIVE FALSE
 
+/* For --find-similar. */
+#define SIMILARITY_THRESHOLD 0.8
+#define SHINGLE_N_WORDS 3
+#define MINHASH_N_HASHES 128
+#define LSH_N_ROWS_PER_BAND 4
+#define LSH_N_BANDS (MINHASH_N_HASHES / LSH_N_ROWS_PER_BAND)
+#define LSH_MAX_PREVIOUS_ENTRIES 32
+
 typedef struct _Sub Sub;
 struct _Sub
 {
@@ -57,32 +96,51 @@ struct _Sub
 
   gchar *replacement;
   TeplBuffer *buffer;
+
+  /* The comments of @buffer, before the substitutions. @lex_shift is the
+   * number of characters added by the substitutions done so far, to convert
+   * an offset in @buffer after the last substitution to an offset in @lex.
+   */
+  GcuLex *lex;
+  gint lex_shift;
+
+  /* Started when the Sub is created, so the time budget includes the lexing
+   * of the whole buffer.
+   */
+  GcuBudgetCounter budget_counter;
 };
 
+static GcuBudget _budget;
+
+/* @filename is %NULL for stdin. */
 static Sub *
 sub_new (GQueue      *canonicalized_search_text,
          const gchar *replacement,
          const gchar *filename)
 {
   Sub *sub = g_new0 (Sub, 1);
-  GFile *location;
-  TeplFile *file;
 
   g_assert (replacement != NULL);
-  g_assert (filename != NULL);
-  g_assert (filename[0] != '\0');
+  g_assert (filename == NULL || filename[0] != '\0');
 
   sub->canonicalized_search_text = canonicalized_search_text;
 
   sub->replacement = g_strdup (replacement);
+  gcu_budget_counter_init (&sub->budget_counter, &_budget, filename != NULL ? filename : "stdin");
 
   sub->buffer = tepl_buffer_new ();
   gtk_source_buffer_set_implicit_trailing_newline (GTK_SOURCE_BUFFER (sub->buffer), FALSE);
 
-  location = g_file_new_for_commandline_arg (filename);
-  file = tepl_buffer_get_file (sub->buffer);
-  tepl_file_set_location (file, location);
-  g_object_unref (location);
+  if (filename != NULL)
+    {
+      GFile *location;
+      TeplFile *file;
+
+      location = g_file_new_for_commandline_arg (filename);
+      file = tepl_buffer_get_file (sub->buffer);
+      tepl_file_set_location (file, location);
+      g_object_unref (location);
+    }
 
   return sub;
 }
@@ -94,6 +152,7 @@ sub_free (Sub *sub)
     {
       g_free (sub->replacement);
       g_clear_object (&sub->buffer);
+      gcu_lex_free (sub->lex);
 
       g_free (sub);
     }
@@ -358,13 +417,20 @@ next_word (GtkTextIter *iter)
   return gtk_text_iter_get_text (&word_start, iter);
 }
 
+static const GcuLexSpan *
+find_c_comment (Sub               *sub,
+                const GtkTextIter *iter)
+{
+  return gcu_lex_find_span (sub->lex,
+                            GCU_LEX_SPAN_COMMENT,
+                            gtk_text_iter_get_offset (iter) - sub->lex_shift);
+}
+
 static gboolean
 is_in_c_comment (Sub               *sub,
                  const GtkTextIter *iter)
 {
-  return gtk_source_buffer_iter_has_context_class (GTK_SOURCE_BUFFER (sub->buffer),
-                                                   iter,
-                                                   "comment");
+  return find_c_comment (sub, iter) != NULL;
 }
 
 static gboolean
@@ -372,17 +438,13 @@ is_in_same_c_comment (Sub               *sub,
                       const GtkTextIter *start,
                       const GtkTextIter *end)
 {
-  GtkTextIter comment_end;
+  const GcuLexSpan *comment;
 
-  if (!is_in_c_comment (sub, start))
+  comment = find_c_comment (sub, start);
+  if (comment == NULL)
     return FALSE;
 
-  comment_end = *start;
-  gtk_source_buffer_iter_forward_to_context_class_toggle (GTK_SOURCE_BUFFER (sub->buffer),
-                                                          &comment_end,
-                                                          "comment");
-
-  return gtk_text_iter_compare (end, &comment_end) <= 0;
+  return gtk_text_iter_get_offset (end) - sub->lex_shift <= (gint64) comment->end;
 }
 
 static gint
@@ -407,6 +469,9 @@ my_strcmp0 (const gchar *str1,
   return result;
 }
 
+/* @match_end is the end of the first word found by the search. If the whole
+ * search text matches, it is moved to the end of the match.
+ */
 static gboolean
 match_search_text (Sub               *sub,
                    const GtkTextIter *match_start,
@@ -415,6 +480,14 @@ match_search_text (Sub               *sub,
   GtkTextIter iter;
   GList *l;
 
+  /* The first word is only the beginning of a longer word. Checking it here
+   * avoids to read the rest of the word with next_word() for each match inside
+   * it, which would be quadratic on a long word.
+   */
+  if (!gtk_text_iter_is_end (match_end) &&
+      !g_unichar_isspace (gtk_text_iter_get_char (match_end)))
+    return FALSE;
+
   if (!is_in_c_comment (sub, match_start))
     return FALSE;
 
@@ -505,8 +578,14 @@ do_substitution (Sub *sub)
                                             &match_end,
                                             NULL))
     {
+      if (!gcu_budget_counter_add_match (&sub->budget_counter))
+        break;
+
       if (match_search_text (sub, &match_start, &match_end))
         {
+          sub->lex_shift += g_utf8_strlen (sub->replacement, -1);
+          sub->lex_shift -= gtk_text_iter_get_offset (&match_end) - gtk_text_iter_get_offset (&match_start);
+
           gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (sub->buffer));
           gtk_text_buffer_delete (GTK_TEXT_BUFFER (sub->buffer), &match_start, &match_end);
           gtk_text_buffer_insert (GTK_TEXT_BUFFER (sub->buffer), &match_end, sub->replacement, -1);
@@ -520,24 +599,39 @@ do_substitution (Sub *sub)
   g_object_unref (search_context);
 }
 
-static void
-set_c_language (Sub *sub)
+/* Finds the comments of the buffer, to be called before do_substitution(). The
+ * GtkSourceView highlighting would give the same comments, but is much slower
+ * on a big file (see gcu-lex.c).
+ *
+ * The budget of a loaded file is checked on the same contents, so that the file
+ * is not read twice. Returns %FALSE if it is exceeded, the buffer is then not
+ * lexed.
+ */
+static gboolean
+lex_buffer (Sub *sub)
 {
-  GtkSourceLanguageManager *manager;
-  GtkSourceLanguage *c_language;
   GtkTextIter start;
   GtkTextIter end;
+  gchar *contents;
+  gsize length;
+
+  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (sub->buffer), &start, &end);
+  contents = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (sub->buffer), &start, &end, TRUE);
+  length = strlen (contents);
 
-  manager = gtk_source_language_manager_get_default ();
-  c_language = gtk_source_language_manager_get_language (manager, "c");
-  if (c_language == NULL)
-    g_error ("GtkSourceLanguage for the C language not found. "
-             "Check your GtkSourceView installation.");
+  if (!gcu_budget_check_contents (&_budget, sub->budget_counter.filename, contents, length))
+    {
+      sub->budget_counter.exceeded = TRUE;
+      g_free (contents);
+      return FALSE;
+    }
 
-  gtk_source_buffer_set_language (GTK_SOURCE_BUFFER (sub->buffer), c_language);
+  gcu_lex_free (sub->lex);
+  sub->lex = gcu_lex_new (contents, length);
+  sub->lex_shift = 0;
 
-  gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (sub->buffer), &start, &end);
-  gtk_source_buffer_ensure_highlight (GTK_SOURCE_BUFFER (sub->buffer), &start, &end);
+  g_free (contents);
+  return TRUE;
 }
 
 static void
@@ -560,8 +654,16 @@ load_cb (GObject      *source_object,
       return;
     }
 
-  set_c_language (sub);
-  do_substitution (sub);
+  if (lex_buffer (sub))
+    do_substitution (sub);
+
+  /* Over budget, the file is left unmodified. */
+  if (sub->budget_counter.exceeded)
+    {
+      gtk_main_quit ();
+      return;
+    }
+
   save_file (sub);
 }
 
@@ -581,6 +683,69 @@ sub_launch (Sub *sub)
                                sub);
 }
 
+/* Does the substitution on stdin, written to stdout. The main loop is not
+ * needed, there is no file to load or save asynchronously.
+ */
+static gint
+handle_stdin (GQueue      *canonicalized_search_text,
+              const gchar *replacement)
+{
+  gchar *contents;
+  gsize length;
+  gchar *new_contents = NULL;
+  GError *error = NULL;
+
+  contents = gcu_filter_read_stdin (&length, &error);
+  if (error != NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      return EXIT_FAILURE;
+    }
+
+  /* A GtkTextBuffer contains only valid UTF-8. The budget is checked before
+   * filling the buffer, which is expensive for a huge input.
+   */
+  if (length > G_MAXINT || !g_utf8_validate (contents, length, NULL))
+    g_printerr ("stdin: not a valid UTF-8 text, written unchanged.\n");
+  else if (gcu_budget_check_contents (&_budget, "stdin", contents, length))
+    {
+      Sub *sub;
+
+      sub = sub_new (canonicalized_search_text, replacement, NULL);
+      gtk_text_buffer_set_text (GTK_TEXT_BUFFER (sub->buffer), contents, length);
+
+      if (lex_buffer (sub))
+        do_substitution (sub);
+
+      /* Over budget, the input is written unchanged. */
+      if (!sub->budget_counter.exceeded)
+        {
+          GtkTextIter start;
+          GtkTextIter end;
+
+          gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (sub->buffer), &start, &end);
+          new_contents = gtk_text_buffer_get_text (GTK_TEXT_BUFFER (sub->buffer), &start, &end, TRUE);
+        }
+
+      sub_free (sub);
+    }
+
+  if (new_contents != NULL)
+    {
+      g_free (contents);
+      contents = new_contents;
+      length = strlen (new_contents);
+    }
+
+  if (!gcu_filter_write_stdout (contents, length, &error))
+    g_error ("Error when writing the output: %s", error->message);
+
+  g_free (contents);
+
+  return EXIT_SUCCESS;
+}
+
 static gchar *
 get_file_contents (const gchar *filename)
 {
@@ -616,6 +781,437 @@ remove_prefix (const gchar  *text1,
   *new_text2 = g_strdup (text2 + i);
 }
 
+typedef struct
+{
+  gchar *filename;
+  guint64 minhash[MINHASH_N_HASHES];
+} Header;
+
+typedef struct
+{
+  guint64 key;
+  guint header_num;
+} BandEntry;
+
+/* FNV-1a. */
+static guint64
+hash_string (guint64      hash,
+             const gchar *str)
+{
+  const guchar *p;
+
+  for (p = (const guchar *) str; *p != '\0'; p++)
+    {
+      hash ^= *p;
+      hash *= G_GUINT64_CONSTANT (0x100000001b3);
+    }
+
+  return hash;
+}
+
+/* The splitmix64 finalizer. */
+static guint64
+mix_hash (guint64 x)
+{
+  x ^= x >> 30;
+  x *= G_GUINT64_CONSTANT (0xbf58476d1ce4e5b9);
+  x ^= x >> 27;
+  x *= G_GUINT64_CONSTANT (0x94d049bb133111eb);
+  x ^= x >> 31;
+  return x;
+}
+
+/* Returns the comment at the start of @contents, or NULL. */
+static gchar *
+get_leading_c_comment (const gchar *contents)
+{
+  const gchar *start = contents;
+  const gchar *end;
+
+  while (g_ascii_isspace (*start))
+    start++;
+
+  if (!g_str_has_prefix (start, "/*"))
+    return NULL;
+
+  end = strstr (start + 2, "*/");
+  if (end == NULL)
+    return NULL;
+
+  return g_strndup (start, end + 2 - start);
+}
+
+/* Returns FALSE if there are no words. */
+static gboolean
+compute_minhash (GQueue  *words,
+                 guint64 *minhash)
+{
+  gchar **words_array;
+  GList *l;
+  guint n_words;
+  guint n_shingles;
+  guint shingle_num;
+  guint word_num;
+  guint i;
+
+  n_words = g_queue_get_length (words);
+  if (n_words == 0)
+    return FALSE;
+
+  words_array = g_new0 (gchar *, n_words + 1);
+  for (l = words->head, word_num = 0; l != NULL; l = l->next, word_num++)
+    {
+      const gchar *word = l->data;
+
+      words_array[word_num] = CASE_SENSITIVE ? g_strdup (word) : g_utf8_casefold (word, -1);
+    }
+
+  for (i = 0; i < MINHASH_N_HASHES; i++)
+    minhash[i] = G_MAXUINT64;
+
+  n_shingles = n_words >= SHINGLE_N_WORDS ? n_words - SHINGLE_N_WORDS + 1 : 1;
+
+  for (shingle_num = 0; shingle_num < n_shingles; shingle_num++)
+    {
+      guint64 shingle_hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+
+      for (word_num = shingle_num;
+           word_num < shingle_num + SHINGLE_N_WORDS && word_num < n_words;
+           word_num++)
+        {
+          shingle_hash = hash_string (shingle_hash, words_array[word_num]);
+          shingle_hash = hash_string (shingle_hash, " ");
+        }
+
+      /* The i-th hash function is the mix of the shingle hash with a seed. */
+      for (i = 0; i < MINHASH_N_HASHES; i++)
+        {
+          guint64 value = mix_hash (shingle_hash ^ mix_hash (i + 1));
+
+          if (value < minhash[i])
+            minhash[i] = value;
+        }
+    }
+
+  g_strfreev (words_array);
+  return TRUE;
+}
+
+static Header *
+header_new (const gchar *filename)
+{
+  Header *header;
+  gchar *contents;
+  gsize length;
+  gchar *comment;
+  GQueue *words;
+  GError *error = NULL;
+
+  g_file_get_contents (filename, &contents, &length, &error);
+  if (error != NULL)
+    {
+      g_warning ("Impossible to get file contents: %s", error->message);
+      g_clear_error (&error);
+      return NULL;
+    }
+
+  if (!gcu_budget_check_contents (&_budget, filename, contents, length))
+    {
+      g_free (contents);
+      return NULL;
+    }
+
+  if (!g_utf8_validate (contents, -1, NULL))
+    {
+      g_warning ("%s: invalid UTF-8, skipped.", filename);
+      g_free (contents);
+      return NULL;
+    }
+
+  comment = get_leading_c_comment (contents);
+  g_free (contents);
+  if (comment == NULL)
+    return NULL;
+
+  header = g_new0 (Header, 1);
+  header->filename = g_strdup (filename);
+
+  words = canonicalize_c_comment (comment);
+  if (!compute_minhash (words, header->minhash))
+    {
+      g_free (header->filename);
+      g_clear_pointer (&header, g_free);
+    }
+
+  g_queue_free_full (words, g_free);
+  g_free (comment);
+  return header;
+}
+
+static void
+header_free (Header *header)
+{
+  if (header != NULL)
+    {
+      g_free (header->filename);
+      g_free (header);
+    }
+}
+
+static gdouble
+estimate_similarity (const Header *header1,
+                     const Header *header2)
+{
+  guint n_equal = 0;
+  guint i;
+
+  for (i = 0; i < MINHASH_N_HASHES; i++)
+    {
+      if (header1->minhash[i] == header2->minhash[i])
+        n_equal++;
+    }
+
+  return (gdouble) n_equal / MINHASH_N_HASHES;
+}
+
+static guint
+union_find_get_root (guint *parents,
+                     guint  num)
+{
+  while (parents[num] != num)
+    {
+      /* Path halving. */
+      parents[num] = parents[parents[num]];
+      num = parents[num];
+    }
+
+  return num;
+}
+
+static void
+union_find_merge (guint *parents,
+                  guint  num1,
+                  guint  num2)
+{
+  guint root1 = union_find_get_root (parents, num1);
+  guint root2 = union_find_get_root (parents, num2);
+
+  /* The smallest number is the root, to keep the first filename first. */
+  if (root1 < root2)
+    parents[root2] = root1;
+  else if (root2 < root1)
+    parents[root1] = root2;
+}
+
+static gint
+compare_band_entries (gconstpointer a,
+                      gconstpointer b)
+{
+  const BandEntry *entry1 = a;
+  const BandEntry *entry2 = b;
+
+  if (entry1->key < entry2->key)
+    return -1;
+  if (entry1->key > entry2->key)
+    return 1;
+  return (gint) entry1->header_num - (gint) entry2->header_num;
+}
+
+/* Two headers are candidates if they have the same values for at least one
+ * band of their MinHash signature. The entries are sorted by band key, so the
+ * candidates are next to each other. Each candidate is compared with the
+ * previous headers of its bucket, the closest first, that are not already in
+ * its cluster. So a chain A~B~C is one cluster even if A and C are not similar.
+ * To stay linear with a big bucket, only the LSH_MAX_PREVIOUS_ENTRIES previous
+ * headers are looked at.
+ */
+static void
+cluster_headers (GPtrArray *headers,
+                 guint     *parents)
+{
+  GArray *entries;
+  guint band_num;
+  guint header_num;
+  guint entry_num;
+  guint bucket_start = 0;
+
+  entries = g_array_sized_new (FALSE, FALSE, sizeof (BandEntry), headers->len * LSH_N_BANDS);
+
+  for (header_num = 0; header_num < headers->len; header_num++)
+    {
+      const Header *header = g_ptr_array_index (headers, header_num);
+
+      for (band_num = 0; band_num < LSH_N_BANDS; band_num++)
+        {
+          BandEntry entry;
+          guint i;
+
+          entry.key = mix_hash (band_num + 1);
+          for (i = 0; i < LSH_N_ROWS_PER_BAND; i++)
+            entry.key = mix_hash (entry.key ^ header->minhash[band_num * LSH_N_ROWS_PER_BAND + i]);
+
+          entry.header_num = header_num;
+          g_array_append_val (entries, entry);
+        }
+    }
+
+  g_array_sort (entries, compare_band_entries);
+
+  for (entry_num = 1; entry_num < entries->len; entry_num++)
+    {
+      const BandEntry *entry = &g_array_index (entries, BandEntry, entry_num);
+      guint n_previous;
+      guint i;
+
+      if (entry->key != g_array_index (entries, BandEntry, bucket_start).key)
+        {
+          bucket_start = entry_num;
+          continue;
+        }
+
+      n_previous = MIN (entry_num - bucket_start, LSH_MAX_PREVIOUS_ENTRIES);
+
+      for (i = 1; i <= n_previous; i++)
+        {
+          const BandEntry *other = &g_array_index (entries, BandEntry, entry_num - i);
+
+          if (union_find_get_root (parents, other->header_num) ==
+              union_find_get_root (parents, entry->header_num))
+            continue;
+
+          if (estimate_similarity (g_ptr_array_index (headers, other->header_num),
+                                   g_ptr_array_index (headers, entry->header_num)) >= SIMILARITY_THRESHOLD)
+            union_find_merge (parents, other->header_num, entry->header_num);
+        }
+    }
+
+  g_array_unref (entries);
+}
+
+static gint
+compare_clusters (gconstpointer a,
+                  gconstpointer b)
+{
+  const GPtrArray * const *cluster_a = a;
+  const GPtrArray * const *cluster_b = b;
+
+  /* Biggest clusters first. */
+  return (gint) (*cluster_b)->len - (gint) (*cluster_a)->len;
+}
+
+static void
+find_similar_headers (GPtrArray *filenames)
+{
+  GPtrArray *headers;
+  GPtrArray *clusters;
+  GHashTable *clusters_by_root;
+  guint *parents;
+  guint num;
+
+  headers = g_ptr_array_new_with_free_func ((GDestroyNotify) header_free);
+  for (num = 0; num < filenames->len; num++)
+    {
+      Header *header = header_new (g_ptr_array_index (filenames, num));
+
+      if (header != NULL)
+        g_ptr_array_add (headers, header);
+    }
+
+  parents = g_new (guint, headers->len);
+  for (num = 0; num < headers->len; num++)
+    parents[num] = num;
+
+  cluster_headers (headers, parents);
+
+  /* Group the headers by root. The roots are the smallest header numbers, so
+   * the filenames stay sorted in each cluster.
+   */
+  clusters = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+  clusters_by_root = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (num = 0; num < headers->len; num++)
+    {
+      guint root = union_find_get_root (parents, num);
+      GPtrArray *cluster;
+
+      cluster = g_hash_table_lookup (clusters_by_root, GUINT_TO_POINTER (root));
+      if (cluster == NULL)
+        {
+          cluster = g_ptr_array_new ();
+          g_ptr_array_add (clusters, cluster);
+          g_hash_table_insert (clusters_by_root, GUINT_TO_POINTER (root), cluster);
+        }
+
+      g_ptr_array_add (cluster, g_ptr_array_index (headers, num));
+    }
+
+  g_ptr_array_sort (clusters, compare_clusters);
+
+  for (num = 0; num < clusters->len; num++)
+    {
+      GPtrArray *cluster = g_ptr_array_index (clusters, num);
+      guint header_num;
+
+      g_print ("Cluster %u (%u file%s):\n",
+               num + 1,
+               cluster->len,
+               cluster->len > 1 ? "s" : "");
+
+      for (header_num = 0; header_num < cluster->len; header_num++)
+        {
+          const Header *header = g_ptr_array_index (cluster, header_num);
+          g_print ("  %s\n", header->filename);
+        }
+
+      g_print ("\n");
+    }
+
+  g_hash_table_unref (clusters_by_root);
+  g_ptr_array_unref (clusters);
+  g_ptr_array_unref (headers);
+  g_free (parents);
+}
+
+static gint
+handle_find_similar (gint    n_args,
+                     gchar **args)
+{
+  GPtrArray *filenames;
+
+  if (n_args >= 2 && g_str_equal (args[0], "--compile-commands"))
+    {
+      gboolean include_headers = FALSE;
+      GError *error = NULL;
+
+      if (n_args == 3 && g_str_equal (args[2], "--include-headers"))
+        {
+          include_headers = TRUE;
+        }
+      else if (n_args != 2)
+        {
+          g_printerr ("Usage: --find-similar --compile-commands <file> [--include-headers]\n");
+          return EXIT_FAILURE;
+        }
+
+      filenames = gcu_file_list_new_from_compile_commands (args[1], include_headers, &error);
+      if (filenames == NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          g_clear_error (&error);
+          return EXIT_FAILURE;
+        }
+    }
+  else
+    {
+      filenames = gcu_file_list_new_from_paths (n_args, args);
+    }
+
+  find_similar_headers (filenames);
+  g_ptr_array_unref (filenames);
+
+  return EXIT_SUCCESS;
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
@@ -629,14 +1225,21 @@ main (gint   argc,
   gchar *replacement = NULL;
   GQueue *canonicalized_search_text;
   Sub *sub;
+  gint status = EXIT_SUCCESS;
 
   setlocale (LC_ALL, "");
+  gcu_budget_init (&_budget);
 
   gtk_init (NULL, NULL);
 
+  if (argc >= 2 && g_str_equal (argv[1], "--find-similar"))
+    return handle_find_similar (argc - 2, argv + 2);
+
   if (argc != 4)
     {
-      g_printerr ("Usage: %s <search-text-file> <replacement-file> <file>\n", argv[0]);
+      g_printerr ("Usage: %s <search-text-file> <replacement-file> <file or ->\n", argv[0]);
+      g_printerr ("       %s --find-similar [file or directory...]\n", argv[0]);
+      g_printerr ("       %s --find-similar --compile-commands <file> [--include-headers]\n", argv[0]);
       g_printerr ("WARNING: the script directly modifies <file> without doing a backup first!\n");
       return EXIT_FAILURE;
     }
@@ -645,6 +1248,13 @@ main (gint   argc,
   replacement_path = argv[2];
   filename = argv[3];
 
+  /* The size is checked first, the loading of a huge file is expensive. The
+   * lines are checked once loaded, by lex_buffer().
+   */
+  if (!g_str_equal (filename, "-") &&
+      !gcu_budget_check_file (&_budget, filename))
+    return EXIT_SUCCESS;
+
   full_search_text = get_file_contents (search_text_path);
   full_replacement = get_file_contents (replacement_path);
 
@@ -661,19 +1271,25 @@ main (gint   argc,
   print_canonicalized_search_text (canonicalized_search_text);
 #endif
 
-  g_print ("Processing %s\n", filename);
+  if (g_str_equal (filename, "-"))
+    status = handle_stdin (canonicalized_search_text, replacement);
+  else
+    {
+      g_print ("Processing %s\n", filename);
+
+      sub = sub_new (canonicalized_search_text, replacement, filename);
+      sub_launch (sub);
 
-  sub = sub_new (canonicalized_search_text, replacement, filename);
-  sub_launch (sub);
+      gtk_main ();
 
-  gtk_main ();
+      sub_free (sub);
+    }
 
-  sub_free (sub);
   g_free (full_search_text);
   g_free (full_replacement);
   g_free (search_text);
   g_free (replacement);
   g_queue_free_full (canonicalized_search_text, g_free);
 
-  return EXIT_SUCCESS;
+  return status;
 }
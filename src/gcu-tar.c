@@ -0,0 +1,1165 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* For splice(). */
+#define _GNU_SOURCE
+
+#include "gcu-tar.h"
+#include <gio/gio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gcu-scheduler.h"
+
+/*
+ * Filter of a tar stream, to process the files of a release tarball without
+ * extracting it to the disk.
+ *
+ * The archive is read from a file descriptor and written to another one, member
+ * by member, in the same order. The regular files whose path ends with one of
+ * the suffixes are read in memory and given to the transform function, in a
+ * thread pool if n_threads > 1. Up to MAX_PENDING_JOBS of them are read ahead
+ * and processed at the same time, and they are written in order as soon as the
+ * first ones are done.
+ *
+ * The memory of a member is estimated from its size, like for the files of
+ * gcu-lineup-parameters --max-memory. The threads are those of a gcu-scheduler
+ * with max_memory, and the members read ahead, running or not, are limited to
+ * max_memory in total too, since they are all in memory until written. A
+ * member bigger than max_memory is processed alone. With a max_memory of 0,
+ * the limit is DEFAULT_MAX_PENDING_MEMORY.
+ *
+ * The contents of the members and the new contents written by the transform
+ * function are in GStrings that are reused from one member to the next, so
+ * that after the first members the threads don't go through the shared
+ * allocator for them, like the per-thread buffers of gcu-lineup-parameters.
+ * The free buffers are only handled by the thread that reads and writes the
+ * archive: a job gets its two buffers when it is created, and gives them back
+ * when it is written.
+ *
+ * The other members are copied as they are, with splice() when the input or
+ * the output is a pipe, so that their data doesn't go through user space. The
+ * end of the archive (the zero blocks and the padding of the last record) is
+ * copied too, so that an archive in which nothing is changed is written back
+ * byte for byte.
+ *
+ * The ustar, GNU (long names) and pax formats are supported. The headers of a
+ * transformed member are kept, only its size (and the header checksum) is
+ * updated. If a pax extended header of the member gives the size, that record
+ * is removed, the size of the ustar header then applies.
+ */
+
+#define BLOCK_SIZE (512)
+
+/* The matching members that are bigger are copied unchanged. */
+#define MAX_MEMBER_SIZE (64 * 1024 * 1024)
+
+/* The GNU long names and the pax extended headers are read in memory. */
+#define MAX_EXTENDED_HEADER_SIZE (1024 * 1024)
+
+#define MAX_PENDING_JOBS (64)
+#define DEFAULT_MAX_PENDING_MEMORY (384 * 1024 * 1024)
+
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+/* A bigger buffer is freed after its member, so that the memory of a huge
+ * member is not kept until the end of the archive.
+ */
+#define MAX_RECYCLED_BUFFER_SIZE (16 * 1024 * 1024)
+
+/* Offsets in a ustar header block. */
+#define HEADER_NAME_OFFSET (0)
+#define HEADER_NAME_SIZE (100)
+#define HEADER_SIZE_OFFSET (124)
+#define HEADER_SIZE_SIZE (12)
+#define HEADER_CHECKSUM_OFFSET (148)
+#define HEADER_CHECKSUM_SIZE (8)
+#define HEADER_TYPEFLAG_OFFSET (156)
+#define HEADER_MAGIC_OFFSET (257)
+#define HEADER_PREFIX_OFFSET (345)
+#define HEADER_PREFIX_SIZE (155)
+
+typedef struct _TarJob TarJob;
+struct _TarJob
+{
+  /* The extended headers of the member followed by its header, as read. */
+  GByteArray *headers;
+
+  /* Offset in @headers of the header of the member, and of the pax extended
+   * header giving its size, or -1.
+   */
+  gsize header_offset;
+  gssize pax_size_offset;
+
+  gchar *path;
+
+  /* The data of the member, with its padding, and its size without the
+   * padding.
+   */
+  GString *contents;
+  gsize length;
+
+  /* The estimated memory to process the member. */
+  guint64 cost;
+
+  /* Filled by the transform function, if @changed. */
+  GString *new_contents;
+  gboolean changed;
+  gboolean done;
+};
+
+typedef struct _TarFilter TarFilter;
+struct _TarFilter
+{
+  gint input_fd;
+  gint output_fd;
+  gboolean can_splice;
+
+  GcuTarTransformFunc transform;
+  gpointer user_data;
+
+  /* %NULL with only one thread. */
+  GcuScheduler *scheduler;
+  GMutex mutex;
+  GCond cond;
+
+  /* The jobs (TarJob *) not yet written, in the order of the archive, and
+   * their total cost.
+   */
+  GQueue pending_jobs;
+  guint64 pending_cost;
+  guint64 max_pending_cost;
+
+  /* The GStrings to reuse for the next jobs. */
+  GPtrArray *free_buffers;
+};
+
+/* The extended headers read before a member. */
+typedef struct _ExtendedHeaders ExtendedHeaders;
+struct _ExtendedHeaders
+{
+  GByteArray *headers;
+  gchar *long_name;
+  gchar *pax_path;
+  guint64 pax_size;
+  gboolean has_pax_size;
+  gssize pax_size_offset;
+};
+
+static const gchar zero_block[BLOCK_SIZE];
+
+/* Returns: an empty buffer, reused if possible. */
+static GString *
+take_buffer (TarFilter *filter)
+{
+  GString *buffer;
+
+  if (filter->free_buffers->len == 0)
+    return g_string_new (NULL);
+
+  buffer = g_ptr_array_index (filter->free_buffers, filter->free_buffers->len - 1);
+  g_ptr_array_set_size (filter->free_buffers, filter->free_buffers->len - 1);
+  g_string_truncate (buffer, 0);
+
+  return buffer;
+}
+
+static void
+give_back_buffer (TarFilter *filter,
+                  GString   *buffer)
+{
+  if (buffer->allocated_len <= MAX_RECYCLED_BUFFER_SIZE)
+    g_ptr_array_add (filter->free_buffers, buffer);
+  else
+    g_string_free (buffer, TRUE);
+}
+
+static TarJob *
+tar_job_new (TarFilter *filter)
+{
+  TarJob *job = g_new0 (TarJob, 1);
+
+  job->contents = take_buffer (filter);
+  job->new_contents = take_buffer (filter);
+
+  return job;
+}
+
+static void
+tar_job_free (TarFilter *filter,
+              TarJob    *job)
+{
+  g_byte_array_unref (job->headers);
+  g_free (job->path);
+  give_back_buffer (filter, job->contents);
+  give_back_buffer (filter, job->new_contents);
+  g_free (job);
+}
+
+static void
+extended_headers_clear (ExtendedHeaders *extended)
+{
+  g_byte_array_set_size (extended->headers, 0);
+  g_clear_pointer (&extended->long_name, g_free);
+  g_clear_pointer (&extended->pax_path, g_free);
+  extended->pax_size = 0;
+  extended->has_pax_size = FALSE;
+  extended->pax_size_offset = -1;
+}
+
+static gsize
+get_padding (guint64 size)
+{
+  return (BLOCK_SIZE - size % BLOCK_SIZE) % BLOCK_SIZE;
+}
+
+static void
+set_unexpected_end_error (GError **error)
+{
+  g_set_error_literal (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "Unexpected end of the tar archive.");
+}
+
+static void
+set_io_error (gint          saved_errno,
+              const gchar  *action,
+              GError      **error)
+{
+  g_set_error (error,
+               G_IO_ERROR,
+               g_io_error_from_errno (saved_errno),
+               "Error when %s the tar archive: %s",
+               action,
+               g_strerror (saved_errno));
+}
+
+/* Returns the number of bytes read, less than @length only at the end of the
+ * input, or -1 on error.
+ */
+static gssize
+read_all (gint     fd,
+          gchar   *data,
+          gsize    length,
+          GError **error)
+{
+  gsize n_read = 0;
+
+  while (n_read < length)
+    {
+      gssize n;
+
+      n = read (fd, data + n_read, length - n_read);
+
+      if (n == 0)
+        break;
+
+      if (n == -1)
+        {
+          if (errno == EINTR)
+            continue;
+
+          set_io_error (errno, "reading", error);
+          return -1;
+        }
+
+      n_read += n;
+    }
+
+  return n_read;
+}
+
+static gboolean
+read_exactly (gint     fd,
+              gchar   *data,
+              gsize    length,
+              GError **error)
+{
+  gssize n_read;
+
+  n_read = read_all (fd, data, length, error);
+
+  if (n_read == -1)
+    return FALSE;
+
+  if ((gsize) n_read < length)
+    {
+      set_unexpected_end_error (error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+write_all (gint          fd,
+           const gchar  *data,
+           gsize         length,
+           GError      **error)
+{
+  while (length > 0)
+    {
+      gssize n_written;
+
+      n_written = write (fd, data, length);
+
+      if (n_written == -1)
+        {
+          if (errno == EINTR)
+            continue;
+
+          set_io_error (errno, "writing", error);
+          return FALSE;
+        }
+
+      data += n_written;
+      length -= n_written;
+    }
+
+  return TRUE;
+}
+
+/* Copies @length bytes from the input to the output, or everything until the
+ * end of the input if @length is -1.
+ */
+static gboolean
+copy_data (TarFilter  *filter,
+           gint64      length,
+           GError    **error)
+{
+  gchar *buffer;
+
+#ifdef HAVE_SPLICE
+  while (filter->can_splice && length != 0)
+    {
+      gsize chunk_length = length < 0 ? G_MAXINT : MIN (length, G_MAXINT);
+      gssize n;
+
+      n = splice (filter->input_fd,
+                  NULL,
+                  filter->output_fd,
+                  NULL,
+                  chunk_length,
+                  SPLICE_F_MOVE | SPLICE_F_MORE);
+
+      if (n > 0)
+        {
+          if (length > 0)
+            length -= n;
+          continue;
+        }
+
+      if (n == 0)
+        {
+          if (length < 0)
+            return TRUE;
+
+          set_unexpected_end_error (error);
+          return FALSE;
+        }
+
+      if (errno == EINTR)
+        continue;
+
+      /* Neither the input nor the output is a pipe, or splice() is not
+       * supported by one of them. Nothing was copied.
+       */
+      if (errno == EINVAL || errno == ENOSYS)
+        {
+          filter->can_splice = FALSE;
+          break;
+        }
+
+      set_io_error (errno, "copying", error);
+      return FALSE;
+    }
+#endif
+
+  if (length == 0)
+    return TRUE;
+
+  buffer = g_malloc (COPY_BUFFER_SIZE);
+
+  while (length != 0)
+    {
+      gsize chunk_length = length < 0 ? COPY_BUFFER_SIZE : MIN (length, COPY_BUFFER_SIZE);
+      gssize n_read;
+
+      n_read = read_all (filter->input_fd, buffer, chunk_length, error);
+
+      if (n_read == -1 ||
+          !write_all (filter->output_fd, buffer, n_read, error))
+        {
+          g_free (buffer);
+          return FALSE;
+        }
+
+      if ((gsize) n_read < chunk_length)
+        {
+          g_free (buffer);
+
+          if (length < 0)
+            return TRUE;
+
+          set_unexpected_end_error (error);
+          return FALSE;
+        }
+
+      if (length > 0)
+        length -= n_read;
+    }
+
+  g_free (buffer);
+  return TRUE;
+}
+
+static gboolean
+is_zero_block (const gchar *block)
+{
+  return memcmp (block, zero_block, BLOCK_SIZE) == 0;
+}
+
+static guint
+compute_checksum (const guchar *header)
+{
+  guint sum = 0;
+  gsize i;
+
+  for (i = 0; i < BLOCK_SIZE; i++)
+    {
+      if (i >= HEADER_CHECKSUM_OFFSET &&
+          i < HEADER_CHECKSUM_OFFSET + HEADER_CHECKSUM_SIZE)
+        sum += ' ';
+      else
+        sum += header[i];
+    }
+
+  return sum;
+}
+
+static void
+update_checksum (guchar *header)
+{
+  g_snprintf ((gchar *) header + HEADER_CHECKSUM_OFFSET,
+              HEADER_CHECKSUM_SIZE,
+              "%06o",
+              compute_checksum (header));
+
+  header[HEADER_CHECKSUM_OFFSET + HEADER_CHECKSUM_SIZE - 1] = ' ';
+}
+
+/* A numeric field is in octal, or in base-256 (a GNU extension for the big
+ * sizes) if the high bit of its first byte is set.
+ */
+static gboolean
+parse_number (const gchar *field,
+              gsize        field_size,
+              guint64     *value)
+{
+  const guchar *bytes = (const guchar *) field;
+  gsize i = 0;
+
+  *value = 0;
+
+  if (bytes[0] & 0x80)
+    {
+      /* Negative numbers are not valid sizes. */
+      if (bytes[0] & 0x40)
+        return FALSE;
+
+      *value = bytes[0] & 0x3f;
+
+      for (i = 1; i < field_size; i++)
+        {
+          if (*value > G_MAXUINT64 >> 8)
+            return FALSE;
+
+          *value = (*value << 8) | bytes[i];
+        }
+
+      return TRUE;
+    }
+
+  while (i < field_size && field[i] == ' ')
+    i++;
+
+  for (; i < field_size && field[i] >= '0' && field[i] <= '7'; i++)
+    {
+      if (*value > G_MAXUINT64 >> 3)
+        return FALSE;
+
+      *value = (*value << 3) | (field[i] - '0');
+    }
+
+  return i == field_size || field[i] == ' ' || field[i] == '\0';
+}
+
+static void
+set_size (guchar  *header,
+          guint64  size)
+{
+  gchar *field = (gchar *) header + HEADER_SIZE_OFFSET;
+
+  if (size < G_GUINT64_CONSTANT (1) << 33)
+    {
+      g_snprintf (field, HEADER_SIZE_SIZE, "%011" G_GINT64_MODIFIER "o", size);
+    }
+  else
+    {
+      gint i;
+
+      for (i = HEADER_SIZE_SIZE - 1; i > 0; i--)
+        {
+          header[HEADER_SIZE_OFFSET + i] = size & 0xff;
+          size >>= 8;
+        }
+
+      header[HEADER_SIZE_OFFSET] = 0x80;
+    }
+}
+
+static gboolean
+check_header (const guchar  *header,
+              GError       **error)
+{
+  guint64 checksum;
+
+  if (!parse_number ((const gchar *) header + HEADER_CHECKSUM_OFFSET,
+                     HEADER_CHECKSUM_SIZE,
+                     &checksum) ||
+      checksum != compute_checksum (header))
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_INVALID_DATA,
+                           "Invalid tar header checksum, the input is not a tar archive "
+                           "or is corrupted.");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+set_invalid_pax_error (GError **error)
+{
+  g_set_error_literal (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "Invalid pax extended header in the tar archive.");
+}
+
+/* Reads the record at *@pos of a pax extended header, and moves *@pos to the
+ * next one. The records are "<length> <key>=<value>\n", the length including
+ * the whole record. Returns FALSE at the end, or if the record is invalid, in
+ * which case @error is set.
+ */
+static gboolean
+next_pax_record (const gchar **pos,
+                 const gchar  *end,
+                 const gchar **key,
+                 gsize        *key_length,
+                 const gchar **value,
+                 gsize        *value_length,
+                 GError      **error)
+{
+  const gchar *record_start = *pos;
+  const gchar *record_end;
+  const gchar *p = *pos;
+  const gchar *equal;
+  gsize record_length = 0;
+
+  /* The data is padded with nul bytes. */
+  if (p >= end || *p == '\0')
+    return FALSE;
+
+  while (p < end && g_ascii_isdigit (*p) && record_length <= (gsize) (end - record_start))
+    record_length = record_length * 10 + (*p++ - '0');
+
+  if (p >= end || *p != ' ' ||
+      record_length > (gsize) (end - record_start))
+    {
+      set_invalid_pax_error (error);
+      return FALSE;
+    }
+
+  record_end = record_start + record_length;
+  p++;
+
+  if (p >= record_end || record_end[-1] != '\n')
+    {
+      set_invalid_pax_error (error);
+      return FALSE;
+    }
+
+  equal = memchr (p, '=', record_end - p);
+  if (equal == NULL)
+    {
+      set_invalid_pax_error (error);
+      return FALSE;
+    }
+
+  *key = p;
+  *key_length = equal - p;
+  *value = equal + 1;
+  *value_length = record_end - 1 - *value;
+  *pos = record_end;
+  return TRUE;
+}
+
+static gboolean
+is_pax_key (const gchar *key,
+            gsize        key_length,
+            const gchar *expected_key)
+{
+  return (key_length == strlen (expected_key) &&
+          memcmp (key, expected_key, key_length) == 0);
+}
+
+static gboolean
+parse_pax_records (const gchar      *data,
+                   gsize             length,
+                   ExtendedHeaders  *extended,
+                   GError          **error)
+{
+  const gchar *pos = data;
+  const gchar *end = data + length;
+  const gchar *key;
+  const gchar *value;
+  gsize key_length;
+  gsize value_length;
+  GError *my_error = NULL;
+
+  while (next_pax_record (&pos, end, &key, &key_length, &value, &value_length, &my_error))
+    {
+      if (is_pax_key (key, key_length, "path"))
+        {
+          g_free (extended->pax_path);
+          extended->pax_path = g_strndup (value, value_length);
+        }
+      else if (is_pax_key (key, key_length, "size"))
+        {
+          gchar *size_str = g_strndup (value, value_length);
+          gboolean ok;
+
+          ok = g_ascii_string_to_unsigned (size_str, 10, 0, G_MAXUINT64, &extended->pax_size, NULL);
+          g_free (size_str);
+
+          if (!ok)
+            {
+              g_set_error_literal (error,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_INVALID_DATA,
+                                   "Invalid size in a pax extended header of the tar archive.");
+              return FALSE;
+            }
+
+          extended->has_pax_size = TRUE;
+        }
+    }
+
+  if (my_error != NULL)
+    {
+      g_propagate_error (error, my_error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Rewrites the pax extended header at @offset in @headers without its "size"
+ * record.
+ */
+static GByteArray *
+remove_pax_size_record (GByteArray *headers,
+                        gsize       offset)
+{
+  GByteArray *new_headers;
+  guint64 data_length;
+  gsize data_offset = offset + BLOCK_SIZE;
+  gsize next_offset;
+  const gchar *pos;
+  const gchar *end;
+  const gchar *record_start;
+  const gchar *key;
+  const gchar *value;
+  gsize key_length;
+  gsize value_length;
+  gsize new_data_length;
+
+  /* Already validated when reading. */
+  parse_number ((const gchar *) headers->data + offset + HEADER_SIZE_OFFSET,
+                HEADER_SIZE_SIZE,
+                &data_length);
+  next_offset = data_offset + data_length + get_padding (data_length);
+
+  new_headers = g_byte_array_sized_new (headers->len);
+  g_byte_array_append (new_headers, headers->data, data_offset);
+
+  pos = (const gchar *) headers->data + data_offset;
+  end = pos + data_length;
+  record_start = pos;
+
+  while (next_pax_record (&pos, end, &key, &key_length, &value, &value_length, NULL))
+    {
+      if (!is_pax_key (key, key_length, "size"))
+        g_byte_array_append (new_headers, (const guint8 *) record_start, pos - record_start);
+
+      record_start = pos;
+    }
+
+  new_data_length = new_headers->len - data_offset;
+  g_byte_array_append (new_headers, (const guint8 *) zero_block, get_padding (new_data_length));
+
+  set_size (new_headers->data + offset, new_data_length);
+  update_checksum (new_headers->data + offset);
+
+  g_byte_array_append (new_headers,
+                       headers->data + next_offset,
+                       headers->len - next_offset);
+
+  return new_headers;
+}
+
+static void
+tar_job_run (gpointer data,
+             gpointer user_data)
+{
+  TarJob *job = data;
+  TarFilter *filter = user_data;
+
+  job->changed = filter->transform (job->path,
+                                    job->contents->str,
+                                    job->length,
+                                    job->new_contents,
+                                    filter->user_data);
+
+  g_mutex_lock (&filter->mutex);
+  job->done = TRUE;
+  g_cond_broadcast (&filter->cond);
+  g_mutex_unlock (&filter->mutex);
+}
+
+static gboolean
+write_job (TarFilter  *filter,
+           TarJob     *job,
+           GError    **error)
+{
+  GByteArray *headers;
+  const gchar *contents = job->contents->str;
+  gsize length = job->length;
+  gboolean ok;
+
+  headers = g_byte_array_ref (job->headers);
+
+  if (job->changed)
+    {
+      gsize header_offset = job->header_offset;
+
+      contents = job->new_contents->str;
+      length = job->new_contents->len;
+
+      if (job->pax_size_offset != -1)
+        {
+          gsize old_length = headers->len;
+
+          g_byte_array_unref (headers);
+          headers = remove_pax_size_record (job->headers, job->pax_size_offset);
+
+          /* The header of the member comes after the pax extended header. */
+          header_offset -= old_length - headers->len;
+        }
+
+      set_size (headers->data + header_offset, length);
+      update_checksum (headers->data + header_offset);
+    }
+
+  ok = (write_all (filter->output_fd, (const gchar *) headers->data, headers->len, error) &&
+        write_all (filter->output_fd, contents, length, error) &&
+        write_all (filter->output_fd, zero_block, get_padding (length), error));
+
+  g_byte_array_unref (headers);
+  return ok;
+}
+
+static gboolean
+write_next_job (TarFilter  *filter,
+                GError    **error)
+{
+  TarJob *job;
+  gboolean ok;
+
+  job = g_queue_pop_head (&filter->pending_jobs);
+
+  g_mutex_lock (&filter->mutex);
+  while (!job->done)
+    g_cond_wait (&filter->cond, &filter->mutex);
+  g_mutex_unlock (&filter->mutex);
+
+  ok = write_job (filter, job, error);
+
+  filter->pending_cost -= job->cost;
+  tar_job_free (filter, job);
+
+  return ok;
+}
+
+static gboolean
+write_pending_jobs (TarFilter  *filter,
+                    GError    **error)
+{
+  while (!g_queue_is_empty (&filter->pending_jobs))
+    {
+      if (!write_next_job (filter, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+push_job (TarFilter  *filter,
+          TarJob     *job,
+          GError    **error)
+{
+  job->cost = gcu_scheduler_estimate_cost (job->length);
+
+  g_queue_push_tail (&filter->pending_jobs, job);
+  filter->pending_cost += job->cost;
+
+  if (filter->scheduler != NULL)
+    gcu_scheduler_push (filter->scheduler, job, job->cost);
+  else
+    tar_job_run (job, filter);
+
+  /* When the pending jobs don't fit, the oldest ones are written. A job that
+   * doesn't fit on its own is written right away, after the previous ones, so
+   * it runs alone.
+   */
+  while (filter->pending_jobs.length > MAX_PENDING_JOBS ||
+         filter->pending_cost > filter->max_pending_cost ||
+         (filter->scheduler == NULL && !g_queue_is_empty (&filter->pending_jobs)))
+    {
+      if (!write_next_job (filter, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+has_suffix (const gchar          *path,
+            const gchar * const  *suffixes)
+{
+  gint i;
+
+  for (i = 0; suffixes[i] != NULL; i++)
+    {
+      if (g_str_has_suffix (path, suffixes[i]))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* The name of the member in @header, with the ustar prefix. */
+static gchar *
+get_header_name (const guchar *header)
+{
+  const gchar *block = (const gchar *) header;
+  gchar *name;
+
+  name = g_strndup (block + HEADER_NAME_OFFSET, HEADER_NAME_SIZE);
+
+  /* In the GNU format, the prefix field is used for other things. */
+  if (memcmp (block + HEADER_MAGIC_OFFSET, "ustar\0" "00", 8) == 0 &&
+      block[HEADER_PREFIX_OFFSET] != '\0')
+    {
+      gchar *prefix = g_strndup (block + HEADER_PREFIX_OFFSET, HEADER_PREFIX_SIZE);
+      gchar *full_name = g_strconcat (prefix, "/", name, NULL);
+
+      g_free (prefix);
+      g_free (name);
+      name = full_name;
+    }
+
+  return name;
+}
+
+/* Reads the data of an extended header (@header is the last block of
+ * @extended->headers) and appends it to @extended->headers.
+ */
+static gboolean
+read_extended_header (TarFilter        *filter,
+                      ExtendedHeaders  *extended,
+                      guint64           size,
+                      GError          **error)
+{
+  gchar typeflag = extended->headers->data[extended->headers->len - BLOCK_SIZE + HEADER_TYPEFLAG_OFFSET];
+  gsize header_offset = extended->headers->len - BLOCK_SIZE;
+  gsize data_offset = extended->headers->len;
+  gsize padded_size;
+  const gchar *data;
+
+  if (size > MAX_EXTENDED_HEADER_SIZE)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_INVALID_DATA,
+                           "Too big extended header in the tar archive.");
+      return FALSE;
+    }
+
+  padded_size = size + get_padding (size);
+  g_byte_array_set_size (extended->headers, data_offset + padded_size);
+
+  if (!read_exactly (filter->input_fd,
+                     (gchar *) extended->headers->data + data_offset,
+                     padded_size,
+                     error))
+    return FALSE;
+
+  data = (const gchar *) extended->headers->data + data_offset;
+
+  if (typeflag == 'L')
+    {
+      g_free (extended->long_name);
+      extended->long_name = g_strndup (data, size);
+      return TRUE;
+    }
+
+  /* typeflag == 'x' */
+  if (!parse_pax_records (data, size, extended, error))
+    return FALSE;
+
+  if (extended->has_pax_size && extended->pax_size_offset == -1)
+    extended->pax_size_offset = header_offset;
+
+  return TRUE;
+}
+
+static gboolean
+filter_members (TarFilter            *filter,
+                const gchar * const  *suffixes,
+                GError              **error)
+{
+  ExtendedHeaders extended = { 0 };
+  gboolean ok = FALSE;
+
+  extended.headers = g_byte_array_new ();
+  extended.pax_size_offset = -1;
+
+  while (TRUE)
+    {
+      guchar *header;
+      gsize header_offset;
+      gchar typeflag;
+      guint64 size;
+      gssize n_read;
+      gchar *path;
+
+      header_offset = extended.headers->len;
+      g_byte_array_set_size (extended.headers, header_offset + BLOCK_SIZE);
+      header = extended.headers->data + header_offset;
+
+      n_read = read_all (filter->input_fd, (gchar *) header, BLOCK_SIZE, error);
+      if (n_read == -1)
+        goto out;
+
+      /* An archive without the end-of-archive blocks, as GNU tar accepts. */
+      if (n_read == 0 && header_offset == 0)
+        {
+          ok = write_pending_jobs (filter, error);
+          goto out;
+        }
+
+      if (n_read < BLOCK_SIZE)
+        {
+          set_unexpected_end_error (error);
+          goto out;
+        }
+
+      if (is_zero_block ((const gchar *) header) && header_offset == 0)
+        {
+          ok = (write_pending_jobs (filter, error) &&
+                write_all (filter->output_fd, zero_block, BLOCK_SIZE, error) &&
+                copy_data (filter, -1, error));
+          goto out;
+        }
+
+      if (!check_header (header, error))
+        goto out;
+
+      typeflag = header[HEADER_TYPEFLAG_OFFSET];
+
+      if (!parse_number ((const gchar *) header + HEADER_SIZE_OFFSET, HEADER_SIZE_SIZE, &size))
+        {
+          g_set_error_literal (error,
+                               G_IO_ERROR,
+                               G_IO_ERROR_INVALID_DATA,
+                               "Invalid size in a tar header.");
+          goto out;
+        }
+
+      if (typeflag == 'L' || typeflag == 'x')
+        {
+          if (!read_extended_header (filter, &extended, size, error))
+            goto out;
+
+          continue;
+        }
+
+      if (extended.has_pax_size)
+        size = extended.pax_size;
+
+      if (extended.pax_path != NULL)
+        path = g_strdup (extended.pax_path);
+      else if (extended.long_name != NULL)
+        path = g_strdup (extended.long_name);
+      else
+        path = get_header_name (header);
+
+      if ((typeflag == '0' || typeflag == '\0' || typeflag == '7') &&
+          size <= MAX_MEMBER_SIZE &&
+          has_suffix (path, suffixes))
+        {
+          TarJob *job = tar_job_new (filter);
+
+          job->headers = g_byte_array_ref (extended.headers);
+          job->header_offset = header_offset;
+          job->pax_size_offset = extended.pax_size_offset;
+          job->path = path;
+          job->length = size;
+          g_string_set_size (job->contents, size + get_padding (size));
+
+          if (!read_exactly (filter->input_fd,
+                             job->contents->str,
+                             size + get_padding (size),
+                             error))
+            {
+              tar_job_free (filter, job);
+              goto out;
+            }
+
+          /* The headers now belong to the job. */
+          g_byte_array_unref (extended.headers);
+          extended.headers = g_byte_array_new ();
+          extended_headers_clear (&extended);
+
+          if (!push_job (filter, job, error))
+            goto out;
+
+          continue;
+        }
+
+      g_free (path);
+
+      /* Other members, and the 'g' pax global headers: copied as they are,
+       * after the pending jobs.
+       */
+      if (!write_pending_jobs (filter, error) ||
+          !write_all (filter->output_fd,
+                      (const gchar *) extended.headers->data,
+                      extended.headers->len,
+                      error) ||
+          !copy_data (filter, size + get_padding (size), error))
+        goto out;
+
+      extended_headers_clear (&extended);
+    }
+
+out:
+  extended_headers_clear (&extended);
+  g_byte_array_unref (extended.headers);
+  return ok;
+}
+
+/**
+ * gcu_tar_filter:
+ * @input_fd: the tar archive to read.
+ * @output_fd: where to write the filtered tar archive.
+ * @suffixes: (array zero-terminated=1): the suffixes of the paths of the
+ *   members to transform, for example ".c".
+ * @n_threads: the number of threads calling @transform, or 1 to call it from
+ *   the current thread.
+ * @max_memory: the maximum memory estimated for the members being processed
+ *   or waiting to be written, in bytes, or 0 for the default.
+ * @transform: the transform function.
+ * @user_data: user data for @transform.
+ * @error: location to a %NULL #GError, or %NULL.
+ *
+ * Copies a tar archive from @input_fd to @output_fd, with the matching
+ * members transformed by @transform. On error, the output is incomplete.
+ *
+ * Returns: whether the whole archive was written.
+ */
+gboolean
+gcu_tar_filter (gint                  input_fd,
+                gint                  output_fd,
+                const gchar * const  *suffixes,
+                guint                 n_threads,
+                guint64               max_memory,
+                GcuTarTransformFunc   transform,
+                gpointer              user_data,
+                GError              **error)
+{
+  TarFilter filter = { 0 };
+  gboolean ok;
+  guint i;
+
+  g_return_val_if_fail (suffixes != NULL, FALSE);
+  g_return_val_if_fail (n_threads >= 1, FALSE);
+  g_return_val_if_fail (transform != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  filter.input_fd = input_fd;
+  filter.output_fd = output_fd;
+  filter.can_splice = TRUE;
+  filter.transform = transform;
+  filter.user_data = user_data;
+  g_mutex_init (&filter.mutex);
+  g_cond_init (&filter.cond);
+  g_queue_init (&filter.pending_jobs);
+  filter.free_buffers = g_ptr_array_new ();
+
+  filter.max_pending_cost = max_memory > 0 ? max_memory : DEFAULT_MAX_PENDING_MEMORY;
+
+  if (n_threads > 1)
+    filter.scheduler = gcu_scheduler_new (tar_job_run, &filter, n_threads, max_memory);
+
+  ok = filter_members (&filter, suffixes, error);
+
+  /* On error, waits for the jobs still running before freeing them. */
+  gcu_scheduler_free (filter.scheduler);
+
+  while (!g_queue_is_empty (&filter.pending_jobs))
+    tar_job_free (&filter, g_queue_pop_head (&filter.pending_jobs));
+
+  /* Without a free function, so that take_buffer() can remove them. */
+  for (i = 0; i < filter.free_buffers->len; i++)
+    g_string_free (g_ptr_array_index (filter.free_buffers, i), TRUE);
+  g_ptr_array_unref (filter.free_buffers);
+  g_mutex_clear (&filter.mutex);
+  g_cond_clear (&filter.cond);
+
+  return ok;
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_TAR_H
+#define GCU_TAR_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* @new_contents is empty, and reused from one member to the next. Returns:
+ * %TRUE if the member @path changes, its new contents are then appended to
+ * @new_contents.
+ */
+typedef gboolean	(* GcuTarTransformFunc)	(const gchar	*path,
+						 const gchar	*contents,
+						 gsize		 length,
+						 GString	*new_contents,
+						 gpointer	 user_data);
+
+gboolean	gcu_tar_filter		(gint			 input_fd,
+					 gint			 output_fd,
+					 const gchar * const	*suffixes,
+					 guint			 n_threads,
+					 guint64		 max_memory,
+					 GcuTarTransformFunc	 transform,
+					 gpointer		 user_data,
+					 GError		       **error);
+
+G_END_DECLS
+
+#endif /* GCU_TAR_H */
@@ -0,0 +1,237 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gcu-trace.h"
+#include "gcu-json.h"
+#include <string.h>
+
+/*
+ * Timeline of a run, in the Chrome trace-event JSON format, which can be opened
+ * with chrome://tracing or https://ui.perfetto.dev/
+ *
+ * Each thread has its own track, and each call to gcu_trace_begin() and
+ * gcu_trace_end() gives a slice, for example for a phase of the processing of
+ * a file, with the filename and its size as arguments. The slices of a thread
+ * can be nested.
+ *
+ * To keep the overhead negligible, each thread records its slices in its own
+ * buffer, without locking, and the JSON is written only by gcu_trace_stop().
+ * When the trace is not started, gcu_trace_begin() returns 0 and
+ * gcu_trace_end() does nothing.
+ */
+
+typedef struct
+{
+  /* Static string. */
+  const gchar *name;
+
+  gchar *filename;
+  gssize n_bytes;
+  gint64 begin_time;
+  gint64 duration;
+} TraceSlice;
+
+typedef struct
+{
+  guint thread_num;
+  GArray *slices;
+} ThreadBuffer;
+
+static gboolean trace_enabled;
+static gboolean trace_started;
+static gchar *trace_path;
+static gint64 trace_start_time;
+
+static GMutex thread_buffers_mutex;
+static GPtrArray *thread_buffers;
+
+/* The ThreadBuffer of the current thread, owned by thread_buffers. */
+static GPrivate current_thread_buffer = G_PRIVATE_INIT (NULL);
+
+static ThreadBuffer *
+get_thread_buffer (void)
+{
+  ThreadBuffer *buffer;
+
+  buffer = g_private_get (&current_thread_buffer);
+  if (buffer != NULL)
+    return buffer;
+
+  buffer = g_new0 (ThreadBuffer, 1);
+  buffer->slices = g_array_new (FALSE, FALSE, sizeof (TraceSlice));
+
+  g_mutex_lock (&thread_buffers_mutex);
+  buffer->thread_num = thread_buffers->len;
+  g_ptr_array_add (thread_buffers, buffer);
+  g_mutex_unlock (&thread_buffers_mutex);
+
+  g_private_set (&current_thread_buffer, buffer);
+  return buffer;
+}
+
+static void
+thread_buffer_free (ThreadBuffer *buffer)
+{
+  guint i;
+
+  for (i = 0; i < buffer->slices->len; i++)
+    g_free (g_array_index (buffer->slices, TraceSlice, i).filename);
+
+  g_array_unref (buffer->slices);
+  g_free (buffer);
+}
+
+/* Starts recording the slices, to be written to @path by gcu_trace_stop().
+ * Must be called from the main thread, before the other threads are created,
+ * and only once per process. The main thread gets the first track.
+ */
+gboolean
+gcu_trace_start (const gchar  *path,
+                 GError      **error)
+{
+  g_return_val_if_fail (path != NULL, FALSE);
+  g_return_val_if_fail (!trace_started, FALSE);
+
+  /* Fail early if the file cannot be written. */
+  if (!g_file_set_contents (path, "", 0, error))
+    return FALSE;
+
+  trace_path = g_strdup (path);
+  trace_start_time = g_get_monotonic_time ();
+  thread_buffers = g_ptr_array_new_with_free_func ((GDestroyNotify) thread_buffer_free);
+  trace_enabled = TRUE;
+  trace_started = TRUE;
+
+  get_thread_buffer ();
+  return TRUE;
+}
+
+/* Writes the trace. Must be called when the other threads no longer record
+ * slices.
+ */
+gboolean
+gcu_trace_stop (GError **error)
+{
+  GString *json;
+  gboolean first = TRUE;
+  gboolean ok;
+  guint buffer_num;
+
+  g_return_val_if_fail (trace_enabled, FALSE);
+
+  trace_enabled = FALSE;
+
+  json = g_string_new ("{\"traceEvents\":[\n");
+
+  for (buffer_num = 0; buffer_num < thread_buffers->len; buffer_num++)
+    {
+      ThreadBuffer *buffer = g_ptr_array_index (thread_buffers, buffer_num);
+      guint i;
+
+      g_string_append_printf (json,
+                              "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                              "\"args\":{\"name\":",
+                              first ? "" : ",\n",
+                              buffer->thread_num);
+      first = FALSE;
+
+      if (buffer->thread_num == 0)
+        g_string_append (json, "\"main\"}}");
+      else
+        g_string_append_printf (json, "\"worker %u\"}}", buffer->thread_num);
+
+      for (i = 0; i < buffer->slices->len; i++)
+        {
+          const TraceSlice *slice = &g_array_index (buffer->slices, TraceSlice, i);
+
+          g_string_append_printf (json,
+                                  ",\n{\"name\":\"%s\",\"cat\":\"gcu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                                  "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ",\"args\":{",
+                                  slice->name,
+                                  buffer->thread_num,
+                                  slice->begin_time - trace_start_time,
+                                  slice->duration);
+
+          if (slice->filename != NULL)
+            {
+              g_string_append (json, "\"file\":");
+              gcu_json_append_string (json, slice->filename);
+            }
+
+          if (slice->n_bytes >= 0)
+            {
+              g_string_append_printf (json,
+                                      "%s\"bytes\":%" G_GSSIZE_FORMAT,
+                                      slice->filename != NULL ? "," : "",
+                                      slice->n_bytes);
+            }
+
+          g_string_append (json, "}}");
+        }
+    }
+
+  g_string_append (json, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+  ok = g_file_set_contents (trace_path, json->str, json->len, error);
+
+  g_string_free (json, TRUE);
+  g_clear_pointer (&trace_path, g_free);
+  /* The threads still point to their buffer, but they are no longer used,
+   * since the trace cannot be started again.
+   */
+  g_clear_pointer (&thread_buffers, g_ptr_array_unref);
+
+  return ok;
+}
+
+/* Returns: the begin time of a slice, to pass to gcu_trace_end(). */
+gint64
+gcu_trace_begin (void)
+{
+  if (!trace_enabled)
+    return 0;
+
+  return g_get_monotonic_time ();
+}
+
+/* Records a slice from @begin_time to now. @name must be a static string.
+ * @filename can be %NULL, and @n_bytes -1, if not relevant.
+ */
+void
+gcu_trace_end (gint64       begin_time,
+               const gchar *name,
+               const gchar *filename,
+               gssize       n_bytes)
+{
+  ThreadBuffer *buffer;
+  TraceSlice slice;
+
+  if (!trace_enabled || begin_time == 0)
+    return;
+
+  buffer = get_thread_buffer ();
+
+  slice.name = name;
+  slice.filename = g_strdup (filename);
+  slice.n_bytes = n_bytes;
+  slice.begin_time = begin_time;
+  slice.duration = g_get_monotonic_time () - begin_time;
+
+  g_array_append_val (buffer->slices, slice);
+}
@@ -0,0 +1,41 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_TRACE_H
+#define GCU_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gboolean	gcu_trace_start		(const gchar  *path,
+					 GError      **error);
+
+gboolean	gcu_trace_stop		(GError      **error);
+
+gint64		gcu_trace_begin		(void);
+
+void		gcu_trace_end		(gint64        begin_time,
+					 const gchar  *name,
+					 const gchar  *filename,
+					 gssize        n_bytes);
+
+G_END_DECLS
+
+#endif /* GCU_TRACE_H */
@@ -0,0 +1,474 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* For the nanoseconds of struct stat's st_mtim. */
+#define _GNU_SOURCE
+
+#include "gcu-watch.h"
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_INOTIFY
+#include <glib-unix.h>
+#include <sys/inotify.h>
+#endif
+
+/*
+ * Watch a directory tree with inotify, and call a function on each *.c or *.h
+ * file that has been saved.
+ *
+ * Editors often write a file in several steps (truncate, write, rename a
+ * backup, ...), so the events of a file are debounced: the function is called
+ * once DEBOUNCE_MS milliseconds have passed without a new event for that file.
+ * Each event restarts the timeout of its file, so a file written in several
+ * steps is processed once, after the last step, and not half-written.
+ *
+ * When the function rewrites the file, it must call gcu_watch_file_written()
+ * afterwards. The events caused by that write are then ignored, as long as the
+ * file on disk is still the one written, otherwise the tool would process its
+ * own output again and again.
+ */
+
+/* Short enough to not be noticeable after a save in a text editor, long
+ * enough for the steps of a save.
+ */
+#define DEBOUNCE_MS 100
+
+#define INOTIFY_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+
+typedef struct _WrittenFile WrittenFile;
+struct _WrittenFile
+{
+  dev_t device;
+  ino_t inode;
+  off_t size;
+  struct timespec mtime;
+};
+
+struct _GcuWatch
+{
+  GcuWatchFunc func;
+  gpointer user_data;
+
+  gint inotify_fd;
+  guint inotify_source_id;
+
+  /* Watch descriptor (gint) -> directory (gchar *). */
+  GHashTable *directories;
+
+  /* Filename (gchar *) -> the source ID (guint) of its debounce timeout, for
+   * the files changed since the last call to the function.
+   */
+  GHashTable *pending_files;
+
+  /* Filename (gchar *) -> WrittenFile, for the files written by the tool. */
+  GHashTable *written_files;
+};
+
+static gboolean
+get_written_file (const gchar *filename,
+                  WrittenFile *written_file)
+{
+  struct stat st;
+
+  if (g_stat (filename, &st) != 0)
+    return FALSE;
+
+  written_file->device = st.st_dev;
+  written_file->inode = st.st_ino;
+  written_file->size = st.st_size;
+  written_file->mtime = st.st_mtim;
+
+  return TRUE;
+}
+
+#ifdef HAVE_INOTIFY
+
+static gboolean
+is_watched_filename (const gchar *basename)
+{
+  if (basename[0] == '.')
+    return FALSE;
+
+  return (g_str_has_suffix (basename, ".c") ||
+          g_str_has_suffix (basename, ".h"));
+}
+
+static gboolean
+written_files_equal (const WrittenFile *a,
+                     const WrittenFile *b)
+{
+  return (a->device == b->device &&
+          a->inode == b->inode &&
+          a->size == b->size &&
+          a->mtime.tv_sec == b->mtime.tv_sec &&
+          a->mtime.tv_nsec == b->mtime.tv_nsec);
+}
+
+/* Returns whether @filename is still the file written by the tool itself. */
+static gboolean
+is_own_write (GcuWatch    *watch,
+              const gchar *filename)
+{
+  WrittenFile *written_file;
+  WrittenFile current;
+
+  written_file = g_hash_table_lookup (watch->written_files, filename);
+  if (written_file == NULL)
+    return FALSE;
+
+  if (get_written_file (filename, &current) &&
+      written_files_equal (written_file, &current))
+    return TRUE;
+
+  /* Modified by someone else since then. */
+  g_hash_table_remove (watch->written_files, filename);
+  return FALSE;
+}
+
+typedef struct _PendingFile PendingFile;
+struct _PendingFile
+{
+  GcuWatch *watch;
+  gchar *filename;
+};
+
+static void
+pending_file_free (gpointer data)
+{
+  PendingFile *pending_file = data;
+
+  g_free (pending_file->filename);
+  g_free (pending_file);
+}
+
+static gboolean
+debounce_timeout_cb (gpointer user_data)
+{
+  PendingFile *pending_file = user_data;
+  GcuWatch *watch = pending_file->watch;
+  const gchar *filename = pending_file->filename;
+
+  g_hash_table_remove (watch->pending_files, filename);
+
+  if (!is_own_write (watch, filename))
+    watch->func (watch, filename, watch->user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Restarts the debounce timeout of @filename. */
+static void
+add_pending_file (GcuWatch *watch,
+                  gchar    *filename)
+{
+  PendingFile *pending_file;
+  guint source_id;
+
+  source_id = GPOINTER_TO_UINT (g_hash_table_lookup (watch->pending_files, filename));
+  if (source_id != 0)
+    g_source_remove (source_id);
+
+  pending_file = g_new (PendingFile, 1);
+  pending_file->watch = watch;
+  pending_file->filename = g_strdup (filename);
+
+  source_id = g_timeout_add_full (G_PRIORITY_DEFAULT,
+                                  DEBOUNCE_MS,
+                                  debounce_timeout_cb,
+                                  pending_file,
+                                  pending_file_free);
+
+  g_hash_table_replace (watch->pending_files, filename, GUINT_TO_POINTER (source_id));
+}
+
+static gboolean
+add_directory (GcuWatch     *watch,
+               const gchar  *directory,
+               GError      **error)
+{
+  GDir *dir;
+  const gchar *basename;
+  gint wd;
+
+  wd = inotify_add_watch (watch->inotify_fd, directory, INOTIFY_MASK | IN_ONLYDIR);
+  if (wd == -1)
+    {
+      gint saved_errno = errno;
+
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   g_file_error_from_errno (saved_errno),
+                   "Failed to watch directory %s: %s",
+                   directory,
+                   g_strerror (saved_errno));
+      return FALSE;
+    }
+
+  g_hash_table_replace (watch->directories, GINT_TO_POINTER (wd), g_strdup (directory));
+
+  dir = g_dir_open (directory, 0, error);
+  if (dir == NULL)
+    return FALSE;
+
+  while ((basename = g_dir_read_name (dir)) != NULL)
+    {
+      gchar *path;
+
+      if (basename[0] == '.')
+        continue;
+
+      path = g_build_filename (directory, basename, NULL);
+
+      /* Symlinks to directories are not followed, to avoid loops. */
+      if (g_file_test (path, G_FILE_TEST_IS_DIR) &&
+          !g_file_test (path, G_FILE_TEST_IS_SYMLINK) &&
+          !add_directory (watch, path, error))
+        {
+          g_free (path);
+          g_dir_close (dir);
+          return FALSE;
+        }
+
+      g_free (path);
+    }
+
+  g_dir_close (dir);
+  return TRUE;
+}
+
+static void
+handle_inotify_event (GcuWatch                   *watch,
+                      const struct inotify_event *event)
+{
+  const gchar *directory;
+  gchar *path;
+
+  if (event->mask & IN_Q_OVERFLOW)
+    {
+      g_warning ("Too many file system events, some changes may have been missed.");
+      return;
+    }
+
+  if (event->mask & IN_IGNORED)
+    {
+      /* The directory has been removed. */
+      g_hash_table_remove (watch->directories, GINT_TO_POINTER (event->wd));
+      return;
+    }
+
+  directory = g_hash_table_lookup (watch->directories, GINT_TO_POINTER (event->wd));
+  if (directory == NULL || event->len == 0)
+    return;
+
+  if (event->mask & IN_ISDIR)
+    {
+      if (event->name[0] != '.' &&
+          (event->mask & (IN_CREATE | IN_MOVED_TO)))
+        {
+          GError *error = NULL;
+
+          path = g_build_filename (directory, event->name, NULL);
+          add_directory (watch, path, &error);
+
+          if (error != NULL)
+            {
+              g_warning ("%s", error->message);
+              g_clear_error (&error);
+            }
+
+          g_free (path);
+        }
+
+      return;
+    }
+
+  /* A file created empty is processed when it is closed after writing. */
+  if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) &&
+      is_watched_filename (event->name))
+    {
+      path = g_build_filename (directory, event->name, NULL);
+      add_pending_file (watch, path);
+    }
+}
+
+static gboolean
+inotify_readable_cb (gint         fd,
+                     GIOCondition condition,
+                     gpointer     user_data)
+{
+  GcuWatch *watch = user_data;
+  gchar buffer[64 * 1024] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+
+  while (TRUE)
+    {
+      gssize length;
+      gssize pos;
+
+      length = read (fd, buffer, sizeof (buffer));
+
+      if (length == -1)
+        {
+          gint saved_errno = errno;
+
+          if (saved_errno == EINTR)
+            continue;
+
+          if (saved_errno != EAGAIN)
+            g_warning ("Error when reading inotify events: %s", g_strerror (saved_errno));
+
+          break;
+        }
+
+      for (pos = 0; pos < length; )
+        {
+          const struct inotify_event *event = (const struct inotify_event *) (gpointer) (buffer + pos);
+
+          handle_inotify_event (watch, event);
+          pos += sizeof (struct inotify_event) + event->len;
+        }
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+#endif /* HAVE_INOTIFY */
+
+/* Returns: (transfer full) (nullable): a new #GcuWatch, for which @func is
+ * called from the default main context.
+ */
+GcuWatch *
+gcu_watch_new (const gchar   *directory,
+               GcuWatchFunc   func,
+               gpointer       user_data,
+               GError       **error)
+{
+#ifdef HAVE_INOTIFY
+  GcuWatch *watch;
+
+  g_return_val_if_fail (directory != NULL, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (!g_file_test (directory, G_FILE_TEST_IS_DIR))
+    {
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   G_FILE_ERROR_NOTDIR,
+                   "%s is not a directory",
+                   directory);
+      return NULL;
+    }
+
+  watch = g_new0 (GcuWatch, 1);
+  watch->func = func;
+  watch->user_data = user_data;
+  watch->inotify_fd = -1;
+  watch->directories = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  watch->pending_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  watch->written_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  watch->inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (watch->inotify_fd == -1)
+    {
+      gint saved_errno = errno;
+
+      g_set_error (error,
+                   G_FILE_ERROR,
+                   g_file_error_from_errno (saved_errno),
+                   "Failed to initialize inotify: %s",
+                   g_strerror (saved_errno));
+      gcu_watch_free (watch);
+      return NULL;
+    }
+
+  if (!add_directory (watch, directory, error))
+    {
+      gcu_watch_free (watch);
+      return NULL;
+    }
+
+  watch->inotify_source_id = g_unix_fd_add (watch->inotify_fd,
+                                            G_IO_IN,
+                                            inotify_readable_cb,
+                                            watch);
+
+  return watch;
+#else
+  g_set_error (error,
+               G_FILE_ERROR,
+               G_FILE_ERROR_NOSYS,
+               "Watching a directory is not supported on this platform.");
+  return NULL;
+#endif
+}
+
+void
+gcu_watch_free (GcuWatch *watch)
+{
+  GHashTableIter iter;
+  gpointer source_id;
+
+  if (watch == NULL)
+    return;
+
+  if (watch->inotify_source_id != 0)
+    g_source_remove (watch->inotify_source_id);
+
+  g_hash_table_iter_init (&iter, watch->pending_files);
+  while (g_hash_table_iter_next (&iter, NULL, &source_id))
+    g_source_remove (GPOINTER_TO_UINT (source_id));
+
+  /* Closing the inotify file descriptor removes all its watches. */
+  if (watch->inotify_fd != -1)
+    close (watch->inotify_fd);
+
+  g_hash_table_unref (watch->directories);
+  g_hash_table_unref (watch->pending_files);
+  g_hash_table_unref (watch->written_files);
+  g_free (watch);
+}
+
+/* To call after the function passed to gcu_watch_new() has written @filename,
+ * so that the events caused by the write are ignored.
+ */
+void
+gcu_watch_file_written (GcuWatch    *watch,
+                        const gchar *filename)
+{
+  WrittenFile *written_file;
+
+  g_return_if_fail (watch != NULL);
+  g_return_if_fail (filename != NULL);
+
+  written_file = g_new (WrittenFile, 1);
+
+  if (get_written_file (filename, written_file))
+    {
+      g_hash_table_replace (watch->written_files, g_strdup (filename), written_file);
+    }
+  else
+    {
+      g_hash_table_remove (watch->written_files, filename);
+      g_free (written_file);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GCU_WATCH_H
+#define GCU_WATCH_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GcuWatch GcuWatch;
+
+typedef void (* GcuWatchFunc) (GcuWatch    *watch,
+                               const gchar *filename,
+                               gpointer     user_data);
+
+GcuWatch *	gcu_watch_new			(const gchar   *directory,
+						 GcuWatchFunc   func,
+						 gpointer       user_data,
+						 GError       **error);
+
+void		gcu_watch_free			(GcuWatch      *watch);
+
+void		gcu_watch_file_written		(GcuWatch      *watch,
+						 const gchar   *filename);
+
+G_END_DECLS
+
+#endif /* GCU_WATCH_H */
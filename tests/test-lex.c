@@ -0,0 +1,212 @@
+/*
+ * This file is part of gnome-c-utils.
+ *
+ * Copyright © 2026 Sébastien Wilmet <swilmet@gnome.org>
+ *
+ * gnome-c-utils is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * gnome-c-utils is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with gnome-c-utils.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Tests of the spans found by gcu-lex.c. gcu-smart-c-comment-substitution,
+ * gcu-check-chain-ups and gcu-include-config-h decide what is a comment with
+ * these spans, so the cases where the lexer differs from a naive search of
+ * comment delimiters are pinned here: the #if 0 blocks, the comment-like text
+ * in the strings, and the continuation lines.
+ *
+ * The spans are compared as their text, joined with '|'.
+ */
+
+#include "gcu-lex.h"
+
+static gchar *
+get_spans_text (const gchar    *contents,
+                GcuLexSpanKind  kind)
+{
+  GcuLex *lex;
+  const GcuLexSpan *spans;
+  guint n_spans;
+  GString *text;
+  guint i;
+
+  lex = gcu_lex_new (contents, -1);
+  spans = gcu_lex_get_spans (lex, kind, &n_spans);
+  text = g_string_new (NULL);
+
+  for (i = 0; i < n_spans; i++)
+    {
+      const gchar *start;
+      const gchar *end;
+
+      start = g_utf8_offset_to_pointer (contents, spans[i].start);
+      end = g_utf8_offset_to_pointer (contents, spans[i].end);
+
+      if (i > 0)
+        g_string_append_c (text, '|');
+      g_string_append_len (text, start, end - start);
+    }
+
+  gcu_lex_free (lex);
+  return g_string_free (text, FALSE);
+}
+
+static void
+check_spans (const gchar    *contents,
+             GcuLexSpanKind  kind,
+             const gchar    *expected_text)
+{
+  gchar *text;
+
+  text = get_spans_text (contents, kind);
+  g_assert_cmpstr (text, ==, expected_text);
+  g_free (text);
+}
+
+static void
+test_comments (void)
+{
+  const gchar *contents =
+    "/* a */ int b; // c\n"
+    "/* multi\n"
+    "   line */\n"
+    "// continued \\\n"
+    "line\n"
+    "/* é */ x\n";
+
+  check_spans (contents, GCU_LEX_SPAN_COMMENT,
+               "/* a */|// c|/* multi\n   line */|// continued \\\nline|/* é */");
+}
+
+static void
+test_if_0 (void)
+{
+  const gchar *contents =
+    "#if 0\n"
+    "/* not lexed */ \"\n"
+    "#if A\n"
+    "#endif\n"
+    "#else\n"
+    "int a;\n"
+    "#endif\n"
+    "#if 0\n"
+    "b\n"
+    "#elif B\n"
+    "#endif\n";
+
+  check_spans (contents, GCU_LEX_SPAN_COMMENT,
+               "\n/* not lexed */ \"\n#if A\n#endif\n|"
+               "\nb\n");
+  check_spans (contents, GCU_LEX_SPAN_DIRECTIVE,
+               "#if 0|#else|#endif|#if 0|#elif B|#endif");
+  check_spans (contents, GCU_LEX_SPAN_STRING, "");
+}
+
+static void
+test_strings (void)
+{
+  const gchar *contents =
+    "s = \"/* not a comment */\";\n"
+    "t = \"// \\\" /*\";\n"
+    "c = '/'; d = '\\'';\n"
+    "/* \"not a string\" */\n";
+
+  check_spans (contents, GCU_LEX_SPAN_STRING,
+               "\"/* not a comment */\"|\"// \\\" /*\"|'/'|'\\''");
+  check_spans (contents, GCU_LEX_SPAN_COMMENT,
+               "/* \"not a string\" */");
+}
+
+static void
+test_directives (void)
+{
+  const gchar *contents =
+    "#include <a.h> // c\n"
+    "#define A(x) \\\n"
+    "  (x) /* c */\n"
+    "  # define B\n"
+    "int a = 1 # 2;\n";
+
+  check_spans (contents, GCU_LEX_SPAN_DIRECTIVE,
+               "#include <a.h> // c|#define A(x) \\\n  (x) /* c */|# define B");
+  check_spans (contents, GCU_LEX_SPAN_COMMENT, "// c|/* c */");
+}
+
+static void
+test_functions (void)
+{
+  const gchar *contents =
+    "static int\n"
+    "foo (int a) /* c */\n"
+    "{\n"
+    "  if (a) { return \"}\"[0]; }\n"
+    "  return 0;\n"
+    "}\n"
+    "struct s { int a; };\n"
+    "void (*get_func (void)) (int)\n"
+    "{\n"
+    "}\n";
+
+  /* The span starts at the name before the first '(', which is the return
+   * type for a function that returns a function pointer.
+   */
+  check_spans (contents, GCU_LEX_SPAN_FUNCTION,
+               "foo (int a) /* c */\n"
+               "{\n"
+               "  if (a) { return \"}\"[0]; }\n"
+               "  return 0;\n"
+               "}|"
+               "void (*get_func (void)) (int)\n"
+               "{\n"
+               "}");
+}
+
+static void
+test_find_span (void)
+{
+  const gchar *contents = "a /* b */ c";
+  GcuLex *lex;
+  const GcuLexSpan *span;
+
+  lex = gcu_lex_new (contents, -1);
+
+  g_assert_null (gcu_lex_find_span (lex, GCU_LEX_SPAN_COMMENT, 1));
+  span = gcu_lex_find_span (lex, GCU_LEX_SPAN_COMMENT, 2);
+  g_assert_nonnull (span);
+  g_assert_cmpuint (span->start, ==, 2);
+  g_assert_cmpuint (span->end, ==, 9);
+  g_assert_nonnull (gcu_lex_find_span (lex, GCU_LEX_SPAN_COMMENT, 8));
+  g_assert_null (gcu_lex_find_span (lex, GCU_LEX_SPAN_COMMENT, 9));
+
+  gcu_lex_free (lex);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  /* The inputs are small, but a cache file written by a previous version
+   * must not be used instead of the lexing.
+   */
+  g_setenv ("GCU_LEX_CACHE", "0", TRUE);
+
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/lex/comments", test_comments);
+  g_test_add_func ("/lex/if-0", test_if_0);
+  g_test_add_func ("/lex/strings", test_strings);
+  g_test_add_func ("/lex/directives", test_directives);
+  g_test_add_func ("/lex/functions", test_functions);
+  g_test_add_func ("/lex/find-span", test_find_span);
+
+  return g_test_run ();
+}
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Checks the statuses of the --results file of gcu-lineup-parameters: a file
+# that is realigned is "changed", and a file already aligned is "unchanged".
+#
+# Usage: test-lineup-parameters-results.sh GCU_LINEUP_PARAMETERS
+
+set -e
+
+program=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+printf 'void\nfoo (int a,\n  const char *b)\n{\n}\n' > "$dir/misaligned.c"
+printf 'void\nfoo (int         a,\n     const char *b)\n{\n}\n' > "$dir/aligned.c"
+
+"$program" --results="$dir/results.json" "$dir/misaligned.c" "$dir/aligned.c"
+
+grep -q "\"path\":\"$dir/misaligned.c\",\"status\":\"changed\"" "$dir/results.json"
+grep -q "\"path\":\"$dir/aligned.c\",\"status\":\"unchanged\"" "$dir/results.json"
+cmp "$dir/misaligned.c" "$dir/aligned.c"
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Checks that gcu-lineup-parameters --watch processes a file written in two
+# steps, like some text editors do, only once: after the second step, and not
+# on the half-written file.
+#
+# Usage: test-watch-debounce.sh GCU_LINEUP_PARAMETERS
+
+set -e
+
+program=$1
+dir=$(mktemp -d)
+pid=
+
+cleanup ()
+{
+  if [ -n "$pid" ]; then
+    kill "$pid" 2>/dev/null || true
+  fi
+
+  rm -rf "$dir"
+}
+
+trap cleanup EXIT
+
+mkdir "$dir/src"
+
+"$program" --watch="$dir/src" > "$dir/output" 2>&1 &
+pid=$!
+
+# Wait for the watch to start.
+i=0
+until grep -q '^Watching' "$dir/output"; do
+  if ! kill -0 "$pid" 2>/dev/null; then
+    # Without inotify, --watch is not supported: skip the test.
+    grep -q 'not supported' "$dir/output" && exit 77
+    cat "$dir/output"
+    exit 1
+  fi
+
+  i=$((i + 1))
+  [ $i -lt 100 ] || exit 1
+  sleep 0.1
+done
+
+# Each step closes the file, so each one is a separate event.
+printf 'void\nfoo (int a,\n  const char *b)\n{\n}\n' > "$dir/src/file.c"
+sleep 0.05
+printf '\nvoid\nbar (int a,\n  const char *b)\n{\n}\n' >> "$dir/src/file.c"
+
+sleep 1
+
+kill "$pid"
+wait "$pid" 2>/dev/null || true
+pid=
+
+cat "$dir/output"
+
+[ "$(grep -c '^Lined up parameters' "$dir/output")" -eq 1 ]
+
+printf 'void\nfoo (int         a,\n     const char *b)\n{\n}\n\nvoid\nbar (int         a,\n     const char *b)\n{\n}\n' > "$dir/expected.c"
+cmp "$dir/expected.c" "$dir/src/file.c"